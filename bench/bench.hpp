@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Number of operator new calls since program start, see alloc_counter.cpp.
+size_t allocationCount();
+
+// Prevent the optimizer from discarding a computed value.
+template <typename T>
+inline void doNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+    std::string name_;
+    size_t iterations_;
+    double nsPerOp_;
+    double bytesPerSec_;
+    double allocsPerOp_;
+};
+
+// Runs registered benchmarks and reports ns/op, bytes/s and allocations/op.
+class Runner {
+   public:
+    // bytesPerOp = 0 means throughput is not reported.
+    void add(const std::string &name, size_t bytesPerOp, const std::function<void()> &op) {
+        benchmarks_.push_back({name, bytesPerOp, op});
+    }
+
+    // Run all benchmarks whose name contains filter.
+    std::vector<Result> run(const std::string &filter, std::chrono::milliseconds minTime) {
+        std::vector<Result> results;
+        for (const auto &b : benchmarks_) {
+            if (b.name_.find(filter) == std::string::npos) {
+                continue;
+            }
+            results.push_back(runOne(b, minTime));
+        }
+        return results;
+    }
+
+    static void printTable(const std::vector<Result> &results) {
+        printf("%-44s %12s %12s %14s %10s\n", "benchmark", "iterations", "ns/op", "MB/s", "allocs/op");
+        for (const auto &r : results) {
+            printf("%-44s %12zu %12.1f ", r.name_.c_str(), r.iterations_, r.nsPerOp_);
+            if (r.bytesPerSec_ > 0) {
+                printf("%14.1f ", r.bytesPerSec_ / 1e6);
+            } else {
+                printf("%14s ", "-");
+            }
+            printf("%10.2f\n", r.allocsPerOp_);
+        }
+    }
+
+    static bool writeJson(const std::vector<Result> &results, const std::string &path) {
+        FILE *f = path == "-" ? stdout : fopen(path.c_str(), "w");
+        if (f == nullptr) {
+            return false;
+        }
+        fprintf(f, "{\"benchmarks\":[");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result &r = results[i];
+            fprintf(f,
+                    "%s\n{\"name\":\"%s\",\"iterations\":%zu,\"ns_per_op\":%.3f,"
+                    "\"bytes_per_sec\":%.1f,\"allocs_per_op\":%.3f}",
+                    i == 0 ? "" : ",",
+                    r.name_.c_str(),
+                    r.iterations_,
+                    r.nsPerOp_,
+                    r.bytesPerSec_,
+                    r.allocsPerOp_);
+        }
+        fprintf(f, "\n]}\n");
+        if (f != stdout) {
+            fclose(f);
+        }
+        return true;
+    }
+
+   private:
+    struct Benchmark {
+        std::string name_;
+        size_t bytesPerOp_;
+        std::function<void()> op_;
+    };
+
+    static Result runOne(const Benchmark &b, std::chrono::milliseconds minTime) {
+        using clock = std::chrono::steady_clock;
+
+        // warm up caches and lazily allocated state
+        for (int i = 0; i < 10; ++i) {
+            b.op_();
+        }
+
+        // grow the batch until it runs for at least minTime
+        size_t iterations = 1;
+        while (true) {
+            size_t allocsBefore = allocationCount();
+            auto start = clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                b.op_();
+            }
+            auto elapsed = clock::now() - start;
+            size_t allocs = allocationCount() - allocsBefore;
+
+            if (elapsed >= minTime || iterations >= (size_t(1) << 32)) {
+                double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+                double nsPerOp = ns / iterations;
+                double bytesPerSec = b.bytesPerOp_ > 0 ? b.bytesPerOp_ * 1e9 / nsPerOp : 0;
+                return {b.name_,
+                        iterations,
+                        nsPerOp,
+                        bytesPerSec,
+                        static_cast<double>(allocs) / iterations};
+            }
+            iterations *= 2;
+        }
+    }
+
+    std::vector<Benchmark> benchmarks_;
+};
+
+}  // namespace bench
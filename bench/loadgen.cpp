@@ -0,0 +1,765 @@
+// Loopback load generator. Forks a beauty::Server into a child process and
+// drives it with many concurrent client connections from the parent, so the
+// reported RSS belongs to the server only.
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <asio.hpp>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "file_io.hpp"
+#include "server.hpp"
+
+using namespace beauty;
+using clock_type = std::chrono::steady_clock;
+
+namespace {
+
+enum class Workload { get, download, upload, mixed };
+
+// How clients reach the server, "both" runs each config over each.
+enum class Transport { tcp, unix_socket, both };
+
+const char *toString(Workload w) {
+    switch (w) {
+        case Workload::get:
+            return "get";
+        case Workload::download:
+            return "download";
+        case Workload::upload:
+            return "upload";
+        case Workload::mixed:
+            return "mixed";
+    }
+    return "";
+}
+
+struct Options {
+    size_t connections_ = 100;
+    std::chrono::seconds duration_{5};
+    std::chrono::milliseconds timeout_{2000};
+    Workload workload_ = Workload::mixed;
+    bool clientClose_ = false;
+    size_t maxContentSize_ = 1024;
+    size_t downloadSize_ = 1024 * 1024;
+    size_t uploadSize_ = 64 * 1024;
+    bool sweep_ = false;
+    Transport transport_ = Transport::tcp;
+    bool socketSweep_ = false;
+    std::string jsonPath_;
+};
+
+// Server configuration of a single run.
+struct ServerConfig {
+    std::string name_;
+    HttpPersistence persistence_;
+    size_t maxContentSize_;
+    // Listen on a Unix domain socket instead of loopback TCP.
+    bool unixSocket_;
+    SocketOptions socketOptions_;
+};
+
+struct Stats {
+    size_t requests_ = 0;
+    size_t errors_ = 0;
+    size_t timeouts_ = 0;
+    size_t bytesSent_ = 0;
+    size_t bytesReceived_ = 0;
+    std::vector<uint32_t> latenciesUs_;
+};
+
+struct RunResult {
+    std::string config_;
+    std::string workload_;
+    size_t connections_;
+    size_t requests_;
+    size_t errors_;
+    size_t timeouts_;
+    double rps_;
+    double rxMBps_;
+    double p50Ms_;
+    double p99Ms_;
+    double p999Ms_;
+    size_t serverRssKb_;
+    size_t serverPeakRssKb_;
+};
+
+// Reads a "Name:   1234 kB" line from /proc/<pid>/status.
+size_t readProcStatusKb(pid_t pid, const std::string &name) {
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, name.size(), name) == 0 && line[name.size()] == ':') {
+            return std::strtoul(line.c_str() + name.size() + 1, nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+double percentile(std::vector<uint32_t> &values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t n = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n] / 1000.0;
+}
+
+std::string multiPartBody(const std::string &boundary, size_t size) {
+    std::string body = "--" + boundary +
+                       "\r\nContent-Disposition: form-data; name=\"file1\"; "
+                       "filename=\"upload.bin\"\r\n"
+                       "Content-Type: application/octet-stream\r\n\r\n";
+    body.append(size, 'u');
+    body += "\r\n--" + boundary + "--\r\n";
+    return body;
+}
+
+// The requests sent by the clients, prepared once.
+struct Requests {
+    Requests(const Options &options) {
+        std::string connection = options.clientClose_ ? "close" : "keep-alive";
+        std::string common = "Host: 127.0.0.1\r\nAccept: */*\r\nConnection: " + connection + "\r\n";
+        get_ = "GET /small.html HTTP/1.1\r\n" + common + "\r\n";
+        download_ = "GET /large.bin HTTP/1.1\r\n" + common + "\r\n";
+
+        const std::string boundary = "----beautyLoadgenBoundary7MA4YWxkTrZu0gW";
+        std::string body = multiPartBody(boundary, options.uploadSize_);
+        upload_ = "POST /upload/ HTTP/1.1\r\n" + common +
+                  "Content-Type: multipart/form-data; boundary=" + boundary +
+                  "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    }
+
+    std::string get_;
+    std::string download_;
+    std::string upload_;
+};
+
+// One client connection issuing requests back to back until the deadline.
+class Client : public std::enable_shared_from_this<Client> {
+   public:
+    Client(asio::io_context &ioc,
+           const asio::generic::stream_protocol::endpoint &endpoint,
+           const Options &options,
+           const Requests &requests,
+           Stats &stats,
+           size_t index,
+           clock_type::time_point deadline)
+        : ioc_(ioc),
+          socket_(ioc),
+          timer_(ioc),
+          endpoint_(endpoint),
+          options_(options),
+          requests_(requests),
+          stats_(stats),
+          counter_(index),
+          deadline_(deadline) {}
+
+    void start() {
+        doConnect();
+    }
+
+   private:
+    void doConnect() {
+        if (clock_type::now() >= deadline_) {
+            return;
+        }
+        socket_ = asio::generic::stream_protocol::socket(ioc_);
+        // close-per-request latency includes the connect
+        requestStart_ = clock_type::now();
+        armTimer();
+        auto self(shared_from_this());
+        socket_.async_connect(endpoint_, [this, self, gen = generation_](std::error_code ec) {
+            if (gen != generation_) {
+                return;
+            }
+            if (ec) {
+                fail(false);
+                return;
+            }
+            // fails on Unix domain sockets, which have no Nagle delay
+            std::error_code ignored;
+            socket_.set_option(asio::ip::tcp::no_delay(true), ignored);
+            doWrite();
+        });
+    }
+
+    void doWrite() {
+        if (clock_type::now() >= deadline_) {
+            close();
+            return;
+        }
+        const std::string *request = nextRequest();
+        auto self(shared_from_this());
+        asio::async_write(
+            socket_,
+            asio::buffer(*request),
+            [this, self, gen = generation_](std::error_code ec, std::size_t n) {
+                if (gen != generation_) {
+                    return;
+                }
+                if (ec) {
+                    fail(false);
+                    return;
+                }
+                stats_.bytesSent_ += n;
+                doReadHead();
+            });
+    }
+
+    void doReadHead() {
+        auto self(shared_from_this());
+        asio::async_read_until(
+            socket_,
+            response_,
+            "\r\n\r\n",
+            [this, self, gen = generation_](std::error_code ec, std::size_t n) {
+                if (gen != generation_) {
+                    return;
+                }
+                if (ec) {
+                    fail(false);
+                    return;
+                }
+                stats_.bytesReceived_ += n;
+                std::string head(asio::buffers_begin(response_.data()),
+                                 asio::buffers_begin(response_.data()) + n);
+                response_.consume(n);
+
+                // Beauty adds a Connection header to every final response.
+                // The acknowledgements written while a multipart upload is
+                // received have none and are skipped.
+                std::string connection = headerValue(head, "Connection");
+                if (connection.empty()) {
+                    doReadHead();
+                    return;
+                }
+                serverClose_ = connection == "close";
+                if (head.compare(0, 9, "HTTP/1.0 ") != 0 && head.compare(0, 9, "HTTP/1.1 ") != 0) {
+                    fail(false);
+                    return;
+                }
+                if (head[9] != '2') {
+                    stats_.errors_++;
+                }
+                std::string contentLength = headerValue(head, "Content-Length");
+                doReadBody(std::strtoul(contentLength.c_str(), nullptr, 10));
+            });
+    }
+
+    void doReadBody(size_t contentLength) {
+        size_t buffered = std::min(contentLength, response_.size());
+        response_.consume(buffered);
+        stats_.bytesReceived_ += buffered;
+        size_t remaining = contentLength - buffered;
+        if (remaining == 0) {
+            handleResponse();
+            return;
+        }
+        body_.resize(std::min<size_t>(remaining, 64 * 1024));
+        auto self(shared_from_this());
+        socket_.async_read_some(
+            asio::buffer(body_),
+            [this, self, remaining, gen = generation_](std::error_code ec, std::size_t n) {
+                if (gen != generation_) {
+                    return;
+                }
+                if (ec) {
+                    fail(false);
+                    return;
+                }
+                stats_.bytesReceived_ += n;
+                if (n < remaining) {
+                    doReadBody(remaining - n);
+                } else {
+                    handleResponse();
+                }
+            });
+    }
+
+    void handleResponse() {
+        auto latency = clock_type::now() - requestStart_;
+        stats_.latenciesUs_.push_back(static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+        stats_.requests_++;
+
+        timer_.cancel();
+        if (options_.clientClose_ || serverClose_) {
+            close();
+            doConnect();
+        } else {
+            requestStart_ = clock_type::now();
+            armTimer();
+            doWrite();
+        }
+    }
+
+    const std::string *nextRequest() {
+        Workload workload = options_.workload_;
+        if (workload == Workload::mixed) {
+            // 80% small GET, 10% each of download and upload
+            static const Workload mix[] = {Workload::get,
+                                           Workload::get,
+                                           Workload::download,
+                                           Workload::get,
+                                           Workload::upload,
+                                           Workload::get,
+                                           Workload::get,
+                                           Workload::get,
+                                           Workload::get,
+                                           Workload::get};
+            workload = mix[counter_++ % 10];
+        }
+        switch (workload) {
+            case Workload::download:
+                return &requests_.download_;
+            case Workload::upload:
+                return &requests_.upload_;
+            default:
+                return &requests_.get_;
+        }
+    }
+
+    static std::string headerValue(const std::string &head, const std::string &name) {
+        size_t pos = head.find("\r\n" + name + ": ");
+        if (pos == std::string::npos) {
+            return "";
+        }
+        pos += name.size() + 4;
+        return head.substr(pos, head.find("\r\n", pos) - pos);
+    }
+
+    void armTimer() {
+        auto self(shared_from_this());
+        timer_.expires_after(options_.timeout_);
+        timer_.async_wait([this, self, gen = generation_](std::error_code ec) {
+            if (!ec && gen == generation_) {
+                fail(true);
+            }
+        });
+    }
+
+    void fail(bool timedOut) {
+        if (timedOut) {
+            stats_.timeouts_++;
+        } else {
+            stats_.errors_++;
+        }
+        close();
+        doConnect();
+    }
+
+    // Handlers of a closed socket see a new generation and return early.
+    void close() {
+        generation_++;
+        timer_.cancel();
+        std::error_code ignored;
+        socket_.close(ignored);
+        response_.consume(response_.size());
+    }
+
+    asio::io_context &ioc_;
+    asio::generic::stream_protocol::socket socket_;
+    asio::steady_timer timer_;
+    const asio::generic::stream_protocol::endpoint endpoint_;
+    const Options &options_;
+    const Requests &requests_;
+    Stats &stats_;
+    size_t counter_;
+    const clock_type::time_point deadline_;
+    clock_type::time_point requestStart_;
+    asio::streambuf response_;
+    std::vector<char> body_;
+    bool serverClose_ = false;
+    unsigned generation_ = 0;
+};
+
+// Starts a server in a child process and returns its pid and port, 0 when
+// listening on socketPath.
+pid_t startServer(const ServerConfig &config,
+                  const std::string &docRoot,
+                  const std::string &socketPath,
+                  uint16_t &port) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        asio::io_context ioc;
+        FileIO fileIO(docRoot);
+        // the advanced constructors stop the server on SIGTERM
+        std::vector<Listener> listeners(1,
+                                        config.unixSocket_ ? Listener::unixSocket(socketPath)
+                                                           : Listener("127.0.0.1", "0"));
+        Server server(ioc,
+                      listeners,
+                      &fileIO,
+                      config.persistence_,
+                      config.maxContentSize_,
+                      config.socketOptions_);
+        uint16_t serverPort = server.getBindedPort();
+        if (write(fds[1], &serverPort, sizeof(serverPort)) != sizeof(serverPort)) {
+            _exit(1);
+        }
+        close(fds[1]);
+        ioc.run();
+        _exit(0);
+    }
+    close(fds[1]);
+    if (pid < 0 || read(fds[0], &port, sizeof(port)) != sizeof(port)) {
+        close(fds[0]);
+        return -1;
+    }
+    close(fds[0]);
+    return pid;
+}
+
+RunResult run(const Options &options, const ServerConfig &config, const std::string &docRoot) {
+    RunResult result{config.name_, toString(options.workload_), options.connections_};
+
+    uint16_t port = 0;
+    std::string socketPath = docRoot + ".sock";
+    pid_t pid = startServer(config, docRoot, socketPath, port);
+    if (pid < 0) {
+        std::cerr << "failed to start server\n";
+        return result;
+    }
+
+    asio::io_context ioc;
+    asio::generic::stream_protocol::endpoint endpoint =
+        config.unixSocket_
+            ? asio::generic::stream_protocol::endpoint(
+                  asio::local::stream_protocol::endpoint(socketPath))
+            : asio::generic::stream_protocol::endpoint(
+                  asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+    Requests requests(options);
+    Stats stats;
+    auto start = clock_type::now();
+    auto deadline = start + options.duration_;
+    for (size_t i = 0; i < options.connections_; ++i) {
+        std::make_shared<Client>(ioc, endpoint, options, requests, stats, i, deadline)->start();
+    }
+
+    // sample the server memory while under load
+    size_t maxRssKb = 0;
+    asio::steady_timer sampler(ioc);
+    std::function<void(std::error_code)> sample = [&](std::error_code ec) {
+        if (ec) {
+            return;
+        }
+        maxRssKb = std::max(maxRssKb, readProcStatusKb(pid, "VmRSS"));
+        if (clock_type::now() < deadline) {
+            sampler.expires_after(std::chrono::milliseconds(100));
+            sampler.async_wait(sample);
+        }
+    };
+    sample({});
+    ioc.run();
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    result.requests_ = stats.requests_;
+    result.errors_ = stats.errors_;
+    result.timeouts_ = stats.timeouts_;
+    result.rps_ = stats.requests_ / elapsed;
+    result.rxMBps_ = stats.bytesReceived_ / elapsed / 1e6;
+    result.p50Ms_ = percentile(stats.latenciesUs_, 0.50);
+    result.p99Ms_ = percentile(stats.latenciesUs_, 0.99);
+    result.p999Ms_ = percentile(stats.latenciesUs_, 0.999);
+    result.serverRssKb_ = maxRssKb;
+    result.serverPeakRssKb_ = readProcStatusKb(pid, "VmHWM");
+
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    std::remove(socketPath.c_str());
+    return result;
+}
+
+void printTable(const std::vector<RunResult> &results) {
+    printf("%-36s %-9s %6s %9s %7s %7s %10s %9s %8s %8s %8s %9s %9s\n",
+           "config",
+           "workload",
+           "conns",
+           "requests",
+           "errors",
+           "tmouts",
+           "rps",
+           "rx MB/s",
+           "p50 ms",
+           "p99 ms",
+           "p999 ms",
+           "rss kB",
+           "peak kB");
+    for (const auto &r : results) {
+        printf("%-36s %-9s %6zu %9zu %7zu %7zu %10.0f %9.1f %8.2f %8.2f %8.2f %9zu %9zu\n",
+               r.config_.c_str(),
+               r.workload_.c_str(),
+               r.connections_,
+               r.requests_,
+               r.errors_,
+               r.timeouts_,
+               r.rps_,
+               r.rxMBps_,
+               r.p50Ms_,
+               r.p99Ms_,
+               r.p999Ms_,
+               r.serverRssKb_,
+               r.serverPeakRssKb_);
+    }
+}
+
+bool writeJson(const std::vector<RunResult> &results, const std::string &path) {
+    FILE *f = path == "-" ? stdout : fopen(path.c_str(), "w");
+    if (f == nullptr) {
+        return false;
+    }
+    fprintf(f, "{\"runs\":[");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const RunResult &r = results[i];
+        fprintf(f,
+                "%s\n{\"config\":\"%s\",\"workload\":\"%s\",\"connections\":%zu,"
+                "\"requests\":%zu,\"errors\":%zu,\"timeouts\":%zu,\"rps\":%.1f,"
+                "\"rx_mb_per_sec\":%.3f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,"
+                "\"server_rss_kb\":%zu,\"server_peak_rss_kb\":%zu}",
+                i == 0 ? "" : ",",
+                r.config_.c_str(),
+                r.workload_.c_str(),
+                r.connections_,
+                r.requests_,
+                r.errors_,
+                r.timeouts_,
+                r.rps_,
+                r.rxMBps_,
+                r.p50Ms_,
+                r.p99Ms_,
+                r.p999Ms_,
+                r.serverRssKb_,
+                r.serverPeakRssKb_);
+    }
+    fprintf(f, "\n]}\n");
+    if (f != stdout) {
+        fclose(f);
+    }
+    return true;
+}
+
+std::string persistenceName(const HttpPersistence &p) {
+    if (p.keepAliveTimeout_.count() == 0) {
+        return "close";
+    }
+    std::string name = "keep-alive";
+    if (p.connectionLimit_ > 0) {
+        name += " limit=" + std::to_string(p.connectionLimit_);
+    }
+    return name;
+}
+
+// One scenario per socket option, each compared to the defaults. Options
+// acting on the accept path show best with --close, TCP_FASTOPEN only has
+// an effect on clients sending data in the SYN.
+std::vector<std::pair<std::string, SocketOptions>> socketScenarios(const Options &options) {
+    using std::chrono::seconds;
+    std::vector<std::pair<std::string, SocketOptions>> scenarios;
+    scenarios.push_back({"", SocketOptions()});
+    if (!options.socketSweep_) {
+        return scenarios;
+    }
+    scenarios.push_back({" nodelay", SocketOptions(true)});
+    scenarios.push_back({" sndbuf=rcvbuf=256k", SocketOptions(false, 256 * 1024, 256 * 1024)});
+    scenarios.push_back({" defer-accept", SocketOptions(false, 0, 0, seconds(1))});
+    scenarios.push_back({" fastopen", SocketOptions(false, 0, 0, seconds(0), 256)});
+    scenarios.push_back({" quickack", SocketOptions(false, 0, 0, seconds(0), 0, true)});
+    scenarios.push_back(
+        {" tcp-keepalive",
+         SocketOptions(false, 0, 0, seconds(0), 0, false, seconds(60), seconds(10), 3)});
+    scenarios.push_back(
+        {" backlog=16",
+         SocketOptions(false, 0, 0, seconds(0), 0, false, seconds(0), seconds(0), 0, 16)});
+    scenarios.push_back(
+        {" accept-batch=64",
+         SocketOptions(false, 0, 0, seconds(0), 0, false, seconds(0), seconds(0), 0, 0, 64)});
+    return scenarios;
+}
+
+std::vector<ServerConfig> serverConfigs(const Options &options) {
+    std::vector<HttpPersistence> persistences;
+    std::vector<size_t> contentSizes;
+    if (options.sweep_) {
+        persistences = {HttpPersistence(std::chrono::seconds(0), 0, 0),
+                        HttpPersistence(std::chrono::seconds(5), 1000, 0),
+                        HttpPersistence(std::chrono::seconds(5), 1000, options.connections_ / 2)};
+        contentSizes = {1024, 4096, 16384, 65536};
+    } else {
+        persistences = {HttpPersistence(std::chrono::seconds(5), 1000, 0)};
+        contentSizes = {options.maxContentSize_};
+    }
+
+    std::vector<bool> unixSockets;
+    if (options.transport_ != Transport::unix_socket) {
+        unixSockets.push_back(false);
+    }
+    if (options.transport_ != Transport::tcp) {
+        unixSockets.push_back(true);
+    }
+
+    std::vector<ServerConfig> configs;
+    for (const auto &persistence : persistences) {
+        for (size_t contentSize : contentSizes) {
+            for (bool unixSocket : unixSockets) {
+                for (const auto &scenario : socketScenarios(options)) {
+                    configs.push_back({persistenceName(persistence) + " max=" +
+                                           std::to_string(contentSize) +
+                                           (unixSocket ? " unix" : "") + scenario.first,
+                                       persistence,
+                                       contentSize,
+                                       unixSocket,
+                                       scenario.second});
+                }
+            }
+        }
+    }
+    return configs;
+}
+
+void createDocRoot(const std::string &docRoot, const Options &options) {
+    std::filesystem::create_directories(docRoot + "/upload");
+    std::ofstream(docRoot + "/small.html") << "<html><body><h1>beauty loadgen</h1></body></html>\n";
+    std::ofstream large(docRoot + "/large.bin", std::ios::binary);
+    std::string block(4096, 'x');
+    for (size_t written = 0; written < options.downloadSize_; written += block.size()) {
+        large.write(block.data(), std::min(block.size(), options.downloadSize_ - written));
+    }
+}
+
+// Allow thousands of sockets, the server child inherits the limit.
+void raiseFileLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+bool parseWorkload(const std::string &name, Workload &workload) {
+    const Workload all[] = {Workload::get, Workload::download, Workload::upload, Workload::mixed};
+    for (Workload w : all) {
+        if (name == toString(w)) {
+            workload = w;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseTransport(const std::string &name, Transport &transport) {
+    if (name == "tcp") {
+        transport = Transport::tcp;
+    } else if (name == "unix") {
+        transport = Transport::unix_socket;
+    } else if (name == "both") {
+        transport = Transport::both;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void usage() {
+    std::cerr
+        << "Usage: beauty_loadgen [options]\n"
+           "  --connections <n>       concurrent client connections (100)\n"
+           "  --duration <s>          seconds per run (5)\n"
+           "  --timeout <ms>          per request timeout (2000)\n"
+           "  --workload <name>       get|download|upload|mixed (mixed)\n"
+           "  --close                 close the connection after each request\n"
+           "  --max-content-size <n>  server maxContentSize (1024)\n"
+           "  --download-size <n>     size of the downloaded file (1048576)\n"
+           "  --upload-size <n>       size of the uploaded file (65536)\n"
+           "  --sweep                 sweep maxContentSize and HttpPersistence\n"
+           "  --transport <name>      tcp|unix|both, loopback TCP or Unix domain socket (tcp)\n"
+           "  --socket-sweep          run each SocketOptions scenario against the defaults\n"
+           "  --json <file|->         write results as JSON\n";
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--close") {
+            options.clientClose_ = true;
+            continue;
+        } else if (arg == "--sweep") {
+            options.sweep_ = true;
+            continue;
+        } else if (arg == "--socket-sweep") {
+            options.socketSweep_ = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        std::string val = argv[++i];
+        if (arg == "--connections") {
+            options.connections_ = std::stoul(val);
+        } else if (arg == "--duration") {
+            options.duration_ = std::chrono::seconds(std::stoul(val));
+        } else if (arg == "--timeout") {
+            options.timeout_ = std::chrono::milliseconds(std::stoul(val));
+        } else if (arg == "--workload" && parseWorkload(val, options.workload_)) {
+        } else if (arg == "--transport" && parseTransport(val, options.transport_)) {
+        } else if (arg == "--max-content-size") {
+            options.maxContentSize_ = std::stoul(val);
+        } else if (arg == "--download-size") {
+            options.downloadSize_ = std::stoul(val);
+        } else if (arg == "--upload-size") {
+            options.uploadSize_ = std::stoul(val);
+        } else if (arg == "--json") {
+            options.jsonPath_ = val;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    raiseFileLimit();
+    signal(SIGPIPE, SIG_IGN);
+
+    std::string docRoot = std::filesystem::temp_directory_path().string() + "/beauty_loadgen_" +
+                          std::to_string(getpid());
+    createDocRoot(docRoot, options);
+
+    std::vector<RunResult> results;
+    for (const auto &config : serverConfigs(options)) {
+        if (options.jsonPath_ != "-") {
+            std::cerr << "running " << config.name_ << " ...\n";
+        }
+        results.push_back(run(options, config, docRoot));
+    }
+    std::filesystem::remove_all(docRoot);
+
+    if (options.jsonPath_ != "-") {
+        printTable(results);
+    }
+    if (!options.jsonPath_.empty() && !writeJson(results, options.jsonPath_)) {
+        std::cerr << "failed to write " << options.jsonPath_ << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -2,7 +2,9 @@
 #include <iostream>
 #include <string>
 
+#include "async_log_sink.hpp"
 #include "file_io.hpp"
+#include "listener_handoff.hpp"
 #include "my_file_api.hpp"
 #include "server.hpp"
 
@@ -27,9 +29,27 @@ int main(int argc, char *argv[]) {
         FileIO fileIO(argv[3]);
         HttpPersistence persistentOption(5s, 1000, 0);
         MyFileApi fileApi(argv[3]);
-        Server s(ioc, argv[1], argv[2], &fileIO, persistentOption, 1024);
+        // Format and print log messages on a background thread.
+        AsyncLogSink logSink(
+            [](LogLevel level, const std::string &msg) {
+                std::cout << toString(level) << ": " << msg << std::endl;
+            },
+            LogLevel::info);
+        // Serve the sockets passed by systemd socket activation, if any.
+        std::vector<Listener> listeners;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+        listeners = systemdListeners();
+#endif
+        if (listeners.empty()) {
+            listeners.push_back(Listener(argv[1], argv[2]));
+        }
+        Server s(ioc, listeners, &fileIO, persistentOption, 1024);
         s.addRequestHandler(std::bind(&MyFileApi::handleRequest, &fileApi, _1, _2));
-        s.setDebugMsgHandler([](const std::string &msg) { std::cout << msg << std::endl; });
+        s.setLogSink(&logSink);
+        // Also serve clients speaking cleartext HTTP/2.
+        s.setHttp2(Http2Options(true));
+        // Accept uploads with curl -T.
+        s.setRawUploads(true);
 
         // Run the server until stopped with Ctrl-C.
         ioc.run();
@@ -0,0 +1,60 @@
+#include "async_log_sink.hpp"
+
+namespace beauty {
+
+AsyncLogSink::AsyncLogSink(const outputCallback &output, LogLevel minLevel, size_t maxQueueSize)
+    : output_(output), minLevel_(minLevel), maxQueueSize_(maxQueueSize) {
+    thread_ = std::thread(&AsyncLogSink::run, this);
+}
+
+AsyncLogSink::~AsyncLogSink() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+bool AsyncLogSink::accepts(LogLevel level) const {
+    return level >= minLevel_;
+}
+
+void AsyncLogSink::write(LogLevel level, logFormatter &&format) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= maxQueueSize_) {
+            droppedCount_++;
+            return;
+        }
+        queue_.push_back({level, std::move(format)});
+    }
+    cv_.notify_one();
+}
+
+size_t AsyncLogSink::getDroppedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return droppedCount_;
+}
+
+void AsyncLogSink::run() {
+    std::deque<Entry> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty() && stop_) {
+            return;
+        }
+        // format and output outside the lock so the io_context thread is
+        // never blocked by slow output
+        batch.swap(queue_);
+        lock.unlock();
+        for (auto &entry : batch) {
+            output_(entry.level_, entry.format_());
+        }
+        batch.clear();
+        lock.lock();
+    }
+}
+
+}  // namespace beauty
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "logger.hpp"
+
+namespace beauty {
+
+// Log sink that hands message formatting and output to a background thread,
+// intended for PC builds. The io_context thread only queues the deferred
+// formatter. When the queue is full new messages are dropped and counted.
+class AsyncLogSink : public ILogSink {
+   public:
+    using outputCallback = std::function<void(LogLevel level, const std::string &msg)>;
+
+    AsyncLogSink(const AsyncLogSink &) = delete;
+    AsyncLogSink &operator=(const AsyncLogSink &) = delete;
+
+    explicit AsyncLogSink(const outputCallback &output,
+                          LogLevel minLevel = LogLevel::debug,
+                          size_t maxQueueSize = 1024);
+
+    // Writes all queued messages before returning.
+    ~AsyncLogSink();
+
+    bool accepts(LogLevel level) const override;
+    void write(LogLevel level, logFormatter &&format) override;
+
+    // Number of messages dropped due to a full queue.
+    size_t getDroppedCount() const;
+
+   private:
+    void run();
+
+    struct Entry {
+        LogLevel level_;
+        logFormatter format_;
+    };
+
+    outputCallback output_;
+    const LogLevel minLevel_;
+    const size_t maxQueueSize_;
+
+    std::deque<Entry> queue_;
+    size_t droppedCount_ = 0;
+    bool stop_ = false;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
+}  // namespace beauty
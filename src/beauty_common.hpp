@@ -12,7 +12,6 @@ namespace beauty {
 using handlerCallback = std::function<void(const Request &req, Reply &rep)>;
 
 using debugMsgCallback = std::function<void(const std::string &msg)>;
-static void defaultDebugMsgHandler(const std::string &msg) {}
 
 struct HttpPersistence {
     HttpPersistence(std::chrono::seconds keepAliveTimeout,
@@ -37,4 +36,275 @@ struct HttpPersistence {
     size_t connectionLimit_;
 };
 
+struct AdmissionControl {
+    // What to do with new clients when a limit is reached and no idle
+    // keep-alive connection can be evicted.
+    enum Policy {
+        // Stop accepting, clients wait in the listen backlog until a
+        // connection closes.
+        pause_accept,
+        // Accept and reply 503 Service Unavailable with Retry-After.
+        reject_503
+    };
+
+    AdmissionControl(size_t maxConnections = 0,
+                     size_t bufferBudget = 0,
+                     Policy policy = pause_accept,
+                     std::chrono::seconds retryAfter = std::chrono::seconds(1))
+        : maxConnections_(maxConnections),
+          bufferBudget_(bufferBudget),
+          policy_(policy),
+          retryAfter_(retryAfter) {}
+
+    // Hard limit of open connections.
+    // 0 = no limit.
+    size_t maxConnections_;
+
+    // Limit in bytes of the buffer memory borrowed from the buffer pool by
+    // open connections. A new client is admitted if the buffers in use and
+    // the smallest receive and reply buffers of its first request fit.
+    // 0 = no limit.
+    size_t bufferBudget_;
+
+    Policy policy_;
+
+    // Sent in Retry-After header of 503 replies.
+    std::chrono::seconds retryAfter_;
+};
+
+struct Http2Options {
+    Http2Options(bool enabled = false,
+                 size_t maxConcurrentStreams = 8,
+                 size_t headerTableSize = 4096)
+        : enabled_(enabled),
+          maxConcurrentStreams_(maxConcurrentStreams),
+          headerTableSize_(headerTableSize) {}
+
+    // Accept cleartext HTTP/2 (h2c), with prior knowledge or by an Upgrade
+    // of the first request.
+    bool enabled_;
+
+    // Streams a client may have open at once on a connection. Sent in
+    // SETTINGS_MAX_CONCURRENT_STREAMS, further streams are refused.
+    size_t maxConcurrentStreams_;
+
+    // Bound of the HPACK dynamic table of each connection. Sent in
+    // SETTINGS_HEADER_TABLE_SIZE.
+    size_t headerTableSize_;
+};
+
+// Deadlines of the phases of a request, with or without keep-alive, so that
+// slow or stalled clients cannot hold connections and their buffers. Checked
+// every second, on the connection tick.
+// 0 = disabled.
+struct ConnectionTimeouts {
+    ConnectionTimeouts(std::chrono::seconds headerTimeout = std::chrono::seconds(0),
+                       size_t minBodyRate = 0,
+                       size_t minSendRate = 0,
+                       std::chrono::seconds handlerTimeout = std::chrono::seconds(0),
+                       std::chrono::seconds gracePeriod = std::chrono::seconds(5))
+        : headerTimeout_(headerTimeout),
+          minBodyRate_(minBodyRate),
+          minSendRate_(minSendRate),
+          handlerTimeout_(handlerTimeout),
+          gracePeriod_(gracePeriod) {}
+
+    // Time from accept, or from the first byte of a later request on a
+    // keep-alive connection, until the request headers are complete.
+    // Includes the TLS handshake.
+    std::chrono::seconds headerTimeout_;
+
+    // Bytes per second a request body must arrive at on average, once the
+    // grace period has passed.
+    size_t minBodyRate_;
+
+    // Bytes per second each response write must progress at: a write of n
+    // bytes has gracePeriod_ + n / minSendRate_ to complete.
+    size_t minSendRate_;
+
+    // Time a body consumer may keep the body paused.
+    std::chrono::seconds handlerTimeout_;
+
+    std::chrono::seconds gracePeriod_;
+};
+
+// Limits per client IP address, see Server::setRateLimit(). Clients over a
+// limit get 429 Too Many Requests.
+struct RateLimit {
+    RateLimit(size_t requestsPerSecond = 0,
+              size_t burst = 1,
+              size_t maxConnectionsPerClient = 0,
+              size_t tableSize = 4096,
+              std::chrono::seconds retryAfter = std::chrono::seconds(1))
+        : requestsPerSecond_(requestsPerSecond),
+          burst_(burst),
+          maxConnectionsPerClient_(maxConnectionsPerClient),
+          tableSize_(tableSize),
+          retryAfter_(retryAfter) {}
+
+    // Sustained rate of new connections and requests of a client, which may
+    // exceed it by burst_ at once.
+    // 0 = no limit.
+    size_t requestsPerSecond_;
+    size_t burst_;
+
+    // Open connections of a client.
+    // 0 = no limit.
+    size_t maxConnectionsPerClient_;
+
+    // Number of clients tracked at once. The table is allocated up front and
+    // never grows, clients not seen for a while make room for new ones.
+    size_t tableSize_;
+
+    // Sent in Retry-After header of 429 replies.
+    std::chrono::seconds retryAfter_;
+};
+
+// An endpoint the server accepts connections on, see the Server constructor
+// taking a list of listeners.
+struct Listener {
+    enum Type { tcp, unix_socket, descriptor };
+
+    // TCP on address and port, port "0" lets the operating system assign a
+    // free port.
+    Listener(const std::string &address, const std::string &port)
+        : type_(tcp), address_(address), port_(port) {}
+
+    // Unix domain socket at path. A socket left at path by an earlier server
+    // is replaced, any other file is kept and the listener fails with an
+    // error logged.
+    static Listener unixSocket(const std::string &path) {
+        Listener listener(path, "");
+        listener.type_ = unix_socket;
+        return listener;
+    }
+
+    // A socket already bound and listening, e.g. passed by systemd or by
+    // the server being replaced, see listener_handoff.hpp. The server takes
+    // ownership of the descriptor.
+    static Listener fromDescriptor(int fd) {
+        Listener listener("", "");
+        listener.type_ = descriptor;
+        listener.descriptor_ = fd;
+        return listener;
+    }
+
+    Type type_;
+
+    // Address, or path of a Unix domain socket.
+    std::string address_;
+    std::string port_;
+
+    // The listening socket of a descriptor listener.
+    int descriptor_ = -1;
+};
+
+// Options of the listening and accepted sockets, see the Server
+// constructors. Options a platform does not support are ignored, the ones
+// marked Linux only have no effect elsewhere. Defaults keep the operating
+// system defaults.
+struct SocketOptions {
+    SocketOptions(bool noDelay = false,
+                  int sendBufferSize = 0,
+                  int receiveBufferSize = 0,
+                  std::chrono::seconds deferAccept = std::chrono::seconds(0),
+                  int fastOpenQueue = 0,
+                  bool quickAck = false,
+                  std::chrono::seconds tcpKeepAliveIdle = std::chrono::seconds(0),
+                  std::chrono::seconds tcpKeepAliveInterval = std::chrono::seconds(0),
+                  int tcpKeepAliveProbes = 0,
+                  int listenBacklog = 0,
+                  size_t acceptBatch = 1)
+        : noDelay_(noDelay),
+          sendBufferSize_(sendBufferSize),
+          receiveBufferSize_(receiveBufferSize),
+          deferAccept_(deferAccept),
+          fastOpenQueue_(fastOpenQueue),
+          quickAck_(quickAck),
+          tcpKeepAliveIdle_(tcpKeepAliveIdle),
+          tcpKeepAliveInterval_(tcpKeepAliveInterval),
+          tcpKeepAliveProbes_(tcpKeepAliveProbes),
+          listenBacklog_(listenBacklog),
+          acceptBatch_(acceptBatch) {}
+
+    // TCP_NODELAY, send small replies without waiting for the ACK of
+    // earlier data.
+    bool noDelay_;
+
+    // SO_SNDBUF and SO_RCVBUF in bytes, set on the listening socket so that
+    // accepted sockets start with them.
+    // 0 = operating system default.
+    int sendBufferSize_;
+    int receiveBufferSize_;
+
+    // TCP_DEFER_ACCEPT, accept a client only once its first data has
+    // arrived, or the timeout passed. Linux only.
+    // 0s = disabled.
+    std::chrono::seconds deferAccept_;
+
+    // TCP_FASTOPEN, length of the queue of clients sending their request in
+    // the SYN before the handshake completes. Linux only.
+    // 0 = disabled.
+    int fastOpenQueue_;
+
+    // TCP_QUICKACK, ACK each request immediately instead of delaying the
+    // ACK. Linux clears the option on its own, so it is set again before
+    // every read, one extra system call per read. Linux only.
+    bool quickAck_;
+
+    // TCP keep-alive probes of idle connections, not to be confused with
+    // HTTP Keep-Alive: first probe after tcpKeepAliveIdle_, then every
+    // tcpKeepAliveInterval_ until tcpKeepAliveProbes_ are unanswered.
+    // 0s idle = disabled, 0 = operating system default of the others.
+    std::chrono::seconds tcpKeepAliveIdle_;
+    std::chrono::seconds tcpKeepAliveInterval_;
+    int tcpKeepAliveProbes_;
+
+    // Clients waiting in the listen backlog.
+    // 0 = SOMAXCONN.
+    int listenBacklog_;
+
+    // Max connections accepted per wakeup of an acceptor. A burst of
+    // clients is accepted in one go instead of one completion each.
+    size_t acceptBatch_;
+};
+
+// TLS termination, only available when built with BEAUTY_ENABLE_TLS.
+struct TlsOptions {
+    TlsOptions(const std::string &certificateChainFile,
+               const std::string &privateKeyFile,
+               size_t sessionCacheSize = 1024,
+               std::chrono::seconds sessionTimeout = std::chrono::seconds(3600),
+               bool sessionTickets = true,
+               bool kernelTls = false)
+        : certificateChainFile_(certificateChainFile),
+          privateKeyFile_(privateKeyFile),
+          sessionCacheSize_(sessionCacheSize),
+          sessionTimeout_(sessionTimeout),
+          sessionTickets_(sessionTickets),
+          kernelTls_(kernelTls) {}
+
+    // PEM files of the server certificate, followed by any intermediate
+    // certificates, and of its private key.
+    std::string certificateChainFile_;
+    std::string privateKeyFile_;
+
+    // Sessions kept by the server for resumption by session id, shared by
+    // all connections.
+    // 0 = no limit.
+    size_t sessionCacheSize_;
+
+    // Lifetime of cached sessions and session tickets.
+    std::chrono::seconds sessionTimeout_;
+
+    // Resume sessions from tickets kept by the client, the server then holds
+    // no state per session.
+    bool sessionTickets_;
+
+    // Let the Linux kernel encrypt and decrypt records once the handshake is
+    // done (kTLS). Needs OpenSSL 3 built with kTLS and the tls kernel module,
+    // otherwise records are processed by OpenSSL.
+    bool kernelTls_;
+};
+
 }  // namespace beauty
@@ -0,0 +1,112 @@
+#include "buffer_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace beauty {
+
+BufferPool::BufferPool(size_t maxContentSize, size_t maxFreeBytes)
+    : maxContentSize_(maxContentSize), maxFreeBytes_(maxFreeBytes), stats_() {
+    size_t nrOfClasses = 1;
+    for (size_t size = minBufferSize; size < maxContentSize; size *= 2) {
+        nrOfClasses++;
+    }
+    freeLists_.resize(nrOfClasses);
+}
+
+void BufferPool::acquire(std::vector<char> &buffer, size_t size) {
+    take(buffer, bufferSizeClass(size, maxContentSize_));
+    stats_.inUse_++;
+    stats_.inUseBytes_ += buffer.capacity();
+}
+
+void BufferPool::grow(std::vector<char> &buffer, size_t size) {
+    size_t sizeClass = bufferSizeClass(size, maxContentSize_);
+    if (buffer.capacity() >= sizeClass) {
+        return;
+    }
+    std::vector<char> grown;
+    take(grown, sizeClass);
+    grown.resize(buffer.size());
+    if (!buffer.empty()) {
+        std::memcpy(grown.data(), buffer.data(), buffer.size());
+    }
+    buffer.swap(grown);
+    stats_.inUseBytes_ += buffer.capacity();
+    stats_.inUseBytes_ -= std::min(stats_.inUseBytes_, grown.capacity());
+    put(grown);
+}
+
+void BufferPool::release(std::vector<char> &buffer) {
+    // the owner may have grown the buffer without the pool
+    stats_.inUseBytes_ -= std::min(stats_.inUseBytes_, buffer.capacity());
+    put(buffer);
+    if (stats_.inUse_ > 0) {
+        stats_.inUse_--;
+    }
+}
+
+void BufferPool::setMaxFreeBytes(size_t maxFreeBytes) {
+    maxFreeBytes_ = maxFreeBytes;
+    // drop the largest free buffers first
+    for (size_t i = freeLists_.size(); i > 0 && stats_.freeBytes_ > maxFreeBytes_; --i) {
+        auto &freeList = freeLists_[i - 1];
+        while (!freeList.empty() && stats_.freeBytes_ > maxFreeBytes_) {
+            stats_.freeBytes_ -= freeList.back().capacity();
+            stats_.free_--;
+            freeList.pop_back();
+        }
+    }
+}
+
+BufferPool::Stats BufferPool::getStats() const {
+    return stats_;
+}
+
+void BufferPool::take(std::vector<char> &buffer, size_t sizeClass) {
+    buffer.clear();
+    int index = classIndex(sizeClass);
+    if (index >= 0 && !freeLists_[index].empty()) {
+        buffer.swap(freeLists_[index].back());
+        freeLists_[index].pop_back();
+        stats_.free_--;
+        stats_.freeBytes_ -= buffer.capacity();
+        stats_.reuses_++;
+        return;
+    }
+    std::vector<char>().swap(buffer);
+    buffer.reserve(sizeClass);
+    stats_.allocations_++;
+}
+
+void BufferPool::put(std::vector<char> &buffer) {
+    int index = classIndex(buffer.capacity());
+    if (index >= 0 && stats_.freeBytes_ + buffer.capacity() <= maxFreeBytes_) {
+        stats_.free_++;
+        stats_.freeBytes_ += buffer.capacity();
+        buffer.clear();
+        freeLists_[index].push_back(std::vector<char>());
+        freeLists_[index].back().swap(buffer);
+        return;
+    }
+    std::vector<char>().swap(buffer);
+}
+
+int BufferPool::classIndex(size_t capacity) const {
+    if (capacity < minBufferSize || capacity > maxContentSize_) {
+        return -1;
+    }
+    // the largest size class the capacity can serve
+    int index = 0;
+    for (size_t sizeClass = minBufferSize * 2;
+         sizeClass <= capacity && static_cast<size_t>(index + 1) < freeLists_.size();
+         sizeClass *= 2) {
+        index++;
+    }
+    if (static_cast<size_t>(index + 1) < freeLists_.size() && capacity == maxContentSize_) {
+        index = static_cast<int>(freeLists_.size()) - 1;
+    }
+    return index;
+}
+
+}  // namespace beauty
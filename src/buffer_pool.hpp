@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include "buffer_size.hpp"
+
+namespace beauty {
+
+// Pool of connection buffers in the size classes of buffer_size.hpp, shared by
+// all connections of a server. Buffers are moved in and out of the callers'
+// vectors by swapping, so references to those vectors stay valid. Not thread
+// safe, use from the io_context thread only.
+class BufferPool {
+   public:
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    // Free buffers are kept up to maxFreeBytes in total.
+    BufferPool(size_t maxContentSize, size_t maxFreeBytes);
+
+    // Move a buffer of at least size bytes capacity into the empty buffer.
+    void acquire(std::vector<char> &buffer, size_t size);
+
+    // Grow an acquired buffer to at least size bytes capacity, keeping its
+    // content.
+    void grow(std::vector<char> &buffer, size_t size);
+
+    // Return an acquired buffer to the pool, leaving it without storage.
+    void release(std::vector<char> &buffer);
+
+    // Limit the memory held by free buffers.
+    void setMaxFreeBytes(size_t maxFreeBytes);
+
+    struct Stats {
+        // Acquired buffers not yet released and their total size.
+        size_t inUse_;
+        size_t inUseBytes_;
+        // Buffers held for reuse and their total size.
+        size_t free_;
+        size_t freeBytes_;
+        // Acquires and grows served by a new allocation or a free buffer.
+        size_t allocations_;
+        size_t reuses_;
+    };
+    Stats getStats() const;
+
+   private:
+    // Take a buffer of the size class from the free list or allocate it.
+    void take(std::vector<char> &buffer, size_t sizeClass);
+
+    // Keep the storage of buffer for reuse if there is room, otherwise free
+    // it.
+    void put(std::vector<char> &buffer);
+
+    // Index in freeLists_ of the largest size class a buffer of capacity
+    // can serve, or -1 if it is outside the size classes.
+    int classIndex(size_t capacity) const;
+
+    const size_t maxContentSize_;
+    size_t maxFreeBytes_;
+    std::vector<std::vector<std::vector<char>>> freeLists_;
+    Stats stats_;
+};
+
+}  // namespace beauty
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+namespace beauty {
+
+// Connection buffers start at minBufferSize and grow in power of two size
+// classes up to maxContentSize only while a request or reply needs it.
+const size_t minBufferSize = 512;
+
+// The smallest size class that holds size bytes, limited to maxContentSize.
+inline size_t bufferSizeClass(size_t size, size_t maxContentSize) {
+    size_t sizeClass = minBufferSize;
+    while (sizeClass < size && sizeClass < maxContentSize) {
+        sizeClass *= 2;
+    }
+    return sizeClass < maxContentSize ? sizeClass : maxContentSize;
+}
+
+// Max size of a request head, the request line and headers of HTTP/1.1 or
+// a header block of HTTP/2, which is accumulated over reads.
+inline size_t maxHeadSize(size_t maxContentSize) {
+    return maxContentSize > 16384 ? maxContentSize : 16384;
+}
+
+}  // namespace beauty
@@ -1,34 +1,81 @@
 #include "connection_manager.hpp"
 #include "connection.hpp"
 
+#include <array>
+#include <cstring>
+#include <string>
+
 namespace beauty {
 
-Connection::Connection(asio::ip::tcp::socket socket,
+Connection::Connection(ConnectionSocket::socket_type socket,
                        ConnectionManager &manager,
                        RequestHandler &handler,
                        unsigned connectionId,
-                       size_t maxContentSize)
+                       size_t maxContentSize,
+                       IRequestObserver *observer)
     : socket_(std::move(socket)),
       connectionManager_(manager),
       requestHandler_(handler),
+      request_(buffer_),
+      requestParser_(maxHeadSize(maxContentSize)),
+      reply_(maxContentSize),
       connectionId_(connectionId),
       maxContentSize_(maxContentSize),
-      buffer_(maxContentSize),
-      request_(buffer_),
-      reply_(maxContentSize) {}
+      observer_(observer) {}
 
 void Connection::start(bool useKeepAlive,
                        std::chrono::seconds keepAliveTimeout,
                        size_t keepAliveMax) {
     lastReceivedTime_ = std::chrono::steady_clock::now();
+    phaseStart_ = lastReceivedTime_;
     useKeepAlive_ = useKeepAlive;
     keepAliveTimeout_ = keepAliveTimeout;
     keepAliveMax_ = keepAliveMax;
-    doRead();
+    keepAliveHeaders_ = "Connection: keep-alive\r\nKeep-Alive: timeout=" +
+                        std::to_string(keepAliveTimeout_.count()) +
+                        ", max=" + std::to_string(keepAliveMax_) + "\r\n";
+    BEAUTY_OBSERVE(observer_, onAccept(connectionId_, IRequestObserver::now()));
+#ifdef BEAUTY_ENABLE_TLS
+    if (TlsContext *tls = connectionManager_.tlsContext()) {
+        doHandshake(*tls);
+        return;
+    }
+#endif
+    doAwaitRequest();
 }
 
 void Connection::stop() {
     socket_.close();
+    if (rateLimitSlot_ >= 0) {
+        connectionManager_.rateLimiter()->release(rateLimitSlot_);
+        rateLimitSlot_ = -1;
+    }
+    if (reply_.replyPartial_ && !reply_.finalPart_) {
+        // the file of a download that is cut off
+        requestHandler_.closeFile(reply_, connectionId_);
+        reply_.replyPartial_ = false;
+    }
+    if (reply_.bodyConsumer_) {
+        reply_.bodyConsumer_->onAbort(request_);
+        reply_.bodyConsumer_.reset();
+    }
+    bodyPaused_ = false;
+    if (webSocket_) {
+        std::shared_ptr<WebSocket> webSocket;
+        webSocket.swap(webSocket_);
+        webSocket->open_ = false;
+        // the handler likely holds the socket, so release it
+        std::shared_ptr<IWebSocketHandler> handler;
+        handler.swap(webSocket->handler_);
+        handler->onClose(webSocket, webSocket->closeCode_);
+    }
+    eventQueue_.reset();
+    if (http2_) {
+        http2_->close();
+        http2_.reset();
+    }
+    releaseBuffers();
+    BEAUTY_OBSERVE(observer_, onClose(connectionId_, IRequestObserver::now()));
 }
 
 std::chrono::steady_clock::time_point Connection::getLastReceivedTime() const {
@@ -40,35 +87,207 @@ size_t Connection::getNrOfRequests() const {
 }
 
 bool Connection::useKeepAlive() const {
-    return (useKeepAlive_ && request_.keepAlive_);
+    if (http2_) {
+        // streams end on their own, without streams the connection times
+        // out as an idle keep-alive connection does
+        return http2_->isIdle();
+    }
+    // a WebSocket or event stream stays open until either side closes it
+    return (useKeepAlive_ && request_.keepAlive_ && !webSocket_ && !eventQueue_);
+}
+
+bool Connection::isIdle() const {
+    if (http2_) {
+        return http2_->isIdle();
+    }
+    return useKeepAlive() && nrOfRequest_ > 0 && awaitingFirstByte_;
+}
+
+bool Connection::isAwaitingRequest() const {
+    return !http2_ && !webSocket_ && !eventQueue_ && awaitingFirstByte_;
+}
+
+Connection::Activity Connection::activity() const {
+    if (http2_) {
+        return http2;
+    }
+    if (webSocket_) {
+        return websocket;
+    }
+    if (eventQueue_) {
+        return event_stream;
+    }
+    if (reply_.replyPartial_) {
+        return download;
+    }
+    if (reply_.isMultiPart_ || reply_.isRawUpload_ || reply_.bodyConsumer_) {
+        return upload;
+    }
+    return request;
+}
+
+bool Connection::isStalled(const ConnectionTimeouts &timeouts,
+                           std::chrono::steady_clock::time_point now) const {
+    if (http2_ || webSocket_ || eventQueue_) {
+        // streams and frames have no request phases
+        return false;
+    }
+    auto elapsed = now - phaseStart_;
+    switch (phase_) {
+        case receiving_headers:
+            if (awaitingFirstByte_ && nrOfRequest_ > 0) {
+                // an idle keep-alive connection, see keepAliveTimeout_
+                return false;
+            }
+            return timeouts.headerTimeout_.count() > 0 && elapsed > timeouts.headerTimeout_;
+        case receiving_body: {
+            if (bodyPaused_ || timeouts.minBodyRate_ == 0 || elapsed <= timeouts.gracePeriod_) {
+                return false;
+            }
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+            return phaseBytes_ * 1000 < timeouts.minBodyRate_ * static_cast<size_t>(ms);
+        }
+        case handling:
+            return timeouts.handlerTimeout_.count() > 0 && elapsed > timeouts.handlerTimeout_;
+        case sending: {
+            if (timeouts.minSendRate_ == 0) {
+                return false;
+            }
+            std::chrono::milliseconds allowed(phaseBytes_ * 1000 / timeouts.minSendRate_);
+            return elapsed > timeouts.gracePeriod_ + allowed;
+        }
+    }
+    return false;
+}
+
+void Connection::setRateLimitSlot(int slot) {
+    rateLimitSlot_ = slot;
+}
+
+void Connection::setQuickAck(bool enabled) {
+    socket_.setQuickAck(enabled);
+}
+
+void Connection::drain() {
+    useKeepAlive_ = false;
+    if (webSocket_ && !webSocket_->closeSent_) {
+        webSocket_->close(1001);
+    }
+}
+
+#ifdef BEAUTY_ENABLE_TLS
+void Connection::doHandshake(TlsContext &context) {
+    if (!socket_.startTls(context)) {
+        BEAUTY_LOG(connectionManager_.logger(), LogLevel::error, "doHandshake: no TLS session");
+        shutdown();
+        return;
+    }
+    auto self(shared_from_this());
+    socket_.async_handshake([this, self](std::error_code ec) {
+        if (!ec) {
+            doAwaitRequest();
+        } else if (ec != asio::error::operation_aborted) {
+            // e.g. a client not trusting the certificate
+            BEAUTY_LOG(connectionManager_.logger(),
+                       LogLevel::info,
+                       "doHandshake: " + ec.message() + ':' + std::to_string(ec.value()));
+            connectionManager_.stop(shared_from_this());
+        }
+    });
+}
+#endif
+
+void Connection::doAwaitRequest() {
+    auto self(shared_from_this());
+    socket_.async_wait(asio::socket_base::wait_read, [this, self](std::error_code ec) {
+        if (!ec) {
+            acquireBuffers();
+            doRead();
+        } else if (ec != asio::error::operation_aborted) {
+            BEAUTY_LOG(connectionManager_.logger(),
+                       LogLevel::warning,
+                       "doAwaitRequest: " + ec.message() + ':' + std::to_string(ec.value()));
+            connectionManager_.stop(shared_from_this());
+        }
+    });
 }
 
 void Connection::doRead() {
     auto self(shared_from_this());
     // asio uses buffer_.size() to limit amount of read data so must restore
-    // size before reading. Note: operation is "cheap" as maxContentSize is
-    // already reserved.
-    buffer_.resize(maxContentSize_);
+    // size before reading. Note: operation is "cheap" as the current size
+    // class is already reserved.
+    buffer_.resize(readSize());
     socket_.async_read_some(
         asio::buffer(buffer_), [this, self](std::error_code ec, std::size_t bytesTransferred) {
             if (!ec) {
                 lastReceivedTime_ = std::chrono::steady_clock::now();
+                bool firstRead = awaitingFirstByte_ && nrOfRequest_ == 0;
+                if (awaitingFirstByte_) {
+                    awaitingFirstByte_ = false;
+                    if (nrOfRequest_ > 0) {
+                        // the header deadline of a keep-alive request
+                        setPhase(receiving_headers);
+                    }
+                    BEAUTY_OBSERVE(observer_, onFirstByte(connectionId_, lastReceivedTime_));
+                    // the first request took its token when accepted
+                    if (nrOfRequest_ > 0 && rateLimitSlot_ >= 0 &&
+                        !connectionManager_.rateLimiter()->take(rateLimitSlot_,
+                                                                lastReceivedTime_)) {
+                        doWriteTooManyRequests();
+                        return;
+                    }
+                }
                 buffer_.resize(bytesTransferred);
+                readAvailable();
+                if (firstRead && connectionManager_.http2Options().enabled_ &&
+                    buffer_.size() >= 4 &&
+                    memcmp(buffer_.data(),
+                           Http2Session::preface,
+                           std::min(buffer_.size(), Http2Session::prefaceSize)) == 0) {
+                    // HTTP/2 with prior knowledge
+                    startHttp2(false);
+                    http2_->receive(buffer_.data(), buffer_.size());
+                    releaseBuffers();
+                    continueHttp2();
+                    return;
+                }
                 RequestParser::result_type result = requestParser_.parse(request_, buffer_);
+                if (result == RequestParser::good_complete || result == RequestParser::good_part) {
+                    BEAUTY_OBSERVE(observer_, onHeadParsed(connectionId_, IRequestObserver::now()));
+                }
 
-                if (result == RequestParser::good_complete) {
+                if (result == RequestParser::good_complete && nrOfRequest_ == 0 &&
+                    connectionManager_.http2Options().enabled_ && request_.isHttp2Upgrade() &&
+                    request_.contentLength_ == 0) {
+                    doUpgradeHttp2();
+                } else if (result == RequestParser::good_complete) {
                     if (requestDecoder_.decodeRequest(request_, buffer_)) {
+                        BEAUTY_OBSERVE(observer_,
+                                       onDecodeDone(connectionId_, IRequestObserver::now()));
                         requestHandler_.handleRequest(connectionId_, request_, buffer_, reply_);
-                        doWriteHeaders();
+                        if (reply_.bodyConsumer_) {
+                            reply_.noBodyBytesReceived_ = static_cast<size_t>(
+                                std::max(request_.getNoInitialBodyBytesReceived(), 0));
+                            consumeBody();
+                        } else {
+                            doWriteHeaders();
+                        }
                     } else {
                         reply_.stockReply(Reply::bad_request);
                         doWriteHeaders();
                     }
                 } else if (result == RequestParser::good_part) {
                     if (requestDecoder_.decodeRequest(request_, buffer_)) {
-                        reply_.noBodyBytesReceived_ = request_.getNoInitialBodyBytesReceived();
+                        BEAUTY_OBSERVE(observer_,
+                                       onDecodeDone(connectionId_, IRequestObserver::now()));
+                        reply_.noBodyBytesReceived_ = static_cast<size_t>(
+                            std::max(request_.getNoInitialBodyBytesReceived(), 0));
                         requestHandler_.handleRequest(connectionId_, request_, buffer_, reply_);
-                        if (reply_.isMultiPart_) {
+                        setPhase(receiving_body);
+                        if (reply_.bodyConsumer_) {
+                            consumeBody();
+                        } else if (reply_.isMultiPart_) {
                             doWritePartAck();
                         } else {
                             doReadBody();
@@ -84,36 +303,51 @@ void Connection::doRead() {
                     doRead();
                 }
             } else if (ec != asio::error::operation_aborted) {
-                connectionManager_.debugMsg("doRead: " + ec.message() + ':' +
-                                            std::to_string(ec.value()));
+                // eof is the normal way for a client to close the connection
+                BEAUTY_LOG(connectionManager_.logger(),
+                           ec == asio::error::eof ? LogLevel::debug : LogLevel::warning,
+                           "doRead: " + ec.message() + ':' + std::to_string(ec.value()));
                 connectionManager_.stop(shared_from_this());
             }
         });
 }
 
 void Connection::doWritePartAck() {
+    if (reply_.precomputed_ != nullptr) {
+        // a complete response ends the upload
+        request_.keepAlive_ = false;
+        doWriteHeaders();
+        return;
+    }
     auto self(shared_from_this());
     asio::async_write(
         socket_, reply_.headerToBuffers(), [this, self](std::error_code ec, std::size_t) {
             if (!ec) {
                 doReadBody();
             } else {
-                connectionManager_.debugMsg("doWritePartAck: " + ec.message() + ':' +
-                                            std::to_string(ec.value()));
+                BEAUTY_LOG(connectionManager_.logger(),
+                           LogLevel::warning,
+                           "doWritePartAck: " + ec.message() + ':' + std::to_string(ec.value()));
                 shutdown();
             }
         });
 }
 
 void Connection::doReadBody() {
-    buffer_.resize(maxContentSize_);
+    buffer_.resize(readSize());
     auto self(shared_from_this());
     socket_.async_read_some(
         asio::buffer(buffer_), [this, self](std::error_code ec, std::size_t bytesTransferred) {
             if (!ec) {
                 lastReceivedTime_ = std::chrono::steady_clock::now();
                 buffer_.resize(bytesTransferred);
-                reply_.noBodyBytesReceived_ += bytesTransferred;
+                readAvailable();
+                reply_.noBodyBytesReceived_ += buffer_.size();
+                phaseBytes_ += buffer_.size();
+                if (reply_.bodyConsumer_) {
+                    consumeBody();
+                    return;
+                }
 
                 // As the receiving buffer is limited, keep track if we have
                 // opened a new multi-part file and should send an ack or if we
@@ -131,37 +365,151 @@ void Connection::doReadBody() {
                     doWriteHeaders();
                 }
             } else if (ec != asio::error::operation_aborted) {
-                connectionManager_.debugMsg("doReadBody: " + ec.message() + ':' +
-                                            std::to_string(ec.value()));
+                BEAUTY_LOG(connectionManager_.logger(),
+                           LogLevel::warning,
+                           "doReadBody: " + ec.message() + ':' + std::to_string(ec.value()));
                 connectionManager_.stop(shared_from_this());
             }
         });
 }
 
+void Connection::consumeBody() {
+    // bytes past the body belong to a pipelined request, which is not
+    // supported
+    size_t received = reply_.noBodyBytesReceived_;
+    size_t size = buffer_.size();
+    if (received > request_.contentLength_) {
+        size -= std::min(size, received - request_.contentLength_);
+    }
+
+    if (!resumeBodyCb_) {
+        std::weak_ptr<Connection> weak(shared_from_this());
+        auto executor = socket_.get_executor();
+        resumeBodyCb_ = [weak, executor] {
+            asio::post(executor, [weak] {
+                if (auto self = weak.lock()) {
+                    self->resumeBody();
+                }
+            });
+        };
+    }
+
+    bool more = true;
+    if (size > 0) {
+        more = reply_.bodyConsumer_->onData(request_, buffer_.data(), size, resumeBodyCb_);
+    }
+    if (!more) {
+        bodyPaused_ = true;
+        setPhase(handling);
+    } else if (received < request_.contentLength_) {
+        doReadBody();
+    } else {
+        endBody();
+    }
+}
+
+void Connection::resumeBody() {
+    if (!bodyPaused_ || !reply_.bodyConsumer_) {
+        return;
+    }
+    bodyPaused_ = false;
+    if (reply_.noBodyBytesReceived_ < request_.contentLength_) {
+        setPhase(receiving_body);
+        doReadBody();
+    } else {
+        endBody();
+    }
+}
+
+void Connection::endBody() {
+    std::shared_ptr<IBodyConsumer> consumer;
+    consumer.swap(reply_.bodyConsumer_);
+    consumer->onEnd(request_, reply_);
+    if (!reply_.hasHeaders()) {
+        reply_.send(Reply::ok);
+    }
+    doWriteHeaders();
+}
+
 void Connection::doWriteHeaders() {
+    if (reply_.precomputed_ != nullptr) {
+        doWritePrecomputed();
+        return;
+    }
     handleKeepAlive();
+    std::vector<asio::const_buffer> buffers = reply_.headerToBuffers();
+    setPhase(sending, asio::buffer_size(buffers));
     auto self(shared_from_this());
-    asio::async_write(
-        socket_, reply_.headerToBuffers(), [this, self](std::error_code ec, std::size_t) {
-            if (!ec) {
-                if (!reply_.content_.empty() || reply_.contentPtr_ != nullptr) {
-                    doWriteContent();
-                } else {
-                    handleWriteCompleted();
-                }
+    asio::async_write(socket_, buffers, [this, self](std::error_code ec, std::size_t) {
+        if (!ec) {
+            BEAUTY_OBSERVE(observer_, onHeadersWritten(connectionId_, IRequestObserver::now()));
+            if (reply_.webSocketHandler_) {
+                startWebSocket();
+            } else if (reply_.eventBroadcaster_) {
+                startEventStream();
+            } else if (!reply_.content_.empty() || reply_.contentPtr_ != nullptr) {
+                doWriteContent();
             } else {
-                connectionManager_.debugMsg("doWriteHeaders: " + ec.message() + ':' +
-                                            std::to_string(ec.value()));
-                shutdown();
+                handleWriteCompleted();
             }
-        });
+        } else {
+            BEAUTY_LOG(connectionManager_.logger(),
+                       LogLevel::warning,
+                       "doWriteHeaders: " + ec.message() + ':' + std::to_string(ec.value()));
+            shutdown();
+        }
+    });
+}
+
+void Connection::doWritePrecomputed() {
+    static const std::string connectionClose = "Connection: close\r\n";
+    nrOfRequest_++;
+    const PrecomputedResponse &response = *reply_.precomputed_;
+    std::array<asio::const_buffer, 3> buffers = {
+        {response.head(),
+         asio::buffer(useKeepAlive() ? keepAliveHeaders_ : connectionClose),
+         response.tail()}};
+    setPhase(sending, asio::buffer_size(buffers));
+    auto self(shared_from_this());
+    asio::async_write(socket_, buffers, [this, self](std::error_code ec, std::size_t) {
+        if (!ec) {
+            BEAUTY_OBSERVE(observer_, onHeadersWritten(connectionId_, IRequestObserver::now()));
+            handleWriteCompleted();
+        } else {
+            BEAUTY_LOG(connectionManager_.logger(),
+                       LogLevel::warning,
+                       "doWritePrecomputed: " + ec.message() + ':' + std::to_string(ec.value()));
+            shutdown();
+        }
+    });
+}
+
+void Connection::doWriteTooManyRequests() {
+    BEAUTY_LOG(connectionManager_.logger(), LogLevel::warning, "Client over rate limit");
+    auto self(shared_from_this());
+    asio::async_write(socket_,
+                      asio::buffer(connectionManager_.rateLimiter()->reply()),
+                      [this, self](std::error_code ec, std::size_t) {
+                          if (ec) {
+                              BEAUTY_LOG(connectionManager_.logger(),
+                                         LogLevel::warning,
+                                         "doWriteTooManyRequests: " + ec.message() + ':' +
+                                             std::to_string(ec.value()));
+                          }
+                          shutdown();
+                      });
 }
 
 void Connection::doWriteContent() {
+    std::vector<asio::const_buffer> buffers = reply_.contentToBuffers();
+    setPhase(sending, asio::buffer_size(buffers));
     auto self(shared_from_this());
     asio::async_write(
-        socket_, reply_.contentToBuffers(), [this, self](std::error_code ec, std::size_t) {
+        socket_, buffers, [this, self](std::error_code ec, std::size_t bytesTransferred) {
             if (!ec) {
+                BEAUTY_OBSERVE(
+                    observer_,
+                    onBodyChunkWritten(connectionId_, bytesTransferred, IRequestObserver::now()));
                 if (reply_.replyPartial_) {
                     if (reply_.finalPart_) {
                         handleWriteCompleted();
@@ -173,15 +521,72 @@ void Connection::doWriteContent() {
                     handleWriteCompleted();
                 }
             } else {
-                connectionManager_.debugMsg("doWriteContent: " + ec.message() + ':' +
-                                            std::to_string(ec.value()));
+                BEAUTY_LOG(connectionManager_.logger(),
+                           LogLevel::warning,
+                           "doWriteContent: " + ec.message() + ':' + std::to_string(ec.value()));
                 shutdown();
             }
         });
 }
 
+size_t Connection::readSize() const {
+    return std::min(std::max(buffer_.capacity(), bufferSizeClass(0, maxContentSize_)),
+                    maxContentSize_);
+}
+
+void Connection::readAvailable() {
+    // A read that filled the buffer likely left more data in the socket. Read
+    // it now, growing the buffer, so that a read returns up to maxContentSize_
+    // bytes as if the buffer had been allocated at full size.
+    if (buffer_.size() < buffer_.capacity()) {
+        return;
+    }
+    std::error_code ec;
+    while (buffer_.size() < maxContentSize_) {
+        size_t available = socket_.available(ec);
+        if (ec || available == 0) {
+            return;
+        }
+        size_t size = buffer_.size();
+        connectionManager_.bufferPool().grow(buffer_, size + available);
+        size_t newSize = std::min(buffer_.capacity(), maxContentSize_);
+        buffer_.resize(newSize);
+        size_t n = socket_.read_some(asio::buffer(&buffer_[size], newSize - size), ec);
+        buffer_.resize(size + n);
+        if (ec) {
+            // reported by the next asynchronous read
+            return;
+        }
+    }
+}
+
+void Connection::acquireBuffers() {
+    if (!hasBuffers_) {
+        hasBuffers_ = true;
+        connectionManager_.bufferPool().acquire(buffer_, 0);
+        connectionManager_.bufferPool().acquire(reply_.content_, 0);
+    }
+}
+
+void Connection::releaseBuffers() {
+    if (hasBuffers_) {
+        hasBuffers_ = false;
+        connectionManager_.bufferPool().release(buffer_);
+        connectionManager_.bufferPool().release(reply_.content_);
+    }
+}
+
 void Connection::handleKeepAlive() {
     nrOfRequest_++;
+    if (reply_.webSocketHandler_) {
+        // the handshake carries its own Connection header
+        return;
+    }
+    if (reply_.eventBroadcaster_) {
+        // the stream ends when the connection is closed
+        reply_.addHeader("Connection", "close");
+        return;
+    }
     if (useKeepAlive_ && request_.keepAlive_) {
         reply_.addHeader("Connection", "keep-alive");
         reply_.addHeader("Keep-Alive",
@@ -193,25 +598,448 @@ void Connection::handleKeepAlive() {
 }
 
 void Connection::handleWriteCompleted() {
+    BEAUTY_OBSERVE(observer_, onResponseComplete(connectionId_, IRequestObserver::now()));
     if (useKeepAlive_ && request_.keepAlive_) {
+        awaitingFirstByte_ = true;
+        setPhase(receiving_headers);
         requestParser_.reset();
         request_.reset();
         reply_.reset();
-        doRead();
+        releaseBuffers();
+        doAwaitRequest();
     } else {
         // initiate graceful connection closure.
         std::error_code ignored_ec;
-        socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ignored_ec);
+        socket_.shutdown(asio::socket_base::shutdown_both, ignored_ec);
+        connectionManager_.stop(shared_from_this());
+    }
+}
+
+void Connection::setPhase(Phase phase, size_t bytes) {
+    phase_ = phase;
+    phaseStart_ = std::chrono::steady_clock::now();
+    phaseBytes_ = bytes;
+}
+
+void Connection::startWebSocket() {
+    BEAUTY_OBSERVE(observer_, onResponseComplete(connectionId_, IRequestObserver::now()));
+    webSocket_ = std::make_shared<WebSocket>(
+        shared_from_this(), socket_.get_executor(), reply_.webSocketHandler_);
+    requestParser_.reset();
+    reply_.reset();
+    std::shared_ptr<WebSocket> webSocket = webSocket_;
+    webSocket->handler_->onOpen(webSocket, request_);
+    request_.reset();
+    releaseBuffers();
+    doAwaitFrames();
+}
+
+void Connection::doAwaitFrames() {
+    auto self(shared_from_this());
+    socket_.async_wait(asio::socket_base::wait_read, [this, self](std::error_code ec) {
+        if (!ec) {
+            acquireBuffers();
+            doReadFrames();
+        } else if (ec != asio::error::operation_aborted) {
+            BEAUTY_LOG(connectionManager_.logger(),
+                       LogLevel::warning,
+                       "doAwaitFrames: " + ec.message() + ':' + std::to_string(ec.value()));
+            connectionManager_.stop(shared_from_this());
+        }
+    });
+}
+
+void Connection::doReadFrames() {
+    buffer_.resize(readSize());
+    auto self(shared_from_this());
+    socket_.async_read_some(
+        asio::buffer(buffer_), [this, self](std::error_code ec, std::size_t bytesTransferred) {
+            if (!ec) {
+                lastReceivedTime_ = std::chrono::steady_clock::now();
+                buffer_.resize(bytesTransferred);
+                readAvailable();
+                if (handleFrames()) {
+                    // a message received over several reads is kept by the
+                    // socket, so the buffers can be given back in between
+                    releaseBuffers();
+                    doAwaitFrames();
+                }
+            } else if (ec != asio::error::operation_aborted) {
+                BEAUTY_LOG(connectionManager_.logger(),
+                           ec == asio::error::eof ? LogLevel::debug : LogLevel::warning,
+                           "doReadFrames: " + ec.message() + ':' + std::to_string(ec.value()));
+                connectionManager_.stop(shared_from_this());
+            }
+        });
+}
+
+bool Connection::handleFrames() {
+    // the handler may drop its socket while a frame is handled
+    std::shared_ptr<WebSocket> webSocket = webSocket_;
+    char *begin = buffer_.data();
+    char *end = begin + buffer_.size();
+    WebSocketFrameParser::Chunk chunk;
+    while (webSocket_ && !webSocket->closeSent_) {
+        WebSocketFrameParser::result_type result = webSocket->parser_.parse(begin, end, chunk);
+        if (result == WebSocketFrameParser::indeterminate) {
+            return true;
+        }
+        if (result == WebSocketFrameParser::bad) {
+            failWebSocket(1002);
+            return false;
+        }
+        if (!handleChunk(chunk)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool Connection::handleChunk(const WebSocketFrameParser::Chunk &chunk) {
+    WebSocket &ws = *webSocket_;
+    if (chunk.opcode_ >= WebSocketFrameParser::close) {
+        // control frames are at most 125 bytes but may still span reads
+        if (chunk.first_ && chunk.last_) {
+            handleControlFrame(chunk.opcode_, chunk.data_, chunk.size_);
+        } else {
+            if (chunk.first_) {
+                ws.control_.clear();
+            }
+            ws.control_.append(chunk.data_, chunk.size_);
+            if (chunk.last_) {
+                handleControlFrame(chunk.opcode_, ws.control_.data(), ws.control_.size());
+            }
+        }
+        return true;
+    }
+
+    if (chunk.first_) {
+        // a fragmented message continues with continuation frames only
+        bool inMessage = ws.messageOpcode_ != WebSocketFrameParser::continuation;
+        if (inMessage == (chunk.opcode_ != WebSocketFrameParser::continuation)) {
+            failWebSocket(1002);
+            return false;
+        }
+        if (!inMessage) {
+            ws.messageOpcode_ = chunk.opcode_;
+        }
+    }
+    bool binary = ws.messageOpcode_ == WebSocketFrameParser::binary;
+    bool messageEnd = chunk.last_ && chunk.fin_;
+    if (ws.message_.size() + chunk.size_ > ws.handler_->maxMessageSize()) {
+        failWebSocket(1009);
+        return false;
+    }
+
+    if (messageEnd) {
+        ws.messageOpcode_ = WebSocketFrameParser::continuation;
+    }
+    if (messageEnd && chunk.first_ && ws.message_.empty()) {
+        // the whole message is in buffer_, so hand it over without a copy
+        ws.handler_->onMessage(webSocket_, chunk.data_, chunk.size_, binary);
+        return true;
+    }
+    ws.message_.append(chunk.data_, chunk.size_);
+    if (messageEnd) {
+        ws.handler_->onMessage(webSocket_, ws.message_.data(), ws.message_.size(), binary);
+        ws.message_.clear();
+    }
+    return true;
+}
+
+void Connection::handleControlFrame(WebSocketFrameParser::opcode_type opcode,
+                                    const char *data,
+                                    size_t size) {
+    if (opcode == WebSocketFrameParser::ping) {
+        queueFrame(WebSocketFrame(WebSocketFrameParser::pong, std::string(data, size)));
+    } else if (opcode == WebSocketFrameParser::close) {
+        if (size == 1) {
+            failWebSocket(1002);
+            return;
+        }
+        // echo the code to complete the closing handshake, 1005 reports a
+        // close frame without a code
+        webSocket_->closeCode_ =
+            size >= 2 ? (static_cast<uint8_t>(data[0]) << 8) | static_cast<uint8_t>(data[1])
+                      : 1005;
+        queueFrame(
+            WebSocketFrame(WebSocketFrameParser::close, std::string(data, size >= 2 ? 2 : 0)));
+    }
+    // pongs need no answer
+}
+
+void Connection::failWebSocket(uint16_t code) {
+    BEAUTY_LOG(connectionManager_.logger(),
+               LogLevel::info,
+               "Closing WebSocket with code " + std::to_string(code));
+    webSocket_->close(code);
+}
+
+void Connection::queueFrame(WebSocketFrame frame) {
+    if (!webSocket_ || webSocket_->closeSent_) {
+        return;
+    }
+    WebSocket &ws = *webSocket_;
+    if (frame.opcode_ == WebSocketFrameParser::close) {
+        ws.closeSent_ = true;
+        if (ws.closeCode_ == 1006 && frame.payload_.size() >= 2) {
+            ws.closeCode_ = (static_cast<uint8_t>(frame.payload_[0]) << 8) |
+                            static_cast<uint8_t>(frame.payload_[1]);
+        }
+    }
+    ws.outFrames_.push_back(std::move(frame));
+    if (!ws.writing_) {
+        doWriteFrames();
+    }
+}
+
+void Connection::doWriteFrames() {
+    // gather the queued frames into one write, bounded to keep the buffer
+    // sequence small
+    static const size_t maxFrames = 16;
+    std::shared_ptr<WebSocket> webSocket = webSocket_;
+    size_t count = std::min(webSocket->outFrames_.size(), maxFrames);
+    std::vector<asio::const_buffer> buffers;
+    buffers.reserve(2 * count);
+    for (size_t i = 0; i < count; ++i) {
+        const WebSocketFrame &frame = webSocket->outFrames_[i];
+        buffers.push_back(asio::buffer(frame.header_, frame.headerSize_));
+        if (!frame.payload_.empty()) {
+            buffers.push_back(asio::buffer(frame.payload_));
+        }
+    }
+    webSocket->writing_ = true;
+    auto self(shared_from_this());
+    asio::async_write(
+        socket_, buffers, [this, self, webSocket, count](std::error_code ec, std::size_t) {
+            if (webSocket != webSocket_) {
+                // stopped while writing
+                return;
+            }
+            if (ec) {
+                BEAUTY_LOG(connectionManager_.logger(),
+                           LogLevel::warning,
+                           "doWriteFrames: " + ec.message() + ':' + std::to_string(ec.value()));
+                connectionManager_.stop(shared_from_this());
+                return;
+            }
+            bool closed = false;
+            for (size_t i = 0; i < count; ++i) {
+                const WebSocketFrame &frame = webSocket->outFrames_.front();
+                closed = closed || frame.opcode_ == WebSocketFrameParser::close;
+                webSocket->outFrames_.pop_front();
+            }
+            webSocket->writing_ = false;
+            if (closed) {
+                shutdown();
+            } else if (!webSocket->outFrames_.empty()) {
+                doWriteFrames();
+            }
+        });
+}
+
+void Connection::startEventStream() {
+    BEAUTY_OBSERVE(observer_, onResponseComplete(connectionId_, IRequestObserver::now()));
+    std::shared_ptr<EventBroadcaster> broadcaster = reply_.eventBroadcaster_;
+    eventQueue_ = std::make_shared<EventQueue>(broadcaster->maxQueued(), broadcaster->policy());
+    broadcaster->subscribe(shared_from_this(), socket_.get_executor());
+    requestParser_.reset();
+    request_.reset();
+    reply_.reset();
+    releaseBuffers();
+    doAwaitEventStreamClose();
+}
+
+void Connection::doAwaitEventStreamClose() {
+    auto self(shared_from_this());
+    socket_.async_read_some(asio::buffer(discard_), [this, self](std::error_code ec, std::size_t) {
+        if (!ec) {
+            doAwaitEventStreamClose();
+        } else if (ec != asio::error::operation_aborted) {
+            BEAUTY_LOG(connectionManager_.logger(),
+                       ec == asio::error::eof ? LogLevel::debug : LogLevel::warning,
+                       "doAwaitEventStreamClose: " + ec.message() + ':' +
+                           std::to_string(ec.value()));
+            connectionManager_.stop(shared_from_this());
+        }
+    });
+}
+
+void Connection::queueEvent(const SerializedEvent &event) {
+    if (!eventQueue_) {
+        return;
+    }
+    if (!eventQueue_->push(event)) {
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::info,
+                   "Closing slow event stream subscriber");
         connectionManager_.stop(shared_from_this());
+        return;
+    }
+    if (!eventQueue_->isWriting()) {
+        doWriteEvents();
+    }
+}
+
+void Connection::doWriteEvents() {
+    // gather the queued events into one write, bounded to keep the buffer
+    // sequence small
+    static const size_t maxEvents = 16;
+    std::shared_ptr<EventQueue> queue = eventQueue_;
+    auto self(shared_from_this());
+    asio::async_write(
+        socket_, queue->startWrite(maxEvents), [this, self, queue](std::error_code ec, std::size_t) {
+            if (queue != eventQueue_) {
+                // stopped while writing
+                return;
+            }
+            if (ec) {
+                BEAUTY_LOG(connectionManager_.logger(),
+                           LogLevel::warning,
+                           "doWriteEvents: " + ec.message() + ':' + std::to_string(ec.value()));
+                connectionManager_.stop(shared_from_this());
+                return;
+            }
+            eventQueue_->written();
+            if (!eventQueue_->empty()) {
+                doWriteEvents();
+            }
+        });
+}
+
+void Connection::startHttp2(bool upgraded) {
+    http2_ = std::make_shared<Http2Session>(requestHandler_,
+                                            connectionManager_.bufferPool(),
+                                            connectionId_,
+                                            maxContentSize_,
+                                            connectionManager_.http2Options(),
+                                            connectionManager_.logger());
+    if (rateLimitSlot_ >= 0) {
+        // the token taken when accepted is for the upgraded request, or else
+        // for the first stream
+        bool firstStream = !upgraded;
+        http2_->setStreamAdmission([this, firstStream]() mutable {
+            if (firstStream) {
+                firstStream = false;
+                return true;
+            }
+            return connectionManager_.rateLimiter()->take(rateLimitSlot_,
+                                                          std::chrono::steady_clock::now());
+        });
+    }
+    http2_->start();
+}
+
+void Connection::doUpgradeHttp2() {
+    static const std::string switchingProtocols =
+        "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+    auto self(shared_from_this());
+    asio::async_write(
+        socket_, asio::buffer(switchingProtocols), [this, self](std::error_code ec, std::size_t) {
+            if (!ec) {
+                // the request is answered on stream 1
+                startHttp2(true);
+                http2_->upgrade(request_);
+                requestParser_.reset();
+                request_.reset();
+                reply_.reset();
+                releaseBuffers();
+                continueHttp2();
+            } else {
+                BEAUTY_LOG(connectionManager_.logger(),
+                           LogLevel::warning,
+                           "doUpgradeHttp2: " + ec.message() + ':' + std::to_string(ec.value()));
+                shutdown();
+            }
+        });
+}
+
+void Connection::doAwaitHttp2() {
+    if (http2Reading_) {
+        return;
+    }
+    http2Reading_ = true;
+    auto self(shared_from_this());
+    socket_.async_wait(asio::socket_base::wait_read, [this, self](std::error_code ec) {
+        if (!ec && http2_) {
+            acquireBuffers();
+            doReadHttp2();
+        } else if (ec && ec != asio::error::operation_aborted) {
+            BEAUTY_LOG(connectionManager_.logger(),
+                       LogLevel::warning,
+                       "doAwaitHttp2: " + ec.message() + ':' + std::to_string(ec.value()));
+            connectionManager_.stop(shared_from_this());
+        }
+    });
+}
+
+void Connection::doReadHttp2() {
+    buffer_.resize(readSize());
+    auto self(shared_from_this());
+    socket_.async_read_some(
+        asio::buffer(buffer_), [this, self](std::error_code ec, std::size_t bytesTransferred) {
+            if (!ec && http2_) {
+                lastReceivedTime_ = std::chrono::steady_clock::now();
+                buffer_.resize(bytesTransferred);
+                readAvailable();
+                http2Reading_ = false;
+                http2_->receive(buffer_.data(), buffer_.size());
+                // the session copies what it keeps
+                releaseBuffers();
+                continueHttp2();
+            } else if (ec && ec != asio::error::operation_aborted) {
+                BEAUTY_LOG(connectionManager_.logger(),
+                           ec == asio::error::eof ? LogLevel::debug : LogLevel::warning,
+                           "doReadHttp2: " + ec.message() + ':' + std::to_string(ec.value()));
+                connectionManager_.stop(shared_from_this());
+            }
+        });
+}
+
+void Connection::doWriteHttp2() {
+    std::shared_ptr<Http2Session> session = http2_;
+    http2Writing_ = true;
+    auto self(shared_from_this());
+    asio::async_write(
+        socket_, session->startWrite(), [this, self, session](std::error_code ec, std::size_t) {
+            if (session != http2_) {
+                // stopped while writing
+                return;
+            }
+            http2Writing_ = false;
+            if (ec) {
+                BEAUTY_LOG(connectionManager_.logger(),
+                           LogLevel::warning,
+                           "doWriteHttp2: " + ec.message() + ':' + std::to_string(ec.value()));
+                connectionManager_.stop(shared_from_this());
+                return;
+            }
+            http2_->written();
+            continueHttp2();
+        });
+}
+
+void Connection::continueHttp2() {
+    if (http2_->hasOutput() && !http2Writing_) {
+        doWriteHttp2();
+    }
+    if (http2_->isClosing()) {
+        if (!http2Writing_) {
+            shutdown();
+        }
+        return;
+    }
+    // reading pauses while the client does not read what is written to it
+    if (http2_->backlog() <= maxContentSize_) {
+        doAwaitHttp2();
     }
 }
 
 void Connection::shutdown() {
     // initiate graceful connection closure.
     std::error_code ignored_ec;
-    socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ignored_ec);
+    socket_.shutdown(asio::socket_base::shutdown_both, ignored_ec);
     connectionManager_.stop(shared_from_this());
-    requestHandler_.closeFile(reply_, connectionId_);
 }
 
 }  // namespace beauty
@@ -3,14 +3,21 @@
 
 #include <asio.hpp>
 #include <chrono>
+#include <functional>
 #include <vector>
 #include <memory>
 
+#include "buffer_size.hpp"
+#include "connection_socket.hpp"
+#include "event_stream.hpp"
+#include "http2_session.hpp"
+#include "i_request_observer.hpp"
 #include "reply.hpp"
 #include "request.hpp"
 #include "request_decoder.hpp"
 #include "request_handler.hpp"
 #include "request_parser.hpp"
+#include "websocket.hpp"
 
 namespace beauty {
 
@@ -23,11 +30,12 @@ class Connection : public std::enable_shared_from_this<Connection> {
     Connection &operator=(const Connection &) = delete;
 
     // Construct a connection with the given socket.
-    explicit Connection(asio::ip::tcp::socket socket,
+    explicit Connection(ConnectionSocket::socket_type socket,
                         ConnectionManager &manager,
                         RequestHandler &handler,
                         unsigned connectionId,
-                        size_t maxContentSize);
+                        size_t maxContentSize,
+                        IRequestObserver *observer = nullptr);
 
     // Start the first asynchronous operation for the connection.
     void start(bool useKeepAlive, std::chrono::seconds keepAliveTimeout, size_t keepAliveMax);
@@ -39,23 +47,135 @@ class Connection : public std::enable_shared_from_this<Connection> {
     size_t getNrOfRequests() const;
     bool useKeepAlive() const;
 
+    // True for a keep-alive connection waiting for its next request.
+    bool isIdle() const;
+
+    // True while no request has arrived on a plain HTTP/1.1 connection,
+    // either a new connection or an idle keep-alive connection.
+    bool isAwaitingRequest() const;
+
+    // What a busy connection is doing, see ConnectionManager::DrainReport.
+    enum Activity { request, upload, download, websocket, event_stream, http2 };
+    Activity activity() const;
+
+    // True when the client is too slow in the current phase of a request,
+    // see ConnectionTimeouts.
+    bool isStalled(const ConnectionTimeouts &timeouts,
+                   std::chrono::steady_clock::time_point now) const;
+
+    // Bucket of the client in the rate limiter, released when the connection
+    // is stopped. Later requests on the connection take a token from it.
+    void setRateLimitSlot(int slot);
+
+    // Send the ACK of each read immediately, see SocketOptions::quickAck_.
+    void setQuickAck(bool enabled);
+
+    // Close after the response in progress, which carries Connection:
+    // close. A WebSocket is closed with 1001 Going Away.
+    void drain();
+
+    // Queue a frame on the WebSocket of the connection, see WebSocket.
+    void queueFrame(WebSocketFrame frame);
+
+    // Queue an event on the event stream of the connection, see
+    // EventBroadcaster.
+    void queueEvent(const SerializedEvent &event);
+
    private:
+#ifdef BEAUTY_ENABLE_TLS
+    // Complete the TLS handshake before the first request.
+    void doHandshake(TlsContext &context);
+#endif
+
+    // Wait for the next request without holding any buffers.
+    void doAwaitRequest();
+
     // Perform an asynchronous read operation.
     void doRead();
     void doReadBody();
 
+    // Feed the body data in buffer_ to the body consumer, then continue
+    // reading unless the consumer paused.
+    void consumeBody();
+    void resumeBody();
+    void endBody();
+
     // Perform an asynchronous write operation.
     void doWritePartAck();
     void doWriteHeaders();
     void doWriteContent();
 
+    // Write a precomputed reply, with the Connection headers spliced in, in
+    // one gathered write.
+    void doWritePrecomputed();
+
+    // Reply 429 to a request over the rate limit, without parsing it, and
+    // close.
+    void doWriteTooManyRequests();
+
+    // Size of the next read, the capacity of buffer_ within size classes.
+    size_t readSize() const;
+
+    // Read data pending in the socket after a read filled buffer_.
+    void readAvailable();
+
+    // Borrow buffer_ and the reply content from the buffer pool, and give
+    // them back.
+    void acquireBuffers();
+    void releaseBuffers();
+
     void handleKeepAlive();
     void handleWriteCompleted();
 
+    // Phases of a request with a deadline, see isStalled().
+    enum Phase { receiving_headers, receiving_body, handling, sending };
+
+    // Enter phase now, with the size of the write of a sending phase.
+    void setPhase(Phase phase, size_t bytes = 0);
+
+    // Switch to frame mode once the WebSocket handshake is written.
+    void startWebSocket();
+    void doAwaitFrames();
+    void doReadFrames();
+    void doWriteFrames();
+
+    // Handle the frames in buffer_. Returns false when the connection is
+    // closing and no more frames should be read.
+    bool handleFrames();
+    bool handleChunk(const WebSocketFrameParser::Chunk &chunk);
+    void handleControlFrame(WebSocketFrameParser::opcode_type opcode,
+                            const char *data,
+                            size_t size);
+
+    // Close the WebSocket with code, e.g. 1002 for a protocol error.
+    void failWebSocket(uint16_t code);
+
+    // Park the connection on the event broadcaster once the event stream
+    // headers are written.
+    void startEventStream();
+    void doWriteEvents();
+
+    // Wait for the client of an event stream to disconnect, anything it
+    // sends is discarded.
+    void doAwaitEventStreamClose();
+
+    // Switch to HTTP/2, after the client preface was received or the 101
+    // Switching Protocols of an h2c upgrade is written. Each stream takes a
+    // token of the rate limit as an HTTP/1.1 request does.
+    void startHttp2(bool upgraded);
+    void doUpgradeHttp2();
+    void doAwaitHttp2();
+    void doReadHttp2();
+    void doWriteHttp2();
+
+    // Write queued frames and continue reading, or close once the session
+    // is closing and everything is written.
+    void continueHttp2();
+
     void shutdown();
 
-    // Socket for the connection.
-    asio::ip::tcp::socket socket_;
+    // Socket for the connection, plain or TLS.
+    ConnectionSocket socket_;
 
     // The manager for this connection.
     ConnectionManager &connectionManager_;
@@ -63,7 +183,9 @@ class Connection : public std::enable_shared_from_this<Connection> {
     // The handler used to process the incoming request.
     RequestHandler &requestHandler_;
 
-    // Buffer for incoming data.
+    // Buffer for incoming data. Borrowed from the buffer pool at
+    // minBufferSize when a request arrives and grows while the request needs
+    // it, see buffer_size.hpp.
     std::vector<char> buffer_;
 
     // The incoming request.
@@ -93,11 +215,50 @@ class Connection : public std::enable_shared_from_this<Connection> {
     // Max requests that can be made on the connection.
     size_t keepAliveMax_;
 
+    // The Connection and Keep-Alive headers, rendered when started.
+    std::string keepAliveHeaders_;
+
     // Request counter
     size_t nrOfRequest_ = 0;
 
     // The max buffer size when reading/writing socket.
     size_t maxContentSize_;
+
+    // Optional observer of request lifecycle events.
+    IRequestObserver *observer_;
+
+    // True until the first bytes of the next request are received.
+    bool awaitingFirstByte_ = true;
+
+    // Current phase and when it started.
+    Phase phase_ = receiving_headers;
+    std::chrono::steady_clock::time_point phaseStart_;
+
+    // Body bytes received in the receiving_body phase, or the size of the
+    // write in progress in the sending phase.
+    size_t phaseBytes_ = 0;
+
+    // Bucket in the rate limiter, -1 if the client is not limited.
+    int rateLimitSlot_ = -1;
+
+    // True while buffer_ and the reply content are borrowed from the pool.
+    bool hasBuffers_ = false;
+
+    // Set once the connection is upgraded to a WebSocket.
+    std::shared_ptr<WebSocket> webSocket_;
+
+    // Set while the connection is subscribed to an event stream.
+    std::shared_ptr<EventQueue> eventQueue_;
+    char discard_[16];
+
+    // Set once the connection speaks HTTP/2.
+    std::shared_ptr<Http2Session> http2_;
+    bool http2Reading_ = false;
+    bool http2Writing_ = false;
+
+    // Handed to the body consumer to resume a paused body.
+    std::function<void()> resumeBodyCb_;
+    bool bodyPaused_ = false;
 };
 
 }  // namespace beauty
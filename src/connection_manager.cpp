@@ -3,13 +3,13 @@
 
 namespace beauty {
 
-ConnectionManager::ConnectionManager(HttpPersistence options)
-    : httpPersistence_(options), debugMsgCb_(defaultDebugMsgHandler) {}
+ConnectionManager::ConnectionManager(HttpPersistence options, size_t maxContentSize)
+    : httpPersistence_(options), bufferPool_(maxContentSize, 4 * maxContentSize) {}
 
 void ConnectionManager::start(std::shared_ptr<Connection> c) {
     connections_.insert(c);
     bool useKeepAlive = false;
-    if (httpPersistence_.keepAliveTimeout_ != std::chrono::seconds(0) &&
+    if (!draining_ && httpPersistence_.keepAliveTimeout_ != std::chrono::seconds(0) &&
         (httpPersistence_.connectionLimit_ == 0 ||  // 0 = unlimited
          (httpPersistence_.connectionLimit_ > 0 &&
           connections_.size() <= httpPersistence_.connectionLimit_))) {
@@ -21,31 +21,179 @@ void ConnectionManager::start(std::shared_ptr<Connection> c) {
 void ConnectionManager::stop(std::shared_ptr<Connection> c) {
     connections_.erase(c);
     c->stop();
+    if (connectionsClosedCb_) {
+        connectionsClosedCb_();
+    }
 }
 
 void ConnectionManager::stopAll() {
     for (auto c : connections_) {
+        if (draining_) {
+            switch (c->activity()) {
+                case Connection::upload:
+                    drainReport_.cutUploads_++;
+                    break;
+                case Connection::download:
+                    drainReport_.cutDownloads_++;
+                    break;
+                case Connection::websocket:
+                    drainReport_.cutWebSockets_++;
+                    break;
+                case Connection::http2:
+                    drainReport_.cutHttp2_++;
+                    break;
+                default:
+                    drainReport_.cutRequests_++;
+                    break;
+            }
+        }
         c->stop();
     }
     connections_.clear();
 }
 
+void ConnectionManager::drain() {
+    if (draining_) {
+        return;
+    }
+    draining_ = true;
+    auto it = connections_.begin();
+    while (it != connections_.end()) {
+        if ((*it)->isIdle() || (*it)->isAwaitingRequest() ||
+            (*it)->activity() == Connection::event_stream) {
+            (*it)->stop();
+            it = connections_.erase(it);
+            drainReport_.closedIdle_++;
+        } else {
+            (*it)->drain();
+            it++;
+        }
+    }
+    drainReport_.inFlight_ = connections_.size();
+    if (drainReport_.closedIdle_ > 0 && connectionsClosedCb_) {
+        connectionsClosedCb_();
+    }
+}
+
+bool ConnectionManager::isDraining() const {
+    return draining_;
+}
+
+const ConnectionManager::DrainReport &ConnectionManager::getDrainReport() const {
+    return drainReport_;
+}
+
 void ConnectionManager::setHttpPersistence(HttpPersistence options) {
     httpPersistence_ = options;
 }
 
+void ConnectionManager::setAdmissionControl(AdmissionControl admission,
+                                            size_t bytesPerConnection) {
+    admissionControl_ = admission;
+    bytesPerConnection_ = bytesPerConnection;
+}
+
+const AdmissionControl &ConnectionManager::admissionControl() const {
+    return admissionControl_;
+}
+
+void ConnectionManager::setHttp2Options(Http2Options options) {
+    http2Options_ = options;
+}
+
+const Http2Options &ConnectionManager::http2Options() const {
+    return http2Options_;
+}
+
+void ConnectionManager::setConnectionTimeouts(ConnectionTimeouts timeouts) {
+    connectionTimeouts_ = timeouts;
+}
+
+void ConnectionManager::setRateLimit(RateLimit limit) {
+    rateLimiter_.reset(new RateLimiter(limit));
+}
+
+RateLimiter *ConnectionManager::rateLimiter() const {
+    return rateLimiter_.get();
+}
+
+#ifdef BEAUTY_ENABLE_TLS
+void ConnectionManager::setTlsContext(TlsContext *context) {
+    tlsContext_ = context;
+}
+
+TlsContext *ConnectionManager::tlsContext() const {
+    return tlsContext_;
+}
+#endif
+
+bool ConnectionManager::hasCapacity() const {
+    size_t n = connections_.size() + 1;
+    if (admissionControl_.maxConnections_ > 0 && n > admissionControl_.maxConnections_) {
+        return false;
+    }
+    if (admissionControl_.bufferBudget_ > 0 &&
+        bufferPool_.getStats().inUseBytes_ + bytesPerConnection_ >
+            admissionControl_.bufferBudget_) {
+        return false;
+    }
+    return true;
+}
+
+bool ConnectionManager::makeRoom() {
+    // idle connections hold no buffers, evicting them only frees a
+    // connection slot
+    while (admissionControl_.maxConnections_ > 0 &&
+           connections_.size() + 1 > admissionControl_.maxConnections_) {
+        if (!evictIdle()) {
+            return false;
+        }
+    }
+    return hasCapacity();
+}
+
+bool ConnectionManager::evictIdle() {
+    auto oldest = connections_.end();
+    for (auto it = connections_.begin(); it != connections_.end(); ++it) {
+        if ((*it)->isIdle() && (oldest == connections_.end() ||
+                                (*it)->getLastReceivedTime() < (*oldest)->getLastReceivedTime())) {
+            oldest = it;
+        }
+    }
+    if (oldest == connections_.end()) {
+        return false;
+    }
+    BEAUTY_LOG(logger_, LogLevel::info, "Evicting idle connection");
+    (*oldest)->stop();
+    connections_.erase(oldest);
+    return true;
+}
+
+void ConnectionManager::setConnectionsClosedHandler(const std::function<void()> &cb) {
+    connectionsClosedCb_ = cb;
+}
+
 void ConnectionManager::tick() {
+    size_t nrOfConnections = connections_.size();
     auto now = std::chrono::steady_clock::now();
     auto it = connections_.begin();
     while (it != connections_.end()) {
-        if ((*it)->useKeepAlive()) {
+        if ((*it)->isStalled(connectionTimeouts_, now)) {
+            BEAUTY_LOG(logger_, LogLevel::info, "Removing connection due to slow client");
+            (*it)->stop();
+            it = connections_.erase(it);
+        } else if ((*it)->useKeepAlive()) {
             bool erase = false;
             if (((*it)->getLastReceivedTime() + httpPersistence_.keepAliveTimeout_ < now)) {
-                debugMsgCb_("Removing connection due to inactivity");
+                BEAUTY_LOG(logger_, LogLevel::info, "Removing connection due to inactivity");
                 erase = true;
             }
             if ((*it)->getNrOfRequests() >= httpPersistence_.keepAliveMax_) {
-                debugMsgCb_("Removing connection due max request limit");
+                BEAUTY_LOG(logger_, LogLevel::info, "Removing connection due max request limit");
+                erase = true;
+            }
+            if (draining_ && (*it)->isIdle()) {
+                // e.g. an HTTP/2 connection whose last stream ended
                 erase = true;
             }
 
@@ -59,14 +207,31 @@ void ConnectionManager::tick() {
             it++;
         }
     }
+    // buffers also return to the pool when a connection goes idle
+    if ((connections_.size() < nrOfConnections || admissionControl_.bufferBudget_ > 0) &&
+        connectionsClosedCb_) {
+        connectionsClosedCb_();
+    }
+}
+
+size_t ConnectionManager::getNrOfConnections() const {
+    return connections_.size();
 }
 
 void ConnectionManager::setDebugMsgHandler(const debugMsgCallback &cb) {
-    debugMsgCb_ = cb;
+    logger_.setDebugMsgHandler(cb);
+}
+
+Logger &ConnectionManager::logger() {
+    return logger_;
+}
+
+BufferPool &ConnectionManager::bufferPool() {
+    return bufferPool_;
 }
 
-void ConnectionManager::debugMsg(const std::string &msg) {
-    debugMsgCb_(msg);
+const BufferPool &ConnectionManager::bufferPool() const {
+    return bufferPool_;
 }
 
 }  // namespace beauty
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <set>
 
+#include "buffer_pool.hpp"
 #include "connection.hpp"
+#include "logger.hpp"
+#include "rate_limiter.hpp"
+#include "tls_context.hpp"
 
 namespace beauty {
 
@@ -15,7 +20,7 @@ class ConnectionManager {
     ConnectionManager &operator=(const ConnectionManager &) = delete;
 
     // Construct a connection manager.
-    ConnectionManager(HttpPersistence options);
+    ConnectionManager(HttpPersistence options, size_t maxContentSize);
 
     // Add the specified connection to the manager and start it.
     void start(std::shared_ptr<Connection> c);
@@ -23,30 +28,125 @@ class ConnectionManager {
     // Stop the specified connection.
     void stop(std::shared_ptr<Connection> c);
 
-    // Stop all connections.
+    // Stop all connections. Connections still open while draining are
+    // counted as cut in the drain report.
     void stopAll();
 
+    // Outcome of a graceful shutdown, see drain().
+    struct DrainReport {
+        // Idle keep-alive connections, connections without a request and
+        // event streams, closed when the drain started.
+        size_t closedIdle_;
+        // Connections busy when the drain started. Those not cut completed.
+        size_t inFlight_;
+        // Connections closed at the deadline, by what they were doing.
+        size_t cutRequests_;
+        size_t cutUploads_;
+        size_t cutDownloads_;
+        size_t cutWebSockets_;
+        size_t cutHttp2_;
+    };
+
+    // Close the connections without a request in progress, and each other
+    // connection after its current response. New connections get no
+    // keep-alive.
+    void drain();
+    bool isDraining() const;
+    const DrainReport &getDrainReport() const;
+
     // Set connection options.
     void setHttpPersistence(HttpPersistence options);
 
+    // Set admission limits. bytesPerConnection is the buffer memory a new
+    // connection borrows from the pool for its first request.
+    void setAdmissionControl(AdmissionControl admission, size_t bytesPerConnection);
+    const AdmissionControl &admissionControl() const;
+
+    // Set HTTP/2 options of new connections.
+    void setHttp2Options(Http2Options options);
+    const Http2Options &http2Options() const;
+
+    // Set the deadlines of request phases, checked on each tick.
+    void setConnectionTimeouts(ConnectionTimeouts timeouts);
+
+    // Limit the rate and connections of each client IP address.
+    void setRateLimit(RateLimit limit);
+
+    // nullptr without a rate limit.
+    RateLimiter *rateLimiter() const;
+
+#ifdef BEAUTY_ENABLE_TLS
+    // New connections start with a TLS handshake when a context is set.
+    void setTlsContext(TlsContext *context);
+    TlsContext *tlsContext() const;
+#endif
+
+    // True if a new connection fits within the admission limits.
+    bool hasCapacity() const;
+
+    // Evict idle keep-alive connections, oldest first, until a new
+    // connection is within the connection limit. Returns false if there is
+    // still no capacity.
+    bool makeRoom();
+
+    // Called when connections have been stopped and capacity may be
+    // available.
+    void setConnectionsClosedHandler(const std::function<void()> &cb);
+
     // Handle connections periodically.
     void tick();
 
+    size_t getNrOfConnections() const;
+
     // Handler for debug messages
     void setDebugMsgHandler(const debugMsgCallback &cb);
 
-    // Connections may use the debug message handler.
-    void debugMsg(const std::string &msg);
+    // Connections may use the logger.
+    Logger &logger();
+
+    // Connections borrow their buffers from the pool while serving a
+    // request.
+    BufferPool &bufferPool();
+    const BufferPool &bufferPool() const;
 
    private:
+    // Stop the keep-alive connection that has been idle the longest. Returns
+    // false if there is no idle connection.
+    bool evictIdle();
+
     // The managed connections.
     std::set<std::shared_ptr<Connection>> connections_;
 
     // Http persistence options.
     HttpPersistence httpPersistence_;
 
-    // Callback to handle debug messages.
-    debugMsgCallback debugMsgCb_;
+    bool draining_ = false;
+    DrainReport drainReport_ = DrainReport();
+
+    // Admission limits.
+    AdmissionControl admissionControl_;
+    size_t bytesPerConnection_ = 0;
+    std::function<void()> connectionsClosedCb_;
+
+    // HTTP/2 options, disabled by default.
+    Http2Options http2Options_;
+
+    // Request phase deadlines, disabled by default.
+    ConnectionTimeouts connectionTimeouts_;
+
+    // Set by setRateLimit().
+    std::unique_ptr<RateLimiter> rateLimiter_;
+
+#ifdef BEAUTY_ENABLE_TLS
+    // TLS of new connections, owned by the server.
+    TlsContext *tlsContext_ = nullptr;
+#endif
+
+    // Leveled logging, disabled until a sink is installed.
+    Logger logger_;
+
+    // Buffers shared by all connections.
+    BufferPool bufferPool_;
 };
 
 }  // namespace beauty
@@ -0,0 +1,140 @@
+#include "connection_socket.hpp"
+#include "socket_option.hpp"
+
+#ifdef BEAUTY_ENABLE_TLS
+#include <cerrno>
+
+#include <asio/ssl/error.hpp>
+#include <openssl/err.h>
+#endif
+
+namespace beauty {
+
+ConnectionSocket::ConnectionSocket(socket_type socket) : socket_(std::move(socket)) {}
+
+ConnectionSocket::~ConnectionSocket() {
+#ifdef BEAUTY_ENABLE_TLS
+    SSL_free(ssl_);
+#endif
+}
+
+size_t ConnectionSocket::available(std::error_code &ec) const {
+#ifdef BEAUTY_ENABLE_TLS
+    if (ssl_ != nullptr) {
+        ec = std::error_code();
+        return static_cast<size_t>(SSL_pending(ssl_));
+    }
+#endif
+    return socket_.available(ec);
+}
+
+void ConnectionSocket::shutdown(asio::socket_base::shutdown_type what, std::error_code &ec) {
+#ifdef BEAUTY_ENABLE_TLS
+    if (ssl_ != nullptr && what != asio::socket_base::shutdown_receive &&
+        SSL_is_init_finished(ssl_)) {
+        // best effort, the connection is closed without waiting for the
+        // close_notify of the client
+        ERR_clear_error();
+        SSL_shutdown(ssl_);
+        ERR_clear_error();
+    }
+#endif
+    socket_.shutdown(what, ec);
+}
+
+void ConnectionSocket::close() {
+    socket_.close();
+}
+
+void ConnectionSocket::armQuickAck() {
+#if defined(TCP_QUICKACK)
+    std::error_code ignored_ec;
+    socket_.set_option(quick_ack(1), ignored_ec);
+#endif
+}
+
+#ifdef BEAUTY_ENABLE_TLS
+
+bool ConnectionSocket::startTls(TlsContext &context) {
+    std::error_code ec;
+    socket_.non_blocking(true, ec);
+    ssl_ = ec ? nullptr : context.newSsl();
+    if (ssl_ == nullptr || SSL_set_fd(ssl_, static_cast<int>(socket_.native_handle())) != 1) {
+        context.handshakeFailed();
+        return false;
+    }
+    SSL_set_accept_state(ssl_);
+    tlsContext_ = &context;
+    record_.reset(new char[maxRecordSize]);
+    handshakeStart_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+ConnectionSocket::tls_result ConnectionSocket::tlsHandshake(std::error_code &ec) {
+    ERR_clear_error();
+    errno = 0;
+    tls_result result = toResult(SSL_do_handshake(ssl_), ec);
+    if (result == tls_done) {
+        if (!ec) {
+            tlsContext_->handshakeDone(ssl_, std::chrono::steady_clock::now() - handshakeStart_);
+        } else {
+            tlsContext_->handshakeFailed();
+        }
+    }
+    return result;
+}
+
+ConnectionSocket::tls_result ConnectionSocket::tlsRead(asio::mutable_buffer buffer,
+                                                       size_t &size,
+                                                       std::error_code &ec) {
+    size = 0;
+    if (buffer.size() == 0) {
+        return tls_done;
+    }
+    ERR_clear_error();
+    errno = 0;
+    return toResult(SSL_read_ex(ssl_, buffer.data(), buffer.size(), &size), ec);
+}
+
+ConnectionSocket::tls_result ConnectionSocket::tlsWrite(const char *data,
+                                                        size_t size,
+                                                        size_t &written,
+                                                        std::error_code &ec) {
+    written = 0;
+    if (size == 0) {
+        return tls_done;
+    }
+    ERR_clear_error();
+    errno = 0;
+    return toResult(SSL_write_ex(ssl_, data, size, &written), ec);
+}
+
+ConnectionSocket::tls_result ConnectionSocket::toResult(int ret, std::error_code &ec) {
+    if (ret == 1) {
+        return tls_done;
+    }
+    int error = errno;
+    switch (SSL_get_error(ssl_, ret)) {
+        case SSL_ERROR_WANT_READ:
+            return tls_want_read;
+        case SSL_ERROR_WANT_WRITE:
+            return tls_want_write;
+        case SSL_ERROR_ZERO_RETURN:
+            ec = asio::error::eof;
+            break;
+        case SSL_ERROR_SYSCALL:
+            ec = error != 0 ? std::error_code(error, asio::error::get_system_category())
+                            : std::error_code(asio::error::eof);
+            break;
+        default:
+            ec = std::error_code(static_cast<int>(ERR_get_error()),
+                                 asio::error::get_ssl_category());
+            ERR_clear_error();
+            break;
+    }
+    return tls_done;
+}
+
+#endif  // BEAUTY_ENABLE_TLS
+
+}  // namespace beauty
@@ -0,0 +1,282 @@
+#pragma once
+#include "environment.hpp"
+
+#include <algorithm>
+#include <asio.hpp>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#ifdef BEAUTY_ENABLE_TLS
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+#include <openssl/ssl.h>
+
+#include "tls_context.hpp"
+#endif
+
+namespace beauty {
+
+// The socket of a connection, plain or TLS once startTls() is called, over
+// TCP or a Unix domain socket. Offers the stream socket operations that
+// Connection uses, so asio::async_write accepts it as a stream.
+//
+// TLS is done by OpenSSL directly on the non-blocking socket, rather than
+// through an asio::ssl::stream, so that OpenSSL may hand the record
+// encryption over to the kernel (kTLS) once the handshake is done.
+class ConnectionSocket {
+   public:
+    // Holds a TCP or Unix domain socket, see Listener.
+    typedef asio::generic::stream_protocol::socket socket_type;
+    typedef socket_type::executor_type executor_type;
+
+    ConnectionSocket(const ConnectionSocket &) = delete;
+    ConnectionSocket &operator=(const ConnectionSocket &) = delete;
+
+    explicit ConnectionSocket(socket_type socket);
+    ~ConnectionSocket();
+
+    executor_type get_executor() {
+        return socket_.get_executor();
+    }
+
+    // Linux leaves quick ACK mode again on its own, so TCP_QUICKACK is set
+    // anew before each read. TCP sockets only.
+    void setQuickAck(bool enabled) {
+        quickAck_ = enabled;
+    }
+
+    template <typename MutableBufferSequence, typename ReadHandler>
+    void async_read_some(const MutableBufferSequence &buffers, ReadHandler &&handler) {
+        if (quickAck_) {
+            armQuickAck();
+        }
+#ifdef BEAUTY_ENABLE_TLS
+        if (ssl_ != nullptr) {
+            startTlsOperation(ReadAttempt(firstBuffer(buffers)),
+                              std::forward<ReadHandler>(handler));
+            return;
+        }
+#endif
+        socket_.async_read_some(buffers, std::forward<ReadHandler>(handler));
+    }
+
+    template <typename ConstBufferSequence, typename WriteHandler>
+    void async_write_some(const ConstBufferSequence &buffers, WriteHandler &&handler) {
+#ifdef BEAUTY_ENABLE_TLS
+        if (ssl_ != nullptr) {
+            startTlsOperation(WriteAttempt<ConstBufferSequence>(buffers),
+                              std::forward<WriteHandler>(handler));
+            return;
+        }
+#endif
+        socket_.async_write_some(buffers, std::forward<WriteHandler>(handler));
+    }
+
+    // Wait until reading would not block. With TLS, data already decrypted
+    // is ready without waiting for the socket.
+    template <typename WaitHandler>
+    void async_wait(asio::socket_base::wait_type type, WaitHandler &&handler) {
+#ifdef BEAUTY_ENABLE_TLS
+        if (ssl_ != nullptr && type == asio::socket_base::wait_read && SSL_has_pending(ssl_)) {
+            asio::post(socket_.get_executor(),
+                       std::bind(std::forward<WaitHandler>(handler), std::error_code()));
+            return;
+        }
+#endif
+        socket_.async_wait(type, std::forward<WaitHandler>(handler));
+    }
+
+    // Bytes that can be read without blocking.
+    size_t available(std::error_code &ec) const;
+
+    // Read without blocking, e.g. after available() reported data.
+    template <typename MutableBufferSequence>
+    size_t read_some(const MutableBufferSequence &buffers, std::error_code &ec) {
+#ifdef BEAUTY_ENABLE_TLS
+        if (ssl_ != nullptr) {
+            size_t size = 0;
+            ec = std::error_code();
+            if (tlsRead(firstBuffer(buffers), size, ec) != tls_done) {
+                ec = asio::error::would_block;
+            }
+            return size;
+        }
+#endif
+        return socket_.read_some(buffers, ec);
+    }
+
+    // With TLS, shutting down sending first sends a close_notify alert.
+    void shutdown(asio::socket_base::shutdown_type what, std::error_code &ec);
+    void close();
+
+#ifdef BEAUTY_ENABLE_TLS
+    // Switch to TLS as the server side of context. The handshake is
+    // started by async_handshake(). Returns false if OpenSSL fails to set up
+    // the connection.
+    bool startTls(TlsContext &context);
+
+    // Complete the handshake, then reads and writes carry application data.
+    // The handler is called with the error of a failed handshake.
+    template <typename HandshakeHandler>
+    void async_handshake(HandshakeHandler &&handler) {
+        startTlsOperation(HandshakeAttempt(),
+                          DiscardSize<typename std::decay<HandshakeHandler>::type>(
+                              std::forward<HandshakeHandler>(handler)));
+    }
+#endif
+
+   private:
+    void armQuickAck();
+
+    socket_type socket_;
+    bool quickAck_ = false;
+
+#ifdef BEAUTY_ENABLE_TLS
+    // Records carry at most 16 kB of data.
+    static const size_t maxRecordSize = 16384;
+
+    enum tls_result { tls_done, tls_want_read, tls_want_write };
+
+    // One non-blocking attempt of an OpenSSL call. On tls_done, ec holds the
+    // outcome.
+    tls_result tlsHandshake(std::error_code &ec);
+    tls_result tlsRead(asio::mutable_buffer buffer, size_t &size, std::error_code &ec);
+    tls_result tlsWrite(const char *data, size_t size, size_t &written, std::error_code &ec);
+    tls_result toResult(int ret, std::error_code &ec);
+
+    template <typename MutableBufferSequence>
+    static asio::mutable_buffer firstBuffer(const MutableBufferSequence &buffers) {
+        auto end = asio::buffer_sequence_end(buffers);
+        for (auto it = asio::buffer_sequence_begin(buffers); it != end; ++it) {
+            asio::mutable_buffer buffer(*it);
+            if (buffer.size() > 0) {
+                return buffer;
+            }
+        }
+        return asio::mutable_buffer();
+    }
+
+    struct HandshakeAttempt {
+        tls_result operator()(ConnectionSocket &socket, size_t &, std::error_code &ec) {
+            return socket.tlsHandshake(ec);
+        }
+    };
+
+    struct ReadAttempt {
+        explicit ReadAttempt(asio::mutable_buffer buffer) : buffer_(buffer) {}
+        tls_result operator()(ConnectionSocket &socket, size_t &size, std::error_code &ec) {
+            return socket.tlsRead(buffer_, size, ec);
+        }
+        asio::mutable_buffer buffer_;
+    };
+
+    template <typename ConstBufferSequence>
+    struct WriteAttempt {
+        explicit WriteAttempt(const ConstBufferSequence &buffers) : buffers_(buffers) {}
+        tls_result operator()(ConnectionSocket &socket, size_t &size, std::error_code &ec) {
+            auto it = asio::buffer_sequence_begin(buffers_);
+            auto end = asio::buffer_sequence_end(buffers_);
+            while (it != end && asio::const_buffer(*it).size() == 0) {
+                ++it;
+            }
+            if (it == end) {
+                return socket.tlsWrite(nullptr, 0, size, ec);
+            }
+            // A single buffer, or one filling a record, is written in place.
+            asio::const_buffer first(*it);
+            bool single = true;
+            for (auto next = std::next(it); next != end && single; ++next) {
+                single = asio::const_buffer(*next).size() == 0;
+            }
+            if (single || first.size() >= maxRecordSize) {
+                return socket.tlsWrite(
+                    static_cast<const char *>(first.data()), first.size(), size, ec);
+            }
+            // Small buffers, e.g. the header lines of a reply, are gathered
+            // into one record instead of a record each. A retried write
+            // gathers the same data again.
+            char *record = socket.record_.get();
+            size_t recordSize = 0;
+            for (; it != end && recordSize < maxRecordSize; ++it) {
+                asio::const_buffer buffer(*it);
+                if (buffer.size() == 0) {
+                    continue;
+                }
+                size_t n = std::min(buffer.size(), maxRecordSize - recordSize);
+                std::memcpy(record + recordSize, buffer.data(), n);
+                recordSize += n;
+            }
+            return socket.tlsWrite(record, recordSize, size, ec);
+        }
+        ConstBufferSequence buffers_;
+    };
+
+    template <typename Handler>
+    struct DiscardSize {
+        explicit DiscardSize(Handler handler) : handler_(std::move(handler)) {}
+        void operator()(std::error_code ec, size_t) {
+            handler_(ec);
+        }
+        Handler handler_;
+    };
+
+    // Retries an attempt whenever the socket is ready for what OpenSSL waits
+    // for, then calls the handler with the error and size transferred.
+    template <typename Attempt, typename Handler>
+    struct TlsOperation {
+        TlsOperation(ConnectionSocket &socket, Attempt attempt, Handler handler)
+            : socket_(&socket), attempt_(std::move(attempt)), handler_(std::move(handler)) {}
+
+        void operator()(std::error_code ec) {
+            if (ec) {
+                handler_(ec, 0);
+                return;
+            }
+            run(false);
+        }
+
+        void run(bool initiating) {
+            size_t size = 0;
+            std::error_code ec;
+            tls_result result = attempt_(*socket_, size, ec);
+            if (result != tls_done) {
+                socket_->socket_.async_wait(result == tls_want_read
+                                                ? asio::socket_base::wait_read
+                                                : asio::socket_base::wait_write,
+                                            std::move(*this));
+            } else if (initiating) {
+                // the handler is never called from within the initiating
+                // function
+                asio::post(socket_->get_executor(), std::bind(std::move(handler_), ec, size));
+            } else {
+                handler_(ec, size);
+            }
+        }
+
+        ConnectionSocket *socket_;
+        Attempt attempt_;
+        Handler handler_;
+    };
+
+    template <typename Attempt, typename Handler>
+    void startTlsOperation(Attempt attempt, Handler &&handler) {
+        TlsOperation<Attempt, typename std::decay<Handler>::type> operation(
+            *this, std::move(attempt), std::forward<Handler>(handler));
+        operation.run(true);
+    }
+
+    SSL *ssl_ = nullptr;
+    TlsContext *tlsContext_ = nullptr;
+    // Gathers the small buffers of a write, see WriteAttempt. A connection
+    // has one write in progress at a time.
+    std::unique_ptr<char[]> record_;
+    std::chrono::steady_clock::time_point handshakeStart_;
+#endif
+};
+
+}  // namespace beauty
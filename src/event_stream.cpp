@@ -0,0 +1,136 @@
+#include "connection.hpp"
+#include "event_stream.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace beauty {
+
+namespace {
+
+// Append the value of a single line field, dropping CR and LF, which would
+// end the line and let the value inject further fields or events.
+void appendField(std::string &block, const std::string &value) {
+    for (char c : value) {
+        if (c != '\r' && c != '\n') {
+            block.push_back(c);
+        }
+    }
+    block.push_back('\n');
+}
+
+}  // namespace
+
+EventBroadcaster::EventBroadcaster(size_t maxQueued, OverflowPolicy policy)
+    : maxQueued_(std::max<size_t>(maxQueued, 1)), policy_(policy) {}
+
+void EventBroadcaster::publish(const std::string &data,
+                               const std::string &event,
+                               const std::string &id) {
+    publish(serialize(data, event, id));
+}
+
+void EventBroadcaster::publish(const SerializedEvent &event) {
+    std::vector<Subscriber> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribers_.erase(std::remove_if(subscribers_.begin(),
+                                          subscribers_.end(),
+                                          [](const Subscriber &s) {
+                                              return s.connection_.expired();
+                                          }),
+                           subscribers_.end());
+        subscribers = subscribers_;
+    }
+    // only the pointer to the event is copied per subscriber
+    for (const Subscriber &s : subscribers) {
+        std::weak_ptr<Connection> weak = s.connection_;
+        asio::dispatch(s.executor_, [weak, event] {
+            if (std::shared_ptr<Connection> connection = weak.lock()) {
+                connection->queueEvent(event);
+            }
+        });
+    }
+}
+
+SerializedEvent EventBroadcaster::serialize(const std::string &data,
+                                            const std::string &event,
+                                            const std::string &id) {
+    auto block = std::make_shared<std::string>();
+    block->reserve(data.size() + event.size() + id.size() + 32);
+    if (!event.empty()) {
+        block->append("event: ");
+        appendField(*block, event);
+    }
+    if (!id.empty()) {
+        block->append("id: ");
+        appendField(*block, id);
+    }
+    // a client ends a line at CRLF, CR or LF
+    size_t pos = 0;
+    do {
+        size_t end = data.find_first_of("\r\n", pos);
+        if (end == std::string::npos) {
+            end = data.size();
+        }
+        block->append("data: ").append(data, pos, end - pos).push_back('\n');
+        pos = end + (data.compare(end, 2, "\r\n") == 0 ? 2 : 1);
+    } while (pos <= data.size());
+    block->push_back('\n');
+    return block;
+}
+
+size_t EventBroadcaster::subscriberCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::count_if(subscribers_.begin(), subscribers_.end(), [](const Subscriber &s) {
+        return !s.connection_.expired();
+    });
+}
+
+void EventBroadcaster::subscribe(const std::weak_ptr<Connection> &connection,
+                                 const asio::ip::tcp::socket::executor_type &executor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.push_back({connection, executor});
+}
+
+EventQueue::EventQueue(size_t maxQueued, EventBroadcaster::OverflowPolicy policy)
+    : maxQueued_(maxQueued), policy_(policy) {}
+
+bool EventQueue::push(const SerializedEvent &event) {
+    if (waiting() >= maxQueued_) {
+        switch (policy_) {
+            case EventBroadcaster::drop_oldest:
+                events_.erase(events_.begin() + writing_);
+                dropped_++;
+                break;
+            case EventBroadcaster::drop_newest:
+                dropped_++;
+                return true;
+            case EventBroadcaster::keep_latest:
+                dropped_ += waiting();
+                events_.erase(events_.begin() + writing_, events_.end());
+                break;
+            case EventBroadcaster::disconnect:
+                return false;
+        }
+    }
+    events_.push_back(event);
+    return true;
+}
+
+std::vector<asio::const_buffer> EventQueue::startWrite(size_t maxEvents) {
+    writing_ = std::min(events_.size(), maxEvents);
+    std::vector<asio::const_buffer> buffers;
+    buffers.reserve(writing_);
+    for (size_t i = 0; i < writing_; ++i) {
+        buffers.push_back(asio::buffer(*events_[i]));
+    }
+    return buffers;
+}
+
+void EventQueue::written() {
+    events_.erase(events_.begin(), events_.begin() + writing_);
+    writing_ = 0;
+}
+
+}  // namespace beauty
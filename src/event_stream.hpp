@@ -0,0 +1,121 @@
+#pragma once
+#include "environment.hpp"
+
+#include <asio.hpp>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace beauty {
+
+class Connection;
+
+// An event rendered once in the text/event-stream format. Every subscriber
+// writes from the same block.
+using SerializedEvent = std::shared_ptr<const std::string>;
+
+// Publishes Server-Sent Events to the connections parked on it with
+// Reply::acceptEventStream(). publish() may be called from any thread.
+class EventBroadcaster {
+   public:
+    EventBroadcaster(const EventBroadcaster &) = delete;
+    EventBroadcaster &operator=(const EventBroadcaster &) = delete;
+
+    // What a subscriber does with a new event when maxQueued events are
+    // already waiting to be written.
+    enum OverflowPolicy {
+        // Drop the oldest waiting event.
+        drop_oldest,
+        // Drop the new event.
+        drop_newest,
+        // Drop all waiting events, i.e. send only the latest state.
+        keep_latest,
+        // Close the connection.
+        disconnect
+    };
+
+    explicit EventBroadcaster(size_t maxQueued = 64, OverflowPolicy policy = drop_oldest);
+
+    // Serialize the event once and queue it on every subscriber. Lines of
+    // data, ended by CRLF, CR or LF, are sent as separate data fields. Event
+    // and id are omitted when empty, CR and LF are dropped from them.
+    void publish(const std::string &data,
+                 const std::string &event = std::string(),
+                 const std::string &id = std::string());
+    void publish(const SerializedEvent &event);
+
+    // Render an event in the text/event-stream format.
+    static SerializedEvent serialize(const std::string &data,
+                                     const std::string &event = std::string(),
+                                     const std::string &id = std::string());
+
+    size_t subscriberCount() const;
+
+    size_t maxQueued() const {
+        return maxQueued_;
+    }
+    OverflowPolicy policy() const {
+        return policy_;
+    }
+
+   private:
+    friend class Connection;
+
+    struct Subscriber {
+        std::weak_ptr<Connection> connection_;
+        asio::ip::tcp::socket::executor_type executor_;
+    };
+
+    void subscribe(const std::weak_ptr<Connection> &connection,
+                   const asio::ip::tcp::socket::executor_type &executor);
+
+    const size_t maxQueued_;
+    const OverflowPolicy policy_;
+
+    mutable std::mutex mutex_;
+    std::vector<Subscriber> subscribers_;
+};
+
+// The events waiting to be written to one subscriber. The front events are
+// being written while writing_ is non zero. Only used from the io_context
+// thread.
+class EventQueue {
+   public:
+    EventQueue(size_t maxQueued, EventBroadcaster::OverflowPolicy policy);
+
+    // Queue event according to the overflow policy. Returns false if the
+    // subscriber should be disconnected.
+    bool push(const SerializedEvent &event);
+
+    // Start writing up to maxEvents events, the buffers stay valid until
+    // written() is called.
+    std::vector<asio::const_buffer> startWrite(size_t maxEvents);
+    void written();
+
+    bool isWriting() const {
+        return writing_ != 0;
+    }
+    bool empty() const {
+        return events_.empty();
+    }
+
+    // Events waiting to be written, and the number of events dropped so far.
+    size_t waiting() const {
+        return events_.size() - writing_;
+    }
+    size_t dropped() const {
+        return dropped_;
+    }
+
+   private:
+    const size_t maxQueued_;
+    const EventBroadcaster::OverflowPolicy policy_;
+    std::deque<SerializedEvent> events_;
+    size_t writing_ = 0;
+    size_t dropped_ = 0;
+};
+
+}  // namespace beauty
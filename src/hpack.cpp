@@ -0,0 +1,426 @@
+#include "hpack.hpp"
+
+#include <cctype>
+
+namespace beauty {
+
+namespace {
+
+// RFC 7541 Appendix A.
+const char *const staticTable[][2] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+const size_t staticTableSize = sizeof(staticTable) / sizeof(staticTable[0]);
+
+// Bit lengths of the Huffman codes of RFC 7541 Appendix B, the last entry
+// is EOS.
+const uint8_t huffmanLengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30
+};
+
+// The Huffman code is canonical, i.e. codes of the same length are
+// consecutive in symbol order, so the codes follow from the lengths.
+struct HuffmanTable {
+    static const unsigned maxLength = 30;
+
+    HuffmanTable() {
+        for (unsigned length = 0; length <= maxLength; ++length) {
+            count_[length] = 0;
+        }
+        for (unsigned symbol = 0; symbol < 257; ++symbol) {
+            count_[huffmanLengths[symbol]]++;
+        }
+        uint32_t code = 0;
+        uint16_t index = 0;
+        for (unsigned length = 1; length <= maxLength; ++length) {
+            code = (code + count_[length - 1]) << 1;
+            firstCode_[length] = code;
+            firstIndex_[length] = index;
+            index += count_[length];
+        }
+        uint32_t next[maxLength + 1];
+        uint16_t nextIndex[maxLength + 1];
+        for (unsigned length = 1; length <= maxLength; ++length) {
+            next[length] = firstCode_[length];
+            nextIndex[length] = firstIndex_[length];
+        }
+        for (unsigned symbol = 0; symbol < 257; ++symbol) {
+            unsigned length = huffmanLengths[symbol];
+            codes_[symbol] = next[length]++;
+            symbols_[nextIndex[length]++] = static_cast<uint16_t>(symbol);
+        }
+    }
+
+    uint32_t codes_[257];
+
+    // Per length the first code, the index of its symbol in symbols_ and
+    // the number of codes.
+    uint32_t firstCode_[maxLength + 1];
+    uint16_t firstIndex_[maxLength + 1];
+    uint16_t count_[maxLength + 1];
+    uint16_t symbols_[257];
+};
+
+const HuffmanTable &huffmanTable() {
+    static const HuffmanTable table;
+    return table;
+}
+
+const std::vector<Header> &staticHeaders() {
+    static const std::vector<Header> headers = [] {
+        std::vector<Header> h;
+        for (size_t i = 0; i < staticTableSize; ++i) {
+            h.push_back({staticTable[i][0], staticTable[i][1]});
+        }
+        return h;
+    }();
+    return headers;
+}
+
+size_t entrySize(const Header &header) {
+    return header.name_.size() + header.value_.size() + 32;
+}
+
+// Integer with an n bit prefix, RFC 7541 5.1.
+bool decodeInteger(const uint8_t *&p, const uint8_t *end, unsigned n, size_t &value) {
+    if (p == end) {
+        return false;
+    }
+    size_t max = (1u << n) - 1;
+    value = *p++ & max;
+    if (value < max) {
+        return true;
+    }
+    for (unsigned shift = 0; p != end && shift <= 28; shift += 7) {
+        uint8_t b = *p++;
+        value += static_cast<size_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    // truncated, or too large for any sane header
+    return false;
+}
+
+void encodeInteger(size_t value, unsigned n, uint8_t prefix, std::string &out) {
+    size_t max = (1u << n) - 1;
+    if (value < max) {
+        out.push_back(static_cast<char>(prefix | value));
+        return;
+    }
+    out.push_back(static_cast<char>(prefix | max));
+    value -= max;
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(0x80 | (value & 0x7f)));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool decodeString(const uint8_t *&p, const uint8_t *end, std::string &out) {
+    if (p == end) {
+        return false;
+    }
+    bool huffman = (*p & 0x80) != 0;
+    size_t length;
+    if (!decodeInteger(p, end, 7, length) || length > static_cast<size_t>(end - p)) {
+        return false;
+    }
+    if (huffman) {
+        if (!hpack::huffmanDecode(p, length, out)) {
+            return false;
+        }
+    } else {
+        out.assign(reinterpret_cast<const char *>(p), length);
+    }
+    p += length;
+    return true;
+}
+
+void encodeString(const std::string &str, std::string &out) {
+    size_t huffmanSize = hpack::huffmanEncodedSize(str.data(), str.size());
+    if (huffmanSize < str.size()) {
+        encodeInteger(huffmanSize, 7, 0x80, out);
+        hpack::huffmanEncode(str.data(), str.size(), out);
+    } else {
+        encodeInteger(str.size(), 7, 0x00, out);
+        out += str;
+    }
+}
+
+}  // namespace
+
+HpackDecoder::HpackDecoder(size_t maxTableSize, size_t maxHeaderListSize)
+    : maxSize_(maxTableSize), limit_(maxTableSize), maxHeaderListSize_(maxHeaderListSize) {}
+
+bool HpackDecoder::decode(const uint8_t *data, size_t size, std::vector<Header> &headers) {
+    const uint8_t *p = data;
+    const uint8_t *end = data + size;
+    bool fieldSeen = false;
+    size_t listSize = 0;
+    while (p != end) {
+        uint8_t b = *p;
+        if ((b & 0x80) != 0) {
+            // indexed field
+            size_t index;
+            if (!decodeInteger(p, end, 7, index)) {
+                return false;
+            }
+            const Header *header = lookup(index);
+            if (header == nullptr) {
+                return false;
+            }
+            listSize += entrySize(*header);
+            if (listSize > maxHeaderListSize_) {
+                return false;
+            }
+            headers.push_back(*header);
+        } else if ((b & 0xe0) == 0x20) {
+            // dynamic table size update, only allowed before the first field
+            size_t maxSize;
+            if (!decodeInteger(p, end, 5, maxSize) || fieldSeen || maxSize > limit_) {
+                return false;
+            }
+            maxSize_ = maxSize;
+            evict(maxSize_);
+            continue;
+        } else {
+            // literal with incremental indexing (01), without indexing (0000)
+            // or never indexed (0001)
+            bool indexing = (b & 0xc0) == 0x40;
+            size_t nameIndex;
+            if (!decodeInteger(p, end, indexing ? 6 : 4, nameIndex)) {
+                return false;
+            }
+            Header header;
+            if (nameIndex == 0) {
+                if (!decodeString(p, end, header.name_)) {
+                    return false;
+                }
+            } else {
+                const Header *name = lookup(nameIndex);
+                if (name == nullptr) {
+                    return false;
+                }
+                header.name_ = name->name_;
+            }
+            if (!decodeString(p, end, header.value_)) {
+                return false;
+            }
+            listSize += entrySize(header);
+            if (listSize > maxHeaderListSize_) {
+                return false;
+            }
+            if (indexing) {
+                insert(header);
+            }
+            headers.push_back(std::move(header));
+        }
+        fieldSeen = true;
+    }
+    return true;
+}
+
+void HpackDecoder::setMaxTableSize(size_t maxTableSize) {
+    limit_ = maxTableSize;
+    if (maxSize_ > limit_) {
+        maxSize_ = limit_;
+        evict(maxSize_);
+    }
+}
+
+const Header *HpackDecoder::lookup(size_t index) const {
+    if (index == 0) {
+        return nullptr;
+    }
+    if (index <= staticTableSize) {
+        return &staticHeaders()[index - 1];
+    }
+    index -= staticTableSize + 1;
+    return index < table_.size() ? &table_[index] : nullptr;
+}
+
+void HpackDecoder::insert(Header header) {
+    size_t size = entrySize(header);
+    if (size > maxSize_) {
+        // an entry larger than the table empties it, RFC 7541 4.4
+        evict(0);
+        return;
+    }
+    evict(maxSize_ - size);
+    size_ += size;
+    table_.push_front(std::move(header));
+}
+
+void HpackDecoder::evict(size_t maxSize) {
+    while (size_ > maxSize) {
+        size_ -= entrySize(table_.back());
+        table_.pop_back();
+    }
+}
+
+namespace hpack {
+
+void encode(const std::string &name, const std::string &value, std::string &block) {
+    std::string lower(name);
+    for (char &c : lower) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    size_t nameIndex = 0;
+    for (size_t i = 0; i < staticTableSize; ++i) {
+        if (lower == staticTable[i][0]) {
+            if (value == staticTable[i][1]) {
+                encodeInteger(i + 1, 7, 0x80, block);
+                return;
+            }
+            if (nameIndex == 0) {
+                nameIndex = i + 1;
+            }
+        }
+    }
+    encodeInteger(nameIndex, 4, 0x00, block);
+    if (nameIndex == 0) {
+        encodeString(lower, block);
+    }
+    encodeString(value, block);
+}
+
+void encodeStatus(unsigned status, std::string &block) {
+    encode(":status", std::to_string(status), block);
+}
+
+bool huffmanDecode(const uint8_t *data, size_t size, std::string &out) {
+    const HuffmanTable &table = huffmanTable();
+    out.clear();
+    uint32_t code = 0;
+    unsigned length = 0;
+    for (size_t i = 0; i < size; ++i) {
+        for (int bit = 7; bit >= 0; --bit) {
+            code = (code << 1) | ((data[i] >> bit) & 1);
+            if (++length > HuffmanTable::maxLength) {
+                return false;
+            }
+            uint32_t offset = code - table.firstCode_[length];
+            if (code >= table.firstCode_[length] && offset < table.count_[length]) {
+                uint16_t symbol = table.symbols_[table.firstIndex_[length] + offset];
+                if (symbol == 256) {
+                    // EOS must not be encoded
+                    return false;
+                }
+                out.push_back(static_cast<char>(symbol));
+                code = 0;
+                length = 0;
+            }
+        }
+    }
+    // padding is a prefix of EOS, i.e. at most 7 one bits
+    return length <= 7 && code == (1u << length) - 1;
+}
+
+void huffmanEncode(const char *data, size_t size, std::string &out) {
+    const HuffmanTable &table = huffmanTable();
+    uint64_t bits = 0;
+    unsigned count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        uint8_t symbol = static_cast<uint8_t>(data[i]);
+        bits = (bits << huffmanLengths[symbol]) | table.codes_[symbol];
+        count += huffmanLengths[symbol];
+        while (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<char>(bits >> count));
+        }
+        bits &= (uint64_t(1) << count) - 1;
+    }
+    if (count > 0) {
+        // pad with the most significant bits of EOS
+        out.push_back(static_cast<char>((bits << (8 - count)) | (0xff >> count)));
+    }
+}
+
+size_t huffmanEncodedSize(const char *data, size_t size) {
+    size_t bits = 0;
+    for (size_t i = 0; i < size; ++i) {
+        bits += huffmanLengths[static_cast<uint8_t>(data[i])];
+    }
+    return (bits + 7) / 8;
+}
+
+}  // namespace hpack
+
+}  // namespace beauty
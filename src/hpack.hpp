@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "header.hpp"
+
+namespace beauty {
+
+// Decoder of HTTP/2 header blocks (RFC 7541). The dynamic table is bounded
+// by the size announced with SETTINGS_HEADER_TABLE_SIZE, the decoded fields
+// of a block by the one announced with SETTINGS_MAX_HEADER_LIST_SIZE.
+class HpackDecoder {
+   public:
+    explicit HpackDecoder(size_t maxTableSize = 4096, size_t maxHeaderListSize = 16384);
+
+    // Decode a complete header block, appending its fields to headers.
+    // Returns false on a compression error, or when the fields exceed the
+    // header list size, after which the decoder state is undefined and the
+    // connection must be closed.
+    bool decode(const uint8_t *data, size_t size, std::vector<Header> &headers);
+
+    // Change the bound of the dynamic table, e.g. once the peer acknowledged
+    // a new SETTINGS_HEADER_TABLE_SIZE.
+    void setMaxTableSize(size_t maxTableSize);
+
+    // Size of the dynamic table as defined by RFC 7541, i.e. name, value and
+    // 32 bytes per entry.
+    size_t tableSize() const {
+        return size_;
+    }
+
+   private:
+    // Look up index in the static and dynamic table.
+    const Header *lookup(size_t index) const;
+    void insert(Header header);
+    void evict(size_t maxSize);
+
+    // Newest entry first.
+    std::deque<Header> table_;
+    size_t size_ = 0;
+
+    // Current size set by the encoder and its upper bound.
+    size_t maxSize_;
+    size_t limit_;
+
+    // Bound of the decoded fields of a block, counted as table entries are,
+    // so that a small block of references cannot expand without limit.
+    size_t maxHeaderListSize_;
+};
+
+namespace hpack {
+
+// Append a header field to a header block. Names are lower cased, and
+// values are Huffman coded when that is shorter. The dynamic table is never
+// used, so a block can be rendered once and sent on any connection.
+void encode(const std::string &name, const std::string &value, std::string &block);
+
+// Append the :status pseudo-header.
+void encodeStatus(unsigned status, std::string &block);
+
+// Huffman coding of string literals.
+bool huffmanDecode(const uint8_t *data, size_t size, std::string &out);
+void huffmanEncode(const char *data, size_t size, std::string &out);
+size_t huffmanEncodedSize(const char *data, size_t size);
+
+}  // namespace hpack
+
+}  // namespace beauty
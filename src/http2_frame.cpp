@@ -0,0 +1,96 @@
+#include "http2_frame.hpp"
+
+#include <algorithm>
+
+namespace beauty {
+
+namespace {
+
+size_t frameLength(const char *header) {
+    return (size_t(static_cast<uint8_t>(header[0])) << 16) |
+           (size_t(static_cast<uint8_t>(header[1])) << 8) | static_cast<uint8_t>(header[2]);
+}
+
+void fill(const char *data, Http2FrameParser::Frame &frame) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    frame.size_ = frameLength(data);
+    frame.type_ = p[3];
+    frame.flags_ = p[4];
+    // the reserved bit is ignored
+    frame.streamId_ = ((uint32_t(p[5]) & 0x7f) << 24) | (uint32_t(p[6]) << 16) |
+                      (uint32_t(p[7]) << 8) | p[8];
+    frame.payload_ = p + Http2FrameParser::headerSize;
+}
+
+}  // namespace
+
+Http2FrameParser::Http2FrameParser(size_t maxFrameSize) : maxFrameSize_(maxFrameSize) {}
+
+Http2FrameParser::result_type Http2FrameParser::parse(const char *&begin,
+                                                      const char *end,
+                                                      Frame &frame) {
+    if (complete_) {
+        partial_.clear();
+        complete_ = false;
+    }
+
+    if (partial_.empty()) {
+        size_t available = static_cast<size_t>(end - begin);
+        if (available >= headerSize) {
+            size_t length = frameLength(begin);
+            if (length > maxFrameSize_) {
+                return bad;
+            }
+            if (available >= headerSize + length) {
+                fill(begin, frame);
+                begin += headerSize + length;
+                return result_type::frame;
+            }
+        }
+        if (available == 0) {
+            return indeterminate;
+        }
+    }
+
+    // complete the header first, as it holds the length
+    if (partial_.size() < headerSize) {
+        size_t n = std::min(headerSize - partial_.size(), static_cast<size_t>(end - begin));
+        partial_.append(begin, n);
+        begin += n;
+        if (partial_.size() < headerSize) {
+            return indeterminate;
+        }
+        if (frameLength(partial_.data()) > maxFrameSize_) {
+            return bad;
+        }
+    }
+    size_t total = headerSize + frameLength(partial_.data());
+    size_t n = std::min(total - partial_.size(), static_cast<size_t>(end - begin));
+    partial_.append(begin, n);
+    begin += n;
+    if (partial_.size() < total) {
+        return indeterminate;
+    }
+    fill(partial_.data(), frame);
+    complete_ = true;
+    return result_type::frame;
+}
+
+void Http2FrameParser::writeHeader(std::string &out,
+                                   size_t size,
+                                   uint8_t type,
+                                   uint8_t flags,
+                                   uint32_t streamId) {
+    char header[headerSize] = {static_cast<char>(size >> 16),
+                               static_cast<char>(size >> 8),
+                               static_cast<char>(size),
+                               static_cast<char>(type),
+                               static_cast<char>(flags),
+                               static_cast<char>((streamId >> 24) & 0x7f),
+                               static_cast<char>(streamId >> 16),
+                               static_cast<char>(streamId >> 8),
+                               static_cast<char>(streamId)};
+    out.append(header, headerSize);
+}
+
+}  // namespace beauty
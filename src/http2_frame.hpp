@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace beauty {
+
+// Incremental parser for HTTP/2 frames (RFC 7540 4.1). A frame that is
+// complete in the receive buffer is returned pointing into it, only a frame
+// split over several reads is copied.
+class Http2FrameParser {
+   public:
+    explicit Http2FrameParser(size_t maxFrameSize = 16384);
+
+    enum frame_type {
+        data = 0x0,
+        headers = 0x1,
+        priority = 0x2,
+        rst_stream = 0x3,
+        settings = 0x4,
+        push_promise = 0x5,
+        ping = 0x6,
+        goaway = 0x7,
+        window_update = 0x8,
+        continuation = 0x9
+    };
+
+    enum flag_type {
+        end_stream = 0x1,
+        ack = 0x1,
+        end_headers = 0x4,
+        padded = 0x8,
+        priority_flag = 0x20
+    };
+
+    // Result of parse.
+    enum result_type { frame, bad, indeterminate };
+
+    struct Frame {
+        uint8_t type_;
+        uint8_t flags_;
+        uint32_t streamId_;
+        const uint8_t *payload_;
+        size_t size_;
+    };
+
+    static const size_t headerSize = 9;
+
+    // Parse the next frame from [begin, end). Returns frame with begin
+    // advanced past it, bad if the frame is larger than maxFrameSize, or
+    // indeterminate when begin reached end before the frame is complete. The
+    // payload is valid until the next call.
+    result_type parse(const char *&begin, const char *end, Frame &frame);
+
+    // Append a frame header to out.
+    static void writeHeader(std::string &out,
+                            size_t size,
+                            uint8_t type,
+                            uint8_t flags,
+                            uint32_t streamId);
+
+   private:
+    size_t maxFrameSize_;
+
+    // A frame received over several reads, header included.
+    std::string partial_;
+    bool complete_ = false;
+};
+
+}  // namespace beauty
@@ -0,0 +1,984 @@
+#include "http2_session.hpp"
+#include "buffer_size.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace beauty {
+
+const char Http2Session::preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const size_t Http2Session::prefaceSize;
+
+namespace {
+
+enum settings_type {
+    header_table_size = 0x1,
+    enable_push = 0x2,
+    max_concurrent_streams = 0x3,
+    initial_window_size = 0x4,
+    max_frame_size = 0x5,
+    max_header_list_size = 0x6
+};
+
+const int64_t maxWindow = 0x7fffffff;
+
+// Frames gathered into one write, bounded to keep the buffer sequence small.
+const size_t maxOutputs = 64;
+
+uint32_t readUint32(const uint8_t *p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+void appendUint32(std::string &out, uint32_t value) {
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+void appendSetting(std::string &out, uint16_t id, size_t value) {
+    out.push_back(static_cast<char>(id >> 8));
+    out.push_back(static_cast<char>(id));
+    appendUint32(out, static_cast<uint32_t>(std::min<size_t>(value, maxWindow)));
+}
+
+bool iequals(const std::string &a, const char *b) {
+    size_t size = strlen(b);
+    if (a.size() != size) {
+        return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Headers of an HTTP/1.1 connection, which HTTP/2 does not allow.
+bool isConnectionHeader(const std::string &name) {
+    return iequals(name, "connection") || iequals(name, "keep-alive") ||
+           iequals(name, "proxy-connection") || iequals(name, "transfer-encoding") ||
+           iequals(name, "upgrade");
+}
+
+// Strip the padding of a DATA or HEADERS frame. Returns false if the padding
+// is longer than the payload.
+bool unpad(const Http2FrameParser::Frame &frame, const uint8_t *&data, size_t &size) {
+    data = frame.payload_;
+    size = frame.size_;
+    if ((frame.flags_ & Http2FrameParser::padded) == 0) {
+        return true;
+    }
+    if (size == 0 || data[0] >= size) {
+        return false;
+    }
+    size -= 1 + data[0];
+    data += 1;
+    return true;
+}
+
+bool parseContentLength(const std::string &value, size_t &length) {
+    if (value.empty() || value.size() > 15) {
+        return false;
+    }
+    length = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        length = length * 10 + (c - '0');
+    }
+    return true;
+}
+
+// The HTTP2-Settings header is base64url without padding.
+bool decodeBase64Url(const std::string &in, std::string &out) {
+    uint32_t bits = 0;
+    unsigned count = 0;
+    for (char c : in) {
+        uint32_t value;
+        if (c >= 'A' && c <= 'Z') {
+            value = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            value = c - 'a' + 26;
+        } else if (c >= '0' && c <= '9') {
+            value = c - '0' + 52;
+        } else if (c == '-' || c == '+') {
+            value = 62;
+        } else if (c == '_' || c == '/') {
+            value = 63;
+        } else if (c == '=') {
+            break;
+        } else {
+            return false;
+        }
+        bits = (bits << 6) | value;
+        count += 6;
+        if (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<char>(bits >> count));
+            bits &= (1u << count) - 1;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+Http2Session::Http2Session(RequestHandler &handler,
+                           BufferPool &bufferPool,
+                           unsigned connectionId,
+                           size_t maxContentSize,
+                           const Http2Options &options,
+                           Logger &logger)
+    : requestHandler_(handler),
+      bufferPool_(bufferPool),
+      connectionId_(connectionId),
+      maxContentSize_(maxContentSize),
+      options_(options),
+      logger_(logger),
+      decoder_(4096, maxHeadSize(maxContentSize)) {}
+
+void Http2Session::start() {
+    std::string payload;
+    appendSetting(payload, max_concurrent_streams, options_.maxConcurrentStreams_);
+    // the receive window of a stream bounds the body buffered for it
+    appendSetting(payload, initial_window_size, maxContentSize_);
+    appendSetting(payload, header_table_size, options_.headerTableSize_);
+    appendSetting(payload, max_header_list_size, maxHeadSize(maxContentSize_));
+    queueFrame(Http2FrameParser::settings, 0, 0, payload);
+}
+
+void Http2Session::upgrade(const Request &request) {
+    std::string settings;
+    if (!decodeBase64Url(request.getHeaderValue("HTTP2-Settings"), settings) ||
+        settings.size() % 6 != 0) {
+        fail(protocol_error, "invalid HTTP2-Settings");
+        return;
+    }
+    if (!applySettings(reinterpret_cast<const uint8_t *>(settings.data()), settings.size())) {
+        return;
+    }
+
+    // the request was complete, so stream 1 is half-closed for the client
+    auto stream = std::make_shared<Stream>(1, maxContentSize_, initialWindow_);
+    Request &req = stream->request_;
+    req.method_ = request.method_;
+    req.uri_ = request.uri_;
+    req.httpVersionMajor_ = 2;
+    req.httpVersionMinor_ = 0;
+    for (const Header &h : request.headers_) {
+        if (!isConnectionHeader(h.name_) && !iequals(h.name_, "http2-settings")) {
+            req.headers_.push_back(h);
+        }
+    }
+    stream->remoteClosed_ = true;
+    stream->contentLengthKnown_ = true;
+    lastStreamId_ = 1;
+    streams_[1] = stream;
+    dispatch(stream);
+}
+
+void Http2Session::receive(const char *data, size_t size) {
+    const char *begin = data;
+    const char *end = data + size;
+    if (goawaySent_) {
+        return;
+    }
+    if (prefaceReceived_ < prefaceSize) {
+        size_t n = std::min(prefaceSize - prefaceReceived_, size);
+        if (memcmp(begin, preface + prefaceReceived_, n) != 0) {
+            fail(protocol_error, "invalid connection preface");
+            return;
+        }
+        prefaceReceived_ += n;
+        begin += n;
+    }
+
+    Http2FrameParser::Frame frame;
+    while (!goawaySent_) {
+        Http2FrameParser::result_type result = parser_.parse(begin, end, frame);
+        if (result == Http2FrameParser::indeterminate) {
+            break;
+        }
+        if (result == Http2FrameParser::bad) {
+            fail(frame_size_error, "frame too large");
+            break;
+        }
+        handleFrame(frame);
+    }
+    pump();
+}
+
+std::vector<asio::const_buffer> Http2Session::startWrite() {
+    writing_ = std::min(outputs_.size(), maxOutputs);
+    std::vector<asio::const_buffer> buffers;
+    buffers.reserve(2 * writing_);
+    for (size_t i = 0; i < writing_; ++i) {
+        const Output &output = outputs_[i];
+        if (output.skip_) {
+            continue;
+        }
+        buffers.push_back(asio::buffer(output.frame_));
+        if (output.size_ > 0) {
+            buffers.push_back(asio::buffer(output.data_, output.size_));
+        }
+    }
+    return buffers;
+}
+
+void Http2Session::written() {
+    for (size_t i = 0; i < writing_; ++i) {
+        Output &output = outputs_.front();
+        if (output.stream_) {
+            output.stream_->inFlight_--;
+        }
+        backlog_ -= output.frame_.size();
+        outputs_.pop_front();
+    }
+    writing_ = 0;
+    pump();
+}
+
+bool Http2Session::isClosing() const {
+    return goawaySent_ || (goawayReceived_ && streams_.empty());
+}
+
+void Http2Session::close() {
+    for (auto &entry : streams_) {
+        abortStream(*entry.second);
+    }
+    streams_.clear();
+    pending_.clear();
+}
+
+void Http2Session::handleFrame(const Http2FrameParser::Frame &frame) {
+    if (expectContinuation_ && (frame.type_ != Http2FrameParser::continuation ||
+                                frame.streamId_ != headerStreamId_)) {
+        fail(protocol_error, "expected CONTINUATION");
+        return;
+    }
+    if (!settingsReceived_ && frame.type_ != Http2FrameParser::settings) {
+        fail(protocol_error, "expected SETTINGS");
+        return;
+    }
+
+    switch (frame.type_) {
+        case Http2FrameParser::data:
+            handleData(frame);
+            break;
+        case Http2FrameParser::headers:
+            handleHeaders(frame);
+            break;
+        case Http2FrameParser::priority:
+            // priorities are not used, streams are served round-robin
+            if (frame.streamId_ == 0) {
+                fail(protocol_error, "PRIORITY on stream 0");
+            } else if (frame.size_ != 5) {
+                resetStream(frame.streamId_, frame_size_error, true);
+            }
+            break;
+        case Http2FrameParser::rst_stream:
+            handleRstStream(frame);
+            break;
+        case Http2FrameParser::settings:
+            handleSettings(frame);
+            break;
+        case Http2FrameParser::push_promise:
+            fail(protocol_error, "PUSH_PROMISE from client");
+            break;
+        case Http2FrameParser::ping:
+            if (frame.streamId_ != 0) {
+                fail(protocol_error, "PING on a stream");
+            } else if (frame.size_ != 8) {
+                fail(frame_size_error, "invalid PING");
+            } else if ((frame.flags_ & Http2FrameParser::ack) == 0) {
+                queueFrame(Http2FrameParser::ping,
+                           Http2FrameParser::ack,
+                           0,
+                           std::string(reinterpret_cast<const char *>(frame.payload_), 8));
+            }
+            break;
+        case Http2FrameParser::goaway:
+            if (frame.streamId_ != 0) {
+                fail(protocol_error, "GOAWAY on a stream");
+            } else {
+                goawayReceived_ = true;
+            }
+            break;
+        case Http2FrameParser::window_update:
+            handleWindowUpdate(frame);
+            break;
+        case Http2FrameParser::continuation:
+            if (!expectContinuation_) {
+                fail(protocol_error, "unexpected CONTINUATION");
+            } else {
+                handleContinuation(frame);
+            }
+            break;
+        default:
+            // unknown frame types are ignored
+            break;
+    }
+}
+
+void Http2Session::handleData(const Http2FrameParser::Frame &frame) {
+    if (frame.streamId_ == 0) {
+        fail(protocol_error, "DATA on stream 0");
+        return;
+    }
+    const uint8_t *data;
+    size_t size;
+    if (!unpad(frame, data, size)) {
+        fail(protocol_error, "invalid padding");
+        return;
+    }
+    // the connection window is given back right away, the stream windows
+    // bound what is buffered
+    queueWindowUpdate(0, frame.size_);
+
+    auto it = streams_.find(frame.streamId_);
+    if (it == streams_.end()) {
+        if (frame.streamId_ > lastStreamId_) {
+            fail(protocol_error, "DATA on idle stream");
+        }
+        // otherwise the stream was reset and its data is dropped
+        return;
+    }
+    std::shared_ptr<Stream> stream = it->second;
+    if (stream->remoteClosed_) {
+        resetStream(frame.streamId_, stream_closed, true);
+        return;
+    }
+    if (static_cast<int64_t>(frame.size_) > stream->recvWindow_) {
+        resetStream(frame.streamId_, flow_control_error, true);
+        return;
+    }
+    stream->recvWindow_ -= frame.size_;
+    stream->received_ += size;
+    if (stream->contentLengthKnown_ && stream->received_ > stream->request_.contentLength_) {
+        resetStream(frame.streamId_, protocol_error, true);
+        return;
+    }
+
+    if (size > 0) {
+        std::vector<char> &body = stream->body_;
+        if (!stream->hasBody_) {
+            stream->hasBody_ = true;
+            bufferPool_.acquire(body, size);
+        } else if (body.size() + size > body.capacity()) {
+            bufferPool_.grow(body, body.size() + size);
+        }
+        body.insert(body.end(), data, data + size);
+    }
+    // padding is not buffered
+    consumed(*stream, frame.size_ - size);
+
+    if ((frame.flags_ & Http2FrameParser::end_stream) != 0) {
+        endOfBody(stream);
+    } else {
+        progressBody(stream);
+    }
+}
+
+void Http2Session::handleHeaders(const Http2FrameParser::Frame &frame) {
+    if (frame.streamId_ == 0 || (frame.streamId_ & 1) == 0) {
+        fail(protocol_error, "HEADERS on invalid stream");
+        return;
+    }
+    const uint8_t *data;
+    size_t size;
+    if (!unpad(frame, data, size)) {
+        fail(protocol_error, "invalid padding");
+        return;
+    }
+    if ((frame.flags_ & Http2FrameParser::priority_flag) != 0) {
+        if (size < 5) {
+            fail(frame_size_error, "invalid HEADERS");
+            return;
+        }
+        data += 5;
+        size -= 5;
+    }
+    headerBlock_.assign(reinterpret_cast<const char *>(data), size);
+    headerStreamId_ = frame.streamId_;
+    headerEndStream_ = (frame.flags_ & Http2FrameParser::end_stream) != 0;
+    if ((frame.flags_ & Http2FrameParser::end_headers) != 0) {
+        headersComplete();
+    } else {
+        expectContinuation_ = true;
+    }
+}
+
+void Http2Session::handleContinuation(const Http2FrameParser::Frame &frame) {
+    headerBlock_.append(reinterpret_cast<const char *>(frame.payload_), frame.size_);
+    if (headerBlock_.size() > maxHeadSize(maxContentSize_)) {
+        fail(enhance_your_calm, "header block too large");
+        return;
+    }
+    if ((frame.flags_ & Http2FrameParser::end_headers) != 0) {
+        expectContinuation_ = false;
+        headersComplete();
+    }
+}
+
+void Http2Session::handleSettings(const Http2FrameParser::Frame &frame) {
+    if (frame.streamId_ != 0) {
+        fail(protocol_error, "SETTINGS on a stream");
+        return;
+    }
+    if ((frame.flags_ & Http2FrameParser::ack) != 0) {
+        if (frame.size_ != 0) {
+            fail(frame_size_error, "invalid SETTINGS ACK");
+            return;
+        }
+        if (!settingsAcked_) {
+            // the client now uses the settings of the server
+            settingsAcked_ = true;
+            decoder_.setMaxTableSize(options_.headerTableSize_);
+            int64_t window = std::min<int64_t>(maxContentSize_, maxWindow);
+            for (auto &entry : streams_) {
+                entry.second->recvWindow_ += window - localWindow_;
+            }
+            localWindow_ = window;
+        }
+        return;
+    }
+    if (frame.size_ % 6 != 0) {
+        fail(frame_size_error, "invalid SETTINGS");
+        return;
+    }
+    if (!applySettings(frame.payload_, frame.size_)) {
+        return;
+    }
+    settingsReceived_ = true;
+    queueFrame(Http2FrameParser::settings, Http2FrameParser::ack, 0, std::string());
+}
+
+void Http2Session::handleWindowUpdate(const Http2FrameParser::Frame &frame) {
+    if (frame.size_ != 4) {
+        fail(frame_size_error, "invalid WINDOW_UPDATE");
+        return;
+    }
+    uint32_t increment = readUint32(frame.payload_) & 0x7fffffff;
+    if (frame.streamId_ == 0) {
+        sendWindow_ += increment;
+        if (increment == 0) {
+            fail(protocol_error, "empty WINDOW_UPDATE");
+        } else if (sendWindow_ > maxWindow) {
+            fail(flow_control_error, "connection window overflow");
+        }
+        return;
+    }
+    auto it = streams_.find(frame.streamId_);
+    if (it == streams_.end()) {
+        if (frame.streamId_ > lastStreamId_) {
+            fail(protocol_error, "WINDOW_UPDATE on idle stream");
+        }
+        return;
+    }
+    Stream &stream = *it->second;
+    stream.sendWindow_ += increment;
+    if (increment == 0) {
+        resetStream(frame.streamId_, protocol_error, true);
+    } else if (stream.sendWindow_ > maxWindow) {
+        resetStream(frame.streamId_, flow_control_error, true);
+    }
+}
+
+void Http2Session::handleRstStream(const Http2FrameParser::Frame &frame) {
+    if (frame.streamId_ == 0 || frame.streamId_ > lastStreamId_) {
+        fail(protocol_error, "RST_STREAM on idle stream");
+    } else if (frame.size_ != 4) {
+        fail(frame_size_error, "invalid RST_STREAM");
+    } else {
+        resetStream(frame.streamId_, no_error, false);
+    }
+}
+
+void Http2Session::headersComplete() {
+    // the block is decoded even for a refused stream, to keep the dynamic
+    // table in sync with the client
+    std::vector<Header> fields;
+    if (!decoder_.decode(reinterpret_cast<const uint8_t *>(headerBlock_.data()),
+                         headerBlock_.size(),
+                         fields)) {
+        fail(compression_error, "invalid header block");
+        return;
+    }
+    headerBlock_.clear();
+    uint32_t id = headerStreamId_;
+
+    auto it = streams_.find(id);
+    if (it != streams_.end()) {
+        // trailers, which end the body and are not passed on
+        std::shared_ptr<Stream> stream = it->second;
+        if (stream->remoteClosed_) {
+            resetStream(id, stream_closed, true);
+        } else if (!headerEndStream_) {
+            resetStream(id, protocol_error, true);
+        } else {
+            endOfBody(stream);
+        }
+        return;
+    }
+    if (id <= lastStreamId_) {
+        // a stream that is already reset or finished
+        return;
+    }
+    lastStreamId_ = id;
+    if (streams_.size() >= options_.maxConcurrentStreams_ || (admit_ && !admit_())) {
+        queueRstStream(id, refused_stream);
+        return;
+    }
+
+    auto stream = std::make_shared<Stream>(id, maxContentSize_, initialWindow_);
+    stream->recvWindow_ = localWindow_;
+    if (!toRequest(fields, *stream)) {
+        queueRstStream(id, protocol_error);
+        return;
+    }
+    streams_[id] = stream;
+    if (headerEndStream_) {
+        endOfBody(stream);
+    } else {
+        progressBody(stream);
+    }
+}
+
+bool Http2Session::toRequest(std::vector<Header> &fields, Stream &stream) {
+    Request &req = stream.request_;
+    std::string scheme;
+    std::string authority;
+    std::string cookie;
+    bool regular = false;
+    bool hasHost = false;
+    for (Header &field : fields) {
+        const std::string &name = field.name_;
+        if (name.empty()) {
+            return false;
+        }
+        if (name[0] == ':') {
+            // pseudo-headers come first and only once
+            std::string *value = name == ":method"      ? &req.method_
+                                 : name == ":path"      ? &req.uri_
+                                 : name == ":scheme"    ? &scheme
+                                 : name == ":authority" ? &authority
+                                                        : nullptr;
+            if (regular || value == nullptr || !value->empty() || field.value_.empty()) {
+                return false;
+            }
+            value->swap(field.value_);
+            continue;
+        }
+        regular = true;
+        if (std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; }) ||
+            isConnectionHeader(name) || (name == "te" && field.value_ != "trailers")) {
+            return false;
+        }
+        if (name == "cookie") {
+            // a cookie may be split into several fields for compression
+            if (!cookie.empty()) {
+                cookie += "; ";
+            }
+            cookie += field.value_;
+            continue;
+        }
+        if (name == "content-length") {
+            if (!parseContentLength(field.value_, req.contentLength_)) {
+                return false;
+            }
+            stream.contentLengthKnown_ = true;
+        }
+        hasHost = hasHost || name == "host";
+        req.headers_.push_back(std::move(field));
+    }
+    if (req.method_.empty() || req.uri_.empty() || scheme.empty()) {
+        return false;
+    }
+    if (!cookie.empty()) {
+        req.headers_.push_back({"cookie", cookie});
+    }
+    if (!authority.empty() && !hasHost) {
+        req.headers_.push_back({"host", authority});
+    }
+    req.httpVersionMajor_ = 2;
+    req.httpVersionMinor_ = 0;
+    if (!stream.contentLengthKnown_) {
+        // unknown until END_STREAM
+        req.contentLength_ = std::numeric_limits<size_t>::max();
+    }
+    return true;
+}
+
+bool Http2Session::applySettings(const uint8_t *data, size_t size) {
+    for (size_t i = 0; i + 6 <= size; i += 6) {
+        uint16_t id = static_cast<uint16_t>((data[i] << 8) | data[i + 1]);
+        uint32_t value = readUint32(data + i + 2);
+        switch (id) {
+            case enable_push:
+                if (value > 1) {
+                    fail(protocol_error, "invalid SETTINGS_ENABLE_PUSH");
+                    return false;
+                }
+                break;
+            case initial_window_size:
+                if (value > maxWindow) {
+                    fail(flow_control_error, "invalid SETTINGS_INITIAL_WINDOW_SIZE");
+                    return false;
+                }
+                for (auto &entry : streams_) {
+                    entry.second->sendWindow_ += static_cast<int64_t>(value) - initialWindow_;
+                }
+                initialWindow_ = value;
+                break;
+            case max_frame_size:
+                if (value < 16384 || value > 16777215) {
+                    fail(protocol_error, "invalid SETTINGS_MAX_FRAME_SIZE");
+                    return false;
+                }
+                maxFrameSize_ = value;
+                break;
+            default:
+                // the encoder does not use the dynamic table, and nothing is
+                // pushed
+                break;
+        }
+    }
+    return true;
+}
+
+void Http2Session::endOfBody(const std::shared_ptr<Stream> &stream) {
+    stream->remoteClosed_ = true;
+    if (stream->contentLengthKnown_ && stream->received_ != stream->request_.contentLength_) {
+        resetStream(stream->id_, protocol_error, true);
+        return;
+    }
+    stream->request_.contentLength_ = stream->received_;
+    stream->contentLengthKnown_ = true;
+    progressBody(stream);
+}
+
+void Http2Session::progressBody(const std::shared_ptr<Stream> &stream) {
+    Stream &s = *stream;
+    bool ready = s.remoteClosed_ || s.body_.size() >= maxContentSize_;
+    if (!s.handled_) {
+        if (ready && !s.pending_) {
+            dispatch(stream);
+        }
+        return;
+    }
+
+    Reply &rep = s.reply_;
+    size_t size = s.body_.size();
+    if ((rep.isMultiPart_ || rep.isRawUpload_) && !s.responding_) {
+        // an upload is written in parts of up to maxContentSize, as over
+        // HTTP/1.1
+        if (!ready) {
+            return;
+        }
+        rep.noBodyBytesReceived_ += size;
+        requestHandler_.handlePartialWrite(connectionId_, s.request_, s.body_, rep);
+        s.body_.clear();
+        consumed(s, size);
+        if (rep.noBodyBytesReceived_ >= s.request_.contentLength_ ||
+            rep.precomputed_ != nullptr) {
+            respond(stream);
+        }
+        return;
+    }
+    // the reply does not need the rest of the body
+    s.body_.clear();
+    consumed(s, size);
+}
+
+void Http2Session::dispatch(const std::shared_ptr<Stream> &stream) {
+    if (partialReader_ || !pending_.empty()) {
+        stream->pending_ = true;
+        pending_.push_back(stream);
+        return;
+    }
+    handle(stream);
+}
+
+void Http2Session::dispatchPending() {
+    while (!partialReader_ && !pending_.empty()) {
+        std::shared_ptr<Stream> stream = pending_.front();
+        pending_.pop_front();
+        handle(stream);
+    }
+}
+
+void Http2Session::handle(const std::shared_ptr<Stream> &stream) {
+    Stream &s = *stream;
+    Reply &rep = s.reply_;
+    s.pending_ = false;
+    s.handled_ = true;
+    size_t size = s.body_.size();
+    if (!requestDecoder_.decodeRequest(s.request_, s.body_)) {
+        rep.stockReply(Reply::bad_request);
+    } else {
+        rep.noBodyBytesReceived_ = size;
+        requestHandler_.handleRequest(connectionId_, s.request_, s.body_, rep);
+    }
+    s.body_.clear();
+    consumed(s, size);
+    if ((rep.isMultiPart_ || rep.isRawUpload_) && rep.precomputed_ == nullptr &&
+        rep.noBodyBytesReceived_ < s.request_.contentLength_) {
+        // wait for the rest of the upload
+        return;
+    }
+    respond(stream);
+}
+
+void Http2Session::respond(const std::shared_ptr<Stream> &stream) {
+    Stream &s = *stream;
+    Reply &rep = s.reply_;
+    if (rep.bodyConsumer_ || rep.webSocketHandler_ || rep.eventBroadcaster_) {
+        // these take over an HTTP/1.1 connection, which a stream cannot
+        rep.bodyConsumer_.reset();
+        rep.webSocketHandler_.reset();
+        rep.eventBroadcaster_.reset();
+        rep.stockReply(Reply::not_implemented);
+    }
+    s.responding_ = true;
+
+    const char *block;
+    size_t blockSize;
+    if (rep.precomputed_ != nullptr) {
+        const std::string &http2Block = rep.precomputed_->http2Block();
+        block = http2Block.data();
+        blockSize = http2Block.size();
+        asio::const_buffer content = rep.precomputed_->content();
+        s.data_ = static_cast<const char *>(content.data());
+        s.remaining_ = content.size();
+    } else {
+        hpack::encodeStatus(rep.status_, s.headerBlock_);
+        for (const Header &h : rep.headers_) {
+            if (!isConnectionHeader(h.name_)) {
+                hpack::encode(h.name_, h.value_, s.headerBlock_);
+            }
+        }
+        block = s.headerBlock_.data();
+        blockSize = s.headerBlock_.size();
+        if (rep.contentPtr_ != nullptr) {
+            s.data_ = rep.contentPtr_;
+            s.remaining_ = rep.contentSize_;
+        } else {
+            s.data_ = rep.content_.data();
+            s.remaining_ = rep.content_.size();
+        }
+    }
+
+    bool partial = rep.replyPartial_ && !rep.finalPart_;
+    if (partial) {
+        partialReader_ = stream;
+    }
+    queueHeaders(stream, block, blockSize, s.remaining_ == 0 && !partial);
+}
+
+void Http2Session::pump() {
+    for (auto it = streams_.begin(); it != streams_.end();) {
+        std::shared_ptr<Stream> stream = it->second;
+        Reply &rep = stream->reply_;
+        if (stream->responding_ && !stream->endSent_ && stream->remaining_ == 0 &&
+            stream->inFlight_ == 0) {
+            // the last part of a file read in parts is written, read the next
+            requestHandler_.handlePartialRead(connectionId_, stream->request_, rep);
+            stream->data_ = rep.content_.data();
+            stream->remaining_ = rep.content_.size();
+            if (rep.finalPart_) {
+                partialReader_.reset();
+                if (stream->remaining_ == 0) {
+                    queueData(stream, nullptr, 0, true);
+                }
+            }
+        }
+        if (stream->endSent_ && stream->inFlight_ == 0) {
+            if (!stream->remoteClosed_) {
+                // the rest of the request is not needed
+                queueRstStream(stream->id_, no_error);
+            }
+            releaseBody(*stream);
+            it = streams_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    dispatchPending();
+
+    // one frame per stream and round, so that streams share the connection
+    bool progress = true;
+    while (progress && sendWindow_ > 0) {
+        progress = false;
+        for (auto &entry : streams_) {
+            Stream &s = *entry.second;
+            if (s.remaining_ == 0 || s.sendWindow_ <= 0) {
+                continue;
+            }
+            size_t size = static_cast<size_t>(
+                std::min<int64_t>(std::min<int64_t>(s.remaining_, maxFrameSize_),
+                                  std::min(s.sendWindow_, sendWindow_)));
+            s.remaining_ -= size;
+            bool partial = s.reply_.replyPartial_ && !s.reply_.finalPart_;
+            queueData(entry.second, s.data_, size, s.remaining_ == 0 && !partial);
+            s.data_ += size;
+            s.sendWindow_ -= size;
+            sendWindow_ -= size;
+            progress = true;
+            if (sendWindow_ <= 0) {
+                break;
+            }
+        }
+    }
+}
+
+void Http2Session::consumed(Stream &stream, size_t size) {
+    if (size == 0 || stream.remoteClosed_) {
+        return;
+    }
+    stream.recvWindow_ += size;
+    queueWindowUpdate(stream.id_, size);
+}
+
+void Http2Session::queue(Output output) {
+    if (output.stream_) {
+        output.stream_->inFlight_++;
+    }
+    backlog_ += output.frame_.size();
+    outputs_.push_back(std::move(output));
+}
+
+void Http2Session::queueFrame(uint8_t type,
+                              uint8_t flags,
+                              uint32_t streamId,
+                              const std::string &payload) {
+    Output output;
+    output.frame_.reserve(Http2FrameParser::headerSize + payload.size());
+    Http2FrameParser::writeHeader(output.frame_, payload.size(), type, flags, streamId);
+    output.frame_ += payload;
+    queue(std::move(output));
+}
+
+void Http2Session::queueHeaders(const std::shared_ptr<Stream> &stream,
+                                const char *block,
+                                size_t size,
+                                bool endStream) {
+    // a block larger than a frame continues in CONTINUATION frames, which
+    // must follow without other frames in between
+    size_t offset = 0;
+    uint8_t type = Http2FrameParser::headers;
+    do {
+        size_t n = std::min(size - offset, maxFrameSize_);
+        uint8_t flags = 0;
+        if (type == Http2FrameParser::headers && endStream) {
+            flags |= Http2FrameParser::end_stream;
+        }
+        if (offset + n == size) {
+            flags |= Http2FrameParser::end_headers;
+        }
+        Output output;
+        Http2FrameParser::writeHeader(output.frame_, n, type, flags, stream->id_);
+        output.data_ = block + offset;
+        output.size_ = n;
+        output.stream_ = stream;
+        queue(std::move(output));
+        offset += n;
+        type = Http2FrameParser::continuation;
+    } while (offset < size);
+    stream->endSent_ = endStream;
+}
+
+void Http2Session::queueData(const std::shared_ptr<Stream> &stream,
+                             const char *data,
+                             size_t size,
+                             bool endStream) {
+    Output output;
+    Http2FrameParser::writeHeader(output.frame_,
+                                  size,
+                                  Http2FrameParser::data,
+                                  endStream ? Http2FrameParser::end_stream : 0,
+                                  stream->id_);
+    output.data_ = data;
+    output.size_ = size;
+    output.stream_ = stream;
+    output.isData_ = true;
+    queue(std::move(output));
+    stream->endSent_ = endStream;
+}
+
+void Http2Session::queueWindowUpdate(uint32_t streamId, size_t increment) {
+    if (increment == 0) {
+        return;
+    }
+    std::string payload;
+    appendUint32(payload, static_cast<uint32_t>(increment));
+    queueFrame(Http2FrameParser::window_update, 0, streamId, payload);
+}
+
+void Http2Session::queueRstStream(uint32_t streamId, error_type error) {
+    std::string payload;
+    appendUint32(payload, error);
+    queueFrame(Http2FrameParser::rst_stream, 0, streamId, payload);
+}
+
+void Http2Session::resetStream(uint32_t streamId, error_type error, bool send) {
+    if (send) {
+        queueRstStream(streamId, error);
+    }
+    auto it = streams_.find(streamId);
+    if (it == streams_.end()) {
+        return;
+    }
+    std::shared_ptr<Stream> stream = it->second;
+    streams_.erase(it);
+    abortStream(*stream);
+}
+
+void Http2Session::abortStream(Stream &stream) {
+    // frames being written are sent, header blocks must stay complete
+    for (size_t i = writing_; i < outputs_.size(); ++i) {
+        Output &output = outputs_[i];
+        if (output.isData_ && !output.skip_ && output.stream_.get() == &stream) {
+            output.skip_ = true;
+            // never sent, so the peer never counts it against the window
+            sendWindow_ += output.size_;
+        }
+    }
+    stream.remaining_ = 0;
+    if (partialReader_.get() == &stream) {
+        requestHandler_.closeFile(stream.reply_, connectionId_);
+        partialReader_.reset();
+    }
+    pending_.erase(std::remove_if(pending_.begin(),
+                                  pending_.end(),
+                                  [&stream](const std::shared_ptr<Stream> &s) {
+                                      return s.get() == &stream;
+                                  }),
+                   pending_.end());
+    releaseBody(stream);
+}
+
+void Http2Session::releaseBody(Stream &stream) {
+    if (stream.hasBody_) {
+        stream.hasBody_ = false;
+        bufferPool_.release(stream.body_);
+    }
+}
+
+void Http2Session::fail(error_type error, const std::string &reason) {
+    if (goawaySent_) {
+        return;
+    }
+    BEAUTY_LOG(logger_, LogLevel::info, "HTTP/2 connection error: " + reason);
+    close();
+    std::string payload;
+    appendUint32(payload, lastStreamId_);
+    appendUint32(payload, error);
+    queueFrame(Http2FrameParser::goaway, 0, 0, payload);
+    goawaySent_ = true;
+}
+
+}  // namespace beauty
@@ -0,0 +1,262 @@
+#pragma once
+#include "environment.hpp"
+
+#include <asio.hpp>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "beauty_common.hpp"
+#include "buffer_pool.hpp"
+#include "hpack.hpp"
+#include "http2_frame.hpp"
+#include "logger.hpp"
+#include "reply.hpp"
+#include "request.hpp"
+#include "request_decoder.hpp"
+#include "request_handler.hpp"
+
+namespace beauty {
+
+// The HTTP/2 protocol of one connection (RFC 7540), without any I/O. The
+// connection feeds received data to receive() and writes the frames queued
+// in response. Each stream is served by a Request and Reply of its own and
+// the RequestHandler, as an HTTP/1.1 request is.
+class Http2Session {
+   public:
+    Http2Session(const Http2Session &) = delete;
+    Http2Session &operator=(const Http2Session &) = delete;
+
+    Http2Session(RequestHandler &handler,
+                 BufferPool &bufferPool,
+                 unsigned connectionId,
+                 size_t maxContentSize,
+                 const Http2Options &options,
+                 Logger &logger);
+
+    enum error_type {
+        no_error = 0x0,
+        protocol_error = 0x1,
+        internal_error = 0x2,
+        flow_control_error = 0x3,
+        stream_closed = 0x5,
+        frame_size_error = 0x6,
+        refused_stream = 0x7,
+        cancel = 0x8,
+        compression_error = 0x9,
+        enhance_your_calm = 0xb
+    };
+
+    // The client connection preface.
+    static const char preface[];
+    static const size_t prefaceSize = 24;
+
+    // Queue the server preface, i.e. the SETTINGS of the server.
+    void start();
+
+    // Continue an HTTP/1.1 request that was upgraded to h2c as stream 1.
+    // Call after start() once the 101 Switching Protocols is written.
+    void upgrade(const Request &request);
+
+    // Handle data received from the client, starting with the connection
+    // preface.
+    void receive(const char *data, size_t size);
+
+    // Frames queued for writing.
+    bool hasOutput() const {
+        return !outputs_.empty();
+    }
+
+    // Bytes of frames rendered into the output queue, content of replies is
+    // not copied and not included.
+    size_t backlog() const {
+        return backlog_;
+    }
+
+    // Buffers of the next write and its completion. The buffers stay valid
+    // until written() is called.
+    std::vector<asio::const_buffer> startWrite();
+    void written();
+
+    // True when the connection should be closed once the output is written,
+    // after a connection error or a GOAWAY from the client.
+    bool isClosing() const;
+
+    // True when no stream is open.
+    bool isIdle() const {
+        return streams_.empty();
+    }
+
+    // Abort all streams, giving back their buffers, e.g. when the connection
+    // is stopped.
+    void close();
+
+    // Called for each new stream from the client, which is refused with
+    // REFUSED_STREAM if it returns false, e.g. when the client is over its
+    // rate limit.
+    typedef std::function<bool()> admitCallback;
+    void setStreamAdmission(admitCallback admit) {
+        admit_ = std::move(admit);
+    }
+
+   private:
+    struct Stream {
+        Stream(uint32_t id, size_t maxContentSize, int64_t sendWindow)
+            : id_(id), request_(body_), reply_(maxContentSize), sendWindow_(sendWindow) {}
+
+        uint32_t id_;
+        std::vector<char> body_;
+        Request request_;
+        Reply reply_;
+        bool hasBody_ = false;
+
+        // END_STREAM received and the number of body bytes so far.
+        bool remoteClosed_ = false;
+        size_t received_ = 0;
+        bool contentLengthKnown_ = false;
+
+        bool pending_ = false;
+        bool handled_ = false;
+
+        // The header block of the response, unless precomputed.
+        std::string headerBlock_;
+
+        // Content not yet framed, and the number of queued frames of the
+        // stream, which keep the content in use.
+        bool responding_ = false;
+        const char *data_ = nullptr;
+        size_t remaining_ = 0;
+        size_t inFlight_ = 0;
+        bool endSent_ = false;
+
+        int64_t sendWindow_;
+        int64_t recvWindow_ = 0;
+    };
+
+    // A frame in the output queue. Payloads not in frame_, e.g. reply
+    // content, are kept valid by stream_.
+    struct Output {
+        std::string frame_;
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+        std::shared_ptr<Stream> stream_;
+        bool isData_ = false;
+        bool skip_ = false;
+    };
+
+    void handleFrame(const Http2FrameParser::Frame &frame);
+    void handleData(const Http2FrameParser::Frame &frame);
+    void handleHeaders(const Http2FrameParser::Frame &frame);
+    void handleContinuation(const Http2FrameParser::Frame &frame);
+    void handleSettings(const Http2FrameParser::Frame &frame);
+    void handleWindowUpdate(const Http2FrameParser::Frame &frame);
+    void handleRstStream(const Http2FrameParser::Frame &frame);
+
+    // Decode a complete header block and open its stream, or end the body
+    // of a stream with trailers.
+    void headersComplete();
+
+    // Map the fields of a header block onto request. Returns false if the
+    // request is malformed.
+    bool toRequest(std::vector<Header> &fields, Stream &stream);
+
+    // Apply SETTINGS parameters. Returns false on a connection error.
+    bool applySettings(const uint8_t *data, size_t size);
+
+    // Check the body length once END_STREAM is received.
+    void endOfBody(const std::shared_ptr<Stream> &stream);
+
+    // Move the received body on to the handler, or start handling the
+    // request once its body is complete or fills the receive buffer.
+    void progressBody(const std::shared_ptr<Stream> &stream);
+
+    // Handle the request of a stream, waiting while another stream reads a
+    // file in parts as they share the file id of the connection.
+    void dispatch(const std::shared_ptr<Stream> &stream);
+    void dispatchPending();
+    void handle(const std::shared_ptr<Stream> &stream);
+
+    // Queue the response headers of a stream and start sending its content.
+    void respond(const std::shared_ptr<Stream> &stream);
+
+    // Frame the content of responding streams within the flow control
+    // windows, refill replies read in parts and retire finished streams.
+    void pump();
+
+    // Give back received bytes to the client's send window of the stream.
+    void consumed(Stream &stream, size_t size);
+
+    void queue(Output output);
+    void queueFrame(uint8_t type, uint8_t flags, uint32_t streamId, const std::string &payload);
+    void queueHeaders(const std::shared_ptr<Stream> &stream,
+                      const char *block,
+                      size_t size,
+                      bool endStream);
+    void queueData(const std::shared_ptr<Stream> &stream,
+                   const char *data,
+                   size_t size,
+                   bool endStream);
+    void queueWindowUpdate(uint32_t streamId, size_t increment);
+    void queueRstStream(uint32_t streamId, error_type error);
+
+    // Reset a stream, after a stream error or an RST_STREAM from the client.
+    void resetStream(uint32_t streamId, error_type error, bool send);
+
+    // Stop the stream, dropping its queued content.
+    void abortStream(Stream &stream);
+    void releaseBody(Stream &stream);
+
+    // Queue a GOAWAY and stop processing input.
+    void fail(error_type error, const std::string &reason);
+
+    RequestHandler &requestHandler_;
+    BufferPool &bufferPool_;
+    unsigned connectionId_;
+    size_t maxContentSize_;
+    Http2Options options_;
+    Logger &logger_;
+    admitCallback admit_;
+
+    Http2FrameParser parser_;
+    HpackDecoder decoder_;
+    RequestDecoder requestDecoder_;
+
+    size_t prefaceReceived_ = 0;
+    bool settingsReceived_ = false;
+
+    // A header block spread over HEADERS and CONTINUATION frames.
+    std::string headerBlock_;
+    uint32_t headerStreamId_ = 0;
+    bool headerEndStream_ = false;
+    bool expectContinuation_ = false;
+
+    std::map<uint32_t, std::shared_ptr<Stream>> streams_;
+    uint32_t lastStreamId_ = 0;
+
+    // Streams waiting for the stream reading a file in parts.
+    std::deque<std::shared_ptr<Stream>> pending_;
+    std::shared_ptr<Stream> partialReader_;
+
+    // The receive window of new streams, the window announced by the server
+    // once the client acknowledged it.
+    int64_t localWindow_ = 65535;
+    bool settingsAcked_ = false;
+
+    // Settings of the client.
+    int64_t initialWindow_ = 65535;
+    size_t maxFrameSize_ = 16384;
+
+    int64_t sendWindow_ = 65535;
+
+    std::deque<Output> outputs_;
+    size_t writing_ = 0;
+    size_t backlog_ = 0;
+
+    bool goawaySent_ = false;
+    bool goawayReceived_ = false;
+};
+
+}  // namespace beauty
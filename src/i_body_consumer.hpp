@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include "request.hpp"
+
+namespace beauty {
+
+class Reply;
+
+// Receives the body of a request as it arrives, see Reply::streamBody(). All
+// callbacks are invoked from the io_context thread.
+class IBodyConsumer {
+   public:
+    IBodyConsumer() = default;
+    virtual ~IBodyConsumer() = default;
+
+    // A chunk of body data, starting with the body bytes received with the
+    // request head. Return false to pause reading, the data then stays valid
+    // until resume is called. resume may be called from any thread.
+    virtual bool onData(const Request &request,
+                        const char *data,
+                        size_t size,
+                        const std::function<void()> &resume) = 0;
+
+    // The whole body has been received. Reply with one of the Reply::send
+    // methods, otherwise an empty 200 OK is sent.
+    virtual void onEnd(const Request &request, Reply &reply) = 0;
+
+    // The connection was closed before the whole body was received.
+    virtual void onAbort(const Request &request) {}
+};
+
+}  // namespace beauty
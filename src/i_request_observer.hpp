@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+// Define BEAUTY_NO_REQUEST_OBSERVER to compile out all observer hooks.
+#ifdef BEAUTY_NO_REQUEST_OBSERVER
+#define BEAUTY_OBSERVE(observer, call) \
+    do {                               \
+    } while (0)
+#else
+#define BEAUTY_OBSERVE(observer, call) \
+    do {                               \
+        if (observer != nullptr) {     \
+            observer->call;            \
+        }                              \
+    } while (0)
+#endif
+
+namespace beauty {
+
+// Receives timestamped events during the lifecycle of each request. All
+// callbacks are invoked from the io_context thread and must return quickly.
+// Override only the events of interest.
+class IRequestObserver {
+   public:
+    using clock = std::chrono::steady_clock;
+
+    IRequestObserver() = default;
+    virtual ~IRequestObserver() = default;
+
+    static clock::time_point now() {
+        return clock::now();
+    }
+
+    // A connection was accepted.
+    virtual void onAccept(unsigned connectionId, clock::time_point t) {}
+
+    // The first bytes of a new request were received.
+    virtual void onFirstByte(unsigned connectionId, clock::time_point t) {}
+
+    // The request line and headers were parsed.
+    virtual void onHeadParsed(unsigned connectionId, clock::time_point t) {}
+
+    // The RequestDecoder finished decoding the request.
+    virtual void onDecodeDone(unsigned connectionId, clock::time_point t) {}
+
+    // The middleware at index returned, replied is true if it sent a reply.
+    virtual void onMiddlewareReturned(unsigned connectionId,
+                                      size_t index,
+                                      bool replied,
+                                      clock::time_point t) {}
+
+    // IFileIO opened a file for reading.
+    virtual void onFileOpened(unsigned connectionId, size_t fileSize, clock::time_point t) {}
+
+    // The reply headers were written to the socket.
+    virtual void onHeadersWritten(unsigned connectionId, clock::time_point t) {}
+
+    // A chunk of the reply body was written to the socket.
+    virtual void onBodyChunkWritten(unsigned connectionId, size_t size, clock::time_point t) {}
+
+    // The reply was completely written.
+    virtual void onResponseComplete(unsigned connectionId, clock::time_point t) {}
+
+    // The connection was closed.
+    virtual void onClose(unsigned connectionId, clock::time_point t) {}
+};
+
+}  // namespace beauty
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "request.hpp"
+
+namespace beauty {
+
+class WebSocket;
+
+// Receives the messages of a WebSocket, see Reply::acceptWebSocket(). All
+// callbacks are invoked from the io_context thread.
+class IWebSocketHandler {
+   public:
+    IWebSocketHandler() = default;
+    virtual ~IWebSocketHandler() = default;
+
+    // The handshake has been sent. Keep socket to push messages to the
+    // client, request is the upgrade request.
+    virtual void onOpen(const std::shared_ptr<WebSocket> &socket, const Request &request) {}
+
+    // A complete text or binary message. data is only valid during the call.
+    virtual void onMessage(const std::shared_ptr<WebSocket> &socket,
+                           const char *data,
+                           size_t size,
+                           bool binary) = 0;
+
+    // The socket is closed, code is the close code sent by the client or
+    // 1006 if the connection was lost.
+    virtual void onClose(const std::shared_ptr<WebSocket> &socket, uint16_t code) {}
+
+    // Messages larger than this are refused with close code 1009.
+    virtual size_t maxMessageSize() const {
+        return 64 * 1024;
+    }
+};
+
+}  // namespace beauty
@@ -0,0 +1,179 @@
+#include "listener_handoff.hpp"
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace beauty {
+
+namespace {
+
+// First descriptor passed by systemd, SD_LISTEN_FDS_START.
+const int listenFdsStart = 3;
+
+// Listening sockets passed in one handoff message.
+const size_t maxHandoffListeners = 16;
+
+// A new server closing the control socket early must not raise SIGPIPE.
+#if defined(MSG_NOSIGNAL)
+const int sendFlags = MSG_NOSIGNAL;
+#else
+const int sendFlags = 0;
+#endif
+
+std::string systemError(const std::string &what) {
+    return what + ": " + std::strerror(errno);
+}
+
+// Bound the blocking connect and recvmsg of fd, so that a running server
+// that is hung does not hang the new one too.
+bool setTimeout(int fd, std::chrono::milliseconds timeout) {
+    timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+    return ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == 0 &&
+           ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0;
+}
+
+// Keep descriptors from leaking into processes started by the server.
+void setCloseOnExec(int fd) {
+    int flags = ::fcntl(fd, F_GETFD);
+    if (flags >= 0) {
+        ::fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+    }
+}
+
+}  // namespace
+
+std::vector<Listener> systemdListeners() {
+    std::vector<Listener> listeners;
+    const char *pid = std::getenv("LISTEN_PID");
+    const char *fds = std::getenv("LISTEN_FDS");
+    if (pid == nullptr || fds == nullptr ||
+        std::strtol(pid, nullptr, 10) != static_cast<long>(::getpid())) {
+        return listeners;
+    }
+    long n = std::strtol(fds, nullptr, 10);
+    for (int fd = listenFdsStart; fd < listenFdsStart + n; ++fd) {
+        setCloseOnExec(fd);
+        listeners.push_back(Listener::fromDescriptor(fd));
+    }
+    ::unsetenv("LISTEN_PID");
+    ::unsetenv("LISTEN_FDS");
+    ::unsetenv("LISTEN_FDNAMES");
+    return listeners;
+}
+
+bool receiveListeners(const std::string &path,
+                      std::vector<Listener> &listeners,
+                      std::string &error,
+                      std::chrono::milliseconds timeout) {
+    asio::io_context ioContext;
+    asio::local::stream_protocol::socket socket(ioContext);
+    asio::local::stream_protocol::endpoint endpoint(path);
+    std::error_code ec;
+    socket.open(endpoint.protocol(), ec);
+    if (ec) {
+        error = path + ": " + ec.message();
+        return false;
+    }
+    if (!setTimeout(socket.native_handle(), timeout)) {
+        error = systemError("setsockopt");
+        return false;
+    }
+    // not socket.connect(), which waits without a timeout for a connect
+    // that would block
+    int ret;
+    do {
+        ret = ::connect(socket.native_handle(), endpoint.data(), endpoint.size());
+    } while (ret != 0 && errno == EINTR);
+    if (ret != 0) {
+        error = errno == EAGAIN ? path + ": timed out connecting" : systemError(path);
+        return false;
+    }
+
+    uint32_t count = 0;
+    iovec data = {&count, sizeof(count)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * maxHandoffListeners)];
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = ::recvmsg(socket.native_handle(), &message, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n != static_cast<ssize_t>(sizeof(count))) {
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            error = path + ": timed out waiting for the listeners";
+        } else {
+            error = n < 0 ? systemError("recvmsg") : path + ": no listeners received";
+        }
+        return false;
+    }
+
+    for (cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr;
+         header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t nrOfFds = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < nrOfFds; ++i) {
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+            setCloseOnExec(fd);
+            listeners.push_back(Listener::fromDescriptor(fd));
+        }
+    }
+    if (listeners.size() != count) {
+        error = path + ": expected " + std::to_string(count) + " listeners, received " +
+                std::to_string(listeners.size());
+        return false;
+    }
+    return true;
+}
+
+bool sendListeners(int socket, const std::vector<int> &fds, std::string &error) {
+    if (fds.empty() || fds.size() > maxHandoffListeners) {
+        error = "cannot hand off " + std::to_string(fds.size()) + " listeners";
+        return false;
+    }
+
+    uint32_t count = static_cast<uint32_t>(fds.size());
+    iovec data = {&count, sizeof(count)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * maxHandoffListeners)];
+    std::memset(control, 0, sizeof(control));
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(header), fds.data(), sizeof(int) * fds.size());
+
+    ssize_t n;
+    do {
+        n = ::sendmsg(socket, &message, sendFlags);
+    } while (n < 0 && errno == EINTR);
+    if (n != static_cast<ssize_t>(sizeof(count))) {
+        error = systemError("sendmsg");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace beauty
+
+#endif  // ASIO_HAS_LOCAL_SOCKETS
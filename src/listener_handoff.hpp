@@ -0,0 +1,39 @@
+#pragma once
+#include "environment.hpp"
+
+#include <asio.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "beauty_common.hpp"
+
+// Passing listening sockets to a server process, so that it serves the
+// port without first binding it. Clients arriving while a server starts or
+// replaces another wait in the listen backlog instead of being refused.
+// POSIX only.
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+
+namespace beauty {
+
+// The listeners passed by systemd socket activation, see sd_listen_fds(3).
+// Empty if the process was not socket activated. The LISTEN_* environment
+// variables are cleared so that child processes do not take the sockets.
+std::vector<Listener> systemdListeners();
+
+// Take over the listening sockets of a running server that enabled handoff
+// on the Unix domain socket at path, see Server::enableHandoff(). The
+// running server then stops accepting and drains its connections. Returns
+// false with a description in error on failure, or if the running server
+// does not send its sockets within timeout.
+bool receiveListeners(const std::string &path,
+                      std::vector<Listener> &listeners,
+                      std::string &error,
+                      std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+// Send the listening sockets fds over the connected Unix domain socket.
+bool sendListeners(int socket, const std::vector<int> &fds, std::string &error);
+
+}  // namespace beauty
+
+#endif  // ASIO_HAS_LOCAL_SOCKETS
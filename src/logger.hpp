@@ -0,0 +1,119 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "beauty_common.hpp"
+
+// Log statements below this level are removed at compile time, e.g. build
+// with -DBEAUTY_LOG_MIN_LEVEL=3 to keep only errors. See beauty::LogLevel.
+#ifndef BEAUTY_LOG_MIN_LEVEL
+#define BEAUTY_LOG_MIN_LEVEL 0
+#endif
+
+// Log a message. The message expression is captured by value in a lambda
+// and only evaluated if the level passes the compile-time minimum level and
+// the installed sink accepts it, so a disabled log statement never formats
+// or allocates. As a sink may format later on another thread, the message
+// must only use local values, never members of objects that may go away.
+#define BEAUTY_LOG(logger, level, message)                                       \
+    do {                                                                         \
+        if (static_cast<int>(level) >= BEAUTY_LOG_MIN_LEVEL &&                   \
+            (logger).accepts(level)) {                                           \
+            (logger).write(level, [=]() -> std::string { return (message); }); \
+        }                                                                        \
+    } while (0)
+
+namespace beauty {
+
+enum class LogLevel { debug = 0, info = 1, warning = 2, error = 3, off = 4 };
+
+inline const char *toString(LogLevel level) {
+    switch (level) {
+        case LogLevel::debug:
+            return "debug";
+        case LogLevel::info:
+            return "info";
+        case LogLevel::warning:
+            return "warning";
+        case LogLevel::error:
+            return "error";
+        default:
+            return "off";
+    }
+}
+
+// Deferred message formatting, invoked by the sink.
+using logFormatter = std::function<std::string()>;
+
+class ILogSink {
+   public:
+    ILogSink() = default;
+    virtual ~ILogSink() = default;
+
+    // Return true if messages at this level should be formatted and written.
+    virtual bool accepts(LogLevel level) const = 0;
+
+    // Format and output a message, only called for accepted levels.
+    virtual void write(LogLevel level, logFormatter &&format) = 0;
+};
+
+// Synchronous sink that formats on the calling thread and passes the message
+// to a debugMsgCallback.
+class CallbackLogSink : public ILogSink {
+   public:
+    explicit CallbackLogSink(const debugMsgCallback &cb, LogLevel minLevel = LogLevel::debug)
+        : cb_(cb), minLevel_(minLevel) {}
+
+    bool accepts(LogLevel level) const override {
+        return level >= minLevel_;
+    }
+
+    void write(LogLevel level, logFormatter &&format) override {
+        cb_(format());
+    }
+
+   private:
+    debugMsgCallback cb_;
+    LogLevel minLevel_;
+};
+
+// Dispatches log statements to the installed sink. Without a sink nothing is
+// accepted, so log statements cost a single pointer check.
+class Logger {
+   public:
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    Logger() = default;
+
+    // The sink must outlive the logger, nullptr disables logging.
+    void setSink(ILogSink *sink) {
+        sink_ = sink;
+    }
+
+    // Convenience to log all levels to a callback.
+    void setDebugMsgHandler(const debugMsgCallback &cb) {
+        callbackSink_ = std::make_shared<CallbackLogSink>(cb);
+        sink_ = callbackSink_.get();
+    }
+
+    bool accepts(LogLevel level) const {
+        return sink_ != nullptr && sink_->accepts(level);
+    }
+
+    void write(LogLevel level, logFormatter &&format) {
+        if (sink_ != nullptr) {
+            sink_->write(level, std::move(format));
+        }
+    }
+
+   private:
+    ILogSink *sink_ = nullptr;
+
+    // Owned sink created by setDebugMsgHandler().
+    std::shared_ptr<CallbackLogSink> callbackSink_;
+};
+
+}  // namespace beauty
@@ -1,29 +1,219 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <list>
+#include <utility>
+
 #include "mime_types.hpp"
 
 namespace beauty {
 namespace mime_types {
 
-struct Mapping {
-    const char *extension;
-    const char *mime_type;
-} mappings[] = {{"css", "text/css"},
-                {"gif", "image/gif"},
-                {"htm", "text/html"},
-                {"html", "text/html"},
-                {"jpg", "image/jpeg"},
-                {"js", "application/javascript"},
-                {"json", "application/json"},
-                {"png", "image/png"}};
-
-std::string extensionToType(const std::string &extension) {
-    for (Mapping m : mappings) {
-        if (m.extension == extension) {
-            return m.mime_type;
+namespace {
+
+const Mapping mappings[] = {
+    {"html", "text/html"},
+    {"htm", "text/html"},
+    {"css", "text/css"},
+    {"js", "application/javascript"},
+    {"mjs", "application/javascript"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"jsonld", "application/ld+json"},
+    {"webmanifest", "application/manifest+json"},
+    {"txt", "text/plain"},
+    {"csv", "text/csv"},
+    {"md", "text/markdown"},
+    {"xml", "application/xml"},
+    {"xhtml", "application/xhtml+xml"},
+    {"rss", "application/rss+xml"},
+    {"atom", "application/atom+xml"},
+    {"ics", "text/calendar"},
+    {"vtt", "text/vtt"},
+    {"yaml", "application/yaml"},
+    {"yml", "application/yaml"},
+    {"toml", "application/toml"},
+    {"png", "image/png"},
+    {"apng", "image/apng"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"svg", "image/svg+xml"},
+    {"ico", "image/x-icon"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"bmp", "image/bmp"},
+    {"tif", "image/tiff"},
+    {"tiff", "image/tiff"},
+    {"heic", "image/heic"},
+    {"jxl", "image/jxl"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    {"eot", "application/vnd.ms-fontobject"},
+    {"mp4", "video/mp4"},
+    {"m4v", "video/mp4"},
+    {"webm", "video/webm"},
+    {"ogv", "video/ogg"},
+    {"mov", "video/quicktime"},
+    {"mpeg", "video/mpeg"},
+    {"mkv", "video/x-matroska"},
+    {"ts", "video/mp2t"},
+    {"m3u8", "application/vnd.apple.mpegurl"},
+    {"mpd", "application/dash+xml"},
+    {"mp3", "audio/mpeg"},
+    {"wav", "audio/wav"},
+    {"ogg", "audio/ogg"},
+    {"oga", "audio/ogg"},
+    {"m4a", "audio/mp4"},
+    {"flac", "audio/flac"},
+    {"aac", "audio/aac"},
+    {"opus", "audio/opus"},
+    {"mid", "audio/midi"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+    {"tar", "application/x-tar"},
+    {"bz2", "application/x-bzip2"},
+    {"xz", "application/x-xz"},
+    {"zst", "application/zstd"},
+    {"7z", "application/x-7z-compressed"},
+    {"bin", "application/octet-stream"},
+    {"cbor", "application/cbor"},
+    {"epub", "application/epub+zip"},
+    {"rtf", "application/rtf"},
+    {"doc", "application/msword"},
+    {"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
+    {"xls", "application/vnd.ms-excel"},
+    {"xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
+    {"ppt", "application/vnd.ms-powerpoint"},
+    {"pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation"},
+    {"sh", "application/x-sh"},
+};
+
+inline char toLower(char ch) {
+    return static_cast<unsigned char>(ch - 'A') < 26 ? ch | 0x20 : ch;
+}
+
+bool iequals(StringView a, const char *b) {
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (b[i] == '\0' || toLower(a[i]) != b[i]) {
+            return false;
+        }
+    }
+    return b[a.size()] == '\0';
+}
+
+// FNV-1a of the lower cased extension, top 9 bits.
+size_t slotOf(StringView extension, uint32_t seed) {
+    uint32_t h = seed;
+    for (char ch : extension) {
+        h ^= static_cast<unsigned char>(toLower(ch));
+        h *= 16777619u;
+    }
+    return h >> 23;
+}
+
+const size_t nrOfMappings = sizeof(mappings) / sizeof(mappings[0]);
+static_assert(nrOfMappings < 255, "slots index mappings with uint8_t, 255 is empty");
+
+// Index into mappings for each hash slot, 255 for an empty slot. The seed is
+// chosen so no two extensions share a slot, and a lookup compares against
+// one candidate only.
+struct Table {
+    uint32_t seed_;
+    size_t maxExtensionSize_;
+    uint8_t slots_[512];
+};
+
+// Try seeds from the FNV offset basis on until the extensions land in
+// distinct slots, a few hundred tries for the mappings above.
+Table buildTable() {
+    Table table;
+    table.maxExtensionSize_ = 0;
+    for (const Mapping &mapping : mappings) {
+        table.maxExtensionSize_ = std::max(table.maxExtensionSize_, strlen(mapping.extension));
+    }
+    for (table.seed_ = 2166136261u;; ++table.seed_) {
+        memset(table.slots_, 255, sizeof(table.slots_));
+        bool collision = false;
+        for (size_t i = 0; i < nrOfMappings && !collision; ++i) {
+            uint8_t &slot = table.slots_[slotOf(mappings[i].extension, table.seed_)];
+            if (slot == 255) {
+                slot = static_cast<uint8_t>(i);
+            } else {
+                // a duplicate extension keeps its first mapping
+                collision = strcmp(mappings[slot].extension, mappings[i].extension) != 0;
+            }
+        }
+        if (!collision) {
+            return table;
+        }
+    }
+}
+
+// Built on first use.
+const Table &table() {
+    static const Table table = buildTable();
+    return table;
+}
+
+std::list<std::pair<std::string, std::string>> &addedTypes() {
+    static std::list<std::pair<std::string, std::string>> types;
+    return types;
+}
+
+}  // namespace
+
+const Mapping *builtInTypes(size_t &size) {
+    size = nrOfMappings;
+    return mappings;
+}
+
+StringView extensionToType(StringView extension) {
+    for (auto &added : addedTypes()) {
+        if (iequals(extension, added.first.c_str())) {
+            return added.second;
+        }
+    }
+
+    const Table &t = table();
+    if (!extension.empty() && extension.size() <= t.maxExtensionSize_) {
+        uint8_t index = t.slots_[slotOf(extension, t.seed_)];
+        if (index != 255 && iequals(extension, mappings[index].extension)) {
+            return mappings[index].mime_type;
         }
     }
 
     return "text/plain";
 }
 
+void addType(const std::string &extension, const std::string &mimeType) {
+    std::string lower(extension);
+    for (auto &ch : lower) {
+        ch = toLower(ch);
+    }
+    for (auto &added : addedTypes()) {
+        if (added.first == lower) {
+            added.second = mimeType;
+            return;
+        }
+    }
+    addedTypes().push_back({lower, mimeType});
+}
+
+void removeType(const std::string &extension) {
+    auto &types = addedTypes();
+    for (auto it = types.begin(); it != types.end(); ++it) {
+        if (iequals(extension, it->first.c_str())) {
+            types.erase(it);
+            return;
+        }
+    }
+}
+
 }  // namespace mime_types
 }  // namespace beauty
@@ -2,11 +2,33 @@
 
 #include <string>
 
+#include "string_view.hpp"
+
 namespace beauty {
 namespace mime_types {
 
-/// Convert a file extension into a MIME type.
-std::string extensionToType(const std::string &extension);
+/// A built in mapping of a lower case file extension to its MIME type.
+struct Mapping {
+    const char *extension;
+    const char *mime_type;
+};
+
+/// The built in mappings, their number is returned in size.
+const Mapping *builtInTypes(size_t &size);
+
+/// Convert a file extension into a MIME type, "text/plain" if unknown. The
+/// extension is matched case insensitively.
+StringView extensionToType(StringView extension);
+
+/// Add or override the MIME type of a file extension. Not thread safe, so
+/// add types before the server is started. A view returned for the
+/// extension before it was overridden is invalidated.
+void addType(const std::string &extension, const std::string &mimeType);
+
+/// Remove a type added by addType(), a built in type of the extension
+/// applies again. Not thread safe, as addType(). A view returned for the
+/// removed type is invalidated.
+void removeType(const std::string &extension);
 
 }  // namespace mime_types
 }  // namespace beauty
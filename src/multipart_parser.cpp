@@ -6,14 +6,15 @@
 
 namespace beauty {
 
-MultiPartParser::MultiPartParser(std::vector<char> &lastBuffer)
-    : state_(expecting_hyphen_1), lastBuffer_(lastBuffer) {}
+MultiPartParser::MultiPartParser() : state_(expecting_hyphen_1) {}
 
 void MultiPartParser::reset() {
     state_ = expecting_hyphen_1;
+    headers_.clear();
     boundaryStr_.clear();
-    lastBuffer_.clear();
-    lastParts_.clear();
+    delimiter_.clear();
+    heldBack_.clear();
+    releasedHeldBack_.clear();
 }
 
 bool MultiPartParser::parseHeader(const Request &req) {
@@ -36,22 +37,39 @@ bool MultiPartParser::parseHeader(const Request &req) {
     } else {
         return false;
     }
+    delimiter_ = "\r\n--" + boundaryStr_;
     return true;
 }
 
 MultiPartParser::result_type MultiPartParser::parse(const Request &req,
                                                     std::vector<char> &content,
                                                     std::deque<ContentPart> &parts) {
-    result_type result;
+    result_type result = indeterminate;
 
+    parts.clear();
     if (content.empty()) {
         return indeterminate;
     }
 
-    parts.clear();
     auto begin = content.begin();
     auto end = content.end();
+    if (!heldBack_.empty() && !resolveHeldBack(begin, end, parts)) {
+        return indeterminate;
+    }
+
+    // part data continued from the previous buffer
+    if (state_ == part_data) {
+        ContentPart part;
+        part.start_ = begin;
+        part.end_ = begin;
+        parts.push_back(part);
+    }
+
     while (begin != end) {
+        if (state_ == part_data) {
+            begin = consumePartData(begin, end, parts.back());
+            continue;
+        }
         result = consume(begin++, parts);
         if (result != indeterminate) {
             break;
@@ -62,65 +80,91 @@ MultiPartParser::result_type MultiPartParser::parse(const Request &req,
         return result;
     }
 
-    // if no filename_/start_/end_ was found in consume() it will not create
-    // a part, so must then assume we're in the middle of content somewhere and
-    // create a part
-    if (result == indeterminate && parts.empty()) {
-        parts.push_back(ContentPart());
-    }
+    // drop continuation parts that ended up holding nothing to write
+    auto isEmpty = [](const ContentPart &part) {
+        return part.filename_.empty() && !part.foundEnd_ && part.start_ == part.end_;
+    };
+    parts.erase(std::remove_if(parts.begin(), parts.end(), isEmpty), parts.end());
 
-    // return the previous content (that have been adjusted below)
-    parts.swap(lastParts_);
-    content.swap(lastBuffer_);
+    return result;
+}
 
-    // make adjustments to the stored lastParts_ so they are correct when
-    // swapped out in the next call
-    bool containEndForPartToLeave = false;
-    for (auto &lastPart : lastParts_) {
-        // if start_ not found, assume buffer start
-        if (!lastPart.foundStart_) {
-            lastPart.start_ = lastBuffer_.begin();
-        }
+bool MultiPartParser::resolveHeldBack(std::vector<char>::iterator &begin,
+                                      std::vector<char>::iterator end,
+                                      std::deque<ContentPart> &parts) {
+    size_t held = heldBack_.size();
+    size_t n = std::min(delimiter_.size() - held, static_cast<size_t>(end - begin));
+    if (memcmp(&*begin, delimiter_.data() + held, n) != 0) {
+        // not a delimiter after all, release the held back bytes as part
+        // data ahead of this buffer
+        releasedHeldBack_.swap(heldBack_);
+        heldBack_.clear();
+        ContentPart part;
+        part.start_ = releasedHeldBack_.begin();
+        part.end_ = releasedHeldBack_.end();
+        parts.push_back(part);
+        return true;
+    }
+    if (held + n < delimiter_.size()) {
+        heldBack_.insert(heldBack_.end(), begin, end);
+        return false;
+    }
 
-        // if end_ not found assume buffer end
-        if (!lastPart.foundEnd_) {
-            lastPart.end_ = lastBuffer_.end();
-        } else {
-            // lastPart.end_ is assigned +1 char after boundary so:
-            // subtract "crlf--boundarySize" to get position after
-            // last data byte
-            lastPart.end_ = lastPart.end_ - (boundaryStr_.size() + 4);
-            if (lastPart.end_ < lastPart.start_) {
-                // end was in the last part of the returned "parts".
-                // "Luckily" (actually the whole reason why we're having
-                // a lastPart/Buffer memory) we can adjust it here!
-                ContentPart &partToLeave = parts.back();
-                partToLeave.end_ = partToLeave.end_ - (lastPart.start_ - lastPart.end_);
-                partToLeave.foundEnd_ = true;
+    // the delimiter completed, so the part ended with the previous buffer
+    heldBack_.clear();
+    ContentPart part;
+    part.start_ = begin;
+    part.end_ = begin;
+    part.foundEnd_ = true;
+    parts.push_back(part);
+    begin += n;
+    state_ = boundary_close;
+    return true;
+}
 
-                // this part needs removing as it was created
-                // by consume() but only contained end_ for previous part
-                containEndForPartToLeave = true;
-            }
-        }
+std::vector<char>::iterator MultiPartParser::consumePartData(std::vector<char>::iterator begin,
+                                                             std::vector<char>::iterator end,
+                                                             ContentPart &part) {
+    auto delimiterStart = skipPartData(begin, end);
+    part.end_ = delimiterStart;
+    if (part.end_ != part.start_) {
+        part.headerOnly_ = false;
     }
-
-    if (containEndForPartToLeave) {
-        lastParts_.pop_front();
+    if (delimiterStart == end) {
+        return end;
     }
 
-    return result;
-}
+    // only a prefix of the delimiter fits, hold it back until the next
+    // buffer tells whether it is data
+    if (static_cast<size_t>(end - delimiterStart) < delimiter_.size()) {
+        heldBack_.assign(delimiterStart, end);
+        return end;
+    }
 
-void MultiPartParser::flush(std::vector<char> &content, std::deque<ContentPart> &parts) {
-    parts.swap(lastParts_);
-    content.swap(lastBuffer_);
-    lastParts_.clear();
-    lastBuffer_.clear();
+    part.foundEnd_ = true;
+    state_ = boundary_close;
+    return delimiterStart + delimiter_.size();
 }
 
-const std::deque<MultiPartParser::ContentPart> &MultiPartParser::peakLastPart() const {
-    return lastParts_;
+std::vector<char>::iterator MultiPartParser::skipPartData(std::vector<char>::iterator begin,
+                                                          std::vector<char>::iterator end) const {
+    // The boundary can not contain '\r', so the delimiter only starts at a
+    // '\r' and memchr, which is vectorized by most C libraries, finds the
+    // candidates.
+    const char *p = &*begin;
+    const char *last = p + (end - begin);
+    while (p != last) {
+        p = static_cast<const char *>(memchr(p, '\r', last - p));
+        if (p == nullptr) {
+            return end;
+        }
+        size_t n = std::min(delimiter_.size(), static_cast<size_t>(last - p));
+        if (memcmp(p, delimiter_.data(), n) == 0) {
+            return begin + (p - &*begin);
+        }
+        ++p;
+    }
+    return end;
 }
 
 MultiPartParser::result_type MultiPartParser::consume(std::vector<char>::iterator inputPtr,
@@ -204,12 +248,10 @@ MultiPartParser::result_type MultiPartParser::consume(std::vector<char>::iterato
                     std::size_t foundEnd = h.value_.find("\"", foundStart + key.size());
                     if (foundStart != std::string::npos && foundEnd != std::string::npos &&
                         foundEnd > foundStart) {
-                        if (parts.empty()) {
-                            parts.push_back(ContentPart());
-                        }
+                        parts.push_back(ContentPart());
                         parts.back().filename_ = h.value_.substr(
                             foundStart + key.size(), foundEnd - foundStart - key.size());
-                        headers_.clear();
+                        parts.back().headerOnly_ = true;
                     } else {
                         return bad;
                     }
@@ -231,65 +273,30 @@ MultiPartParser::result_type MultiPartParser::consume(std::vector<char>::iterato
             return indeterminate;
         case expecting_newline_3: {
             if (input == '\n') {
-                if (parts.empty()) {
+                // the part headers may have started in the previous buffer
+                if (parts.empty() || parts.back().foundEnd_) {
                     parts.push_back(ContentPart());
+                    parts.back().headerOnly_ = true;
                 }
-                parts.back().headerOnly_ = true;
-                state_ = part_data_start;
+                parts.back().start_ = inputPtr + 1;
+                parts.back().end_ = inputPtr + 1;
+                parts.back().foundStart_ = true;
+                headers_.clear();
+                state_ = part_data;
             } else {
                 return bad;
             }
             return indeterminate;
         }
-        case part_data_start:
-            if (parts.empty()) {
-                parts.push_back(ContentPart());
-            }
-            parts.back().headerOnly_ = false;
-            parts.back().start_ = inputPtr;
-            parts.back().foundStart_ = true;
-            state_ = part_data_cont;
-            return indeterminate;
-        case part_data_cont:
-            if (input == '-') {
-                state_ = expecting_hyphen_3;
-            }
-            return indeterminate;
-        case expecting_hyphen_3:
-            if (input == '-') {
-                state_ = boundary_next;
-                boundaryCount_ = 0;
-            } else {
-                state_ = part_data_cont;
-            }
-            return indeterminate;
-        case boundary_next:
-            if (input == boundaryStr_[boundaryCount_++]) {
-                if (boundaryCount_ == boundaryStr_.size()) {
-                    state_ = boundary_close;
-                }
-            } else {
-                boundaryCount_ = 0;
-                state_ = part_data_cont;
-            }
-            return indeterminate;
-        case boundary_close: {
-            if (parts.empty()) {
-                parts.push_back(ContentPart());
-            }
-            parts.back().end_ = inputPtr;
-            parts.back().foundEnd_ = true;
-
+        case boundary_close:
             if (input == '-') {
                 return done;
             } else if (input == '\r') {
-                parts.push_back(ContentPart());
                 state_ = expecting_newline_1;
             } else {
                 return bad;
             }
             return indeterminate;
-        }
         default:
             return bad;
     }
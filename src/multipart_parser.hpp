@@ -14,7 +14,7 @@ struct Request;
 // Parser for incoming requests.
 class MultiPartParser {
    public:
-    MultiPartParser(std::vector<char> &lastBuffer);
+    MultiPartParser();
 
     // Reset to initial parser state.
     void reset();
@@ -37,20 +37,34 @@ class MultiPartParser {
     // Parse multipart content. The enum return value is done when all parts
     // has been parsed, bad if the data is invalid, indeterminate when more
     // data is required.
-    // The caller must inspect readyParts to see if any parts has been
-    // completed.
+    // The returned parts point into content, so must be handled before the
+    // next call. Only a trailing prefix of the delimiter, at most
+    // boundary.size() + 4 bytes, is held back until the next call.
     result_type parse(const Request &req,
                       std::vector<char> &content,
                       std::deque<ContentPart> &parts);
 
-    void flush(std::vector<char> &content, std::deque<ContentPart> &parts);
-
-    const std::deque<ContentPart> &peakLastPart() const;
-
    private:
+    // Match the start of content against the rest of a held back delimiter
+    // prefix. Returns false when content is consumed without a decision.
+    bool resolveHeldBack(std::vector<char>::iterator &begin,
+                         std::vector<char>::iterator end,
+                         std::deque<ContentPart> &parts);
+
+    // Add part data up to the next delimiter to part and return the position
+    // after the delimiter, or end if the data continues in the next buffer.
+    std::vector<char>::iterator consumePartData(std::vector<char>::iterator begin,
+                                                std::vector<char>::iterator end,
+                                                ContentPart &part);
+
     // Handle the next character of input.
     result_type consume(std::vector<char>::iterator inputPtr, std::deque<ContentPart> &parts);
 
+    // Skip part data up to the next '\r' that may start a delimiter, i.e. is
+    // followed by the delimiter or by a prefix of it at the end of input.
+    std::vector<char>::iterator skipPartData(std::vector<char>::iterator begin,
+                                             std::vector<char>::iterator end) const;
+
     // The current state of the parser.
     enum state {
         expecting_hyphen_1,
@@ -64,20 +78,20 @@ class MultiPartParser {
         header_value,
         expecting_newline_2,
         expecting_newline_3,
-        part_data_start,
-        part_data_cont,
-        expecting_hyphen_3,
-        boundary_next,
+        part_data,
         boundary_close,
     } state_;
 
     std::vector<Header> headers_;
-    std::vector<char> &lastBuffer_;
-    std::deque<ContentPart> lastParts_;
-
-    size_t contentCount_;
-    size_t boundaryCount_;
     std::string boundaryStr_;
+
+    // "\r\n--" + boundaryStr_, ending each part's data.
+    std::string delimiter_;
+
+    // A delimiter prefix ending the previous buffer, and the bytes of one
+    // that turned out to be part data, returned by the current call.
+    std::vector<char> heldBack_;
+    std::vector<char> releasedHeldBack_;
 };
 
 }  // namespace beauty
@@ -0,0 +1,127 @@
+#include "rate_limiter.hpp"
+
+#include <algorithm>
+
+namespace beauty {
+
+const size_t RateLimiter::probes_;
+
+RateLimiter::RateLimiter(const RateLimit &limit)
+    : maxConnectionsPerClient_(limit.maxConnectionsPerClient_),
+      interval_(0),
+      tolerance_(0),
+      buckets_(std::max<size_t>(limit.tableSize_, probes_)),
+      reply_("HTTP/1.1 429 Too Many Requests\r\nRetry-After: " +
+             std::to_string(limit.retryAfter_.count()) +
+             "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"),
+      stats_() {
+    if (limit.requestsPerSecond_ > 0) {
+        interval_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::seconds(1)) /
+                    limit.requestsPerSecond_;
+        tolerance_ = interval_ * (std::max<size_t>(limit.burst_, 1) - 1);
+    }
+}
+
+RateLimiter::Key RateLimiter::key(const asio::ip::address &address) {
+    if (address.is_v4()) {
+        return asio::ip::make_address_v6(asio::ip::v4_mapped, address.to_v4()).to_bytes();
+    }
+    Key key = address.to_v6().to_bytes();
+    if (!address.to_v6().is_v4_mapped()) {
+        std::fill(key.begin() + 8, key.end(), 0);
+    }
+    return key;
+}
+
+RateLimiter::Verdict RateLimiter::acquire(const Key &key,
+                                          std::chrono::steady_clock::time_point now,
+                                          int &slot) {
+    slot = find(key, now);
+    if (slot < 0) {
+        stats_.untracked_++;
+        return allowed;
+    }
+    Bucket &bucket = buckets_[slot];
+    if (maxConnectionsPerClient_ > 0 && bucket.connections_ >= maxConnectionsPerClient_) {
+        stats_.limitedConnections_++;
+        return over_connections;
+    }
+    if (!takeToken(bucket, now)) {
+        stats_.limitedConnections_++;
+        return over_rate;
+    }
+    bucket.connections_++;
+    return allowed;
+}
+
+bool RateLimiter::take(int slot, std::chrono::steady_clock::time_point now) {
+    if (slot < 0 || takeToken(buckets_[slot], now)) {
+        return true;
+    }
+    stats_.limitedRequests_++;
+    return false;
+}
+
+void RateLimiter::release(int slot) {
+    if (slot >= 0 && buckets_[slot].connections_ > 0) {
+        buckets_[slot].connections_--;
+    }
+}
+
+RateLimiter::Stats RateLimiter::getStats() const {
+    return stats_;
+}
+
+int RateLimiter::find(const Key &key, std::chrono::steady_clock::time_point now) {
+    // FNV-1a
+    size_t hash = 2166136261u;
+    for (unsigned char byte : key) {
+        hash = (hash ^ byte) * 16777619u;
+    }
+    int free = -1;
+    int stalest = -1;
+    for (size_t i = 0; i < probes_; ++i) {
+        int index = static_cast<int>((hash + i) % buckets_.size());
+        Bucket &bucket = buckets_[index];
+        if (bucket.used_ && bucket.key_ == key) {
+            return index;
+        }
+        if (!bucket.used_ || (bucket.connections_ == 0 && bucket.tat_ <= now)) {
+            // unused, or aged out with a full bucket
+            if (free < 0) {
+                free = index;
+            }
+        } else if (bucket.connections_ == 0 && bucket.tat_ - now <= tolerance_ &&
+                   (stalest < 0 || bucket.tat_ < buckets_[stalest].tat_)) {
+            stalest = index;
+        }
+    }
+    if (free < 0) {
+        // the client with the bucket closest to full is forgotten, never a
+        // throttled one, which a new bucket would set free
+        free = stalest;
+    }
+    if (free >= 0) {
+        Bucket &bucket = buckets_[free];
+        bucket.key_ = key;
+        bucket.tat_ = now;
+        bucket.connections_ = 0;
+        bucket.used_ = true;
+    }
+    return free;
+}
+
+bool RateLimiter::takeToken(Bucket &bucket, std::chrono::steady_clock::time_point now) {
+    if (interval_.count() == 0) {
+        return true;
+    }
+    std::chrono::steady_clock::time_point tat = std::max(bucket.tat_, now);
+    if (tat - now > tolerance_) {
+        return false;
+    }
+    bucket.tat_ = tat + interval_;
+    return true;
+}
+
+}  // namespace beauty
@@ -0,0 +1,93 @@
+#pragma once
+// included first
+#include "environment.hpp"
+
+#include <array>
+#include <asio.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "beauty_common.hpp"
+
+namespace beauty {
+
+// Token buckets per client IP address in a fixed size hash table. Each
+// bucket is kept as the time its tokens are refilled (GCRA), so taking a
+// token is a comparison and an addition, and a refilled bucket without
+// connections is free for another client. Not thread safe, use from the
+// io_context thread only.
+class RateLimiter {
+   public:
+    RateLimiter(const RateLimiter &) = delete;
+    RateLimiter &operator=(const RateLimiter &) = delete;
+
+    explicit RateLimiter(const RateLimit &limit);
+
+    // IPv4 addresses are kept as IPv4-mapped IPv6 addresses. Other IPv6
+    // addresses are kept by their /64 prefix, as a single host usually owns
+    // a whole /64 and may rotate through it.
+    typedef std::array<unsigned char, 16> Key;
+    static Key key(const asio::ip::address &address);
+
+    enum Verdict { allowed, over_rate, over_connections };
+
+    // Count a new connection of the client, taking a token. On allowed, slot
+    // is the bucket to pass to take() and release(), -1 if the table has no
+    // room. The limiter then fails open: the client is not limited and only
+    // counted in untracked_.
+    Verdict acquire(const Key &key, std::chrono::steady_clock::time_point now, int &slot);
+
+    // Take a token for a further request on a connection. Returns false if
+    // the client is over its rate.
+    bool take(int slot, std::chrono::steady_clock::time_point now);
+
+    // Count a connection of the client as closed.
+    void release(int slot);
+
+    // Precomputed 429 reply, closing the connection.
+    const std::string &reply() const {
+        return reply_;
+    }
+
+    struct Stats {
+        // Connections and requests answered with 429.
+        size_t limitedConnections_;
+        size_t limitedRequests_;
+        // Connections not tracked as the table had no room.
+        size_t untracked_;
+    };
+    Stats getStats() const;
+
+   private:
+    struct Bucket {
+        Key key_;
+        // Tokens are full at tat_, the theoretical arrival time of GCRA.
+        std::chrono::steady_clock::time_point tat_;
+        size_t connections_ = 0;
+        bool used_ = false;
+    };
+
+    // Bucket of key, claiming a free or the stalest unconnected bucket among
+    // the probed ones, never one of a throttled client. -1 if there is none.
+    int find(const Key &key, std::chrono::steady_clock::time_point now);
+
+    bool takeToken(Bucket &bucket, std::chrono::steady_clock::time_point now);
+
+    // Buckets probed from the hash of a key.
+    static const size_t probes_ = 8;
+
+    const size_t maxConnectionsPerClient_;
+
+    // Time to refill one token, 0 without a rate limit.
+    std::chrono::steady_clock::duration interval_;
+
+    // Time by which tat_ may be ahead of now, burst_ - 1 tokens.
+    std::chrono::steady_clock::duration tolerance_;
+
+    std::vector<Bucket> buckets_;
+    std::string reply_;
+    Stats stats_;
+};
+
+}  // namespace beauty
@@ -1,11 +1,16 @@
+#include "hpack.hpp"
 #include "reply.hpp"
+#include "websocket.hpp"
 
+#include <memory>
 #include <string>
 
 namespace beauty {
 
 namespace status_strings {
 
+// the WebSocket handshake is an HTTP/1.1 exchange
+const std::string switching_protocols = "HTTP/1.1 101 Switching Protocols\r\n";
 const std::string ok = "HTTP/1.0 200 OK\r\n";
 const std::string created = "HTTP/1.0 201 Created\r\n";
 const std::string accepted = "HTTP/1.0 202 Accepted\r\n";
@@ -25,6 +30,8 @@ const std::string service_unavailable = "HTTP/1.0 503 Service Unavailable\r\n";
 
 asio::const_buffer toBuffer(Reply::status_type status) {
     switch (status) {
+        case Reply::switching_protocols:
+            return asio::buffer(switching_protocols);
         case Reply::ok:
             return asio::buffer(ok);
         case Reply::created:
@@ -71,17 +78,35 @@ const char crlf[] = {'\r', '\n'};
 
 }  // namespace misc_strings
 
-Reply::Reply(size_t maxContentSize) : maxContentSize_(maxContentSize), multiPartParser_(content_) {
-    content_.reserve(maxContentSize);
+Reply::Reply(size_t maxContentSize) : maxContentSize_(maxContentSize) {
     headers_.reserve(2);
 }
 
 void Reply::addHeader(const std::string& name, const std::string& val) {
+    if (stock_) {
+        // the precomputed block cannot take the header, send a copy instead
+        const PrecomputedResponse& stock = *precomputed_;
+        precomputed_ = nullptr;
+        stock_ = false;
+        asio::const_buffer content = stock.content();
+        const char* data = static_cast<const char*>(content.data());
+        content_.assign(data, data + content.size());
+        status_ = stock.status();
+        headers_.push_back({"Content-Length", std::to_string(content_.size())});
+        if (!stock.contentType().empty()) {
+            headers_.push_back({"Content-Type", stock.contentType()});
+        }
+    }
     headers_.push_back({name, val});
 }
 
 bool Reply::hasHeaders() const {
-    return !headers_.empty();
+    return !headers_.empty() || precomputed_ != nullptr;
+}
+
+void Reply::streamBody(const std::shared_ptr<IBodyConsumer>& consumer) {
+    bodyConsumer_ = consumer;
+    returnToClient_ = true;
 }
 
 void Reply::send(status_type status) {
@@ -99,6 +124,41 @@ void Reply::send(status_type status, const std::string& contentType) {
     returnToClient_ = true;
 }
 
+void Reply::acceptWebSocket(const Request& request,
+                            const std::shared_ptr<IWebSocketHandler>& handler) {
+    std::string key = request.getHeaderValue("Sec-WebSocket-Key");
+    if (!request.isWebSocketUpgrade() || key.empty() ||
+        request.getHeaderValue("Sec-WebSocket-Version") != "13") {
+        stockReply(bad_request);
+        return;
+    }
+    status_ = switching_protocols;
+    headers_.push_back({"Upgrade", "websocket"});
+    headers_.push_back({"Connection", "Upgrade"});
+    headers_.push_back({"Sec-WebSocket-Accept", WebSocket::acceptKey(key)});
+    webSocketHandler_ = handler;
+
+    returnToClient_ = true;
+}
+
+void Reply::acceptEventStream(const std::shared_ptr<EventBroadcaster>& broadcaster) {
+    // no Content-Length, the stream ends when the connection is closed
+    status_ = ok;
+    headers_.push_back({"Content-Type", "text/event-stream"});
+    headers_.push_back({"Cache-Control", "no-cache"});
+    eventBroadcaster_ = broadcaster;
+
+    returnToClient_ = true;
+}
+
+void Reply::sendPrecomputed(const PrecomputedResponse& response) {
+    status_ = response.status();
+    precomputed_ = &response;
+    stock_ = false;
+
+    returnToClient_ = true;
+}
+
 void Reply::sendPtr(status_type status,
                     const std::string& contentType,
                     const char* data,
@@ -139,7 +199,7 @@ std::vector<asio::const_buffer> Reply::contentToBuffers() {
 
 namespace stock_replies {
 
-const char ok[] = "";
+const char empty[] = "";
 const char created[] =
     "<html>"
     "<head><title>Created</title></head>"
@@ -150,11 +210,6 @@ const char accepted[] =
     "<head><title>Accepted</title></head>"
     "<body><h1>202 Accepted</h1></body>"
     "</html>";
-const char no_content[] =
-    "<html>"
-    "<head><title>No Content</title></head>"
-    "<body><h1>204 Content</h1></body>"
-    "</html>";
 const char multiple_choices[] =
     "<html>"
     "<head><title>Multiple Choices</title></head>"
@@ -170,11 +225,6 @@ const char moved_temporarily[] =
     "<head><title>Moved Temporarily</title></head>"
     "<body><h1>302 Moved Temporarily</h1></body>"
     "</html>";
-const char not_modified[] =
-    "<html>"
-    "<head><title>Not Modified</title></head>"
-    "<body><h1>304 Not Modified</h1></body>"
-    "</html>";
 const char bad_request[] =
     "<html>"
     "<head><title>Bad Request</title></head>"
@@ -216,62 +266,129 @@ const char service_unavailable[] =
     "<body><h1>503 Service Unavailable</h1></body>"
     "</html>";
 
-std::vector<char> toArray(Reply::status_type status) {
+const Reply::status_type statuses[] = {Reply::switching_protocols,
+                                       Reply::ok,
+                                       Reply::created,
+                                       Reply::accepted,
+                                       Reply::no_content,
+                                       Reply::multiple_choices,
+                                       Reply::moved_permanently,
+                                       Reply::moved_temporarily,
+                                       Reply::not_modified,
+                                       Reply::bad_request,
+                                       Reply::unauthorized,
+                                       Reply::forbidden,
+                                       Reply::not_found,
+                                       Reply::internal_server_error,
+                                       Reply::not_implemented,
+                                       Reply::bad_gateway,
+                                       Reply::service_unavailable};
+const size_t noStatuses = sizeof(statuses) / sizeof(statuses[0]);
+
+const char* toContent(Reply::status_type status) {
     switch (status) {
-        case Reply::ok:
-            return std::vector<char>(ok, ok + sizeof(ok));
         case Reply::created:
-            return std::vector<char>(created, created + sizeof(created));
+            return created;
         case Reply::accepted:
-            return std::vector<char>(accepted, accepted + sizeof(accepted));
-        case Reply::no_content:
-            return std::vector<char>(no_content, no_content + sizeof(no_content));
+            return accepted;
         case Reply::multiple_choices:
-            return std::vector<char>(multiple_choices, multiple_choices + sizeof(multiple_choices));
+            return multiple_choices;
         case Reply::moved_permanently:
-            return std::vector<char>(moved_permanently,
-                                     moved_permanently + sizeof(moved_permanently));
+            return moved_permanently;
         case Reply::moved_temporarily:
-            return std::vector<char>(moved_temporarily,
-                                     moved_temporarily + sizeof(moved_temporarily));
-        case Reply::not_modified:
-            return std::vector<char>(not_modified, not_modified + sizeof(not_modified));
+            return moved_temporarily;
         case Reply::bad_request:
-            return std::vector<char>(bad_request, bad_request + sizeof(bad_request));
+            return bad_request;
         case Reply::unauthorized:
-            return std::vector<char>(unauthorized, unauthorized + sizeof(unauthorized));
+            return unauthorized;
         case Reply::forbidden:
-            return std::vector<char>(forbidden, forbidden + sizeof(forbidden));
+            return forbidden;
         case Reply::not_found:
-            return std::vector<char>(not_found, not_found + sizeof(not_found));
+            return not_found;
         case Reply::internal_server_error:
-            return std::vector<char>(internal_server_error,
-                                     internal_server_error + sizeof(internal_server_error));
+            return internal_server_error;
         case Reply::not_implemented:
-            return std::vector<char>(not_implemented, not_implemented + sizeof(not_implemented));
+            return not_implemented;
         case Reply::bad_gateway:
-            return std::vector<char>(bad_gateway, bad_gateway + sizeof(bad_gateway));
+            return bad_gateway;
         case Reply::service_unavailable:
-            return std::vector<char>(service_unavailable,
-                                     service_unavailable + sizeof(service_unavailable));
+            return service_unavailable;
         default:
-            return std::vector<char>(internal_server_error,
-                                     internal_server_error + sizeof(internal_server_error));
+            // switching_protocols, ok, no_content and not_modified have no
+            // content
+            return empty;
+    }
+}
+
+size_t indexOf(Reply::status_type status) {
+    for (size_t i = 0; i < noStatuses; ++i) {
+        if (statuses[i] == status) {
+            return i;
+        }
     }
+    return indexOf(Reply::internal_server_error);
+}
+
+// All stock replies, rendered on first use.
+struct Replies {
+    Replies() {
+        for (size_t i = 0; i < noStatuses; ++i) {
+            replies_[i].reset(
+                new PrecomputedResponse(statuses[i], "text/html", toContent(statuses[i])));
+        }
+    }
+    std::unique_ptr<PrecomputedResponse> replies_[noStatuses];
+};
+
+Replies& replies() {
+    static Replies replies;
+    return replies;
+}
+
+const PrecomputedResponse& get(Reply::status_type status) {
+    return *replies().replies_[indexOf(status)];
+}
+
+void set(Reply::status_type status, const std::string& contentType, const std::string& content) {
+    replies().replies_[indexOf(status)].reset(
+        new PrecomputedResponse(status, contentType, content));
 }
 
 }  // namespace stock_replies
 
 void Reply::stockReply(Reply::status_type status) {
-    status_ = status;
-    content_ = stock_replies::toArray(status);
-    headers_.resize(2);
-    headers_[0].name_ = "Content-Length";
-    headers_[0].value_ = std::to_string(content_.size());
-    headers_[1].name_ = "Content-Type";
-    headers_[1].value_ = "text/html";
+    content_.clear();
+    headers_.clear();
+    sendPrecomputed(stock_replies::get(status));
+    stock_ = true;
+}
 
-    returnToClient_ = true;
+PrecomputedResponse::PrecomputedResponse(Reply::status_type status,
+                                         const std::string& contentType,
+                                         const std::string& content,
+                                         const std::vector<Header>& headers)
+    : status_(status), contentType_(contentType) {
+    asio::const_buffer statusLine = status_strings::toBuffer(status);
+    block_.assign(static_cast<const char*>(statusLine.data()), statusLine.size());
+    block_ += "Content-Length: " + std::to_string(content.size()) + "\r\n";
+    if (!contentType.empty()) {
+        block_ += "Content-Type: " + contentType + "\r\n";
+    }
+    for (const Header& h : headers) {
+        block_ += h.name_ + ": " + h.value_ + "\r\n";
+    }
+    headSize_ = block_.size();
+    block_ += "\r\n";
+    block_ += content;
+
+    hpack::encodeStatus(status, http2Block_);
+    hpack::encode("content-length", std::to_string(content.size()), http2Block_);
+    if (!contentType.empty()) {
+        hpack::encode("content-type", contentType, http2Block_);
+    }
+    for (const Header& h : headers) {
+        hpack::encode(h.name_, h.value_, http2Block_);
+    }
 }
 
 }  // namespace beauty
@@ -2,19 +2,29 @@
 #include "environment.hpp"
 
 #include <asio.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "event_stream.hpp"
 #include "header.hpp"
+#include "i_body_consumer.hpp"
+#include "i_websocket_handler.hpp"
 #include "multipart_parser.hpp"
 
 namespace beauty {
 
+class Http2Session;
+class PrecomputedResponse;
+class ReplyBenchmark;
 class RequestHandler;
 
 class Reply {
     friend class RequestHandler;
     friend class Connection;
+    friend class Http2Session;
+    // Reaches headerToBuffers() from bench/parser_bench.cpp.
+    friend class ReplyBenchmark;
 
    public:
     Reply(const Reply&) = delete;
@@ -24,6 +34,7 @@ class Reply {
     virtual ~Reply() = default;
 
     enum status_type {
+        switching_protocols = 101,
         ok = 200,
         created = 201,
         accepted = 202,
@@ -45,9 +56,16 @@ class Reply {
     // Content to be sent in the reply.
     std::vector<char> content_;
 
-    // Helper to provide standard replies.
+    // Helper to provide standard replies, see stock_replies::set(). Headers
+    // may be added afterwards, e.g. Location to a 301, the reply is then sent
+    // as a copy of the stock reply.
     void stockReply(status_type status);
 
+    // Reply with a response rendered once up front. Headers and content
+    // set on the reply are not sent, and response must stay valid until the
+    // reply is written.
+    void sendPrecomputed(const PrecomputedResponse& response);
+
     // File path to open.
     std::string filePath_;
 
@@ -60,6 +78,19 @@ class Reply {
     void addHeader(const std::string& name, const std::string& val);
     bool hasHeaders() const;
 
+    // Stream the request body to consumer as it arrives instead of buffering
+    // it. No further handlers are called for the request.
+    void streamBody(const std::shared_ptr<IBodyConsumer>& consumer);
+
+    // Upgrade the connection to a WebSocket served by handler. Replies with
+    // 400 Bad Request if request is not a valid upgrade request, see
+    // Request::isWebSocketUpgrade().
+    void acceptWebSocket(const Request& request, const std::shared_ptr<IWebSocketHandler>& handler);
+
+    // Reply with a text/event-stream and park the connection on broadcaster,
+    // which then writes its events to it until the client disconnects.
+    void acceptEventStream(const std::shared_ptr<EventBroadcaster>& broadcaster);
+
    private:
     void reset() {
         content_.clear();
@@ -71,10 +102,16 @@ class Reply {
         contentSize_ = 0;
         replyPartial_ = false;
         finalPart_ = false;
-        noBodyBytesReceived_ = -1;
+        noBodyBytesReceived_ = 0;
         isMultiPart_ = false;
+        isRawUpload_ = false;
         lastOpenFileForWriteId_ = "";
         multiPartCounter_ = 0;
+        bodyConsumer_.reset();
+        precomputed_ = nullptr;
+        stock_ = false;
+        webSocketHandler_.reset();
+        eventBroadcaster_.reset();
     }
     // Headers to be included in the reply.
     status_type status_;
@@ -91,12 +128,16 @@ class Reply {
     bool replyPartial_ = false;
     bool finalPart_ = false;
 
-    // Keep track of the number of body bytes received in request body.
-    int noBodyBytesReceived_ = -1;
+    // Keep track of the number of body bytes received in request body, which
+    // may exceed 2 GB for raw uploads.
+    size_t noBodyBytesReceived_ = 0;
 
     // Keep track if the body is a multi-part upload.
     bool isMultiPart_ = false;
 
+    // Keep track if the body is written as is to a file, e.g. a PUT.
+    bool isRawUpload_ = false;
+
     // Keep track of the last opened file in multi-part transfers.
     std::string lastOpenFileForWriteId_;
     unsigned multiPartCounter_ = 0;
@@ -104,6 +145,21 @@ class Reply {
     // Parser to handle multipart uploads.
     MultiPartParser multiPartParser_;
 
+    // Optional consumer of the request body.
+    std::shared_ptr<IBodyConsumer> bodyConsumer_;
+
+    // Set when replying with a precomputed response.
+    const PrecomputedResponse* precomputed_ = nullptr;
+
+    // True when precomputed_ is a stock reply.
+    bool stock_ = false;
+
+    // Set when the connection is upgraded to a WebSocket.
+    std::shared_ptr<IWebSocketHandler> webSocketHandler_;
+
+    // Set when the connection subscribes to an event stream.
+    std::shared_ptr<EventBroadcaster> eventBroadcaster_;
+
     // Convert the reply into a vector of buffers. The buffers do not own the
     // underlying memory blocks, therefore the reply object must remain valid
     // and not be changed until the write operation has completed.
@@ -111,4 +167,60 @@ class Reply {
     std::vector<asio::const_buffer> contentToBuffers();
 };
 
+// A complete response, i.e. status line, headers and content, rendered into
+// one constant block. Only the Connection headers are added when it is sent.
+class PrecomputedResponse {
+   public:
+    PrecomputedResponse(Reply::status_type status,
+                        const std::string& contentType,
+                        const std::string& content,
+                        const std::vector<Header>& headers = std::vector<Header>());
+
+    Reply::status_type status() const {
+        return status_;
+    }
+
+    const std::string& contentType() const {
+        return contentType_;
+    }
+
+    // The status line and headers, without the empty line ending them.
+    asio::const_buffer head() const {
+        return asio::buffer(block_.data(), headSize_);
+    }
+
+    // The empty line ending the headers followed by the content.
+    asio::const_buffer tail() const {
+        return asio::buffer(block_.data() + headSize_, block_.size() - headSize_);
+    }
+
+    // The content alone.
+    asio::const_buffer content() const {
+        return asio::buffer(block_.data() + headSize_ + 2, block_.size() - headSize_ - 2);
+    }
+
+    // The status and headers as an HPACK header block, for HTTP/2.
+    const std::string& http2Block() const {
+        return http2Block_;
+    }
+
+   private:
+    Reply::status_type status_;
+    std::string contentType_;
+    std::string block_;
+    size_t headSize_;
+    std::string http2Block_;
+};
+
+namespace stock_replies {
+
+// The stock reply for status, internal_server_error for unknown statuses.
+const PrecomputedResponse& get(Reply::status_type status);
+
+// Replace the stock reply for status, e.g. with a site specific 404 page.
+// Not thread safe, so replace replies before the server is started.
+void set(Reply::status_type status, const std::string& contentType, const std::string& content);
+
+}  // namespace stock_replies
+
 }  // namespace beauty
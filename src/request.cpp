@@ -0,0 +1,88 @@
+#include <string.h>
+
+#include "request.hpp"
+#include "url_decode.hpp"
+
+namespace beauty {
+
+void Request::LazyParams::decode() {
+    decoded_ = true;
+    char *data = &str_[0];
+    size_t pos = 0;
+    while (pos < str_.size()) {
+        const char *amp = static_cast<const char *>(memchr(data + pos, '&', str_.size() - pos));
+        size_t end = amp ? amp - data : str_.size();
+        if (end > pos) {
+            const char *eq = static_cast<const char *>(memchr(data + pos, '=', end - pos));
+            size_t keyEnd = eq ? eq - data : end;
+            size_t valuePos = eq ? keyEnd + 1 : end;
+            Range range;
+            range.keyPos_ = pos;
+            range.keySize_ = urlDecode(data + pos, keyEnd - pos, true);
+            range.valuePos_ = valuePos;
+            range.valueSize_ = urlDecode(data + valuePos, end - valuePos, true);
+            ranges_.push_back(range);
+        }
+        pos = end + 1;
+    }
+}
+
+Request::Param Request::getParam(LazyParams &params, const std::string &key) const {
+    if (!params.decoded_) {
+        params.decode();
+    }
+    const char *data = params.str_.data();
+    for (auto &range : params.ranges_) {
+        if (StringView(data + range.keyPos_, range.keySize_) == key) {
+            return {true, StringView(data + range.valuePos_, range.valueSize_)};
+        }
+    }
+    return {false, StringView()};
+}
+
+std::vector<std::pair<StringView, StringView>> Request::getParams(LazyParams &params) const {
+    if (!params.decoded_) {
+        params.decode();
+    }
+    std::vector<std::pair<StringView, StringView>> ret;
+    ret.reserve(params.ranges_.size());
+    const char *data = params.str_.data();
+    for (auto &range : params.ranges_) {
+        ret.push_back({StringView(data + range.keyPos_, range.keySize_),
+                       StringView(data + range.valuePos_, range.valueSize_)});
+    }
+    return ret;
+}
+
+bool Request::isWebSocketUpgrade() const {
+    return method_ == "GET" && iequals(getHeaderValue("Upgrade"), "websocket") &&
+           hasConnectionToken("upgrade");
+}
+
+bool Request::isHttp2Upgrade() const {
+    return iequals(getHeaderValue("Upgrade"), "h2c") && !getHeaderValue("HTTP2-Settings").empty() &&
+           hasConnectionToken("upgrade");
+}
+
+bool Request::hasConnectionToken(const std::string &token) const {
+    // Connection is a comma separated list of tokens, e.g. "keep-alive, Upgrade"
+    std::string connection = getHeaderValue("Connection");
+    size_t pos = 0;
+    while (pos <= connection.size()) {
+        size_t end = connection.find(',', pos);
+        if (end == std::string::npos) {
+            end = connection.size();
+        }
+        size_t first = connection.find_first_not_of(" \t", pos);
+        if (first < end) {
+            size_t last = connection.find_last_not_of(" \t", end - 1);
+            if (iequals(connection.substr(first, last - first + 1), token)) {
+                return true;
+            }
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+}  // namespace beauty
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "header.hpp"
+#include "string_view.hpp"
 
 namespace beauty {
 
@@ -14,6 +15,8 @@ struct Request {
     friend class Connection;
     friend class RequestParser;
     friend class RequestHandler;
+    friend class RequestDecoder;
+    friend class Http2Session;
 
     Request(std::vector<char> &body) : body_(body) {}
 
@@ -26,12 +29,6 @@ struct Request {
     std::string requestPath_;
     std::vector<char> &body_;
 
-    // Parsed query params in the request
-    std::vector<std::pair<std::string, std::string>> queryParams_;
-
-    // Parsed form params in the request
-    std::vector<std::pair<std::string, std::string>> formParams_;
-
     // convenience functions
     // case insensitive
     std::string getHeaderValue(const std::string &name) const {
@@ -44,11 +41,13 @@ struct Request {
         return "";
     }
 
+    // value_ is valid until the next request on the connection.
     struct Param {
         bool exist_;
-        std::string value_;
+        StringView value_;
     };
 
+    // Query and form params are split and decoded on first access.
     // Note: below are case sensitive for speed
     Param getQueryParam(const std::string &key) const {
         return getParam(queryParams_, key);
@@ -58,6 +57,21 @@ struct Request {
         return getParam(formParams_, key);
     }
 
+    std::vector<std::pair<StringView, StringView>> getQueryParams() const {
+        return getParams(queryParams_);
+    }
+
+    std::vector<std::pair<StringView, StringView>> getFormParams() const {
+        return getParams(formParams_);
+    }
+
+    // True for a GET asking to upgrade to a WebSocket, see
+    // Reply::acceptWebSocket().
+    bool isWebSocketUpgrade() const;
+
+    // True for a request asking to upgrade to cleartext HTTP/2.
+    bool isHttp2Upgrade() const;
+
     // check if requestPath_ starts with specified string
     bool startsWith(const std::string &sw) const {
         return requestPath_.rfind(sw, 0) == 0;
@@ -79,17 +93,33 @@ struct Request {
         queryParams_.clear();
         formParams_.clear();
     }
-    Param getParam(const std::vector<std::pair<std::string, std::string>> &params,
-                   const std::string &key) const {
-        auto it = std::find_if(
-            params.begin(), params.end(), [&](const std::pair<std::string, std::string> &param) {
-                return param.first == key;
-            });
-        if (it != params.end()) {
-            return {true, it->second};
+
+    // Undecoded "key=value&.." string, decoded in place on first access.
+    // Params are stored as offsets so a copied Request stays valid.
+    struct LazyParams {
+        struct Range {
+            size_t keyPos_;
+            size_t keySize_;
+            size_t valuePos_;
+            size_t valueSize_;
+        };
+        std::string str_;
+        std::vector<Range> ranges_;
+        bool decoded_ = false;
+
+        void clear() {
+            str_.clear();
+            ranges_.clear();
+            decoded_ = false;
         }
-        return {false, ""};
-    }
+        void decode();
+    };
+
+    // True if the Connection header lists token.
+    bool hasConnectionToken(const std::string &token) const;
+
+    Param getParam(LazyParams &params, const std::string &key) const;
+    std::vector<std::pair<StringView, StringView>> getParams(LazyParams &params) const;
 
     static bool ichar_equals(char a, char b) {
         return std::tolower(static_cast<unsigned char>(a)) ==
@@ -102,6 +132,8 @@ struct Request {
 
     int noInitialBodyBytesReceived_ = -1;
     size_t contentLength_ = 0;
+    mutable LazyParams queryParams_;
+    mutable LazyParams formParams_;
 };
 
 }  // namespace beauty
@@ -1,14 +1,59 @@
 #include <algorithm>
-#include <cctype>
-#include <sstream>
 
 #include "request_decoder.hpp"
+#include "url_decode.hpp"
+#include "url_parser.hpp"
 
 namespace beauty {
 
+namespace {
+
+// An absolute-form target of the http or https scheme, which names the
+// authority to take the Host header from. Other schemes, e.g. "mailto:x",
+// and the authority-form "host:port" of CONNECT are not served.
+bool isHttpTarget(const std::string &uri) {
+    static const char https[] = "https";
+    size_t schemeSize = uri.find(':');
+    if ((schemeSize != 4 && schemeSize != 5) || uri.compare(schemeSize, 3, "://") != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < schemeSize; ++i) {
+        if ((uri[i] | 0x20) != https[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
 bool RequestDecoder::decodeRequest(Request &req, std::vector<char> &content) {
-    // url decode uri
-    urlDecode(req.uri_.begin(), req.uri_.end(), req.requestPath_);
+    // split off the query string before decoding, so an escaped '?' stays in
+    // the path
+    StringView path;
+    StringView query;
+    if (!req.uri_.empty() && req.uri_[0] != '/') {
+        // absolute-form, as sent to proxies, where the target's authority
+        // replaces any Host header
+        if (!isHttpTarget(req.uri_)) {
+            return false;
+        }
+        UrlParser url(req.uri_);
+        if (!url.isValid() || url.hostname().empty() || !url.username().empty()) {
+            return false;
+        }
+        path = url.path();
+        query = url.query();
+        setHost(req, url.authority());
+    } else {
+        size_t pos = req.uri_.find('?');
+        path = StringView(req.uri_.data(), std::min(pos, req.uri_.size()));
+        if (pos != std::string::npos) {
+            query = StringView(req.uri_.data() + pos + 1, req.uri_.size() - pos - 1);
+        }
+    }
+    req.requestPath_.assign(path.data(), path.size());
+    req.requestPath_.resize(urlDecode(&req.requestPath_[0], req.requestPath_.size(), false));
 
     // request path must be absolute and not contain ".."
     if (req.requestPath_.empty() || req.requestPath_[0] != '/' ||
@@ -16,46 +61,26 @@ bool RequestDecoder::decodeRequest(Request &req, std::vector<char> &content) {
         return false;
     }
 
-    // decode the query string
-    std::string queryStr;
-    size_t pos = req.requestPath_.find('?');
-    if (pos != std::string::npos) {
-        keyValDecode(req.requestPath_.substr(pos + 1, std::string::npos), req.queryParams_);
-
-        // remove the query string from path
-        req.requestPath_ = req.requestPath_.substr(0, pos);
-    }
+    // query and form params are decoded when first asked for
+    req.queryParams_.str_.assign(query.data(), query.size());
 
     if (req.method_ != "GET") {
         if (req.getHeaderValue("content-type") == "application/x-www-form-urlencoded") {
-            std::string bodyStr;
-            urlDecode(content.begin(), content.end(), bodyStr);
-            keyValDecode(bodyStr, req.formParams_);
+            req.formParams_.str_.assign(content.begin(), content.end());
         }
     }
 
     return true;
 }
 
-void RequestDecoder::keyValDecode(const std::string &in,
-                                  std::vector<std::pair<std::string, std::string>> &params) {
-    std::string key, val;
-    auto out = &key;
-    for (std::size_t i = 0; i < in.size(); ++i) {
-        if (in[i] == '=') {
-            out = &val;
-        } else if (in[i] == '&') {
-            params.push_back({key, val});
-            out = &key;
-            key.clear();
-            val.clear();
-        } else if (i == in.size() - 1) {
-            *out += in[i];
-            params.push_back({key, val});
-        } else {
-            *out += in[i];
+void RequestDecoder::setHost(Request &req, StringView authority) {
+    for (auto &header : req.headers_) {
+        if (req.iequals(header.name_, "Host")) {
+            header.value_.assign(authority.data(), authority.size());
+            return;
         }
     }
+    req.headers_.push_back({"Host", authority.str()});
 }
 
 }  // namespace beauty
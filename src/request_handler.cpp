@@ -23,6 +23,14 @@ void RequestHandler::setFileNotFoundHandler(const handlerCallback &cb) {
     fileNotFoundCb_ = cb;
 }
 
+void RequestHandler::setRequestObserver(IRequestObserver *observer) {
+    observer_ = observer;
+}
+
+void RequestHandler::setRawUploads(bool enabled) {
+    rawUploads_ = enabled;
+}
+
 void RequestHandler::handleRequest(unsigned connectionId,
                                    const Request &req,
                                    std::vector<char> &content,
@@ -43,8 +51,11 @@ void RequestHandler::handleRequest(unsigned connectionId,
         rep.fileExtension_ = "html";
     }
 
-    for (const auto &requestHandler_ : requestHandlers_) {
-        requestHandler_(req, rep);
+    for (size_t i = 0; i < requestHandlers_.size(); ++i) {
+        requestHandlers_[i](req, rep);
+        BEAUTY_OBSERVE(observer_,
+                       onMiddlewareReturned(
+                           connectionId, i, rep.returnToClient_, IRequestObserver::now()));
         if (rep.returnToClient_) {
             return;
         }
@@ -55,7 +66,9 @@ void RequestHandler::handleRequest(unsigned connectionId,
         return;
     }
 
-    if (req.method_ == "POST") {
+    if (req.method_ == "POST" &&
+        (!rawUploads_ ||
+         req.getHeaderValue("Content-Type").find("multipart") != std::string::npos)) {
         if (rep.multiPartParser_.parseHeader(req)) {
             rep.status_ = Reply::ok;
             rep.isMultiPart_ = true;
@@ -66,6 +79,19 @@ void RequestHandler::handleRequest(unsigned connectionId,
             return;
         }
 
+    } else if (rawUploads_ && (req.method_ == "POST" || req.method_ == "PUT")) {
+        // any other body is written as is to the file at the request path
+        std::string err;
+        rep.isRawUpload_ = true;
+        rep.lastOpenFileForWriteId_ = rep.filePath_ + std::to_string(connectionId);
+        rep.status_ = fileIO_->openFileForWrite(rep.lastOpenFileForWriteId_, req, rep, err);
+        if (rep.status_ != Reply::status_type::ok && rep.status_ != Reply::status_type::created) {
+            rep.lastOpenFileForWriteId_.clear();
+            rep.content_.assign(err.begin(), err.end());
+        }
+        writeRawBody(connectionId, req, content, rep, content.size());
+        return;
+
     } else if (req.method_ == "GET") {
         if (openAndReadFile(connectionId, req, rep) > 0) {
             return;
@@ -79,7 +105,7 @@ void RequestHandler::handleRequest(unsigned connectionId,
 }
 
 void RequestHandler::handlePartialRead(unsigned connectionId, const Request &req, Reply &rep) {
-    size_t nrReadBytes = readFromFile(connectionId, req, rep);
+    size_t nrReadBytes = readFromFile(connectionId, req, rep, rep.maxContentSize_);
 
     if (nrReadBytes < rep.maxContentSize_) {
         rep.finalPart_ = true;
@@ -91,6 +117,11 @@ void RequestHandler::handlePartialWrite(unsigned connectionId,
                                         const Request &req,
                                         std::vector<char> &content,
                                         Reply &rep) {
+    if (rep.isRawUpload_) {
+        writeRawBody(connectionId, req, content, rep, rep.noBodyBytesReceived_);
+        return;
+    }
+
     std::deque<MultiPartParser::ContentPart> parts;
     MultiPartParser::result_type result = rep.multiPartParser_.parse(req, content, parts);
 
@@ -101,11 +132,6 @@ void RequestHandler::handlePartialWrite(unsigned connectionId,
 
     writeFileParts(connectionId, req, rep, parts);
 
-    if (result == MultiPartParser::result_type::done) {
-        rep.multiPartParser_.flush(content, parts);
-        writeFileParts(connectionId, req, rep, parts);
-    }
-
     // done with content unless there's 'bad' messages that should be return to
     // client
     if (rep.status_ == Reply::status_type::ok) {
@@ -122,11 +148,13 @@ void RequestHandler::closeFile(Reply &rep, unsigned connectionId) {
 bool RequestHandler::openAndReadFile(unsigned connectionId, const Request &req, Reply &rep) {
     // open the file to send back
     size_t contentSize = fileIO_->openFileForRead(std::to_string(connectionId), req, rep);
+    BEAUTY_OBSERVE(observer_, onFileOpened(connectionId, contentSize, IRequestObserver::now()));
     if (contentSize > 0) {
         // fill initial content
         rep.replyPartial_ = contentSize > rep.maxContentSize_;
         rep.status_ = Reply::ok;
-        readFromFile(connectionId, req, rep);
+        // a file that fits is read into a buffer of its own size
+        readFromFile(connectionId, req, rep, rep.replyPartial_ ? rep.maxContentSize_ : contentSize);
         if (!rep.replyPartial_) {
             // all data fits in initial content
             fileIO_->closeReadFile(std::to_string(connectionId));
@@ -138,7 +166,8 @@ bool RequestHandler::openAndReadFile(unsigned connectionId, const Request &req,
             rep.headers_[0].name_ = "Content-Length";
             rep.headers_[0].value_ = std::to_string(contentSize);
             rep.headers_[1].name_ = "Content-Type";
-            rep.headers_[1].value_ = mime_types::extensionToType(rep.fileExtension_);
+            StringView type = mime_types::extensionToType(rep.fileExtension_);
+            rep.headers_[1].value_.assign(type.data(), type.size());
         } else {
             rep.addHeader("Content-Length", std::to_string(contentSize));
         }
@@ -147,31 +176,67 @@ bool RequestHandler::openAndReadFile(unsigned connectionId, const Request &req,
     return false;
 }
 
-size_t RequestHandler::readFromFile(unsigned connectionId, const Request &req, Reply &rep) {
-    rep.content_.resize(rep.maxContentSize_);
+size_t RequestHandler::readFromFile(unsigned connectionId,
+                                    const Request &req,
+                                    Reply &rep,
+                                    size_t size) {
+    rep.content_.resize(size);
     int nrReadBytes = fileIO_->readFile(
         std::to_string(connectionId), req, rep.content_.data(), rep.content_.size());
     rep.content_.resize(nrReadBytes);
     return nrReadBytes;
 }
 
+void RequestHandler::writeRawBody(unsigned connectionId,
+                                  const Request &req,
+                                  std::vector<char> &content,
+                                  Reply &rep,
+                                  size_t received) {
+    // bytes past the body belong to a pipelined request, which is not
+    // supported
+    size_t size = content.size();
+    if (received > req.contentLength_) {
+        size -= std::min(size, received - req.contentLength_);
+    }
+    bool lastData = received >= req.contentLength_;
+
+    // after a failed open or write the rest of the body is only drained
+    if (!rep.lastOpenFileForWriteId_.empty() && (size > 0 || lastData)) {
+        std::string err;
+        Reply::status_type status =
+            fileIO_->writeFile(rep.lastOpenFileForWriteId_, req, content.data(), size, lastData, err);
+        if (status != Reply::status_type::ok && status != Reply::status_type::created) {
+            rep.status_ = status;
+            rep.lastOpenFileForWriteId_.clear();
+            rep.content_.assign(err.begin(), err.end());
+        } else if (lastData) {
+            rep.lastOpenFileForWriteId_.clear();
+        }
+    }
+
+    if (lastData) {
+        if (rep.content_.empty()) {
+            rep.send(rep.status_);
+        } else {
+            rep.send(rep.status_, "text/plain");
+        }
+    }
+}
+
 void RequestHandler::writeFileParts(unsigned connectionId,
                                     const Request &req,
                                     Reply &rep,
                                     std::deque<MultiPartParser::ContentPart> &parts) {
     // It seems that most clients first deliver a "headerOnly" part of the multipart
     // asking for confirmation and then in successive request deliver the part
-    // data. If so, we handle this nicely here by giving the client an
-    // headerOnly response of the openFileForWrite() response. However this
-    // requires "peaking" the last part as the MultiPartParser delivers parts
-    // one request too late.
-    const std::deque<MultiPartParser::ContentPart> &peakParts = rep.multiPartParser_.peakLastPart();
-    for (auto &part : peakParts) {
-        if (part.headerOnly_ && !part.filename_.empty()) {
+    // data. The parser returns a part as soon as its headers are parsed, so
+    // the client gets the openFileForWrite() response right away.
+    for (auto &part : parts) {
+        std::string err;
+        if (!part.filename_.empty()) {
             rep.filePath_ = req.requestPath_ + part.filename_;
-            std::string err;
-            rep.status_ = fileIO_->openFileForWrite(
-                rep.filePath_ + std::to_string(connectionId), req, rep, err);
+            rep.lastOpenFileForWriteId_ = rep.filePath_ + std::to_string(connectionId);
+            rep.status_ = fileIO_->openFileForWrite(rep.lastOpenFileForWriteId_, req, rep, err);
             rep.multiPartCounter_++;
             if (rep.status_ != Reply::status_type::ok &&
                 rep.status_ != Reply::status_type::created) {
@@ -179,42 +244,20 @@ void RequestHandler::writeFileParts(unsigned connectionId,
                 return;
             }
         }
-    }
-
-    // This loop do the actual writing of data to files in sucessive order.
-    for (auto &part : parts) {
-        std::string err;
-        // if 'headerOnly' it as already been handled above
-        if (part.headerOnly_ && !part.filename_.empty()) {
-            std::string filePath = req.requestPath_ + part.filename_;
-            rep.lastOpenFileForWriteId_ = filePath + std::to_string(connectionId);
-        } else {
-            if (!part.filename_.empty()) {
-                // In case client did not issue "headerOnly", its OK, we open
-                // the file for writing here. However as we are one request too
-                // late, the response will be late too.
-                rep.filePath_ = req.requestPath_ + part.filename_;
-                rep.lastOpenFileForWriteId_ = rep.filePath_ + std::to_string(connectionId);
-                rep.status_ = fileIO_->openFileForWrite(rep.lastOpenFileForWriteId_, req, rep, err);
-                rep.multiPartCounter_++;
-                if (rep.status_ != Reply::status_type::ok &&
-                    rep.status_ != Reply::status_type::created) {
-                    rep.content_.insert(rep.content_.begin(), err.begin(), err.end());
-                    return;
-                }
-            }
-            size_t size = part.end_ - part.start_;
-            rep.status_ = fileIO_->writeFile(
-                rep.lastOpenFileForWriteId_, req, &(*part.start_), size, part.foundEnd_, err);
-            if (rep.status_ != Reply::status_type::ok &&
-                rep.status_ != Reply::status_type::created) {
-                rep.lastOpenFileForWriteId_.clear();
-                rep.content_.insert(rep.content_.begin(), err.begin(), err.end());
-                return;
-            }
-            if (part.foundEnd_) {
-                rep.lastOpenFileForWriteId_.clear();
-            }
+        if (part.headerOnly_ && !part.foundEnd_) {
+            continue;
+        }
+        size_t size = part.end_ - part.start_;
+        rep.status_ = fileIO_->writeFile(rep.lastOpenFileForWriteId_, req,
+                                         size > 0 ? &(*part.start_) : nullptr, size,
+                                         part.foundEnd_, err);
+        if (rep.status_ != Reply::status_type::ok && rep.status_ != Reply::status_type::created) {
+            rep.lastOpenFileForWriteId_.clear();
+            rep.content_.insert(rep.content_.begin(), err.begin(), err.end());
+            return;
+        }
+        if (part.foundEnd_) {
+            rep.lastOpenFileForWriteId_.clear();
         }
     }
 }
@@ -3,6 +3,7 @@
 #include "beauty_common.hpp"
 #include "multipart_parser.hpp"
 #include "i_file_io.hpp"
+#include "i_request_observer.hpp"
 #include "reply.hpp"
 #include "request.hpp"
 
@@ -22,6 +23,11 @@ class RequestHandler {
     // Handlers to be optionally implemented.
     void addRequestHandler(const handlerCallback &cb);
     void setFileNotFoundHandler(const handlerCallback &cb);
+    void setRequestObserver(IRequestObserver *observer);
+
+    // Write the body of a PUT, or of a POST that is not multipart, to the
+    // file at the request path. Off by default.
+    void setRawUploads(bool enabled);
 
     void handleRequest(unsigned connectionId,
                        const Request &req,
@@ -36,7 +42,14 @@ class RequestHandler {
 
    private:
     bool openAndReadFile(unsigned connectionId, const Request &req, Reply &rep);
-    size_t readFromFile(unsigned connectionId, const Request &req, Reply &rep);
+    size_t readFromFile(unsigned connectionId, const Request &req, Reply &rep, size_t size);
+    // Write a chunk of a non-multipart body to the file opened in
+    // handleRequest. received is the number of body bytes received so far.
+    void writeRawBody(unsigned connectionId,
+                      const Request &req,
+                      std::vector<char> &content,
+                      Reply &rep,
+                      size_t received);
     void writeFileParts(unsigned connectionId,
                         const Request &req,
                         Reply &rep,
@@ -50,6 +63,11 @@ class RequestHandler {
 
     // Callback to handle post file access, e.g. a custom not found handler.
     handlerCallback fileNotFoundCb_;
+
+    // Optional observer of request lifecycle events.
+    IRequestObserver *observer_ = nullptr;
+
+    bool rawUploads_ = false;
 };
 
 }  // namespace beauty
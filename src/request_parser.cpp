@@ -7,22 +7,30 @@
 
 namespace beauty {
 
-RequestParser::RequestParser() : state_(method_start) {}
+RequestParser::RequestParser(size_t maxHeadSize)
+    : state_(method_start), maxHeadSize_(maxHeadSize) {}
 
 void RequestParser::reset() {
     state_ = method_start;
+    headSize_ = 0;
+    contentLength_ = 0;
 }
 
 RequestParser::result_type RequestParser::parse(Request &req, std::vector<char> &content) {
     auto begin = content.begin();
     auto end = content.end();
     while (begin != end) {
+        if (state_ != post && ++headSize_ > maxHeadSize_) {
+            return bad;
+        }
         result_type result = consume(req, content, *begin++);
         if (result != indeterminate) {
             return result;
         }
     }
-    return good_part;
+    // an incomplete head is resumed by the next call, only body data
+    // continues outside the parser
+    return state_ == post ? good_part : indeterminate;
 }
 
 RequestParser::result_type RequestParser::consume(Request &req,
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <limits>
 #include <vector>
 
 namespace beauty {
@@ -9,7 +11,9 @@ struct Request;
 // Parser for incoming requests.
 class RequestParser {
    public:
-    RequestParser();
+    // A head, i.e. the request line and headers, larger than maxHeadSize is
+    // bad, as it is accumulated over reads.
+    explicit RequestParser(size_t maxHeadSize = std::numeric_limits<size_t>::max());
 
     // Reset to initial parser state.
     void reset();
@@ -17,9 +21,10 @@ class RequestParser {
     // Result of parse.
     enum result_type { good_complete, good_part, bad, indeterminate };
 
-    // Parse some data. The enum return value is good when a complete request
-    // has been parsed, bad if the data is invalid, good_part when more
-    // data is required.
+    // Parse some data. The enum return value is good_complete when a complete
+    // request has been parsed, bad if the data is invalid, good_part when the
+    // head is parsed but more body data is required and indeterminate when
+    // more data is required to complete the head.
     result_type parse(Request &req, std::vector<char> &content);
 
    private:
@@ -53,6 +58,9 @@ class RequestParser {
     } state_;
 
     std::size_t contentLength_ = 0;
+
+    const std::size_t maxHeadSize_;
+    std::size_t headSize_ = 0;
 };
 
 }  // namespace beauty
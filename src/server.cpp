@@ -1,27 +1,146 @@
 #include <signal.h>
 #include <chrono>
+#include <cstring>
 #include <utility>
 
 #include "server.hpp"
+#include "socket_option.hpp"
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 
 namespace beauty {
 
+namespace {
+
+// Bounds the drain after a handoff when no drain timeout is set.
+const std::chrono::seconds defaultHandoffDrainTimeout(30);
+
+// A client rejected by admission control or the rate limit. The socket is
+// kept open until the client has sent its request, as closing with unread
+// data sends a reset that may discard the 503 or 429 reply at the client.
+struct RejectedConnection {
+    RejectedConnection(ConnectionSocket::socket_type socket)
+        : socket_(std::move(socket)), timer_(socket_.get_executor()) {}
+
+    ConnectionSocket::socket_type socket_;
+    asio::steady_timer timer_;
+    char discard_[256];
+};
+
+void drainRejected(std::shared_ptr<RejectedConnection> rejected) {
+    rejected->socket_.async_read_some(asio::buffer(rejected->discard_),
+                                      [rejected](std::error_code ec, std::size_t) {
+                                          if (!ec) {
+                                              drainRejected(rejected);
+                                          } else {
+                                              rejected->timer_.cancel();
+                                          }
+                                      });
+}
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+// Unlink a Unix domain socket left at path by an earlier server, which would
+// fail the bind. Anything else at path is kept and described in error.
+bool removeStaleSocket(const std::string &path, std::string &error) {
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        error = path + ": exists and is not a socket";
+        return false;
+    }
+    if (unlink(path.c_str()) != 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+#endif
+
+// Set an option if it is supported, the server runs without it otherwise.
+template <typename Socket, typename Option>
+void setOption(Socket &socket, const Option &option) {
+    std::error_code ignored_ec;
+    socket.set_option(option, ignored_ec);
+}
+
+// Apply the options of accepted TCP sockets.
+void configureSocket(ConnectionSocket::socket_type &socket, const SocketOptions &options) {
+    if (options.noDelay_) {
+        setOption(socket, asio::ip::tcp::no_delay(true));
+    }
+    if (options.tcpKeepAliveIdle_.count() > 0) {
+        setOption(socket, asio::socket_base::keep_alive(true));
+#if defined(TCP_KEEPIDLE)
+        setOption(socket, keep_alive_idle(static_cast<int>(options.tcpKeepAliveIdle_.count())));
+#endif
+#if defined(TCP_KEEPINTVL)
+        if (options.tcpKeepAliveInterval_.count() > 0) {
+            setOption(socket,
+                      keep_alive_interval(static_cast<int>(options.tcpKeepAliveInterval_.count())));
+        }
+#endif
+#if defined(TCP_KEEPCNT)
+        if (options.tcpKeepAliveProbes_ > 0) {
+            setOption(socket, keep_alive_probes(options.tcpKeepAliveProbes_));
+        }
+#endif
+    }
+}
+
+// The TCP endpoint held by a generic endpoint, false for other protocols.
+bool toTcpEndpoint(const asio::generic::stream_protocol::endpoint &endpoint,
+                   asio::ip::tcp::endpoint &tcpEndpoint) {
+    int family = endpoint.protocol().family();
+    if ((family != asio::ip::tcp::v4().family() && family != asio::ip::tcp::v6().family()) ||
+        endpoint.size() > tcpEndpoint.capacity()) {
+        return false;
+    }
+    std::memcpy(tcpEndpoint.data(), endpoint.data(), endpoint.size());
+    tcpEndpoint.resize(endpoint.size());
+    return true;
+}
+
+}  // namespace
+
 Server::Server(asio::io_context &ioContext,
                uint16_t port,
                IFileIO *fileIO,
                HttpPersistence options,
-               size_t maxContentSize)
-    : acceptor_(ioContext, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)),
-      connectionManager_(options),
+               size_t maxContentSize,
+               SocketOptions socketOptions)
+    : connectionManager_(options, maxContentSize),
       requestHandler_(fileIO),
       timer_(ioContext),
+      drainTimer_(ioContext),
       maxContentSize_(maxContentSize),
-      debugMsgCb_(defaultDebugMsgHandler) {
+      socketOptions_(socketOptions) {
+    listen(ioContext,
+           acceptor_type::endpoint_type(asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)),
+           true);
+    connectionManager_.setConnectionsClosedHandler([this] {
+        resumeAccept();
+        if (draining_) {
+            continueDrain();
+        }
+    });
     if (maxContentSize < 1024) {
-        debugMsgCb_("maxContentSize must be equal or larger than 1024 bytes");
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::error,
+                   "maxContentSize must be equal or larger than 1024 bytes");
         return;
     }
-    doAccept();
+    doAccept(*acceptors_.front());
     doTick();
 }
 
@@ -30,13 +149,34 @@ Server::Server(asio::io_context &ioContext,
                const std::string &port,
                IFileIO *fileIO,
                HttpPersistence options,
-               size_t maxContentSize)
-    : acceptor_(ioContext),
-      connectionManager_(options),
+               size_t maxContentSize,
+               SocketOptions socketOptions)
+    : Server(ioContext,
+             std::vector<Listener>(1, Listener(address, port)),
+             fileIO,
+             options,
+             maxContentSize,
+             socketOptions) {}
+
+Server::Server(asio::io_context &ioContext,
+               const std::vector<Listener> &listeners,
+               IFileIO *fileIO,
+               HttpPersistence options,
+               size_t maxContentSize,
+               SocketOptions socketOptions)
+    : connectionManager_(options, maxContentSize),
       requestHandler_(fileIO),
       timer_(ioContext),
+      drainTimer_(ioContext),
       maxContentSize_(maxContentSize),
-      debugMsgCb_(defaultDebugMsgHandler) {
+      socketOptions_(socketOptions) {
+    connectionManager_.setConnectionsClosedHandler([this] {
+        resumeAccept();
+        if (draining_) {
+            continueDrain();
+        }
+    });
+
     // Register to handle the signals that indicate when the server should exit.
     // It is safe to register for the same signal multiple times in a program,
     // provided all registration for the specified signal is made through Asio.
@@ -48,26 +188,122 @@ Server::Server(asio::io_context &ioContext,
 #endif  // defined(SIGQUIT)
 
     if (maxContentSize < 1024) {
-        debugMsgCb_("maxContentSize must be equal or larger than 1024 bytes");
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::error,
+                   "maxContentSize must be equal or larger than 1024 bytes");
         return;
     }
     doAwaitStop();
 
-    // Open the acceptor with the option to reuse the address (i.e.
-    // SO_REUSEADDR).
-    asio::ip::tcp::resolver resolver(ioContext);
-    asio::ip::tcp::endpoint endpoint = *resolver.resolve(address, port).begin();
-    acceptor_.open(endpoint.protocol());
-    acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true));
-    acceptor_.bind(endpoint);
-    acceptor_.listen();
-
-    doAccept();
+    for (const Listener &listener : listeners) {
+        listen(ioContext, listener);
+    }
+    for (auto &acceptor : acceptors_) {
+        doAccept(*acceptor);
+    }
     doTick();
 }
 
 uint16_t Server::getBindedPort() const {
-    return acceptor_.local_endpoint().port();
+    for (const auto &acceptor : acceptors_) {
+        asio::ip::tcp::endpoint endpoint;
+        if (toTcpEndpoint(acceptor->acceptor_.local_endpoint(), endpoint)) {
+            return endpoint.port();
+        }
+    }
+    return 0;
+}
+
+void Server::listen(asio::io_context &ioContext, const Listener &listener) {
+    if (listener.type_ == Listener::descriptor) {
+        adopt(ioContext, listener.descriptor_);
+        return;
+    }
+    if (listener.type_ == Listener::unix_socket) {
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+        std::string error;
+        if (!removeStaleSocket(listener.address_, error)) {
+            BEAUTY_LOG(connectionManager_.logger(), LogLevel::error, "listen: " + error);
+            return;
+        }
+        listen(ioContext, asio::local::stream_protocol::endpoint(listener.address_), false);
+#else
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::error,
+                   "Unix domain sockets are not supported: " + listener.address_);
+#endif
+        return;
+    }
+    asio::ip::tcp::resolver resolver(ioContext);
+    listen(ioContext, *resolver.resolve(listener.address_, listener.port_).begin(), true);
+}
+
+void Server::listen(asio::io_context &ioContext,
+                    const acceptor_type::endpoint_type &endpoint,
+                    bool tcp) {
+    std::unique_ptr<Acceptor> acceptor(new Acceptor(ioContext, tcp));
+    acceptor_type &socket = acceptor->acceptor_;
+    socket.open(endpoint.protocol());
+    if (tcp) {
+        // Open the acceptor with the option to reuse the address (i.e.
+        // SO_REUSEADDR).
+        socket.set_option(asio::socket_base::reuse_address(true));
+        // accepted sockets inherit the buffer sizes, which must be known
+        // before the handshake to scale the receive window
+        if (socketOptions_.sendBufferSize_ > 0) {
+            setOption(socket, asio::socket_base::send_buffer_size(socketOptions_.sendBufferSize_));
+        }
+        if (socketOptions_.receiveBufferSize_ > 0) {
+            setOption(socket,
+                      asio::socket_base::receive_buffer_size(socketOptions_.receiveBufferSize_));
+        }
+#if defined(TCP_DEFER_ACCEPT)
+        if (socketOptions_.deferAccept_.count() > 0) {
+            setOption(socket, defer_accept(static_cast<int>(socketOptions_.deferAccept_.count())));
+        }
+#endif
+#if defined(TCP_FASTOPEN)
+        if (socketOptions_.fastOpenQueue_ > 0) {
+            setOption(socket, fast_open(socketOptions_.fastOpenQueue_));
+        }
+#endif
+    }
+    socket.bind(endpoint);
+    int backlog = socketOptions_.listenBacklog_ > 0 ? socketOptions_.listenBacklog_
+                                                    : asio::socket_base::max_listen_connections;
+    socket.listen(backlog);
+    addAcceptor(std::move(acceptor));
+}
+
+void Server::adopt(asio::io_context &ioContext, int fd) {
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    // the protocol of the socket, which accepted sockets inherit
+    sockaddr_storage address;
+    socklen_t size = sizeof(address);
+    if (::getsockname(fd, reinterpret_cast<sockaddr *>(&address), &size) != 0) {
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::error,
+                   "adopt: not a socket: " + std::to_string(fd));
+        return;
+    }
+    bool tcp = address.ss_family != AF_UNIX;
+    std::unique_ptr<Acceptor> acceptor(new Acceptor(ioContext, tcp));
+    acceptor->acceptor_.assign(
+        asio::generic::stream_protocol(address.ss_family, tcp ? IPPROTO_TCP : 0), fd);
+    addAcceptor(std::move(acceptor));
+#else
+    BEAUTY_LOG(connectionManager_.logger(),
+               LogLevel::error,
+               "adopt: listening descriptors are not supported: " + std::to_string(fd));
+#endif
+}
+
+void Server::addAcceptor(std::unique_ptr<Acceptor> acceptor) {
+    if (socketOptions_.acceptBatch_ > 1) {
+        // batched accepts return would_block once the backlog is drained
+        acceptor->acceptor_.non_blocking(true);
+    }
+    acceptors_.push_back(std::move(acceptor));
 }
 
 void Server::addRequestHandler(const handlerCallback &cb) {
@@ -80,37 +316,379 @@ void Server::setFileNotFoundHandler(const handlerCallback &cb) {
 
 void Server::setDebugMsgHandler(const debugMsgCallback &cb) {
     connectionManager_.setDebugMsgHandler(cb);
-    debugMsgCb_ = cb;
 }
 
-void Server::doAccept() {
-    acceptor_.async_accept([this](std::error_code ec, asio::ip::tcp::socket socket) {
+void Server::setLogSink(ILogSink *sink) {
+    connectionManager_.logger().setSink(sink);
+}
+
+void Server::setRequestObserver(IRequestObserver *observer) {
+    requestHandler_.setRequestObserver(observer);
+    requestObserver_ = observer;
+}
+
+void Server::setAdmissionControl(AdmissionControl admission) {
+    // a connection starts with the smallest receive and reply buffers
+    connectionManager_.setAdmissionControl(admission, 2 * bufferSizeClass(0, maxContentSize_));
+    serviceUnavailableReply_ =
+        "HTTP/1.0 503 Service Unavailable\r\nRetry-After: " +
+        std::to_string(admission.retryAfter_.count()) +
+        "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+}
+
+void Server::setHttp2(Http2Options options) {
+    connectionManager_.setHttp2Options(options);
+#ifdef BEAUTY_ENABLE_TLS
+    if (tlsContext_) {
+        tlsContext_->setHttp2(options.enabled_);
+    }
+#endif
+}
+
+void Server::setConnectionTimeouts(ConnectionTimeouts timeouts) {
+    connectionManager_.setConnectionTimeouts(timeouts);
+}
+
+void Server::setRateLimit(RateLimit limit) {
+    connectionManager_.setRateLimit(limit);
+}
+
+RateLimiter::Stats Server::getRateLimitStats() const {
+    if (!connectionManager_.rateLimiter()) {
+        return RateLimiter::Stats();
+    }
+    return connectionManager_.rateLimiter()->getStats();
+}
+
+#ifdef BEAUTY_ENABLE_TLS
+bool Server::setTls(const TlsOptions &options) {
+    std::unique_ptr<TlsContext> context(new TlsContext());
+    std::string error;
+    if (!context->load(options, error)) {
+        BEAUTY_LOG(connectionManager_.logger(), LogLevel::error, "setTls: " + error);
+        return false;
+    }
+    context->setHttp2(connectionManager_.http2Options().enabled_);
+    tlsContext_ = std::move(context);
+    connectionManager_.setTlsContext(tlsContext_.get());
+    return true;
+}
+
+TlsContext::Stats Server::getTlsStats() const {
+    if (!tlsContext_) {
+        return TlsContext::Stats();
+    }
+    return tlsContext_->getStats();
+}
+#endif
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+bool Server::enableHandoff(const std::string &path) {
+    std::error_code ec;
+    std::unique_ptr<asio::local::stream_protocol::acceptor> acceptor(
+        new asio::local::stream_protocol::acceptor(timer_.get_executor()));
+    std::string error;
+    if (!removeStaleSocket(path, error)) {
+        BEAUTY_LOG(connectionManager_.logger(), LogLevel::error, "enableHandoff: " + error);
+        return false;
+    }
+    asio::local::stream_protocol::endpoint endpoint(path);
+    acceptor->open(endpoint.protocol(), ec);
+    if (!ec) {
+        acceptor->bind(endpoint, ec);
+    }
+    if (!ec) {
+        acceptor->listen(asio::socket_base::max_listen_connections, ec);
+    }
+    if (ec) {
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::error,
+                   "enableHandoff: " + path + ": " + ec.message());
+        return false;
+    }
+    handoffAcceptor_ = std::move(acceptor);
+    doAwaitHandoff();
+    return true;
+}
+
+void Server::doAwaitHandoff() {
+    handoffAcceptor_->async_accept([this](std::error_code ec,
+                                          asio::local::stream_protocol::socket socket) {
+        if (ec) {
+            return;
+        }
+        std::vector<int> fds;
+        for (const auto &acceptor : acceptors_) {
+            if (acceptor->acceptor_.is_open()) {
+                fds.push_back(acceptor->acceptor_.native_handle());
+            }
+        }
+        std::string error;
+        if (!sendListeners(socket.native_handle(), fds, error)) {
+            BEAUTY_LOG(connectionManager_.logger(), LogLevel::error, "handoff: " + error);
+            doAwaitHandoff();
+            return;
+        }
+        // the message is formatted later, maybe on another thread
+        size_t connections = connectionManager_.getNrOfConnections();
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::info,
+                   "Listeners handed off, draining " + std::to_string(connections) +
+                       " connections");
+        handoffAcceptor_->close();
+        drain();
+    });
+}
+#endif
+
+void Server::setDrainTimeout(std::chrono::seconds timeout) {
+    drainTimeout_ = timeout;
+}
+
+ConnectionManager::DrainReport Server::getDrainReport() const {
+    return connectionManager_.getDrainReport();
+}
+
+void Server::setRawUploads(bool enabled) {
+    requestHandler_.setRawUploads(enabled);
+}
+
+void Server::setBufferPoolSize(size_t maxFreeBytes) {
+    connectionManager_.bufferPool().setMaxFreeBytes(maxFreeBytes);
+}
+
+BufferPool::Stats Server::getBufferPoolStats() const {
+    return connectionManager_.bufferPool().getStats();
+}
+
+void Server::doAccept(Acceptor &acceptor) {
+    if (!connectionManager_.hasCapacity() &&
+        connectionManager_.admissionControl().policy_ == AdmissionControl::pause_accept) {
+        doAwaitClient(acceptor);
+        return;
+    }
+
+    acceptor.acceptor_.async_accept([this, &acceptor](std::error_code ec,
+                                                      ConnectionSocket::socket_type socket) {
         // Check whether the server was stopped by a signal before this
         // completion handler had a chance to run.
-        if (!acceptor_.is_open()) {
+        if (!acceptor.acceptor_.is_open()) {
             return;
         }
 
         if (!ec) {
-            connectionManager_.start(std::make_shared<Connection>(std::move(socket),
-                                                                  connectionManager_,
-                                                                  requestHandler_,
-                                                                  connectionId_++,
-                                                                  maxContentSize_));
+            acceptConnection(acceptor, std::move(socket));
+            acceptBatch(acceptor);
         } else {
-            debugMsgCb_("doAccept: " + ec.message() + ":" + std::to_string(ec.value()));
+            BEAUTY_LOG(connectionManager_.logger(),
+                       LogLevel::error,
+                       "doAccept: " + ec.message() + ":" + std::to_string(ec.value()));
         }
 
-        doAccept();
+        doAccept(acceptor);
     });
 }
 
+void Server::acceptBatch(Acceptor &acceptor) {
+    for (size_t n = 1; n < socketOptions_.acceptBatch_; ++n) {
+        if (!connectionManager_.hasCapacity() &&
+            connectionManager_.admissionControl().policy_ == AdmissionControl::pause_accept) {
+            return;
+        }
+        std::error_code ec;
+        ConnectionSocket::socket_type socket(acceptor.acceptor_.get_executor());
+        acceptor.acceptor_.accept(socket, ec);
+        if (ec) {
+            // would_block, the backlog is drained
+            return;
+        }
+        acceptConnection(acceptor, std::move(socket));
+    }
+}
+
+void Server::acceptConnection(Acceptor &acceptor, ConnectionSocket::socket_type socket) {
+    if (acceptor.tcp_) {
+        configureSocket(socket, socketOptions_);
+    }
+    int rateLimitSlot = -1;
+    RateLimiter *rateLimiter = connectionManager_.rateLimiter();
+    asio::ip::tcp::endpoint remote;
+    std::error_code ec;
+    auto endpoint = socket.remote_endpoint(ec);
+    if (rateLimiter && !ec && toTcpEndpoint(endpoint, remote) &&
+        rateLimiter->acquire(RateLimiter::key(remote.address()),
+                             std::chrono::steady_clock::now(),
+                             rateLimitSlot) != RateLimiter::allowed) {
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::warning,
+                   "Rejecting connection, " + remote.address().to_string() +
+                       " over rate limit");
+        rejectConnection(std::move(socket), rateLimiter->reply());
+        return;
+    }
+    if (!connectionManager_.makeRoom()) {
+        if (rateLimiter) {
+            rateLimiter->release(rateLimitSlot);
+        }
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::warning,
+                   "Rejecting connection, server at capacity");
+        rejectConnection(std::move(socket), serviceUnavailableReply_);
+        return;
+    }
+    auto connection = std::make_shared<Connection>(std::move(socket),
+                                                   connectionManager_,
+                                                   requestHandler_,
+                                                   connectionId_++,
+                                                   maxContentSize_,
+                                                   requestObserver_);
+    connection->setRateLimitSlot(rateLimitSlot);
+    connection->setQuickAck(acceptor.tcp_ && socketOptions_.quickAck_);
+    connectionManager_.start(connection);
+}
+
+void Server::doAwaitClient(Acceptor &acceptor) {
+    // Wait for a client without accepting it, then try to make room by
+    // evicting an idle connection.
+    acceptor.acceptor_.async_wait(
+        asio::socket_base::wait_read, [this, &acceptor](std::error_code ec) {
+            if (!acceptor.acceptor_.is_open() || ec) {
+                return;
+            }
+            if (connectionManager_.makeRoom()) {
+                doAccept(acceptor);
+            } else {
+                BEAUTY_LOG(connectionManager_.logger(),
+                           LogLevel::warning,
+                           "Accept paused, server at capacity");
+                acceptor.paused_ = true;
+            }
+        });
+}
+
+void Server::resumeAccept() {
+    for (auto &acceptor : acceptors_) {
+        if (acceptor->paused_ && acceptor->acceptor_.is_open()) {
+            acceptor->paused_ = false;
+            doAccept(*acceptor);
+        }
+    }
+}
+
+void Server::rejectConnection(ConnectionSocket::socket_type socket, const std::string &reply) {
+#ifdef BEAUTY_ENABLE_TLS
+    if (tlsContext_) {
+        // a TLS client cannot read the cleartext reply
+        std::error_code ignored_ec;
+        socket.close(ignored_ec);
+        return;
+    }
+#endif
+    auto rejected = std::make_shared<RejectedConnection>(std::move(socket));
+    asio::async_write(rejected->socket_,
+                      asio::buffer(reply),
+                      [rejected](std::error_code ec, std::size_t) {
+                          if (ec) {
+                              return;
+                          }
+                          std::error_code ignored_ec;
+                          rejected->socket_.shutdown(asio::socket_base::shutdown_send,
+                                                     ignored_ec);
+                          rejected->timer_.expires_after(std::chrono::seconds(1));
+                          rejected->timer_.async_wait([rejected](std::error_code) {
+                              std::error_code ignored_ec;
+                              rejected->socket_.close(ignored_ec);
+                          });
+                          drainRejected(rejected);
+                      });
+}
+
 void Server::doAwaitStop() {
-    signals_->async_wait([this](std::error_code /*ec*/, int /*signo*/) {
-        timer_.cancel();
-        acceptor_.close();
-        connectionManager_.stopAll();
+    signals_->async_wait([this](std::error_code ec, int /*signo*/) {
+        if (ec) {
+            return;
+        }
+        if (!draining_ && drainTimeout_.count() > 0) {
+            // the message is formatted later, maybe on another thread
+            size_t connections = connectionManager_.getNrOfConnections();
+            BEAUTY_LOG(connectionManager_.logger(),
+                       LogLevel::info,
+                       "Stop requested, draining " + std::to_string(connections) +
+                           " connections");
+            drain();
+            if (!stopped_) {
+                // a second signal stops at once
+                doAwaitStop();
+            }
+            return;
+        }
+        stop();
+    });
+}
+
+void Server::drain() {
+    draining_ = true;
+    // clients still in the backlog are accepted by the new server
+    for (auto &acceptor : acceptors_) {
+        std::error_code ignored_ec;
+        acceptor->acceptor_.close(ignored_ec);
+    }
+    // a handoff drains also without a drain timeout, but never forever
+    drainTimer_.expires_after(drainTimeout_.count() > 0 ? drainTimeout_
+                                                        : defaultHandoffDrainTimeout);
+    drainTimer_.async_wait([this](std::error_code ec) {
+        if (!ec) {
+            BEAUTY_LOG(connectionManager_.logger(), LogLevel::warning, "Drain timeout");
+            stop();
+        }
     });
+    connectionManager_.drain();
+    continueDrain();
+}
+
+void Server::continueDrain() {
+    if (!stopped_ && connectionManager_.getNrOfConnections() == 0) {
+        BEAUTY_LOG(connectionManager_.logger(), LogLevel::info, "Drained, stopping");
+        stop();
+    }
+}
+
+void Server::stop() {
+    if (stopped_) {
+        return;
+    }
+    stopped_ = true;
+    timer_.cancel();
+    drainTimer_.cancel();
+    if (signals_) {
+        signals_->cancel();
+    }
+    for (auto &acceptor : acceptors_) {
+        std::error_code ignored_ec;
+        acceptor->acceptor_.close(ignored_ec);
+    }
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    if (handoffAcceptor_) {
+        std::error_code ignored_ec;
+        handoffAcceptor_->close(ignored_ec);
+    }
+#endif
+    connectionManager_.stopAll();
+
+    const ConnectionManager::DrainReport &report = connectionManager_.getDrainReport();
+    size_t cut = report.cutRequests_ + report.cutUploads_ + report.cutDownloads_ +
+                 report.cutWebSockets_ + report.cutHttp2_;
+    if (cut > 0) {
+        BEAUTY_LOG(connectionManager_.logger(),
+                   LogLevel::warning,
+                   "Stopped with " + std::to_string(cut) + " of " +
+                       std::to_string(report.inFlight_) + " connections in flight cut: " +
+                       std::to_string(report.cutRequests_) + " requests, " +
+                       std::to_string(report.cutUploads_) + " uploads, " +
+                       std::to_string(report.cutDownloads_) + " downloads, " +
+                       std::to_string(report.cutWebSockets_) + " websockets, " +
+                       std::to_string(report.cutHttp2_) + " http2");
+    }
 }
 
 void Server::doTick() {
@@ -118,6 +696,14 @@ void Server::doTick() {
     timer_.async_wait([this](std::error_code ec) {
         if (!ec) {
             connectionManager_.tick();
+            if (draining_) {
+                continueDrain();
+                if (connectionManager_.getNrOfConnections() == 0) {
+                    return;
+                }
+            }
+            // idle connections may have appeared that can be evicted
+            resumeAccept();
 
             doTick();
         }
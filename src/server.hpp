@@ -5,12 +5,17 @@
 #include <asio.hpp>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "beauty_common.hpp"
 #include "connection.hpp"
 #include "connection_manager.hpp"
 #include "i_file_io.hpp"
+#include "i_request_observer.hpp"
+#include "listener_handoff.hpp"
+#include "logger.hpp"
 #include "request_handler.hpp"
+#include "tls_context.hpp"
 
 namespace beauty {
 
@@ -24,7 +29,8 @@ class Server {
                     uint16_t port,
                     IFileIO *fileIO,
                     HttpPersistence options,
-                    size_t maxContentSize = 1024);
+                    size_t maxContentSize = 1024,
+                    SocketOptions socketOptions = SocketOptions());
 
     // Advanced constructor use for OS:s supporting signal_set.
     explicit Server(asio::io_context &ioContext,
@@ -32,8 +38,20 @@ class Server {
                     const std::string &port,
                     IFileIO *fileIO,
                     HttpPersistence options,
-                    size_t maxContentSize = 1024);
+                    size_t maxContentSize = 1024,
+                    SocketOptions socketOptions = SocketOptions());
 
+    // Constructor for several listeners, e.g. IPv4 and IPv6 or a Unix
+    // domain socket next to TCP, all feeding the same connections and
+    // handlers. Use for OS:s supporting signal_set.
+    explicit Server(asio::io_context &ioContext,
+                    const std::vector<Listener> &listeners,
+                    IFileIO *fileIO,
+                    HttpPersistence options,
+                    size_t maxContentSize = 1024,
+                    SocketOptions socketOptions = SocketOptions());
+
+    // Port of the first TCP listener, 0 if there is none.
     uint16_t getBindedPort() const;
 
     // Handlers to be optionally implemented.
@@ -41,13 +59,129 @@ class Server {
     void setFileNotFoundHandler(const handlerCallback &cb);
     void setDebugMsgHandler(const debugMsgCallback &cb);
 
+    // Leveled log sink, e.g. an AsyncLogSink. Replaces any debug message
+    // handler. The sink must outlive the server.
+    void setLogSink(ILogSink *sink);
+
+    // Observer of request lifecycle events, e.g. a TraceCollector. Must be
+    // set before the io_context is run and outlive the server.
+    void setRequestObserver(IRequestObserver *observer);
+
+    // Limit connections and their buffer memory. Must be set before the
+    // io_context is run.
+    void setAdmissionControl(AdmissionControl admission);
+
+    // Accept cleartext HTTP/2 (h2c). Must be set before the io_context is
+    // run.
+    void setHttp2(Http2Options options);
+
+    // Close connections of clients too slow to send a request or read the
+    // response. Must be set before the io_context is run.
+    void setConnectionTimeouts(ConnectionTimeouts timeouts);
+
+    // Limit the request rate and connections of each client IP address.
+    // Must be set before the io_context is run.
+    void setRateLimit(RateLimit limit);
+
+    // Counters of limited clients, all zero without a rate limit.
+    RateLimiter::Stats getRateLimitStats() const;
+
+#ifdef BEAUTY_ENABLE_TLS
+    // Accept TLS only, on the same port. Must be set before the io_context
+    // is run. Returns false, with an error logged, if the certificate or key
+    // cannot be loaded.
+    bool setTls(const TlsOptions &options);
+
+    // Handshake and session resumption counters, all zero without TLS.
+    TlsContext::Stats getTlsStats() const;
+#endif
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    // Hand the listening sockets over to a new server process connecting
+    // to the Unix domain socket at path, see receiveListeners(). This server
+    // then stops accepting, finishes its open connections and stops, so the
+    // io_context runs out. Returns false, with an error logged, if path
+    // cannot be bound or holds a file other than a socket.
+    bool enableHandoff(const std::string &path);
+#endif
+
+    // On SIGINT, SIGTERM or SIGQUIT stop accepting, close idle connections
+    // and let the others finish their current response, for at most timeout.
+    // Connections still open then are closed, as on a second signal. Also
+    // bounds the drain after a handoff, which waits 30 seconds when it is 0.
+    // Default 0, stop at once.
+    void setDrainTimeout(std::chrono::seconds timeout);
+
+    // What the drain closed and cut, all zero until the server drains.
+    ConnectionManager::DrainReport getDrainReport() const;
+
+    // Write the body of a PUT, or of a POST that is not multipart, to the
+    // fileIO file at the request path. Off by default, as any client may then
+    // write files. Must be set before the io_context is run.
+    void setRawUploads(bool enabled);
+
+    // Limit the memory of free buffers kept in the buffer pool for reuse.
+    // Default 4 * maxContentSize.
+    void setBufferPoolSize(size_t maxFreeBytes);
+
+    // Occupancy of the buffer pool.
+    BufferPool::Stats getBufferPoolStats() const;
+
    private:
-    void doAccept();
+    typedef asio::basic_socket_acceptor<asio::generic::stream_protocol> acceptor_type;
+
+    // A listening socket, TCP or Unix domain.
+    struct Acceptor {
+        Acceptor(asio::io_context &ioContext, bool tcp) : acceptor_(ioContext), tcp_(tcp) {}
+
+        acceptor_type acceptor_;
+
+        // TCP socket options apply to accepted sockets.
+        bool tcp_;
+
+        // True while accepting is paused by admission control.
+        bool paused_ = false;
+    };
+
+    // Open, bind and listen on listener.
+    void listen(asio::io_context &ioContext, const Listener &listener);
+    void listen(asio::io_context &ioContext,
+                const acceptor_type::endpoint_type &endpoint,
+                bool tcp);
+
+    // Accept on a socket that is already listening.
+    void adopt(asio::io_context &ioContext, int fd);
+    void addAcceptor(std::unique_ptr<Acceptor> acceptor);
+
+    void doAccept(Acceptor &acceptor);
+
+    // Accept further clients waiting in the backlog, up to acceptBatch_ per
+    // wakeup.
+    void acceptBatch(Acceptor &acceptor);
+
+    // Start serving an accepted client, or reject it when at capacity.
+    void acceptConnection(Acceptor &acceptor, ConnectionSocket::socket_type socket);
+    void doAwaitClient(Acceptor &acceptor);
+    void resumeAccept();
+    // Reply to a client that is not served, e.g. 503 or 429, and close.
+    void rejectConnection(ConnectionSocket::socket_type socket, const std::string &reply);
     void doAwaitStop();
     void doTick();
 
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    void doAwaitHandoff();
+#endif
+
+    // Stop accepting and close connections once they are idle, then stop
+    // the server when none are left.
+    void drain();
+    void continueDrain();
+
+    // Close the listeners and all connections.
+    void stop();
+
     std::shared_ptr<asio::signal_set> signals_;
-    asio::ip::tcp::acceptor acceptor_;
+    std::vector<std::unique_ptr<Acceptor>> acceptors_;
     ConnectionManager connectionManager_;
     RequestHandler requestHandler_;
 
@@ -57,14 +191,38 @@ class Server {
     // Timer to handle connection status.
     asio::steady_timer timer_;
 
+    // Deadline of connections in flight when draining.
+    asio::steady_timer drainTimer_;
+    std::chrono::seconds drainTimeout_ = std::chrono::seconds(0);
+
     // The max buffer size when reading/writing socket.
     const size_t maxContentSize_;
 
+    // Options of listening and accepted sockets.
+    const SocketOptions socketOptions_;
+
     // Callback to handle post file access, e.g. a custom not found handler.
     handlerCallback fileNotFoundCb_;
 
-    // Callback to handle debug messages.
-    debugMsgCallback debugMsgCb_;
+    // Optional observer passed to each new connection.
+    IRequestObserver *requestObserver_ = nullptr;
+
+    // Precomputed reply to clients rejected by admission control.
+    std::string serviceUnavailableReply_;
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    // Waits for a new server process to take over the listeners.
+    std::unique_ptr<asio::local::stream_protocol::acceptor> handoffAcceptor_;
+#endif
+
+    // True once the listeners are handed off or a stop signal is received.
+    bool draining_ = false;
+    bool stopped_ = false;
+
+#ifdef BEAUTY_ENABLE_TLS
+    // Shared by all connections, set by setTls().
+    std::unique_ptr<TlsContext> tlsContext_;
+#endif
 };
 
 }  // namespace beauty
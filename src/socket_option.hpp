@@ -0,0 +1,78 @@
+#pragma once
+#include "environment.hpp"
+
+#include <asio.hpp>
+#include <cstddef>
+#include <stdexcept>
+
+namespace beauty {
+
+// An int valued socket option asio has no type for, e.g. TCP_DEFER_ACCEPT.
+// Meets asio's SettableSocketOption and GettableSocketOption requirements.
+template <int Level, int Name>
+class IntegerOption {
+   public:
+    IntegerOption() : value_(0) {}
+    explicit IntegerOption(int value) : value_(value) {}
+
+    int value() const {
+        return value_;
+    }
+
+    template <typename Protocol>
+    int level(const Protocol &) const {
+        return Level;
+    }
+
+    template <typename Protocol>
+    int name(const Protocol &) const {
+        return Name;
+    }
+
+    template <typename Protocol>
+    int *data(const Protocol &) {
+        return &value_;
+    }
+
+    template <typename Protocol>
+    const int *data(const Protocol &) const {
+        return &value_;
+    }
+
+    template <typename Protocol>
+    size_t size(const Protocol &) const {
+        return sizeof(value_);
+    }
+
+    // Called by get_option with the size the operating system returned.
+    template <typename Protocol>
+    void resize(const Protocol &, size_t size) {
+        if (size != sizeof(value_)) {
+            throw std::length_error("integer socket option resize");
+        }
+    }
+
+   private:
+    int value_;
+};
+
+#if defined(TCP_DEFER_ACCEPT)
+typedef IntegerOption<IPPROTO_TCP, TCP_DEFER_ACCEPT> defer_accept;
+#endif
+#if defined(TCP_FASTOPEN)
+typedef IntegerOption<IPPROTO_TCP, TCP_FASTOPEN> fast_open;
+#endif
+#if defined(TCP_QUICKACK)
+typedef IntegerOption<IPPROTO_TCP, TCP_QUICKACK> quick_ack;
+#endif
+#if defined(TCP_KEEPIDLE)
+typedef IntegerOption<IPPROTO_TCP, TCP_KEEPIDLE> keep_alive_idle;
+#endif
+#if defined(TCP_KEEPINTVL)
+typedef IntegerOption<IPPROTO_TCP, TCP_KEEPINTVL> keep_alive_interval;
+#endif
+#if defined(TCP_KEEPCNT)
+typedef IntegerOption<IPPROTO_TCP, TCP_KEEPCNT> keep_alive_probes;
+#endif
+
+}  // namespace beauty
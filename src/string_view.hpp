@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+
+namespace beauty {
+
+// A non-owning view of a character sequence, used instead of
+// std::string_view as the library is C++11.
+class StringView {
+   public:
+    StringView() : data_(nullptr), size_(0) {}
+    StringView(const char *data, size_t size) : data_(data), size_(size) {}
+    StringView(const char *str) : data_(str), size_(strlen(str)) {}
+    StringView(const std::string &str) : data_(str.data()), size_(str.size()) {}
+
+    const char *data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    const char *begin() const {
+        return data_;
+    }
+    const char *end() const {
+        return data_ + size_;
+    }
+    char operator[](size_t pos) const {
+        return data_[pos];
+    }
+
+    std::string str() const {
+        return std::string(data_, size_);
+    }
+    operator std::string() const {
+        return str();
+    }
+
+    friend bool operator==(StringView a, StringView b) {
+        return a.size_ == b.size_ && (a.size_ == 0 || memcmp(a.data_, b.data_, a.size_) == 0);
+    }
+    friend bool operator!=(StringView a, StringView b) {
+        return !(a == b);
+    }
+
+   private:
+    const char *data_;
+    size_t size_;
+};
+
+}  // namespace beauty
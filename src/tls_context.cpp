@@ -0,0 +1,141 @@
+#include "tls_context.hpp"
+
+#ifdef BEAUTY_ENABLE_TLS
+
+#include <openssl/err.h>
+
+namespace beauty {
+
+namespace {
+
+// ALPN protocol lists, length prefixed names in order of preference.
+const unsigned char http2Protocols[] = "\x02h2\x08http/1.1";
+const unsigned char http1Protocols[] = "\x08http/1.1";
+
+std::string lastError(const std::string &what) {
+    char reason[256];
+    ERR_error_string_n(ERR_get_error(), reason, sizeof(reason));
+    ERR_clear_error();
+    return what + ": " + reason;
+}
+
+}  // namespace
+
+TlsContext::TlsContext() : ctx_(SSL_CTX_new(TLS_server_method())), stats_() {}
+
+TlsContext::~TlsContext() {
+    SSL_CTX_free(ctx_);
+}
+
+bool TlsContext::load(const TlsOptions &options, std::string &error) {
+    if (ctx_ == nullptr) {
+        error = lastError("SSL_CTX_new");
+        return false;
+    }
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+
+    uint64_t sslOptions = SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_NO_RENEGOTIATION;
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // a client closing without close_notify ends the connection as eof
+    sslOptions |= SSL_OP_IGNORE_UNEXPECTED_EOF;
+#endif
+    if (!options.sessionTickets_) {
+        sslOptions |= SSL_OP_NO_TICKET;
+    }
+    if (options.kernelTls_) {
+#ifdef SSL_OP_ENABLE_KTLS
+        sslOptions |= SSL_OP_ENABLE_KTLS;
+#else
+        error = "kernel TLS requires OpenSSL 3";
+        return false;
+#endif
+    }
+    SSL_CTX_set_options(ctx_, sslOptions);
+
+    // Connections retry writes with the same data from wherever it is
+    // copied to, and give back the record buffers while idle.
+    SSL_CTX_set_mode(ctx_,
+                     SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                         SSL_MODE_RELEASE_BUFFERS);
+
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx_, static_cast<long>(options.sessionCacheSize_));
+    SSL_CTX_set_timeout(ctx_, static_cast<long>(options.sessionTimeout_.count()));
+    static const unsigned char sessionIdContext[] = "beauty";
+    SSL_CTX_set_session_id_context(ctx_, sessionIdContext, sizeof(sessionIdContext) - 1);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    // one ticket per handshake, a client resumes one session at a time
+    SSL_CTX_set_num_tickets(ctx_, 1);
+#endif
+
+    if (SSL_CTX_use_certificate_chain_file(ctx_, options.certificateChainFile_.c_str()) != 1) {
+        error = lastError(options.certificateChainFile_);
+        return false;
+    }
+    if (SSL_CTX_use_PrivateKey_file(ctx_, options.privateKeyFile_.c_str(), SSL_FILETYPE_PEM) !=
+        1) {
+        error = lastError(options.privateKeyFile_);
+        return false;
+    }
+    if (SSL_CTX_check_private_key(ctx_) != 1) {
+        error = lastError(options.privateKeyFile_);
+        return false;
+    }
+
+    SSL_CTX_set_alpn_select_cb(ctx_, &TlsContext::selectAlpn, this);
+    return true;
+}
+
+void TlsContext::setHttp2(bool enabled) {
+    http2_ = enabled;
+}
+
+SSL *TlsContext::newSsl() {
+    return ctx_ != nullptr ? SSL_new(ctx_) : nullptr;
+}
+
+void TlsContext::handshakeDone(SSL *ssl, std::chrono::steady_clock::duration duration) {
+    stats_.handshakes_++;
+    if (SSL_session_reused(ssl)) {
+        stats_.resumed_++;
+    }
+    stats_.handshakeTime_ += std::chrono::duration_cast<std::chrono::microseconds>(duration);
+    if (BIO_get_ktls_send(SSL_get_wbio(ssl))) {
+        stats_.kernelTls_++;
+    }
+}
+
+void TlsContext::handshakeFailed() {
+    stats_.failed_++;
+}
+
+TlsContext::Stats TlsContext::getStats() const {
+    Stats stats = stats_;
+    stats.cachedSessions_ = ctx_ != nullptr ? static_cast<size_t>(SSL_CTX_sess_number(ctx_)) : 0;
+    return stats;
+}
+
+int TlsContext::selectAlpn(SSL * /*ssl*/,
+                           const unsigned char **out,
+                           unsigned char *outSize,
+                           const unsigned char *in,
+                           unsigned int inSize,
+                           void *arg) {
+    const TlsContext *self = static_cast<const TlsContext *>(arg);
+    const unsigned char *protocols = self->http2_ ? http2Protocols : http1Protocols;
+    unsigned int size = static_cast<unsigned int>(self->http2_ ? sizeof(http2Protocols) - 1
+                                                               : sizeof(http1Protocols) - 1);
+    unsigned char *selected = nullptr;
+    if (SSL_select_next_proto(&selected, outSize, protocols, size, in, inSize) !=
+        OPENSSL_NPN_NEGOTIATED) {
+        // continue without ALPN, the client speaks HTTP/1.1 or HTTP/2 with
+        // prior knowledge
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+}  // namespace beauty
+
+#endif  // BEAUTY_ENABLE_TLS
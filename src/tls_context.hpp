@@ -0,0 +1,73 @@
+#pragma once
+
+#ifdef BEAUTY_ENABLE_TLS
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include <openssl/ssl.h>
+
+#include "beauty_common.hpp"
+
+namespace beauty {
+
+// The OpenSSL context of a TLS server. Connections share its certificate,
+// session cache and session ticket keys, so a client reconnecting to any
+// connection resumes its session without a full handshake. Not thread safe,
+// use from the io_context thread only.
+class TlsContext {
+   public:
+    TlsContext(const TlsContext &) = delete;
+    TlsContext &operator=(const TlsContext &) = delete;
+
+    TlsContext();
+    ~TlsContext();
+
+    // Load the certificate and key and apply the session options. Returns
+    // false with a description in error if the files are not usable.
+    bool load(const TlsOptions &options, std::string &error);
+
+    // Offer HTTP/2 by ALPN, clients selecting it start with the HTTP/2
+    // connection preface.
+    void setHttp2(bool enabled);
+
+    // A new server side SSL of a connection, nullptr on failure.
+    SSL *newSsl();
+
+    // Account for a finished handshake of ssl, or a failed handshake.
+    void handshakeDone(SSL *ssl, std::chrono::steady_clock::duration duration);
+    void handshakeFailed();
+
+    struct Stats {
+        // Completed handshakes, of which resumed an earlier session.
+        size_t handshakes_;
+        size_t resumed_;
+        // Handshakes that failed, e.g. a client not trusting the
+        // certificate.
+        size_t failed_;
+        // Total time of the completed handshakes.
+        std::chrono::microseconds handshakeTime_;
+        // Connections encrypting their records in the kernel.
+        size_t kernelTls_;
+        // Sessions in the session cache.
+        size_t cachedSessions_;
+    };
+    Stats getStats() const;
+
+   private:
+    static int selectAlpn(SSL *ssl,
+                          const unsigned char **out,
+                          unsigned char *outSize,
+                          const unsigned char *in,
+                          unsigned int inSize,
+                          void *arg);
+
+    SSL_CTX *ctx_;
+    bool http2_ = false;
+    Stats stats_;
+};
+
+}  // namespace beauty
+
+#endif  // BEAUTY_ENABLE_TLS
@@ -0,0 +1,171 @@
+#include <cstdio>
+
+#include "trace_collector.hpp"
+
+namespace beauty {
+
+TraceCollector::TraceCollector(size_t maxRequests, size_t maxEventsPerRequest)
+    : maxEventsPerRequest_(maxEventsPerRequest),
+      ring_(maxRequests > 0 ? maxRequests : 1),
+      epoch_(clock::now()) {}
+
+void TraceCollector::onAccept(unsigned connectionId, clock::time_point t) {
+    addEvent(connectionId, "accept", t);
+}
+
+void TraceCollector::onFirstByte(unsigned connectionId, clock::time_point t) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = inFlight_.find(connectionId);
+    if (it != inFlight_.end() && it->second.responseComplete_) {
+        // keep-alive connection, the previous request is done
+        complete(it);
+    }
+    addEventLocked(connectionId, "wait request", t, 0);
+}
+
+void TraceCollector::onHeadParsed(unsigned connectionId, clock::time_point t) {
+    addEvent(connectionId, "parse head", t);
+}
+
+void TraceCollector::onDecodeDone(unsigned connectionId, clock::time_point t) {
+    addEvent(connectionId, "decode", t);
+}
+
+void TraceCollector::onMiddlewareReturned(unsigned connectionId,
+                                          size_t index,
+                                          bool replied,
+                                          clock::time_point t) {
+    addEvent(connectionId, replied ? "middleware (replied)" : "middleware", t, index);
+}
+
+void TraceCollector::onFileOpened(unsigned connectionId, size_t fileSize, clock::time_point t) {
+    addEvent(connectionId, "file open", t, fileSize);
+}
+
+void TraceCollector::onHeadersWritten(unsigned connectionId, clock::time_point t) {
+    addEvent(connectionId, "write headers", t);
+}
+
+void TraceCollector::onBodyChunkWritten(unsigned connectionId, size_t size, clock::time_point t) {
+    addEvent(connectionId, "write body", t, size);
+}
+
+void TraceCollector::onResponseComplete(unsigned connectionId, clock::time_point t) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    addEventLocked(connectionId, "complete", t, 0).responseComplete_ = true;
+}
+
+void TraceCollector::onClose(unsigned connectionId, clock::time_point t) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    addEventLocked(connectionId, "close", t, 0);
+    complete(inFlight_.find(connectionId));
+}
+
+std::string TraceCollector::dumpChromeTrace() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    out.reserve(256 * (count_ + inFlight_.size()));
+    out += "{\"traceEvents\":[";
+    bool first = true;
+    size_t oldest = (count_ < ring_.size()) ? 0 : next_;
+    for (size_t i = 0; i < count_; ++i) {
+        appendTrace(out, ring_[(oldest + i) % ring_.size()], first);
+    }
+    for (const auto &trace : inFlight_) {
+        appendTrace(out, trace.second, first);
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+}
+
+size_t TraceCollector::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+void TraceCollector::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    inFlight_.clear();
+    next_ = 0;
+    count_ = 0;
+}
+
+void TraceCollector::addEvent(unsigned connectionId,
+                              const char *name,
+                              clock::time_point t,
+                              size_t value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    addEventLocked(connectionId, name, t, value);
+}
+
+TraceCollector::RequestTrace &TraceCollector::addEventLocked(unsigned connectionId,
+                                                             const char *name,
+                                                             clock::time_point t,
+                                                             size_t value) {
+    RequestTrace &trace = inFlight_[connectionId];
+    if (trace.events_.empty()) {
+        trace.connectionId_ = connectionId;
+        trace.events_.reserve(maxEventsPerRequest_);
+    }
+    if (trace.events_.size() < maxEventsPerRequest_) {
+        trace.events_.push_back({name, t, value});
+    }
+    return trace;
+}
+
+void TraceCollector::complete(std::map<unsigned, RequestTrace>::iterator it) {
+    // hand the events over without copying them, the events of the
+    // overwritten request are freed with the in-flight entry
+    RequestTrace &slot = ring_[next_];
+    slot.connectionId_ = it->second.connectionId_;
+    slot.responseComplete_ = it->second.responseComplete_;
+    slot.events_.swap(it->second.events_);
+    inFlight_.erase(it);
+
+    next_ = (next_ + 1) % ring_.size();
+    if (count_ < ring_.size()) {
+        count_++;
+    }
+}
+
+void TraceCollector::appendTrace(std::string &out, const RequestTrace &trace, bool &first) const {
+    if (trace.events_.empty()) {
+        return;
+    }
+    char buf[256];
+    auto toUs = [this](clock::time_point t) {
+        return std::chrono::duration<double, std::micro>(t - epoch_).count();
+    };
+
+    // One span covering the whole request..
+    const Event &front = trace.events_.front();
+    const Event &back = trace.events_.back();
+    snprintf(buf,
+             sizeof(buf),
+             "%s{\"name\":\"request\",\"cat\":\"beauty\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+             "\"pid\":1,\"tid\":%u}",
+             first ? "" : ",",
+             toUs(front.time_),
+             toUs(back.time_) - toUs(front.time_),
+             trace.connectionId_);
+    out += buf;
+    first = false;
+
+    // ..and one span per phase, ending at each event.
+    for (size_t i = 0; i < trace.events_.size(); ++i) {
+        const Event &ev = trace.events_[i];
+        double start = toUs(i == 0 ? ev.time_ : trace.events_[i - 1].time_);
+        snprintf(buf,
+                 sizeof(buf),
+                 ",{\"name\":\"%s\",\"cat\":\"beauty\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                 "\"pid\":1,\"tid\":%u,\"args\":{\"value\":%zu}}",
+                 ev.name_,
+                 start,
+                 toUs(ev.time_) - start,
+                 trace.connectionId_,
+                 ev.value_);
+        out += buf;
+    }
+}
+
+}  // namespace beauty
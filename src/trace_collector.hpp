@@ -0,0 +1,83 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "i_request_observer.hpp"
+
+namespace beauty {
+
+// Request observer that keeps the last N requests in a ring buffer and dumps
+// them in Chrome trace-event JSON format (load in chrome://tracing or
+// https://ui.perfetto.dev). Each connection is shown as its own thread.
+class TraceCollector : public IRequestObserver {
+   public:
+    TraceCollector(const TraceCollector &) = delete;
+    TraceCollector &operator=(const TraceCollector &) = delete;
+
+    explicit TraceCollector(size_t maxRequests = 32, size_t maxEventsPerRequest = 64);
+
+    void onAccept(unsigned connectionId, clock::time_point t) override;
+    void onFirstByte(unsigned connectionId, clock::time_point t) override;
+    void onHeadParsed(unsigned connectionId, clock::time_point t) override;
+    void onDecodeDone(unsigned connectionId, clock::time_point t) override;
+    void onMiddlewareReturned(unsigned connectionId,
+                              size_t index,
+                              bool replied,
+                              clock::time_point t) override;
+    void onFileOpened(unsigned connectionId, size_t fileSize, clock::time_point t) override;
+    void onHeadersWritten(unsigned connectionId, clock::time_point t) override;
+    void onBodyChunkWritten(unsigned connectionId, size_t size, clock::time_point t) override;
+    void onResponseComplete(unsigned connectionId, clock::time_point t) override;
+    void onClose(unsigned connectionId, clock::time_point t) override;
+
+    // Returns the collected requests, oldest first, including requests still
+    // in flight. May be called from any thread.
+    std::string dumpChromeTrace() const;
+
+    // Number of completed requests held in the ring buffer.
+    size_t size() const;
+
+    void clear();
+
+   private:
+    struct Event {
+        // Name of the phase that ended with this event.
+        const char *name_;
+        clock::time_point time_;
+        size_t value_;
+    };
+
+    struct RequestTrace {
+        unsigned connectionId_ = 0;
+        bool responseComplete_ = false;
+        std::vector<Event> events_;
+    };
+
+    void addEvent(unsigned connectionId, const char *name, clock::time_point t, size_t value = 0);
+    RequestTrace &addEventLocked(unsigned connectionId,
+                                 const char *name,
+                                 clock::time_point t,
+                                 size_t value);
+    void complete(std::map<unsigned, RequestTrace>::iterator it);
+    void appendTrace(std::string &out, const RequestTrace &trace, bool &first) const;
+
+    const size_t maxEventsPerRequest_;
+
+    // Requests that have not yet been moved to the ring buffer.
+    std::map<unsigned, RequestTrace> inFlight_;
+
+    // Completed requests, next_ is the slot to overwrite.
+    std::vector<RequestTrace> ring_;
+    size_t next_ = 0;
+    size_t count_ = 0;
+
+    // Timestamps are exported relative to construction.
+    const clock::time_point epoch_;
+
+    mutable std::mutex mutex_;
+};
+
+}  // namespace beauty
@@ -0,0 +1,94 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "url_decode.hpp"
+
+namespace beauty {
+
+namespace {
+
+// Value of each hex digit, 0xFF for all other bytes.
+const unsigned char hexValues[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+// Non-zero if any byte of v equals c.
+inline uint64_t hasByte(uint64_t v, unsigned char c) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    uint64_t x = v ^ (ones * c);
+    return (x - ones) & ~x & (ones * 0x80);
+}
+
+// Find the next byte to decode. Runs without one are skipped eight bytes at
+// a time.
+const char *findEscape(const char *p, const char *end, bool plusIsSpace) {
+    while (end - p >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        uint64_t found = hasByte(v, '%');
+        if (plusIsSpace) {
+            found |= hasByte(v, '+');
+        }
+        if (found) {
+            break;
+        }
+        p += 8;
+    }
+    while (p != end && *p != '%' && !(plusIsSpace && *p == '+')) {
+        ++p;
+    }
+    return p;
+}
+
+}  // namespace
+
+size_t urlDecode(char *data, size_t size, bool plusIsSpace) {
+    const char *in = data;
+    const char *end = data + size;
+    char *out = data;
+    while (true) {
+        const char *run = findEscape(in, end, plusIsSpace);
+        if (out != in) {
+            memmove(out, in, run - in);
+        }
+        out += run - in;
+        in = run;
+        if (in == end) {
+            break;
+        }
+        if (*in == '+') {
+            *out++ = ' ';
+            ++in;
+            continue;
+        }
+        if (end - in >= 3) {
+            unsigned char hi = hexValues[static_cast<unsigned char>(in[1])];
+            unsigned char lo = hexValues[static_cast<unsigned char>(in[2])];
+            if (hi != 0xFF && lo != 0xFF) {
+                *out++ = static_cast<char>(hi << 4 | lo);
+                in += 3;
+                continue;
+            }
+        }
+        // an invalid escape is kept as is
+        *out++ = *in++;
+    }
+    return out - data;
+}
+
+}  // namespace beauty
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+namespace beauty {
+
+// Percent-decode size bytes at data in place and return the decoded size.
+// With plusIsSpace '+' is decoded as ' ', as in query strings and form
+// bodies.
+size_t urlDecode(char *data, size_t size, bool plusIsSpace);
+
+}  // namespace beauty
@@ -2,24 +2,31 @@
 
 #include <assert.h>
 #include <stdint.h>
-#include <stdlib.h>
 
 #include <string>
 
+#include "string_view.hpp"
+
 namespace beauty {
 
+// Parser for absolute URLs, e.g. absolute-form request targets. Components
+// are recorded as offsets into the input and returned as views, so the
+// input must outlive the parser.
 class UrlParser {
    public:
     UrlParser() : valid_(false) {}
 
-    explicit UrlParser(const std::string &url) : valid_(true) {
+    explicit UrlParser(StringView url) : valid_(false) {
         parse(url);
     }
 
-    bool parse(const std::string &str) {
+    bool parse(StringView url) {
         url_ = Url();
-        parse_(str);
-
+        input_ = url.data();
+        valid_ = parse_(url.begin(), url.end());
+        if (!valid_) {
+            url_ = Url();
+        }
         return isValid();
     }
 
@@ -27,44 +34,48 @@ class UrlParser {
         return valid_;
     }
 
-    std::string scheme() const {
-        assert(isValid());
-        return url_.scheme_;
+    StringView scheme() const {
+        return component(url_.scheme_);
     }
 
-    std::string username() const {
-        assert(isValid());
-        return url_.username_;
+    StringView username() const {
+        return component(url_.username_);
     }
 
-    std::string password() const {
-        assert(isValid());
-        return url_.password_;
+    StringView password() const {
+        return component(url_.password_);
     }
 
-    std::string hostname() const {
-        assert(isValid());
-        return url_.hostname_;
+    // An IPv6 host is returned without the brackets.
+    StringView hostname() const {
+        return component(url_.hostname_);
     }
 
-    std::string port() const {
-        assert(isValid());
-        return url_.port_;
+    StringView port() const {
+        return component(url_.port_);
     }
 
-    std::string path() const {
+    StringView path() const {
         assert(isValid());
-        return url_.path_;
+        return url_.path_.size_ == 0 ? StringView("/") : component(url_.path_);
     }
 
-    std::string query() const {
-        assert(isValid());
-        return url_.query_;
+    StringView query() const {
+        return component(url_.query_);
     }
 
-    std::string fragment() const {
+    StringView fragment() const {
+        return component(url_.fragment_);
+    }
+
+    // The host and port as given, e.g. for a Host header.
+    StringView authority() const {
+        return component(url_.authority_);
+    }
+
+    bool isIpv6() const {
         assert(isValid());
-        return url_.fragment_;
+        return url_.isIpv6_;
     }
 
     uint16_t httpPort() const {
@@ -73,7 +84,7 @@ class UrlParser {
 
         assert(isValid());
 
-        if (url_.port_.empty()) {
+        if (url_.port_.size_ == 0) {
             if (scheme() == "https")
                 return defaultHttpsPort;
             else
@@ -84,8 +95,43 @@ class UrlParser {
     }
 
    private:
-    bool isUnreserved(char ch) const {
-        if (isalnum(ch))
+    struct Range {
+        Range() : pos_(0), size_(0) {}
+        size_t pos_;
+        size_t size_;
+    };
+
+    StringView component(const Range &range) const {
+        assert(isValid());
+        return StringView(input_ + range.pos_, range.size_);
+    }
+
+    Range range(const char *begin, const char *end) const {
+        Range r;
+        r.pos_ = begin - input_;
+        r.size_ = end - begin;
+        return r;
+    }
+
+    // Locale independent character classes, cheaper than <ctype.h>.
+    static bool isAlpha(char ch) {
+        return static_cast<unsigned char>((ch | 0x20) - 'a') < 26;
+    }
+
+    static bool isDigit(char ch) {
+        return static_cast<unsigned char>(ch - '0') < 10;
+    }
+
+    static bool isAlnum(char ch) {
+        return isAlpha(ch) || isDigit(ch);
+    }
+
+    static bool isHexDigit(char ch) {
+        return isDigit(ch) || static_cast<unsigned char>((ch | 0x20) - 'a') < 6;
+    }
+
+    static bool isUnreserved(char ch) {
+        if (isAlnum(ch))
             return true;
 
         switch (ch) {
@@ -99,179 +145,178 @@ class UrlParser {
         return false;
     }
 
-    void parse_(const std::string &str) {
-        enum {
-            scheme,
-            slash_after_scheme1,
-            slash_after_scheme_2,
-            username_or_hostname,
-            password,
-            hostname,
-            ipv6_host_name,
-            port_or_password,
-            port,
-            path,
-            query,
-            fragment
-        } state = scheme;
-
-        std::string usernameOrHostname;
-        std::string portOrPassword;
-
-        valid_ = true;
-        url_.path_ = "/";
-        url_.integerPort_ = 0;
-
-        for (size_t i = 0; i < str.size() && valid_; ++i) {
-            char ch = str[i];
-
-            switch (state) {
-                case scheme:
-                    if (isalnum(ch) || ch == '+' || ch == '-' || ch == '.') {
-                        url_.scheme_ += ch;
-                    } else if (ch == ':') {
-                        state = slash_after_scheme1;
-                    } else {
-                        valid_ = false;
-                        url_ = Url();
-                    }
-                    break;
-                case slash_after_scheme1:
-                    if (ch == '/') {
-                        state = slash_after_scheme_2;
-                    } else if (isalnum(ch)) {
-                        usernameOrHostname = ch;
-                        state = username_or_hostname;
-                    } else {
-                        valid_ = false;
-                        url_ = Url();
-                    }
-                    break;
-                case slash_after_scheme_2:
-                    if (ch == '/') {
-                        state = username_or_hostname;
-                    } else {
-                        valid_ = false;
-                        url_ = Url();
-                    }
-                    break;
-                case username_or_hostname:
-                    if (isUnreserved(ch) || ch == '%') {
-                        usernameOrHostname += ch;
-                    } else if (ch == ':') {
-                        state = port_or_password;
-                    } else if (ch == '@') {
-                        state = hostname;
-                        std::swap(url_.username_, usernameOrHostname);
-                    } else if (ch == '/') {
-                        state = path;
-                        std::swap(url_.hostname_, usernameOrHostname);
-                    } else {
-                        valid_ = false;
-                        url_ = Url();
-                    }
-                    break;
-                case password:
-                    if (isalnum(ch) || ch == '%') {
-                        url_.password_ += ch;
-                    } else if (ch == '@') {
-                        state = hostname;
-                    } else {
-                        valid_ = false;
-                        url_ = Url();
-                    }
-                    break;
-                case hostname:
-                    if (ch == '[' && url_.hostname_.empty()) {
-                        state = ipv6_host_name;
-                    } else if (isUnreserved(ch) || ch == '%') {
-                        url_.hostname_ += ch;
-                    } else if (ch == ':') {
-                        state = port;
-                    } else if (ch == '/') {
-                        state = path;
-                    } else {
-                        valid_ = false;
-                        url_ = Url();
-                    }
-                    break;
-                case ipv6_host_name:
-                    abort();  // TODO
-                case port_or_password:
-                    if (isdigit(ch)) {
-                        portOrPassword += ch;
-                    } else if (ch == '/') {
-                        std::swap(url_.hostname_, usernameOrHostname);
-                        std::swap(url_.port_, portOrPassword);
-                        url_.integerPort_ = atoi(url_.port_.c_str());
-                        state = path;
-                    } else if (isalnum(ch) || ch == '%') {
-                        std::swap(url_.username_, usernameOrHostname);
-                        std::swap(url_.password_, portOrPassword);
-                        url_.password_ += ch;
-                        state = password;
-                    } else {
-                        valid_ = false;
-                        url_ = Url();
-                    }
-                    break;
-                case port:
-                    if (isdigit(ch)) {
-                        portOrPassword += ch;
-                    } else if (ch == '/') {
-                        std::swap(url_.port_, portOrPassword);
-                        url_.integerPort_ = atoi(url_.port_.c_str());
-                        state = path;
-                    } else {
-                        valid_ = false;
-                        url_ = Url();
-                    }
-                    break;
-                case path:
-                    if (ch == '#') {
-                        state = fragment;
-                    } else if (ch == '?') {
-                        state = query;
-                    } else {
-                        url_.path_ += ch;
-                    }
-                    break;
-                case query:
-                    if (ch == '#') {
-                        state = fragment;
-                    } else if (ch == '?') {
-                        state = query;
-                    } else {
-                        url_.query_ += ch;
-                    }
-                    break;
-                case fragment:
-                    url_.fragment_ += ch;
-                    break;
-            }
+    static bool isSubDelim(char ch) {
+        switch (ch) {
+            case '!':
+            case '$':
+            case '&':
+            case '\'':
+            case '(':
+            case ')':
+            case '*':
+            case '+':
+            case ',':
+            case ';':
+            case '=':
+                return true;
         }
 
-        assert(portOrPassword.empty());
+        return false;
+    }
 
-        if (!usernameOrHostname.empty()) {
-            url_.hostname_ = usernameOrHostname;
+    // Return the first position in [begin, end) holding one of the given
+    // characters, or end.
+    static const char *findAny(const char *begin, const char *end, char a, char b, char c) {
+        while (begin != end && *begin != a && *begin != b && *begin != c) {
+            ++begin;
+        }
+        return begin;
+    }
+
+    static const char *findAny(const char *begin, const char *end, char a, char b) {
+        while (begin != end && *begin != a && *begin != b) {
+            ++begin;
+        }
+        return begin;
+    }
+
+    static const char *find(const char *begin, const char *end, char a) {
+        while (begin != end && *begin != a) {
+            ++begin;
+        }
+        return begin;
+    }
+
+    bool parse_(const char *p, const char *end) {
+        // scheme
+        const char *begin = p;
+        if (p == end || !isAlpha(*p)) {
+            return false;
+        }
+        while (p != end && (isAlnum(*p) || *p == '+' || *p == '-' ||
+                            *p == '.')) {
+            ++p;
+        }
+        if (p == end || *p != ':') {
+            return false;
+        }
+        url_.scheme_ = range(begin, p++);
+
+        // authority, also taken without "//" as in "mailto:user@host"
+        if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+            p += 2;
+        } else if (p == end || !isAlnum(*p)) {
+            return false;
+        }
+        const char *authorityEnd = findAny(p, end, '/', '?', '#');
+        if (!parseAuthority(p, authorityEnd)) {
+            return false;
+        }
+        p = authorityEnd;
+
+        const char *pathEnd = findAny(p, end, '?', '#');
+        url_.path_ = range(p, pathEnd);
+        p = pathEnd;
+
+        if (p != end && *p == '?') {
+            const char *queryEnd = find(++p, end, '#');
+            url_.query_ = range(p, queryEnd);
+            p = queryEnd;
+        }
+        if (p != end) {
+            url_.fragment_ = range(p + 1, end);
+        }
+        return true;
+    }
+
+    bool parseAuthority(const char *p, const char *end) {
+        const char *at = end;
+        while (at != p && at[-1] != '@') {
+            --at;
+        }
+        if (at != p) {
+            const char *userinfoEnd = at - 1;
+            for (const char *c = p; c != userinfoEnd; ++c) {
+                if (!isUnreserved(*c) && !isSubDelim(*c) && *c != '%' && *c != ':') {
+                    return false;
+                }
+            }
+            const char *colon = find(p, userinfoEnd, ':');
+            url_.username_ = range(p, colon);
+            if (colon != userinfoEnd) {
+                url_.password_ = range(colon + 1, userinfoEnd);
+            }
+            p = at;
+        }
+        url_.authority_ = range(p, end);
+
+        const char *hostEnd;
+        if (p != end && *p == '[') {
+            // IPv6 literal, with an optional "%25" zone id
+            const char *close = find(p, end, ']');
+            if (close == end) {
+                return false;
+            }
+            bool zone = false;
+            for (const char *c = p + 1; c != close; ++c) {
+                if (*c == '%') {
+                    zone = true;
+                } else if (!(zone ? isUnreserved(*c)
+                                  : isHexDigit(*c) || *c == ':' ||
+                                        *c == '.')) {
+                    return false;
+                }
+            }
+            url_.hostname_ = range(p + 1, close);
+            url_.isIpv6_ = true;
+            hostEnd = close + 1;
+            if (hostEnd != end && *hostEnd != ':') {
+                return false;
+            }
+        } else {
+            hostEnd = find(p, end, ':');
+            for (const char *c = p; c != hostEnd; ++c) {
+                if (!isUnreserved(*c) && *c != '%') {
+                    return false;
+                }
+            }
+            url_.hostname_ = range(p, hostEnd);
+        }
+
+        if (hostEnd != end) {
+            uint32_t port = 0;
+            for (const char *c = hostEnd + 1; c != end; ++c) {
+                if (!isDigit(*c)) {
+                    return false;
+                }
+                port = port * 10 + (*c - '0');
+                if (port > 65535) {
+                    return false;
+                }
+            }
+            url_.port_ = range(hostEnd + 1, end);
+            url_.integerPort_ = static_cast<uint16_t>(port);
         }
+        return true;
     }
 
     bool valid_;
+    const char *input_ = nullptr;
 
     struct Url {
-        Url() : integerPort_(0) {}
-
-        std::string scheme_;
-        std::string username_;
-        std::string password_;
-        std::string hostname_;
-        std::string port_;
-        std::string path_;
-        std::string query_;
-        std::string fragment_;
+        Url() : integerPort_(0), isIpv6_(false) {}
+
+        Range scheme_;
+        Range username_;
+        Range password_;
+        Range hostname_;
+        Range port_;
+        Range path_;
+        Range query_;
+        Range fragment_;
+        Range authority_;
         uint16_t integerPort_;
+        bool isIpv6_;
     } url_;
 };
 
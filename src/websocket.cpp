@@ -0,0 +1,181 @@
+#include "connection.hpp"
+#include "websocket.hpp"
+
+#include <cstring>
+#include <utility>
+
+namespace beauty {
+
+namespace {
+
+uint32_t rotl(uint32_t x, unsigned n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+// SHA-1, only used for the handshake.
+void sha1(const std::string &input, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+    std::string data = input;
+    uint64_t bits = static_cast<uint64_t>(input.size()) * 8;
+    data.push_back(static_cast<char>(0x80));
+    while (data.size() % 64 != 56) {
+        data.push_back('\0');
+    }
+    for (int i = 7; i >= 0; --i) {
+        data.push_back(static_cast<char>((bits >> (i * 8)) & 0xff));
+    }
+
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(&data[block + i * 4]);
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) |
+                   uint32_t(p[3]);
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 5; ++i) {
+        digest[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+    }
+}
+
+std::string base64(const uint8_t *data, size_t size) {
+    static const char chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < size) {
+            n |= uint32_t(data[i + 1]) << 8;
+        }
+        if (i + 2 < size) {
+            n |= data[i + 2];
+        }
+        out.push_back(chars[(n >> 18) & 0x3f]);
+        out.push_back(chars[(n >> 12) & 0x3f]);
+        out.push_back(i + 1 < size ? chars[(n >> 6) & 0x3f] : '=');
+        out.push_back(i + 2 < size ? chars[n & 0x3f] : '=');
+    }
+    return out;
+}
+
+}  // namespace
+
+WebSocketFrame::WebSocketFrame(WebSocketFrameParser::opcode_type opcode, std::string payload)
+    : opcode_(opcode), payload_(std::move(payload)) {
+    // server frames are never masked or fragmented
+    uint64_t size = payload_.size();
+    header_[0] = static_cast<char>(0x80 | opcode);
+    if (size < 126) {
+        header_[1] = static_cast<char>(size);
+        headerSize_ = 2;
+    } else if (size <= 0xffff) {
+        header_[1] = 126;
+        header_[2] = static_cast<char>(size >> 8);
+        header_[3] = static_cast<char>(size);
+        headerSize_ = 4;
+    } else {
+        header_[1] = 127;
+        for (int i = 0; i < 8; ++i) {
+            header_[2 + i] = static_cast<char>(size >> ((7 - i) * 8));
+        }
+        headerSize_ = 10;
+    }
+}
+
+WebSocket::WebSocket(const std::weak_ptr<Connection> &connection,
+                     const asio::ip::tcp::socket::executor_type &executor,
+                     const std::shared_ptr<IWebSocketHandler> &handler)
+    : connection_(connection), executor_(executor), open_(true), handler_(handler) {}
+
+void WebSocket::sendText(std::string text) {
+    send(WebSocketFrame(WebSocketFrameParser::text, std::move(text)));
+}
+
+void WebSocket::sendBinary(std::string data) {
+    send(WebSocketFrame(WebSocketFrameParser::binary, std::move(data)));
+}
+
+void WebSocket::sendBinary(const char *data, size_t size) {
+    sendBinary(std::string(data, size));
+}
+
+void WebSocket::close(uint16_t code) {
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code & 0xff));
+    send(WebSocketFrame(WebSocketFrameParser::close, std::move(payload)));
+}
+
+bool WebSocket::isOpen() const {
+    return open_;
+}
+
+std::string WebSocket::acceptKey(const std::string &key) {
+    uint8_t digest[20];
+    sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+    return base64(digest, sizeof(digest));
+}
+
+namespace {
+
+// Moves the frame to the io_context thread, which owns the write queue.
+struct QueueFrame {
+    std::weak_ptr<Connection> connection_;
+    WebSocketFrame frame_;
+
+    void operator()() {
+        if (std::shared_ptr<Connection> connection = connection_.lock()) {
+            connection->queueFrame(std::move(frame_));
+        }
+    }
+};
+
+}  // namespace
+
+void WebSocket::send(WebSocketFrame frame) {
+    if (!open_) {
+        return;
+    }
+    QueueFrame queue = {connection_, std::move(frame)};
+    asio::dispatch(executor_, std::move(queue));
+}
+
+}  // namespace beauty
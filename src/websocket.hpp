@@ -0,0 +1,83 @@
+#pragma once
+#include "environment.hpp"
+
+#include <asio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "i_websocket_handler.hpp"
+#include "websocket_frame_parser.hpp"
+
+namespace beauty {
+
+class Connection;
+
+// An outgoing frame. The header and payload are written without copying
+// them into one buffer.
+struct WebSocketFrame {
+    WebSocketFrame(WebSocketFrameParser::opcode_type opcode, std::string payload);
+
+    WebSocketFrameParser::opcode_type opcode_;
+    char header_[10];
+    size_t headerSize_;
+    std::string payload_;
+};
+
+// Handle to an open WebSocket, see IWebSocketHandler. The send methods may be
+// called from any thread and queue the message, once the socket is closed
+// they do nothing.
+class WebSocket {
+   public:
+    WebSocket(const WebSocket &) = delete;
+    WebSocket &operator=(const WebSocket &) = delete;
+
+    WebSocket(const std::weak_ptr<Connection> &connection,
+              const asio::ip::tcp::socket::executor_type &executor,
+              const std::shared_ptr<IWebSocketHandler> &handler);
+
+    void sendText(std::string text);
+    void sendBinary(std::string data);
+    void sendBinary(const char *data, size_t size);
+
+    // Send a close frame and close the connection once it is written.
+    void close(uint16_t code = 1000);
+
+    bool isOpen() const;
+
+    // The Sec-WebSocket-Accept value for a Sec-WebSocket-Key.
+    static std::string acceptKey(const std::string &key);
+
+   private:
+    friend class Connection;
+
+    void send(WebSocketFrame frame);
+
+    std::weak_ptr<Connection> connection_;
+    asio::ip::tcp::socket::executor_type executor_;
+    std::atomic<bool> open_;
+
+    // State of the connection in frame mode, only used from the io_context
+    // thread.
+    std::shared_ptr<IWebSocketHandler> handler_;
+    WebSocketFrameParser parser_;
+
+    // A message or control frame received over several reads.
+    std::string message_;
+    WebSocketFrameParser::opcode_type messageOpcode_ = WebSocketFrameParser::continuation;
+    std::string control_;
+
+    // Frames waiting to be written, the front frames are being written
+    // while writing_ is set.
+    std::deque<WebSocketFrame> outFrames_;
+    bool writing_ = false;
+    bool closeSent_ = false;
+
+    // Reported to the handler when the connection is stopped, 1006 until a
+    // close frame is sent or received.
+    uint16_t closeCode_ = 1006;
+};
+
+}  // namespace beauty
@@ -0,0 +1,150 @@
+#include "websocket_frame_parser.hpp"
+
+#include <cstring>
+
+namespace beauty {
+
+namespace {
+
+bool isControl(uint8_t opcode) {
+    return (opcode & 0x8) != 0;
+}
+
+bool isValidOpcode(uint8_t opcode) {
+    return opcode <= WebSocketFrameParser::binary ||
+           (opcode >= WebSocketFrameParser::close && opcode <= WebSocketFrameParser::pong);
+}
+
+}  // namespace
+
+WebSocketFrameParser::WebSocketFrameParser() {
+    reset();
+}
+
+void WebSocketFrameParser::reset() {
+    state_ = opcode_byte;
+    opcode_ = continuation;
+    fin_ = false;
+    length_ = 0;
+    received_ = 0;
+    headerBytes_ = 0;
+}
+
+WebSocketFrameParser::result_type WebSocketFrameParser::parse(char *&begin,
+                                                              char *end,
+                                                              Chunk &chunk) {
+    while (state_ != payload) {
+        if (begin == end) {
+            return indeterminate;
+        }
+        if (consume(static_cast<uint8_t>(*begin++)) == bad) {
+            return bad;
+        }
+    }
+
+    uint64_t remaining = length_ - received_;
+    size_t available = static_cast<size_t>(end - begin);
+    size_t size = remaining < available ? static_cast<size_t>(remaining) : available;
+    if (size == 0 && remaining > 0) {
+        return indeterminate;
+    }
+
+    unmask(begin, size, mask_, static_cast<size_t>(received_ & 3));
+    chunk.opcode_ = opcode_;
+    chunk.fin_ = fin_;
+    chunk.first_ = received_ == 0;
+    chunk.data_ = begin;
+    chunk.size_ = size;
+    received_ += size;
+    begin += size;
+    chunk.last_ = received_ == length_;
+    if (chunk.last_) {
+        state_ = opcode_byte;
+    }
+    return result_type::chunk;
+}
+
+void WebSocketFrameParser::unmask(char *data, size_t size, const uint8_t mask[4], size_t offset) {
+    // XOR a word at a time with the mask repeated to the word size, the
+    // copies compile to plain loads and stores and allow unaligned data
+    uint8_t bytes[8];
+    for (size_t i = 0; i < sizeof(bytes); ++i) {
+        bytes[i] = mask[(offset + i) & 3];
+    }
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+
+    size_t i = 0;
+    for (; i + sizeof(word) <= size; i += sizeof(word)) {
+        uint64_t v;
+        std::memcpy(&v, data + i, sizeof(v));
+        v ^= word;
+        std::memcpy(data + i, &v, sizeof(v));
+    }
+    for (; i < size; ++i) {
+        data[i] ^= bytes[i & 7];
+    }
+}
+
+WebSocketFrameParser::result_type WebSocketFrameParser::consume(uint8_t input) {
+    switch (state_) {
+        case opcode_byte: {
+            // no extensions are negotiated, so the reserved bits must be 0
+            uint8_t opcode = input & 0x0f;
+            if ((input & 0x70) != 0 || !isValidOpcode(opcode)) {
+                return bad;
+            }
+            fin_ = (input & 0x80) != 0;
+            if (isControl(opcode) && !fin_) {
+                return bad;
+            }
+            opcode_ = static_cast<opcode_type>(opcode);
+            state_ = length_byte;
+            return indeterminate;
+        }
+        case length_byte: {
+            // client frames must be masked
+            if ((input & 0x80) == 0) {
+                return bad;
+            }
+            uint8_t length = input & 0x7f;
+            if (isControl(opcode_) && length > 125) {
+                return bad;
+            }
+            length_ = 0;
+            headerBytes_ = 0;
+            if (length == 126) {
+                headerBytes_ = 2;
+                state_ = extended_length;
+            } else if (length == 127) {
+                headerBytes_ = 8;
+                state_ = extended_length;
+            } else {
+                length_ = length;
+                state_ = masking_key;
+            }
+            return indeterminate;
+        }
+        case extended_length:
+            length_ = (length_ << 8) | input;
+            if (--headerBytes_ == 0) {
+                // the most significant bit of a 64 bit length must be 0
+                if ((length_ >> 63) != 0) {
+                    return bad;
+                }
+                state_ = masking_key;
+            }
+            return indeterminate;
+        case masking_key:
+            mask_[headerBytes_++] = input;
+            if (headerBytes_ == 4) {
+                received_ = 0;
+                state_ = payload;
+            }
+            return indeterminate;
+        default:
+            return bad;
+    }
+}
+
+}  // namespace beauty
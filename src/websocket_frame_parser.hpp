@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace beauty {
+
+// Incremental parser for WebSocket frames sent by a client (RFC 6455). The
+// payload is unmasked in place and returned as chunks pointing into the
+// receive buffer, so a frame that fits in one read is never copied.
+class WebSocketFrameParser {
+   public:
+    WebSocketFrameParser();
+
+    // Reset to initial parser state.
+    void reset();
+
+    enum opcode_type {
+        continuation = 0x0,
+        text = 0x1,
+        binary = 0x2,
+        close = 0x8,
+        ping = 0x9,
+        pong = 0xa
+    };
+
+    // Result of parse.
+    enum result_type { chunk, bad, indeterminate };
+
+    // Payload data of a frame. A frame split over several reads is returned
+    // as several chunks, first_ is set for the first and last_ for the last.
+    struct Chunk {
+        opcode_type opcode_;
+        bool fin_;
+        bool first_;
+        bool last_;
+        char *data_;
+        size_t size_;
+    };
+
+    // Parse frames from [begin, end). Returns chunk with begin advanced past
+    // the chunk data, bad if the frame is invalid, indeterminate when begin
+    // reached end before the next chunk. A frame with an empty payload is
+    // returned as one empty chunk.
+    result_type parse(char *&begin, char *end, Chunk &chunk);
+
+    // XOR size bytes of data with mask, starting offset bytes into the
+    // payload.
+    static void unmask(char *data, size_t size, const uint8_t mask[4], size_t offset);
+
+   private:
+    // Handle the next byte of the frame header.
+    result_type consume(uint8_t input);
+
+    // The current state of the parser.
+    enum state {
+        opcode_byte,
+        length_byte,
+        extended_length,
+        masking_key,
+        payload
+    } state_;
+
+    opcode_type opcode_;
+    bool fin_;
+    uint64_t length_;
+    uint64_t received_;
+    unsigned headerBytes_;
+    uint8_t mask_[4];
+};
+
+}  // namespace beauty
@@ -0,0 +1,87 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+
+#include "buffer_pool.hpp"
+
+using namespace beauty;
+
+TEST_CASE("buffer pool", "[buffer_pool]") {
+    const size_t maxContentSize = 4096;
+    BufferPool pool(maxContentSize, 2 * maxContentSize);
+    std::vector<char> buffer;
+
+    SECTION("it should acquire buffers in size classes") {
+        pool.acquire(buffer, 0);
+        REQUIRE(buffer.empty());
+        REQUIRE(buffer.capacity() == minBufferSize);
+        pool.release(buffer);
+
+        pool.acquire(buffer, 1500);
+        REQUIRE(buffer.capacity() == 2048);
+        pool.release(buffer);
+
+        pool.acquire(buffer, 100000);
+        REQUIRE(buffer.capacity() == maxContentSize);
+        pool.release(buffer);
+        REQUIRE(buffer.capacity() == 0);
+    }
+
+    SECTION("it should reuse released buffers") {
+        pool.acquire(buffer, 0);
+        const char *data = buffer.data();
+        pool.release(buffer);
+
+        std::vector<char> other;
+        pool.acquire(other, 0);
+        REQUIRE(other.data() == data);
+        REQUIRE(pool.getStats().allocations_ == 1);
+        REQUIRE(pool.getStats().reuses_ == 1);
+        pool.release(other);
+    }
+
+    SECTION("it should keep content when growing a buffer") {
+        pool.acquire(buffer, 0);
+        std::string msg = "keep this";
+        buffer.assign(msg.begin(), msg.end());
+        pool.grow(buffer, 3000);
+        REQUIRE(buffer.capacity() == maxContentSize);
+        REQUIRE(std::string(buffer.begin(), buffer.end()) == msg);
+
+        // the smaller buffer is kept for reuse
+        REQUIRE(pool.getStats().inUse_ == 1);
+        REQUIRE(pool.getStats().inUseBytes_ == maxContentSize);
+        REQUIRE(pool.getStats().free_ == 1);
+        REQUIRE(pool.getStats().freeBytes_ == minBufferSize);
+        pool.release(buffer);
+        REQUIRE(pool.getStats().inUseBytes_ == 0);
+    }
+
+    SECTION("it should limit the memory of free buffers") {
+        std::vector<char> buffers[3];
+        for (auto &b : buffers) {
+            pool.acquire(b, maxContentSize);
+        }
+        REQUIRE(pool.getStats().inUse_ == 3);
+        REQUIRE(pool.getStats().inUseBytes_ == 3 * maxContentSize);
+        for (auto &b : buffers) {
+            pool.release(b);
+        }
+        auto stats = pool.getStats();
+        REQUIRE(stats.inUse_ == 0);
+        REQUIRE(stats.inUseBytes_ == 0);
+        REQUIRE(stats.free_ == 2);
+        REQUIRE(stats.freeBytes_ == 2 * maxContentSize);
+
+        pool.setMaxFreeBytes(maxContentSize);
+        REQUIRE(pool.getStats().free_ == 1);
+        REQUIRE(pool.getStats().freeBytes_ == maxContentSize);
+    }
+
+    SECTION("it should not keep buffers outside the size classes") {
+        buffer.reserve(2 * maxContentSize);
+        pool.release(buffer);
+        REQUIRE(pool.getStats().free_ == 0);
+        REQUIRE(buffer.capacity() == 0);
+    }
+}
@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+#include "event_stream.hpp"
+
+using namespace beauty;
+
+namespace {
+
+SerializedEvent event(const std::string& data) {
+    return EventBroadcaster::serialize(data);
+}
+
+// The events currently queued, in order.
+std::string drain(EventQueue& queue) {
+    std::string out;
+    for (const asio::const_buffer& b : queue.startWrite(100)) {
+        out.append(static_cast<const char*>(b.data()), b.size());
+    }
+    queue.written();
+    return out;
+}
+
+}  // namespace
+
+TEST_CASE("event stream serialization", "[event_stream]") {
+    SECTION("it should render a data only event") {
+        REQUIRE(*EventBroadcaster::serialize("42") == "data: 42\n\n");
+        REQUIRE(*EventBroadcaster::serialize("") == "data: \n\n");
+    }
+    SECTION("it should render event and id fields") {
+        REQUIRE(*EventBroadcaster::serialize("{\"t\":1}", "temp", "7") ==
+                "event: temp\nid: 7\ndata: {\"t\":1}\n\n");
+    }
+    SECTION("it should split multi-line data") {
+        REQUIRE(*EventBroadcaster::serialize("a\nb\n") == "data: a\ndata: b\ndata: \n\n");
+    }
+    SECTION("it should split data on CRLF and a bare CR") {
+        REQUIRE(*EventBroadcaster::serialize("a\r\nb") == "data: a\ndata: b\n\n");
+        REQUIRE(*EventBroadcaster::serialize("a\rb\r") == "data: a\ndata: b\ndata: \n\n");
+        REQUIRE(*EventBroadcaster::serialize("a\r\rb") == "data: a\ndata: \ndata: b\n\n");
+    }
+    SECTION("it should drop line breaks from the event field") {
+        REQUIRE(*EventBroadcaster::serialize("x", "temp\n\ndata: forged\n") ==
+                "event: tempdata: forged\ndata: x\n\n");
+        REQUIRE(*EventBroadcaster::serialize("x", "a\rb") == "event: ab\ndata: x\n\n");
+    }
+    SECTION("it should drop line breaks from the id field") {
+        REQUIRE(*EventBroadcaster::serialize("x", "", "7\r\nevent: forged") ==
+                "id: 7event: forged\ndata: x\n\n");
+    }
+}
+
+TEST_CASE("event queue", "[event_stream]") {
+    SECTION("it should share the serialized event") {
+        EventQueue queue(4, EventBroadcaster::drop_oldest);
+        SerializedEvent e = event("x");
+        REQUIRE(queue.push(e));
+        auto buffers = queue.startWrite(16);
+        REQUIRE(buffers.size() == 1);
+        REQUIRE(buffers[0].data() == e->data());
+    }
+    SECTION("it should drop the oldest waiting event") {
+        EventQueue queue(2, EventBroadcaster::drop_oldest);
+        REQUIRE(queue.push(event("1")));
+        queue.startWrite(16);
+        REQUIRE(queue.push(event("2")));
+        REQUIRE(queue.push(event("3")));
+        REQUIRE(queue.push(event("4")));
+        REQUIRE(queue.waiting() == 2);
+        REQUIRE(queue.dropped() == 1);
+        // the event being written is kept
+        queue.written();
+        REQUIRE(drain(queue) == "data: 3\n\ndata: 4\n\n");
+    }
+    SECTION("it should drop the newest event") {
+        EventQueue queue(2, EventBroadcaster::drop_newest);
+        REQUIRE(queue.push(event("1")));
+        REQUIRE(queue.push(event("2")));
+        REQUIRE(queue.push(event("3")));
+        REQUIRE(queue.dropped() == 1);
+        REQUIRE(drain(queue) == "data: 1\n\ndata: 2\n\n");
+    }
+    SECTION("it should keep only the latest event") {
+        EventQueue queue(2, EventBroadcaster::keep_latest);
+        REQUIRE(queue.push(event("1")));
+        REQUIRE(queue.push(event("2")));
+        REQUIRE(queue.push(event("3")));
+        REQUIRE(queue.dropped() == 2);
+        REQUIRE(drain(queue) == "data: 3\n\n");
+    }
+    SECTION("it should ask to disconnect") {
+        EventQueue queue(1, EventBroadcaster::disconnect);
+        REQUIRE(queue.push(event("1")));
+        REQUIRE_FALSE(queue.push(event("2")));
+    }
+}
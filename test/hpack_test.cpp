@@ -0,0 +1,189 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "hpack.hpp"
+
+using namespace beauty;
+
+namespace {
+
+std::vector<uint8_t> fromHex(const std::string& hex) {
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        if (hex[i] == ' ') {
+            --i;
+            continue;
+        }
+        bytes.push_back(static_cast<uint8_t>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    return bytes;
+}
+
+bool decode(HpackDecoder& decoder, const std::string& hex, std::vector<Header>& headers) {
+    std::vector<uint8_t> block = fromHex(hex);
+    headers.clear();
+    return decoder.decode(block.data(), block.size(), headers);
+}
+
+void requireHeader(const Header& header, const std::string& name, const std::string& value) {
+    REQUIRE(header.name_ == name);
+    REQUIRE(header.value_ == value);
+}
+
+}  // namespace
+
+TEST_CASE("hpack decoder", "[hpack]") {
+    HpackDecoder decoder;
+    std::vector<Header> headers;
+
+    SECTION("it should decode requests without Huffman coding, RFC 7541 C.3") {
+        REQUIRE(decode(decoder, "828684410f7777772e6578616d706c652e636f6d", headers));
+        REQUIRE(headers.size() == 4);
+        requireHeader(headers[0], ":method", "GET");
+        requireHeader(headers[1], ":scheme", "http");
+        requireHeader(headers[2], ":path", "/");
+        requireHeader(headers[3], ":authority", "www.example.com");
+        REQUIRE(decoder.tableSize() == 57);
+
+        REQUIRE(decode(decoder, "828684be58086e6f2d6361636865", headers));
+        REQUIRE(headers.size() == 5);
+        requireHeader(headers[3], ":authority", "www.example.com");
+        requireHeader(headers[4], "cache-control", "no-cache");
+        REQUIRE(decoder.tableSize() == 110);
+
+        REQUIRE(decode(decoder,
+                       "828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565",
+                       headers));
+        REQUIRE(headers.size() == 5);
+        requireHeader(headers[1], ":scheme", "https");
+        requireHeader(headers[2], ":path", "/index.html");
+        requireHeader(headers[3], ":authority", "www.example.com");
+        requireHeader(headers[4], "custom-key", "custom-value");
+        REQUIRE(decoder.tableSize() == 164);
+    }
+
+    SECTION("it should decode requests with Huffman coding, RFC 7541 C.4") {
+        REQUIRE(decode(decoder, "828684418cf1e3c2e5f23a6ba0ab90f4ff", headers));
+        requireHeader(headers[3], ":authority", "www.example.com");
+        REQUIRE(decode(decoder, "828684be5886a8eb10649cbf", headers));
+        requireHeader(headers[4], "cache-control", "no-cache");
+        REQUIRE(decode(decoder,
+                       "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf",
+                       headers));
+        requireHeader(headers[4], "custom-key", "custom-value");
+        REQUIRE(decoder.tableSize() == 164);
+    }
+
+    SECTION("it should evict entries from a bounded table, RFC 7541 C.5") {
+        HpackDecoder small(256);
+        REQUIRE(decode(small,
+                       "4803333032580770726976617465611d4d6f6e2c203231204f637420323031332032"
+                       "303a31333a323120474d546e1768747470733a2f2f7777772e6578616d706c652e636f"
+                       "6d",
+                       headers));
+        REQUIRE(headers.size() == 4);
+        requireHeader(headers[0], ":status", "302");
+        requireHeader(headers[3], "location", "https://www.example.com");
+        REQUIRE(small.tableSize() == 222);
+
+        // :status 302 is evicted to make room for :status 307
+        REQUIRE(decode(small, "4803333037c1c0bf", headers));
+        requireHeader(headers[0], ":status", "307");
+        requireHeader(headers[1], "cache-control", "private");
+        requireHeader(headers[2], "date", "Mon, 21 Oct 2013 20:13:21 GMT");
+        requireHeader(headers[3], "location", "https://www.example.com");
+        REQUIRE(small.tableSize() == 222);
+    }
+
+    SECTION("it should apply table size updates within the limit") {
+        REQUIRE(decode(decoder, "828684410f7777772e6578616d706c652e636f6d", headers));
+        REQUIRE(decoder.tableSize() == 57);
+        REQUIRE(decode(decoder, "2082", headers));
+        REQUIRE(decoder.tableSize() == 0);
+
+        decoder.setMaxTableSize(100);
+        // 4096 is above the limit
+        REQUIRE_FALSE(decode(decoder, "3fe11f82", headers));
+    }
+
+    SECTION("it should reject invalid blocks") {
+        // index 0
+        REQUIRE_FALSE(decode(decoder, "80", headers));
+        // beyond the dynamic table
+        REQUIRE_FALSE(decode(decoder, "be", headers));
+        // truncated string
+        REQUIRE_FALSE(decode(decoder, "410f7777", headers));
+        // size update after a field
+        REQUIRE_FALSE(decode(decoder, "8220", headers));
+        // padding longer than 7 bits
+        REQUIRE_FALSE(decode(decoder, "4182ffff", headers));
+    }
+
+    SECTION("it should bound the decoded header list") {
+        // a 4000 byte entry in the dynamic table, then references to it
+        std::string block("\x40\x01x\x7f\xa1\x1e", 6);
+        block.append(4000, 'a');
+        std::string references(12000, '\xbe');
+        std::string hugeBlock = block + references;
+        HpackDecoder bounded(8192, 16384);
+        REQUIRE_FALSE(bounded.decode(reinterpret_cast<const uint8_t*>(hugeBlock.data()),
+                                     hugeBlock.size(),
+                                     headers));
+        REQUIRE(headers.size() < 5);
+
+        // name, value and 32 bytes per field, 3 * 4033 fits
+        std::string fitting = block + references.substr(0, 2);
+        headers.clear();
+        HpackDecoder other(8192, 16384);
+        REQUIRE(other.decode(
+            reinterpret_cast<const uint8_t*>(fitting.data()), fitting.size(), headers));
+        REQUIRE(headers.size() == 3);
+    }
+}
+
+TEST_CASE("hpack encoder", "[hpack]") {
+    HpackDecoder decoder;
+    std::vector<Header> headers;
+
+    SECTION("it should use the static table") {
+        std::string block;
+        hpack::encodeStatus(200, block);
+        REQUIRE(block == "\x88");
+        block.clear();
+        hpack::encodeStatus(503, block);
+        // name from the static table, value as literal
+        REQUIRE(block == std::string("\x08\x03" "503"));
+    }
+
+    SECTION("it should encode blocks the decoder reads back") {
+        std::string block;
+        hpack::encodeStatus(404, block);
+        hpack::encode("Content-Type", "text/html; charset=utf-8", block);
+        hpack::encode("X-Custom", "some value", block);
+        hpack::encode("content-length", "1234", block);
+        REQUIRE(decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size(), headers));
+        REQUIRE(headers.size() == 4);
+        requireHeader(headers[0], ":status", "404");
+        requireHeader(headers[1], "content-type", "text/html; charset=utf-8");
+        requireHeader(headers[2], "x-custom", "some value");
+        requireHeader(headers[3], "content-length", "1234");
+        // the dynamic table is never used
+        REQUIRE(decoder.tableSize() == 0);
+    }
+
+    SECTION("it should Huffman code all octets") {
+        std::string input;
+        for (int i = 0; i < 256; ++i) {
+            input.push_back(static_cast<char>(i));
+        }
+        std::string encoded;
+        hpack::huffmanEncode(input.data(), input.size(), encoded);
+        REQUIRE(encoded.size() == hpack::huffmanEncodedSize(input.data(), input.size()));
+        std::string decoded;
+        REQUIRE(hpack::huffmanDecode(
+            reinterpret_cast<const uint8_t*>(encoded.data()), encoded.size(), decoded));
+        REQUIRE(decoded == input);
+    }
+}
@@ -0,0 +1,337 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "buffer_pool.hpp"
+#include "hpack.hpp"
+#include "http2_frame.hpp"
+#include "http2_session.hpp"
+#include "logger.hpp"
+#include "request_handler.hpp"
+#include "utils/mock_file_io.hpp"
+
+using namespace beauty;
+
+namespace {
+
+struct TestFrame {
+    uint8_t type_;
+    uint8_t flags_;
+    uint32_t streamId_;
+    std::string payload_;
+};
+
+std::string frame(uint8_t type, uint8_t flags, uint32_t streamId, const std::string& payload) {
+    std::string out;
+    Http2FrameParser::writeHeader(out, payload.size(), type, flags, streamId);
+    return out + payload;
+}
+
+std::string uint32(uint32_t value) {
+    std::string out;
+    for (int i = 3; i >= 0; --i) {
+        out.push_back(static_cast<char>(value >> (i * 8)));
+    }
+    return out;
+}
+
+std::string setting(uint16_t id, uint32_t value) {
+    return std::string(1, static_cast<char>(id >> 8)) + static_cast<char>(id) + uint32(value);
+}
+
+// The client preface with its SETTINGS.
+std::string preface(const std::string& settings = std::string()) {
+    return std::string(Http2Session::preface, Http2Session::prefaceSize) +
+           frame(Http2FrameParser::settings, 0, 0, settings);
+}
+
+std::string request(uint32_t streamId,
+                    const std::string& method,
+                    const std::string& path,
+                    bool endStream,
+                    const std::vector<Header>& headers = std::vector<Header>()) {
+    std::string block;
+    hpack::encode(":method", method, block);
+    hpack::encode(":scheme", "http", block);
+    hpack::encode(":path", path, block);
+    hpack::encode(":authority", "localhost", block);
+    for (const Header& h : headers) {
+        hpack::encode(h.name_, h.value_, block);
+    }
+    uint8_t flags = Http2FrameParser::end_headers | (endStream ? Http2FrameParser::end_stream : 0);
+    return frame(Http2FrameParser::headers, flags, streamId, block);
+}
+
+// Write everything the session queued and parse it into frames.
+std::vector<TestFrame> drain(Http2Session& session) {
+    std::string bytes;
+    while (session.hasOutput()) {
+        for (const asio::const_buffer& b : session.startWrite()) {
+            bytes.append(static_cast<const char*>(b.data()), b.size());
+        }
+        session.written();
+    }
+    std::vector<TestFrame> frames;
+    Http2FrameParser parser;
+    Http2FrameParser::Frame f;
+    const char* begin = bytes.data();
+    while (parser.parse(begin, bytes.data() + bytes.size(), f) == Http2FrameParser::frame) {
+        frames.push_back({f.type_,
+                          f.flags_,
+                          f.streamId_,
+                          std::string(reinterpret_cast<const char*>(f.payload_), f.size_)});
+    }
+    return frames;
+}
+
+std::vector<TestFrame> framesOf(const std::vector<TestFrame>& frames,
+                                uint8_t type,
+                                uint32_t streamId) {
+    std::vector<TestFrame> out;
+    for (const TestFrame& f : frames) {
+        if (f.type_ == type && f.streamId_ == streamId) {
+            out.push_back(f);
+        }
+    }
+    return out;
+}
+
+std::string dataOf(const std::vector<TestFrame>& frames, uint32_t streamId) {
+    std::string data;
+    for (const TestFrame& f : framesOf(frames, Http2FrameParser::data, streamId)) {
+        data += f.payload_;
+    }
+    return data;
+}
+
+std::vector<Header> headersOf(HpackDecoder& decoder, const TestFrame& f) {
+    std::vector<Header> headers;
+    decoder.decode(reinterpret_cast<const uint8_t*>(f.payload_.data()), f.payload_.size(), headers);
+    return headers;
+}
+
+}  // namespace
+
+TEST_CASE("http2 frame parser", "[http2]") {
+    Http2FrameParser parser;
+    Http2FrameParser::Frame f;
+
+    SECTION("it should return a frame in place") {
+        std::string input = frame(Http2FrameParser::ping, 0, 0, "12345678");
+        const char* begin = input.data();
+        REQUIRE(parser.parse(begin, input.data() + input.size(), f) == Http2FrameParser::frame);
+        REQUIRE(f.type_ == Http2FrameParser::ping);
+        REQUIRE(f.size_ == 8);
+        REQUIRE(reinterpret_cast<const char*>(f.payload_) == input.data() + 9);
+        REQUIRE(begin == input.data() + input.size());
+    }
+
+    SECTION("it should join a frame split over reads") {
+        std::string input = frame(Http2FrameParser::data, 1, 3, "hello") +
+                            frame(Http2FrameParser::data, 0, 5, "world");
+        const char* begin = input.data();
+        REQUIRE(parser.parse(begin, input.data() + 4, f) == Http2FrameParser::indeterminate);
+        REQUIRE(parser.parse(begin, input.data() + 12, f) == Http2FrameParser::indeterminate);
+        REQUIRE(parser.parse(begin, input.data() + input.size(), f) == Http2FrameParser::frame);
+        REQUIRE(f.streamId_ == 3);
+        REQUIRE(f.flags_ == 1);
+        REQUIRE(std::string(reinterpret_cast<const char*>(f.payload_), f.size_) == "hello");
+        REQUIRE(parser.parse(begin, input.data() + input.size(), f) == Http2FrameParser::frame);
+        REQUIRE(f.streamId_ == 5);
+        REQUIRE(parser.parse(begin, input.data() + input.size(), f) ==
+                Http2FrameParser::indeterminate);
+    }
+
+    SECTION("it should reject a frame larger than the max frame size") {
+        std::string input = frame(Http2FrameParser::data, 0, 1, std::string(16385, 'x'));
+        const char* begin = input.data();
+        REQUIRE(parser.parse(begin, input.data() + input.size(), f) == Http2FrameParser::bad);
+    }
+}
+
+TEST_CASE("http2 session", "[http2]") {
+    MockFileIO fileIO;
+    RequestHandler handler(&fileIO);
+    BufferPool pool(1024, 4096);
+    Logger logger;
+    HpackDecoder decoder;
+    Http2Session session(handler, pool, 0, 1024, Http2Options(true, 4), logger);
+    session.start();
+
+    handler.addRequestHandler([](const Request& req, Reply& rep) {
+        if (req.requestPath_ == "/echo") {
+            rep.content_.assign(req.body_.begin(), req.body_.end());
+            rep.send(Reply::ok, "text/plain");
+        } else if (req.startsWith("/hello")) {
+            std::string hello = "Hello " + req.getHeaderValue("Host");
+            rep.content_.assign(hello.begin(), hello.end());
+            rep.send(Reply::ok, "text/plain");
+        }
+    });
+
+    SECTION("it should answer a request on a stream") {
+        std::string input = preface() + request(1, "GET", "/hello", true);
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+
+        // server SETTINGS, then the ACK of the client SETTINGS
+        REQUIRE(frames.size() == 4);
+        REQUIRE(frames[0].type_ == Http2FrameParser::settings);
+        REQUIRE(frames[0].flags_ == 0);
+        // SETTINGS_MAX_HEADER_LIST_SIZE 16384
+        REQUIRE(frames[0].payload_.find(std::string("\x00\x06\x00\x00\x40\x00", 6)) !=
+                std::string::npos);
+        REQUIRE(frames[1].type_ == Http2FrameParser::settings);
+        REQUIRE(frames[1].flags_ == Http2FrameParser::ack);
+
+        REQUIRE(frames[2].type_ == Http2FrameParser::headers);
+        REQUIRE(frames[2].streamId_ == 1);
+        std::vector<Header> headers = headersOf(decoder, frames[2]);
+        REQUIRE(headers.size() == 3);
+        REQUIRE(headers[0].name_ == ":status");
+        REQUIRE(headers[0].value_ == "200");
+        REQUIRE(headers[1].name_ == "content-length");
+        REQUIRE(headers[1].value_ == "15");
+
+        REQUIRE(frames[3].type_ == Http2FrameParser::data);
+        REQUIRE(frames[3].flags_ == Http2FrameParser::end_stream);
+        REQUIRE(frames[3].payload_ == "Hello localhost");
+        REQUIRE(session.isIdle());
+    }
+
+    SECTION("it should serve multiplexed streams") {
+        std::string input = preface() + request(1, "GET", "/hello/1", true) +
+                            request(3, "GET", "/hello/3", true) +
+                            request(5, "GET", "/missing", true);
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+        REQUIRE(dataOf(frames, 1) == "Hello localhost");
+        REQUIRE(dataOf(frames, 3) == "Hello localhost");
+
+        // the stock reply is sent with its precomputed header block
+        std::vector<TestFrame> headers = framesOf(frames, Http2FrameParser::headers, 5);
+        REQUIRE(headers.size() == 1);
+        REQUIRE(headersOf(decoder, headers[0])[0].value_ == "404");
+        REQUIRE(dataOf(frames, 5).find("404 Not Found") != std::string::npos);
+        REQUIRE(session.isIdle());
+    }
+
+    SECTION("it should buffer a request body") {
+        std::string input = preface() + request(1, "POST", "/echo", false) +
+                            frame(Http2FrameParser::data, 0, 1, "ping ") +
+                            frame(Http2FrameParser::data, Http2FrameParser::end_stream, 1, "pong");
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+        REQUIRE(dataOf(frames, 1) == "ping pong");
+        // the connection window is given back as data arrives
+        REQUIRE(framesOf(frames, Http2FrameParser::window_update, 0).size() == 2);
+    }
+
+    SECTION("it should send within the flow control window") {
+        fileIO.createMockFile(100);
+        // a window of 30 bytes per stream
+        std::string input = preface(setting(0x4, 30)) + request(1, "GET", "/file.bin", true);
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+        REQUIRE(dataOf(frames, 1).size() == 30);
+        REQUIRE_FALSE(session.isIdle());
+
+        input = frame(Http2FrameParser::window_update, 0, 1, uint32(50));
+        session.receive(input.data(), input.size());
+        frames = drain(session);
+        REQUIRE(dataOf(frames, 1).size() == 50);
+
+        input = frame(Http2FrameParser::window_update, 0, 1, uint32(100));
+        session.receive(input.data(), input.size());
+        frames = drain(session);
+        REQUIRE(dataOf(frames, 1).size() == 20);
+        REQUIRE(frames.back().flags_ == Http2FrameParser::end_stream);
+        REQUIRE(session.isIdle());
+    }
+
+    SECTION("it should read files in parts one stream at a time") {
+        // larger than maxContentSize, so the file is read in parts
+        fileIO.createMockFile(3000);
+        std::string input = preface() + request(1, "GET", "/a.bin", true) +
+                            request(3, "GET", "/b.bin", true);
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+        // MockFileIO throws if the file of the connection is opened twice
+        REQUIRE(dataOf(frames, 1).size() == 3000);
+        REQUIRE(dataOf(frames, 3).size() == 3000);
+        REQUIRE(fileIO.getOpenFileForReadCalls() == 2);
+        REQUIRE(session.isIdle());
+    }
+
+    SECTION("it should give back the window of data dropped by a reset") {
+        fileIO.createMockFile(3000);
+        std::string input = preface();
+        session.receive(input.data(), input.size());
+        drain(session);
+
+        // each reset drops a queued part of the file, together more than the
+        // connection window of 65535 bytes
+        for (uint32_t id = 1; id < 2 * 100; id += 2) {
+            input = request(id, "GET", "/file.bin", true);
+            session.receive(input.data(), input.size());
+            input = frame(Http2FrameParser::rst_stream, 0, id, uint32(Http2Session::cancel));
+            session.receive(input.data(), input.size());
+        }
+        drain(session);
+
+        input = request(201, "GET", "/hello", true);
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+        REQUIRE(dataOf(frames, 201) == "Hello localhost");
+        REQUIRE(session.isIdle());
+    }
+
+    SECTION("it should refuse streams over the limit") {
+        std::string input = preface() + request(1, "POST", "/echo", false) +
+                            request(3, "POST", "/echo", false) +
+                            request(5, "POST", "/echo", false) +
+                            request(7, "POST", "/echo", false) + request(9, "GET", "/hello", true);
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+        std::vector<TestFrame> resets = framesOf(frames, Http2FrameParser::rst_stream, 9);
+        REQUIRE(resets.size() == 1);
+        REQUIRE(resets[0].payload_ == uint32(Http2Session::refused_stream));
+    }
+
+    SECTION("it should reset a malformed request") {
+        std::vector<Header> headers = {{"connection", "keep-alive"}};
+        std::string input = preface() + request(1, "GET", "/hello", true, headers);
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+        std::vector<TestFrame> resets = framesOf(frames, Http2FrameParser::rst_stream, 1);
+        REQUIRE(resets.size() == 1);
+        REQUIRE(resets[0].payload_ == uint32(Http2Session::protocol_error));
+        REQUIRE_FALSE(session.isClosing());
+    }
+
+    SECTION("it should answer a PING") {
+        std::string input = preface() + frame(Http2FrameParser::ping, 0, 0, "abcdefgh");
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+        REQUIRE(frames.back().type_ == Http2FrameParser::ping);
+        REQUIRE(frames.back().flags_ == Http2FrameParser::ack);
+        REQUIRE(frames.back().payload_ == "abcdefgh");
+    }
+
+    SECTION("it should close on a connection error") {
+        std::string input = preface() + request(1, "GET", "/hello", true) +
+                            frame(Http2FrameParser::data, 0, 0, "x");
+        session.receive(input.data(), input.size());
+        std::vector<TestFrame> frames = drain(session);
+        REQUIRE(frames.back().type_ == Http2FrameParser::goaway);
+        REQUIRE(frames.back().payload_ == uint32(1) + uint32(Http2Session::protocol_error));
+        REQUIRE(session.isClosing());
+    }
+
+    SECTION("it should reject an invalid preface") {
+        std::string input = "GET / HTTP/1.1\r\n\r\n";
+        session.receive(input.data(), input.size());
+        REQUIRE(session.isClosing());
+    }
+}
@@ -0,0 +1,111 @@
+#include <catch2/catch_test_macros.hpp>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_log_sink.hpp"
+#include "logger.hpp"
+
+using namespace beauty;
+
+namespace {
+
+// Log messages are captured by value, so count through a pointer.
+std::string formatCounted(int *count, const std::string &msg) {
+    (*count)++;
+    return msg;
+}
+
+}  // namespace
+
+TEST_CASE("logger", "[logger]") {
+    Logger logger;
+    int formatCount = 0;
+    int *counter = &formatCount;
+
+    SECTION("it should not format without a sink") {
+        BEAUTY_LOG(logger, LogLevel::error, formatCounted(counter, "msg"));
+        REQUIRE(formatCount == 0);
+    }
+    SECTION("it should format when sink accepts level") {
+        std::vector<std::string> msgs;
+        logger.setDebugMsgHandler([&](const std::string &msg) { msgs.push_back(msg); });
+        BEAUTY_LOG(logger, LogLevel::debug, formatCounted(counter, "msg"));
+        REQUIRE(formatCount == 1);
+        REQUIRE(msgs.size() == 1);
+        REQUIRE(msgs[0] == "msg");
+    }
+    SECTION("it should not format below sink level") {
+        std::vector<std::string> msgs;
+        CallbackLogSink sink([&](const std::string &msg) { msgs.push_back(msg); },
+                             LogLevel::warning);
+        logger.setSink(&sink);
+        BEAUTY_LOG(logger, LogLevel::info, formatCounted(counter, "info"));
+        BEAUTY_LOG(logger, LogLevel::error, formatCounted(counter, "error"));
+        REQUIRE(formatCount == 1);
+        REQUIRE(msgs.size() == 1);
+        REQUIRE(msgs[0] == "error");
+    }
+    SECTION("it should stop logging when sink is removed") {
+        std::vector<std::string> msgs;
+        CallbackLogSink sink([&](const std::string &msg) { msgs.push_back(msg); });
+        logger.setSink(&sink);
+        logger.setSink(nullptr);
+        BEAUTY_LOG(logger, LogLevel::error, formatCounted(counter, "msg"));
+        REQUIRE(formatCount == 0);
+    }
+}
+
+TEST_CASE("async log sink", "[logger]") {
+    std::mutex mutex;
+    std::vector<std::string> msgs;
+    std::vector<std::thread::id> threadIds;
+    auto output = [&](LogLevel level, const std::string &msg) {
+        std::lock_guard<std::mutex> lock(mutex);
+        msgs.push_back(std::string(toString(level)) + ": " + msg);
+        threadIds.push_back(std::this_thread::get_id());
+    };
+
+    SECTION("it should format and output on a background thread") {
+        {
+            Logger logger;
+            AsyncLogSink sink(output, LogLevel::info);
+            logger.setSink(&sink);
+            BEAUTY_LOG(logger, LogLevel::debug, std::string("dropped by level"));
+            for (int i = 0; i < 10; ++i) {
+                BEAUTY_LOG(logger, LogLevel::warning, "msg " + std::to_string(i));
+            }
+        }  // sink destructor flushes
+        REQUIRE(msgs.size() == 10);
+        REQUIRE(msgs[0] == "warning: msg 0");
+        REQUIRE(msgs[9] == "warning: msg 9");
+        REQUIRE(threadIds[0] != std::this_thread::get_id());
+    }
+    SECTION("it should drop messages when the queue is full") {
+        std::promise<void> started;
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        auto slowOutput = [&started, released](LogLevel, const std::string &msg) {
+            if (msg == "first") {
+                started.set_value();
+                released.wait();
+            }
+        };
+        AsyncLogSink sink(slowOutput, LogLevel::debug, 2);
+        Logger logger;
+        logger.setSink(&sink);
+        BEAUTY_LOG(logger, LogLevel::info, std::string("first"));
+        // the background thread has taken the first message off the queue
+        // and blocks in its output
+        started.get_future().wait();
+        for (int i = 0; i < 5; ++i) {
+            BEAUTY_LOG(logger, LogLevel::info, std::string("queued"));
+        }
+        size_t dropped = sink.getDroppedCount();
+        // unblock before checking, the sink destructor waits for the output
+        release.set_value();
+        REQUIRE(dropped == 3);
+    }
+}
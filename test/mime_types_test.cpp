@@ -0,0 +1,49 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "mime_types.hpp"
+
+using namespace beauty;
+
+TEST_CASE("mime types", "[mime_types]") {
+    SECTION("it should map known extensions") {
+        REQUIRE(mime_types::extensionToType("html") == "text/html");
+        REQUIRE(mime_types::extensionToType("js") == "application/javascript");
+        REQUIRE(mime_types::extensionToType("svg") == "image/svg+xml");
+        REQUIRE(mime_types::extensionToType("wasm") == "application/wasm");
+        REQUIRE(mime_types::extensionToType("woff2") == "font/woff2");
+        REQUIRE(mime_types::extensionToType("mp4") == "video/mp4");
+        REQUIRE(mime_types::extensionToType("bin") == "application/octet-stream");
+        REQUIRE(mime_types::extensionToType("webmanifest") == "application/manifest+json");
+    }
+    SECTION("it should ignore case") {
+        REQUIRE(mime_types::extensionToType("PNG") == "image/png");
+        REQUIRE(mime_types::extensionToType("Jpeg") == "image/jpeg");
+    }
+    SECTION("it should fall back to text/plain") {
+        REQUIRE(mime_types::extensionToType("") == "text/plain");
+        REQUIRE(mime_types::extensionToType("nosuchtype") == "text/plain");
+        REQUIRE(mime_types::extensionToType("htmlx") == "text/plain");
+        REQUIRE(mime_types::extensionToType("averyverylongextension") == "text/plain");
+    }
+    SECTION("it should map every built in extension to its type") {
+        size_t size = 0;
+        const mime_types::Mapping *mappings = mime_types::builtInTypes(size);
+        REQUIRE(size > 0);
+        for (size_t i = 0; i < size; ++i) {
+            REQUIRE(mime_types::extensionToType(mappings[i].extension) == mappings[i].mime_type);
+        }
+    }
+    SECTION("it should use added types before built in ones") {
+        mime_types::addType("Foo", "application/x-foo");
+        mime_types::addType("json", "application/x-test+json");
+        REQUIRE(mime_types::extensionToType("foo") == "application/x-foo");
+        REQUIRE(mime_types::extensionToType("json") == "application/x-test+json");
+        mime_types::addType("json", "application/x-other+json");
+        REQUIRE(mime_types::extensionToType("json") == "application/x-other+json");
+
+        mime_types::removeType("FOO");
+        mime_types::removeType("json");
+        REQUIRE(mime_types::extensionToType("foo") == "text/plain");
+        REQUIRE(mime_types::extensionToType("json") == "application/json");
+    }
+}
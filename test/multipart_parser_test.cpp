@@ -13,9 +13,6 @@ std::vector<char> convertToCharVec(const std::string &s) {
 }
 
 struct Fixture {
-    Fixture(size_t maxContentSize) : parser_(content_) {
-        content_.reserve(maxContentSize);
-    }
     bool parseHeader(const Request &req) {
         return parser_.parseHeader(req);
     }
@@ -25,22 +22,13 @@ struct Fixture {
         return parser_.parse(req, content, parts);
     }
 
-    void flush(std::vector<char> &content, std::deque<MultiPartParser::ContentPart> &parts) {
-        parser_.flush(content, parts);
-    }
-
-    const std::deque<MultiPartParser::ContentPart> &peakLastPart() const {
-        return parser_.peakLastPart();
-    }
-
-    std::vector<char> content_;
     MultiPartParser parser_;
 };
 
 }  // namespace
 
 TEST_CASE("parse header", "[multipart_parser]") {
-    Fixture fixture(1024);
+    Fixture fixture;
     std::vector<char> body;  // not used in tests
     Request request(body);
 
@@ -63,7 +51,7 @@ TEST_CASE("parse header", "[multipart_parser]") {
 }
 
 TEST_CASE("parse single part content", "[multipart_parser]") {
-    Fixture fixture(1024);
+    Fixture fixture;
     std::vector<char> body;  // not used in tests
     Request request(body);
     request.headers_.push_back({"From", "user@example.com"});
@@ -83,13 +71,8 @@ TEST_CASE("parse single part content", "[multipart_parser]") {
     std::vector<char> content = convertToCharVec(contentStr);
 
     SECTION("should return done for single parts") {
-        // getting back the initial empty parts
         std::deque<MultiPartParser::ContentPart> parts;
         REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
-        REQUIRE(parts.size() == 0);
-
-        // result==done so call flush
-        fixture.flush(content, parts);
         REQUIRE(parts.size() == 1);
         REQUIRE(parts[0].filename_ == "testfile01.txt");
         REQUIRE(parts[0].foundStart_);
@@ -100,7 +83,7 @@ TEST_CASE("parse single part content", "[multipart_parser]") {
 }
 
 TEST_CASE("parse multi-part content", "[multipart_parser]") {
-    Fixture fixture(1024);
+    Fixture fixture;
     std::vector<char> body;  // not used in tests
     Request request(body);
     request.headers_.push_back({"From", "user@example.com"});
@@ -126,12 +109,7 @@ TEST_CASE("parse multi-part content", "[multipart_parser]") {
 
     SECTION("should return done for multiple parts") {
         std::deque<MultiPartParser::ContentPart> parts;
-        // getting back the initial empty parts
         REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
-        REQUIRE(parts.size() == 0);
-
-        // result==done so call flush
-        fixture.flush(content, parts);
         REQUIRE(parts.size() == 2);
         REQUIRE(parts[0].filename_ == "testfile01.txt");
         REQUIRE(parts[0].foundStart_);
@@ -140,15 +118,15 @@ TEST_CASE("parse multi-part content", "[multipart_parser]") {
         REQUIRE(*(parts[0].end_ - 2) == '.');
 
         REQUIRE(parts[1].filename_ == "testfile02.txt");
-        REQUIRE(parts[0].foundStart_);
+        REQUIRE(parts[1].foundStart_);
         REQUIRE(*parts[1].start_ == 'S');
-        REQUIRE(parts[0].foundEnd_);
+        REQUIRE(parts[1].foundEnd_);
         REQUIRE(*(parts[1].end_ - 2) == '!');
     }
 }
 
 TEST_CASE("parse until start of content", "[multipart_parser]") {
-    Fixture fixture(1024);
+    Fixture fixture;
     std::vector<char> body;  // not used in tests
     Request request(body);
     request.headers_.push_back({"From", "user@example.com"});
@@ -165,27 +143,21 @@ TEST_CASE("parse until start of content", "[multipart_parser]") {
     const std::string contentStr2 =
         "First part.\n\r\n----------------------------567026409988538820744572--\r\n";
 
-    SECTION("should return start and end not found for first part") {
+    SECTION("should return a header only part before the data") {
         std::deque<MultiPartParser::ContentPart> parts;
-        // getting back the initial empty parts
         std::vector<char> content = convertToCharVec(contentStr1);
         REQUIRE(fixture.parse(request, content, parts) ==
                 MultiPartParser::result_type::indeterminate);
-        REQUIRE(parts.size() == 0);
-
-        content = convertToCharVec(contentStr2);
-        REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
         REQUIRE(parts.size() == 1);
         REQUIRE(parts[0].filename_ == "firstpart.txt");
-        REQUIRE(!parts[0].foundStart_);
         REQUIRE(!parts[0].foundEnd_);
         REQUIRE(parts[0].headerOnly_);
 
-        // result == done so call flush
-        fixture.flush(content, parts);
+        content = convertToCharVec(contentStr2);
+        REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
         REQUIRE(parts.size() == 1);
         REQUIRE(parts[0].filename_ == "");
-        REQUIRE(parts[0].foundStart_);
+        REQUIRE(!parts[0].foundStart_);
         REQUIRE(parts[0].foundEnd_);
         REQUIRE(!parts[0].headerOnly_);
         REQUIRE(*parts[0].start_ == 'F');
@@ -194,7 +166,7 @@ TEST_CASE("parse until start of content", "[multipart_parser]") {
 }
 
 TEST_CASE("parse empty content", "[multipart_parser]") {
-    Fixture fixture(1024);
+    Fixture fixture;
     std::vector<char> body;  // not used in tests
     Request request(body);
     request.headers_.push_back({"From", "user@example.com"});
@@ -207,19 +179,14 @@ TEST_CASE("parse empty content", "[multipart_parser]") {
 
     SECTION("should return indeterminate") {
         std::deque<MultiPartParser::ContentPart> parts;
-        // getting back the initial empty parts
         REQUIRE(fixture.parse(request, content, parts) ==
                 MultiPartParser::result_type::indeterminate);
         REQUIRE(parts.size() == 0);
-
-        // result==done so call flush
-        fixture.flush(content, parts);
-        REQUIRE(parts.size() == 0);
     }
 }
 
 TEST_CASE("parse empty part content", "[multipart_parser]") {
-    Fixture fixture(1024);
+    Fixture fixture;
     std::vector<char> body;  // not used in tests
     Request request(body);
     request.headers_.push_back({"From", "user@example.com"});
@@ -239,12 +206,7 @@ TEST_CASE("parse empty part content", "[multipart_parser]") {
 
     SECTION("should return size = 0") {
         std::deque<MultiPartParser::ContentPart> parts;
-        // getting back the initial empty parts
         REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
-        REQUIRE(parts.size() == 0);
-
-        // result==done so call flush
-        fixture.flush(content, parts);
         REQUIRE(parts.size() == 1);
         REQUIRE(parts[0].filename_ == "empty.txt");
         REQUIRE(parts[0].foundStart_);
@@ -254,7 +216,7 @@ TEST_CASE("parse empty part content", "[multipart_parser]") {
 }
 
 TEST_CASE("content start and end in consecutive buffers", "[multipart_parser]") {
-    Fixture fixture(1024);
+    Fixture fixture;
     std::vector<char> body;  // not used in tests
     Request request(body);
     request.headers_.push_back({"From", "user@example.com"});
@@ -271,23 +233,9 @@ TEST_CASE("content start and end in consecutive buffers", "[multipart_parser]")
         "all.\n\r\n------WebKitFormBoundarylSu7ajtLodoq9XHE--\r\n";
     std::deque<MultiPartParser::ContentPart> parts;
 
-    // getting back the initial empty parts
+    // the data of the first buffer is delivered right away..
     std::vector<char> content = convertToCharVec(contentStr1);
     REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::indeterminate);
-    REQUIRE(parts.size() == 0);
-
-    // peaking the last part..
-    const std::deque<MultiPartParser::ContentPart> &peakParts = fixture.peakLastPart();
-    REQUIRE(peakParts.size() == 1);
-    REQUIRE(peakParts[0].filename_ == "testfile01.txt");
-    REQUIRE(peakParts[0].foundStart_);
-    REQUIRE(*peakParts[0].start_ == 'T');
-    REQUIRE(!peakParts[0].foundEnd_);
-    REQUIRE(*(peakParts[0].end_ - 1) == 'o');
-
-    // ..that is actually delivered in the next parse call
-    content = convertToCharVec(contentStr2);
-    REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
     REQUIRE(parts.size() == 1);
     REQUIRE(parts[0].filename_ == "testfile01.txt");
     REQUIRE(parts[0].foundStart_);
@@ -295,8 +243,9 @@ TEST_CASE("content start and end in consecutive buffers", "[multipart_parser]")
     REQUIRE(!parts[0].foundEnd_);
     REQUIRE(*(parts[0].end_ - 1) == 'o');
 
-    // result==done so call flush
-    fixture.flush(content, parts);
+    // ..and the rest with the next one
+    content = convertToCharVec(contentStr2);
+    REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
     REQUIRE(parts.size() == 1);
     REQUIRE(parts[0].filename_ == "");
     REQUIRE(!parts[0].foundStart_);
@@ -306,7 +255,7 @@ TEST_CASE("content start and end in consecutive buffers", "[multipart_parser]")
 }
 
 TEST_CASE("content end in next to last body part", "[multipart_parser]") {
-    Fixture fixture(1024);
+    Fixture fixture;
     std::vector<char> body;  // not used in tests
     Request request(body);
     request.headers_.push_back({"From", "user@example.com"});
@@ -326,35 +275,21 @@ TEST_CASE("content end in next to last body part", "[multipart_parser]") {
     const std::string contentStr5 = "bKitFormBoundarylSu7ajtLodoq9XHE--\r\n";
     std::deque<MultiPartParser::ContentPart> parts;
 
-    // getting back the initial empty parts
+    // contentStr1 ends within the part headers so no part is returned for it
     std::vector<char> content = convertToCharVec(contentStr1);
     REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::indeterminate);
     REQUIRE(parts.size() == 0);
 
-    // Note: Whenever no start or end is found, the multipart parser assumes
-    // that we're in the middle of a large file and creates a part with
-    // start/end to match the entire request.content_ buffer. However as this
-    // use case uses very small contentStr's (75 chars), this situation happens
-    // here for the first contentStr1. For real use cases it must be
-    // a requirement that if receiving any body data in the first request, we
-    // at least get all the first multipart headers.
-    // So here we "overlook" this and get parts.size() == 1, but really it
-    // should be 0. But to get '0', the code would need more logic that in
-    // practise doesn't make much sense.
     content = convertToCharVec(contentStr2);
     REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::indeterminate);
     REQUIRE(parts.size() == 1);
-
-    content = convertToCharVec(contentStr3);
-    REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::indeterminate);
-    REQUIRE(parts.size() == 1);
     REQUIRE(parts[0].filename_ == "testfile01.txt");
     REQUIRE(parts[0].foundStart_);
     REQUIRE(*parts[0].start_ == 'T');
     REQUIRE(!parts[0].foundEnd_);
     REQUIRE(*(parts[0].end_ - 1) == 'o');
 
-    content = convertToCharVec(contentStr4);
+    content = convertToCharVec(contentStr3);
     REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::indeterminate);
     REQUIRE(parts.size() == 1);
     REQUIRE(parts[0].filename_ == "");
@@ -363,22 +298,28 @@ TEST_CASE("content end in next to last body part", "[multipart_parser]") {
     REQUIRE(!parts[0].foundEnd_);
     REQUIRE(*(parts[0].end_ - 1) == ' ');
 
-    content = convertToCharVec(contentStr5);
-    REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
+    // the delimiter prefix ending contentStr4 is held back
+    content = convertToCharVec(contentStr4);
+    REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::indeterminate);
     REQUIRE(parts.size() == 1);
     REQUIRE(parts[0].filename_ == "");
     REQUIRE(!parts[0].foundStart_);
     REQUIRE(*parts[0].start_ == 'n');
-    REQUIRE(parts[0].foundEnd_);
+    REQUIRE(!parts[0].foundEnd_);
     REQUIRE(*(parts[0].end_ - 2) == '.');
+    REQUIRE(content.end() - parts[0].end_ == 10);
 
-    // result==done so call flush
-    fixture.flush(content, parts);
-    REQUIRE(parts.size() == 0);
+    // and completed by contentStr5, ending the part without more data
+    content = convertToCharVec(contentStr5);
+    REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
+    REQUIRE(parts.size() == 1);
+    REQUIRE(parts[0].filename_ == "");
+    REQUIRE(parts[0].foundEnd_);
+    REQUIRE(parts[0].start_ == parts[0].end_);
 }
 
 TEST_CASE("content end in previous body part and last part contain content", "[multipart_parser]") {
-    Fixture fixture(1024);
+    Fixture fixture;
     std::vector<char> body;  // not used in tests
     Request request(body);
     request.headers_.push_back({"From", "user@example.com"});
@@ -402,13 +343,8 @@ TEST_CASE("content end in previous body part and last part contain content", "[m
         "\r\n------WebKitFormBoundarylSu7ajtLodoq9XHE--\r\n";
     std::deque<MultiPartParser::ContentPart> parts;
 
-    // getting back the initial empty parts
     std::vector<char> content = convertToCharVec(contentStr1);
     REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::indeterminate);
-    REQUIRE(parts.size() == 0);
-
-    content = convertToCharVec(contentStr2);
-    REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
     REQUIRE(parts.size() == 2);
     REQUIRE(parts[0].filename_ == "testfile01.txt");
     REQUIRE(parts[0].foundStart_);
@@ -417,14 +353,75 @@ TEST_CASE("content end in previous body part and last part contain content", "[m
     REQUIRE(*(parts[0].end_ - 2) == '.');
     REQUIRE(parts[1].filename_ == "testfile02.txt");
     REQUIRE(*parts[1].start_ == 'S');
+    REQUIRE(!parts[1].foundEnd_);
     REQUIRE(*(parts[1].end_ - 2) == '!');
 
-    // result==done so call flush
-    fixture.flush(content, parts);
-    REQUIRE(parts.size() == 1);
-    REQUIRE(parts[0].filename_ == "testfile03.txt");
-    REQUIRE(parts[0].foundStart_);
-    REQUIRE(*parts[0].start_ == 'T');
+    content = convertToCharVec(contentStr2);
+    REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
+    REQUIRE(parts.size() == 2);
+    REQUIRE(parts[0].filename_ == "");
     REQUIRE(parts[0].foundEnd_);
-    REQUIRE(*(parts[0].end_ - 2) == '!');
+    REQUIRE(parts[0].start_ == parts[0].end_);
+    REQUIRE(parts[1].filename_ == "testfile03.txt");
+    REQUIRE(parts[1].foundStart_);
+    REQUIRE(*parts[1].start_ == 'T');
+    REQUIRE(parts[1].foundEnd_);
+    REQUIRE(*(parts[1].end_ - 2) == '!');
+}
+
+TEST_CASE("delimiter split across buffers at any position", "[multipart_parser]") {
+    std::vector<char> body;  // not used in tests
+    Request request(body);
+    request.headers_.push_back(
+        {"Content-Type", "multipart/form-data; boundary=----WebKitFormBoundarylSu7ajtLodoq9XHE"});
+
+    // data holding partial delimiters and a delimiter without leading crlf
+    const std::string data1 =
+        "a\r\n-b\r\n--c\r\r\n------WebKitFormBoundary\r\n"
+        "x------WebKitFormBoundarylSu7ajtLodoq9XHE end";
+    const std::string data2 = "\r\n";
+    const std::string contentStr =
+        "------WebKitFormBoundarylSu7ajtLodoq9XHE\r\n"
+        "Content-Disposition: form-data; name=\"file1\"; filename=\"testfile01.txt\"\r\n"
+        "Content-Type: text/plain\r\n\r\n" +
+        data1 +
+        "\r\n------WebKitFormBoundarylSu7ajtLodoq9XHE\r\n"
+        "Content-Disposition: form-data; name=\"file2\"; filename=\"testfile02.txt\"\r\n"
+        "Content-Type: text/plain\r\n\r\n" +
+        data2 + "\r\n------WebKitFormBoundarylSu7ajtLodoq9XHE--\r\n";
+
+    for (size_t split = 1; split < contentStr.size(); ++split) {
+        INFO("split at " << split);
+        Fixture fixture;
+        REQUIRE(fixture.parseHeader(request));
+
+        // collect file data the way RequestHandler writes it
+        std::vector<std::string> files;
+        auto collect = [&files](const std::deque<MultiPartParser::ContentPart> &parts) {
+            for (auto &part : parts) {
+                if (!part.filename_.empty()) {
+                    files.push_back("");
+                }
+                if (!part.headerOnly_ && !files.empty()) {
+                    files.back().append(part.start_, part.end_);
+                }
+            }
+        };
+
+        std::deque<MultiPartParser::ContentPart> parts;
+        std::vector<char> content = convertToCharVec(contentStr.substr(0, split));
+        MultiPartParser::result_type result = fixture.parse(request, content, parts);
+        collect(parts);
+        // done is returned at the first hyphen of the closing "--"
+        if (result != MultiPartParser::result_type::done) {
+            REQUIRE(result == MultiPartParser::result_type::indeterminate);
+            content = convertToCharVec(contentStr.substr(split));
+            REQUIRE(fixture.parse(request, content, parts) == MultiPartParser::result_type::done);
+            collect(parts);
+        }
+
+        REQUIRE(files.size() == 2);
+        REQUIRE(files[0] == data1);
+        REQUIRE(files[1] == data2);
+    }
 }
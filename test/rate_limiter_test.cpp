@@ -0,0 +1,100 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+
+#include "rate_limiter.hpp"
+
+using namespace std::literals::chrono_literals;
+using namespace beauty;
+
+TEST_CASE("rate limiter", "[rate_limiter]") {
+    auto now = std::chrono::steady_clock::now();
+    RateLimiter::Key client = RateLimiter::key(asio::ip::make_address("192.168.0.1"));
+    RateLimiter::Key other = RateLimiter::key(asio::ip::make_address("::1"));
+    int slot = -1;
+
+    SECTION("it should allow a burst and then the sustained rate") {
+        RateLimiter limiter(RateLimit(10, 3));
+        REQUIRE(limiter.acquire(client, now, slot) == RateLimiter::allowed);
+        REQUIRE(limiter.take(slot, now));
+        REQUIRE(limiter.take(slot, now));
+        REQUIRE_FALSE(limiter.take(slot, now));
+        REQUIRE(limiter.take(slot, now + 100ms));
+        REQUIRE_FALSE(limiter.take(slot, now + 100ms));
+        REQUIRE(limiter.getStats().limitedRequests_ == 2);
+
+        int otherSlot = -1;
+        REQUIRE(limiter.acquire(other, now, otherSlot) == RateLimiter::allowed);
+        REQUIRE(otherSlot != slot);
+    }
+
+    SECTION("it should limit new connections by the rate") {
+        RateLimiter limiter(RateLimit(1, 1));
+        REQUIRE(limiter.acquire(client, now, slot) == RateLimiter::allowed);
+        REQUIRE(limiter.acquire(client, now, slot) == RateLimiter::over_rate);
+        REQUIRE(limiter.acquire(client, now + 1s, slot) == RateLimiter::allowed);
+        REQUIRE(limiter.getStats().limitedConnections_ == 1);
+    }
+
+    SECTION("it should cap the connections of a client") {
+        RateLimiter limiter(RateLimit(0, 1, 2));
+        int first = -1;
+        int second = -1;
+        REQUIRE(limiter.acquire(client, now, first) == RateLimiter::allowed);
+        REQUIRE(limiter.acquire(client, now, second) == RateLimiter::allowed);
+        REQUIRE(first == second);
+        REQUIRE(limiter.acquire(client, now, slot) == RateLimiter::over_connections);
+        limiter.release(first);
+        REQUIRE(limiter.acquire(client, now, slot) == RateLimiter::allowed);
+    }
+
+    SECTION("it should reuse aged buckets when the table is full") {
+        // the table holds at least the probed buckets, 8
+        RateLimiter limiter(RateLimit(1, 1, 0, 8));
+        for (int i = 0; i < 8; ++i) {
+            auto address = asio::ip::make_address_v4(0x0a000001 + i);
+            REQUIRE(limiter.acquire(RateLimiter::key(address), now, slot) ==
+                    RateLimiter::allowed);
+        }
+        REQUIRE(limiter.acquire(client, now, slot) == RateLimiter::allowed);
+        REQUIRE(slot == -1);
+        REQUIRE(limiter.getStats().untracked_ == 1);
+
+        // clients that closed and refilled their bucket make room
+        for (int i = 0; i < 8; ++i) {
+            limiter.release(i);
+        }
+        REQUIRE(limiter.acquire(client, now + 1s, slot) == RateLimiter::allowed);
+        REQUIRE(slot >= 0);
+    }
+
+    SECTION("it should not forget a throttled client to make room") {
+        RateLimiter limiter(RateLimit(1, 1, 0, 8));
+        for (int i = 0; i < 8; ++i) {
+            auto address = asio::ip::make_address_v4(0x0a000001 + i);
+            REQUIRE(limiter.acquire(RateLimiter::key(address), now, slot) ==
+                    RateLimiter::allowed);
+            limiter.release(slot);
+        }
+        // all buckets are empty until now + 1s
+        REQUIRE(limiter.acquire(client, now, slot) == RateLimiter::allowed);
+        REQUIRE(slot == -1);
+        REQUIRE(limiter.acquire(RateLimiter::key(asio::ip::make_address_v4(0x0a000001)),
+                                now,
+                                slot) == RateLimiter::over_rate);
+    }
+
+    SECTION("it should key IPv6 clients by their /64 prefix") {
+        RateLimiter limiter(RateLimit(1, 1));
+        RateLimiter::Key v6 = RateLimiter::key(asio::ip::make_address("2001:db8:1:2::1"));
+        REQUIRE(v6 == RateLimiter::key(asio::ip::make_address("2001:db8:1:2:ffff::7")));
+        REQUIRE(v6 != RateLimiter::key(asio::ip::make_address("2001:db8:1:3::1")));
+        REQUIRE(limiter.acquire(v6, now, slot) == RateLimiter::allowed);
+        REQUIRE(limiter.acquire(RateLimiter::key(asio::ip::make_address("2001:db8:1:2::2")),
+                                now,
+                                slot) == RateLimiter::over_rate);
+
+        // IPv4 clients keep their whole address, also when IPv4-mapped
+        REQUIRE(client == RateLimiter::key(asio::ip::make_address("::ffff:192.168.0.1")));
+        REQUIRE(client != RateLimiter::key(asio::ip::make_address("::ffff:192.168.0.2")));
+    }
+}
@@ -168,6 +168,62 @@ TEST_CASE("parse POST request", "[request_parser]") {
     }
 }
 
+TEST_CASE("parse request head split across buffers", "[request_parser]") {
+    std::vector<char> content;
+    Request request(content);
+    RequestParser parser;
+    const std::string head =
+        "GET /uri HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept: */*\r\nConnection: keep-alive\r\n\r\n";
+
+    content.assign(head.begin(), head.begin() + 30);
+    REQUIRE(parser.parse(request, content) == RequestParser::indeterminate);
+
+    content.assign(head.begin() + 30, head.end());
+    REQUIRE(parser.parse(request, content) == RequestParser::good_complete);
+    REQUIRE(request.uri_ == "/uri");
+    REQUIRE(request.headers_.size() == 3);
+    REQUIRE(request.headers_[0].value_ == "127.0.0.1");
+    REQUIRE(request.keepAlive_);
+}
+
+TEST_CASE("parse request head larger than the max head size", "[request_parser]") {
+    std::vector<char> content;
+    Request request(content);
+    RequestParser parser(64);
+    const std::string head = "GET /uri HTTP/1.1\r\nHost: 127.0.0.1\r\nX-Filler: " +
+                             std::string(40, 'x') + "\r\n\r\n";
+
+    // the limit applies to the head accumulated over reads
+    content.assign(head.begin(), head.begin() + 50);
+    REQUIRE(parser.parse(request, content) == RequestParser::indeterminate);
+    content.assign(head.begin() + 50, head.end());
+    REQUIRE(parser.parse(request, content) == RequestParser::bad);
+
+    // a head within the limit is parsed after a reset
+    const std::string small = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    Request next(content);
+    parser.reset();
+    content.assign(small.begin(), small.end());
+    REQUIRE(parser.parse(next, content) == RequestParser::good_complete);
+}
+
+TEST_CASE("parse request without body after a partially parsed body", "[request_parser]") {
+    std::vector<char> content;
+    content.reserve(64);
+    Request request(content);
+    RequestParser parser;
+    const std::string post = "POST / HTTP/1.1\r\nContent-Length: 1000\r\n\r\nsome body";
+    content.assign(post.begin(), post.end());
+    REQUIRE(parser.parse(request, content) == RequestParser::good_part);
+
+    // the rest of the body is received outside the parser
+    const std::string get = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    Request next(content);
+    parser.reset();
+    content.assign(get.begin(), get.end());
+    REQUIRE(parser.parse(next, content) == RequestParser::good_complete);
+}
+
 TEST_CASE("parse POST request partially", "[request_parser]") {
     RequestFixture fixture(320);
     const std::string headers =
@@ -1,5 +1,9 @@
 #include <catch2/catch_test_macros.hpp>
+#include <atomic>
 #include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
 #include <future>
 #include <numeric>
 #include <thread>
@@ -9,8 +13,13 @@
 #include "utils/mock_request_handler.hpp"
 #include "utils/test_client.hpp"
 
+#include "hpack.hpp"
+#include "http2_frame.hpp"
+#include "http2_session.hpp"
 #include "server.hpp"
 #include "request_handler.hpp"
+#include "trace_collector.hpp"
+#include "websocket.hpp"
 
 using namespace std::literals::chrono_literals;
 using namespace beauty;
@@ -30,6 +39,49 @@ TestClient::TestResult openConnection(TestClient& c, const std::string& host, ui
     return fut.get();
 }
 
+// A MockRequestHandler replying "some content" to every request.
+struct ContentHandler {
+    ContentHandler() : mock_(buffer_) {
+        mock_.setReturnToClient(true);
+        mock_.setMockedReply(Reply::status_type::ok, "some content");
+    }
+
+    handlerCallback callback() {
+        return std::bind(&MockRequestHandler::handleRequest,
+                         &mock_,
+                         std::placeholders::_1,
+                         std::placeholders::_2);
+    }
+
+    std::vector<char> buffer_;
+    MockRequestHandler mock_;
+};
+
+// A blocking connection, for clients that send partial requests, connect
+// before the server runs or use a Unix domain socket.
+asio::ip::tcp::socket connectTcp(asio::io_context& ioc, uint16_t port) {
+    asio::ip::tcp::socket socket(ioc);
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+    return socket;
+}
+
+// Read a line of a reply from a blocking connection. Data read beyond it is
+// left in response.
+template <typename Socket>
+std::string readLine(Socket& socket, asio::streambuf& response) {
+    asio::read_until(socket, response, "\r\n");
+    std::istream responseStream(&response);
+    std::string line;
+    std::getline(responseStream, line);
+    return line;
+}
+
+template <typename Socket>
+std::string readStatusLine(Socket& socket) {
+    asio::streambuf response;
+    return readLine(socket, response);
+}
+
 std::vector<char> convertToCharVec(const std::vector<uint32_t> v) {
     std::vector<char> ret(v.size() * sizeof(decltype(v)::value_type));
     std::memcpy(ret.data(), v.data(), v.size() * sizeof(decltype(v)::value_type));
@@ -54,6 +106,9 @@ const std::string GetUriWithQueryRequest =
 const std::string GetApiRequest =
     "GET /api/status HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept: */*\r\nConnection: close\r\n\r\n";
 
+const std::string GetApiKeepAliveRequest =
+    "GET /api/status HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n";
+
 }  // namespace
 
 TEST_CASE("server should return binded port", "[server]") {
@@ -154,6 +209,17 @@ TEST_CASE("server with file handler", "[server]") {
         REQUIRE(res.statusCode_ == 404);
     }
 
+    SECTION("it should not write a PUT body unless raw uploads are enabled") {
+        openConnection(c, "127.0.0.1", port);
+
+        auto fut = createFutureResult(c);
+        c.sendRequest("PUT /firmware.bin HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                      "Connection: close\r\nContent-Length: 0\r\n\r\n");
+        auto res = fut.get();
+        REQUIRE(res.statusCode_ == 501);
+        REQUIRE(mockFileIO.getOpenFileForWriteCalls() == 0);
+    }
+
     SECTION("it should call fileIO openFileForRead but not close when no file exists") {
         openConnection(c, "127.0.0.1", port);
 
@@ -276,6 +342,44 @@ TEST_CASE("server with file handler", "[server]") {
     t.join();
 }
 
+TEST_CASE("server with request observer", "[server]") {
+    asio::io_context ioc;
+    TestClient c(ioc);
+
+    TraceCollector collector;
+    MockFileIO mockFileIO;
+    HttpPersistence persistentOption(0s, 0, 0);
+    Server dut(ioc, "127.0.0.1", "0", &mockFileIO, persistentOption);
+    uint16_t port = dut.getBindedPort();
+    // must be set before the io_context is run
+    dut.setRequestObserver(&collector);
+    auto t = std::thread(&asio::io_context::run, &ioc);
+
+    SECTION("it should report request lifecycle events to observer") {
+        openConnection(c, "127.0.0.1", port);
+
+        const size_t fileSizeBytes = 100;
+        mockFileIO.createMockFile(fileSizeBytes);
+        std::future<TestClient::TestResult> futs[3] = {
+            createFutureResult(c), createFutureResult(c), createFutureResult(c, fileSizeBytes)};
+        c.sendRequest(GetIndexRequest);
+        futs[0].get();             // status
+        futs[1].get();             // headers
+        auto res = futs[2].get();  // content
+        REQUIRE(res.action_ == TestClient::TestResult::ReadContent);
+
+        std::string trace = collector.dumpChromeTrace();
+        REQUIRE(trace.find("\"name\":\"accept\"") != std::string::npos);
+        REQUIRE(trace.find("\"name\":\"parse head\"") != std::string::npos);
+        REQUIRE(trace.find("\"name\":\"decode\"") != std::string::npos);
+        REQUIRE(trace.find("\"name\":\"file open\"") != std::string::npos);
+        REQUIRE(trace.find("\"name\":\"write headers\"") != std::string::npos);
+    }
+
+    ioc.stop();
+    t.join();
+}
+
 TEST_CASE("server with route handler", "[server]") {
     asio::io_context ioc;
     TestClient c(ioc);
@@ -376,6 +480,22 @@ TEST_CASE("server with route handler", "[server]") {
         REQUIRE(res.action_ == TestClient::TestResult::ReadContent);
         REQUIRE(res.content_ == convertToCharVec(content));
     }
+    SECTION("it should handle request headers larger than the initial buffer") {
+        mockRequestHandler.setReturnToClient(true);
+        mockRequestHandler.setMockedReply(Reply::status_type::ok, "some content");
+        openConnection(c, "127.0.0.1", port);
+
+        auto fut = createFutureResult(c);
+
+        const std::string cookie(3000, 'c');
+        c.sendRequest("GET /api/status HTTP/1.1\r\nHost: 127.0.0.1\r\nCookie: " + cookie +
+                      "\r\nConnection: close\r\n\r\n");
+
+        auto res = fut.get();
+        REQUIRE(res.statusCode_ == 200);
+        REQUIRE(mockRequestHandler.getNoCalls() == 1);
+        REQUIRE(mockRequestHandler.getReceivedRequest().getHeaderValue("Cookie") == cookie);
+    }
     SECTION("it should call all handlers if they return true") {
         std::vector<char> buffer2;  // not used in test
         MockRequestHandler mockRequestHandler2(buffer2);
@@ -416,6 +536,1041 @@ TEST_CASE("server with route handler", "[server]") {
     t.join();
 }
 
+
+namespace {
+
+// Puts back a stock reply replaced by a test when going out of scope.
+class StockReplyRestorer {
+   public:
+    explicit StockReplyRestorer(Reply::status_type status) : status_(status) {
+        const PrecomputedResponse& original = stock_replies::get(status);
+        asio::const_buffer content = original.content();
+        contentType_ = original.contentType();
+        content_.assign(static_cast<const char*>(content.data()), content.size());
+    }
+    ~StockReplyRestorer() {
+        stock_replies::set(status_, contentType_, content_);
+    }
+
+   private:
+    Reply::status_type status_;
+    std::string contentType_;
+    std::string content_;
+};
+
+}  // namespace
+
+TEST_CASE("server with precomputed responses", "[server]") {
+    asio::io_context ioc;
+    TestClient c(ioc);
+
+    const PrecomputedResponse status(
+        Reply::status_type::ok, "text/plain", "all good!", {{"Cache-Control", "no-store"}});
+    HttpPersistence persistentOption(0s, 0, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler([&status](const Request& req, Reply& rep) {
+        if (req.requestPath_ == "/api/status") {
+            rep.addHeader("X-Ignored", "1");
+            rep.sendPrecomputed(status);
+        } else if (req.requestPath_ == "/old") {
+            rep.stockReply(Reply::status_type::moved_permanently);
+            rep.addHeader("Location", "/new");
+            rep.addHeader("X-Moved-By", "beauty");
+        } else {
+            rep.stockReply(Reply::status_type::created);
+        }
+    });
+    auto t = std::thread(&asio::io_context::run, &ioc);
+
+    SECTION("it should send the precomputed response with the connection header") {
+        openConnection(c, "127.0.0.1", port);
+
+        std::future<TestClient::TestResult> futs[3] = {
+            createFutureResult(c), createFutureResult(c), createFutureResult(c, 9)};
+
+        c.sendRequest(GetApiRequest);
+
+        auto res = futs[0].get();  // status
+        REQUIRE(res.statusCode_ == 200);
+        res = futs[1].get();  // headers
+        REQUIRE(res.headers_.size() == 4);
+        REQUIRE(res.headers_[0] == "Content-Length: 9\r");
+        REQUIRE(res.headers_[1] == "Content-Type: text/plain\r");
+        REQUIRE(res.headers_[2] == "Cache-Control: no-store\r");
+        REQUIRE(res.headers_[3] == "Connection: close\r");
+        res = futs[2].get();
+        REQUIRE(res.action_ == TestClient::TestResult::ReadContent);
+        REQUIRE(res.content_ == convertToCharVec("all good!"));
+    }
+    SECTION("it should send headers added to a stock reply") {
+        asio::const_buffer stockContent =
+            stock_replies::get(Reply::status_type::moved_permanently).content();
+        asio::io_context clientIoc;
+        asio::ip::tcp::socket socket = connectTcp(clientIoc, port);
+        asio::streambuf response;
+
+        asio::write(socket,
+                    asio::buffer(std::string(
+                        "GET /old HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n")));
+
+        REQUIRE(readLine(socket, response) == "HTTP/1.0 301 Moved Permanently\r");
+        REQUIRE(readLine(socket, response) ==
+                "Content-Length: " + std::to_string(stockContent.size()) + "\r");
+        REQUIRE(readLine(socket, response) == "Content-Type: text/html\r");
+        REQUIRE(readLine(socket, response) == "Location: /new\r");
+        REQUIRE(readLine(socket, response) == "X-Moved-By: beauty\r");
+        REQUIRE(readLine(socket, response) == "Connection: close\r");
+        REQUIRE(readLine(socket, response) == "\r");
+
+        // the rest up until EOF is the stock content
+        std::error_code ec;
+        asio::read(socket, response, ec);
+        REQUIRE(ec == asio::error::eof);
+        REQUIRE(response.size() == stockContent.size());
+    }
+    SECTION("it should send a replaced stock reply") {
+        StockReplyRestorer restorer(Reply::status_type::created);
+        stock_replies::set(Reply::status_type::created, "text/plain", "made it, 1 item");
+        openConnection(c, "127.0.0.1", port);
+
+        std::future<TestClient::TestResult> futs[3] = {
+            createFutureResult(c), createFutureResult(c), createFutureResult(c, 15)};
+
+        c.sendRequest(GetIndexRequest);
+
+        auto res = futs[0].get();  // status
+        REQUIRE(res.statusCode_ == 201);
+        res = futs[1].get();  // headers
+        REQUIRE(res.headers_.size() == 3);
+        REQUIRE(res.headers_[0] == "Content-Length: 15\r");
+        REQUIRE(res.headers_[1] == "Content-Type: text/plain\r");
+        REQUIRE(res.headers_[2] == "Connection: close\r");
+        res = futs[2].get();
+        REQUIRE(res.content_ == convertToCharVec("made it, 1 item"));
+    }
+    ioc.stop();
+    t.join();
+}
+
+namespace {
+
+class EchoHandler : public IWebSocketHandler {
+   public:
+    void onOpen(const std::shared_ptr<WebSocket>& socket, const Request& request) override {
+        socket->sendText("welcome " + request.requestPath_);
+    }
+    void onMessage(const std::shared_ptr<WebSocket>& socket,
+                   const char* data,
+                   size_t size,
+                   bool binary) override {
+        if (binary) {
+            socket->sendBinary(data, size);
+        } else {
+            socket->sendText(std::string(data, size));
+        }
+    }
+    void onClose(const std::shared_ptr<WebSocket>& socket, uint16_t code) override {
+        closeCode_ = code;
+    }
+
+    std::atomic<int> closeCode_{0};
+};
+
+// A masked client frame.
+std::string webSocketFrame(uint8_t firstByte, const std::string& payload) {
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    std::string frame;
+    frame.push_back(static_cast<char>(firstByte));
+    if (payload.size() < 126) {
+        frame.push_back(static_cast<char>(0x80 | payload.size()));
+    } else {
+        frame.push_back(static_cast<char>(0x80 | 126));
+        frame.push_back(static_cast<char>(payload.size() >> 8));
+        frame.push_back(static_cast<char>(payload.size()));
+    }
+    frame.append(mask, 4);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        frame.push_back(payload[i] ^ mask[i & 3]);
+    }
+    return frame;
+}
+
+// Read an unmasked server frame following data already read into buffer,
+// returns the first byte and the payload.
+std::pair<uint8_t, std::string> readWebSocketFrame(asio::ip::tcp::socket& socket,
+                                                   asio::streambuf& buffer) {
+    auto fill = [&](size_t size) {
+        if (buffer.size() < size) {
+            asio::read(socket, buffer, asio::transfer_exactly(size - buffer.size()));
+        }
+    };
+    fill(2);
+    const uint8_t* data = static_cast<const uint8_t*>(buffer.data().data());
+    uint8_t firstByte = data[0];
+    size_t size = data[1] & 0x7f;
+    size_t headerSize = 2;
+    if (size == 126) {
+        fill(4);
+        data = static_cast<const uint8_t*>(buffer.data().data());
+        size = (data[2] << 8) | data[3];
+        headerSize = 4;
+    }
+    fill(headerSize + size);
+    const char* payload = static_cast<const char*>(buffer.data().data()) + headerSize;
+    std::pair<uint8_t, std::string> frame(firstByte, std::string(payload, size));
+    buffer.consume(headerSize + size);
+    return frame;
+}
+
+const std::string WebSocketUpgradeRequest =
+    "GET /ws/echo HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: "
+    "Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: "
+    "13\r\n\r\n";
+
+}  // namespace
+
+TEST_CASE("server with websocket", "[server]") {
+    asio::io_context ioc;
+    TestClient c(ioc);
+
+    auto handler = std::make_shared<EchoHandler>();
+    HttpPersistence persistentOption(5s, 10, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler([handler](const Request& req, Reply& rep) {
+        if (req.startsWith("/ws/")) {
+            rep.acceptWebSocket(req, handler);
+        }
+    });
+    auto t = std::thread(&asio::io_context::run, &ioc);
+
+    asio::io_context clientIoc;
+    asio::ip::tcp::socket socket(clientIoc);
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+
+    SECTION("it should upgrade and echo messages") {
+        asio::write(socket, asio::buffer(WebSocketUpgradeRequest));
+        asio::streambuf response;
+        size_t headSize = asio::read_until(socket, response, "\r\n\r\n");
+        std::string head(asio::buffers_begin(response.data()),
+                         asio::buffers_begin(response.data()) + headSize);
+        REQUIRE(head ==
+                "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: "
+                "Upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n");
+        response.consume(headSize);
+
+        auto frame = readWebSocketFrame(socket, response);
+        REQUIRE(frame.first == 0x81);
+        REQUIRE(frame.second == "welcome /ws/echo");
+
+        // a fragmented message with a ping in between
+        std::string big(200, 'b');
+        asio::write(socket,
+                    asio::buffer(webSocketFrame(0x81, "hello") + webSocketFrame(0x02, "bin") +
+                                 webSocketFrame(0x89, "p") + webSocketFrame(0x80, big)));
+        frame = readWebSocketFrame(socket, response);
+        REQUIRE(frame.first == 0x81);
+        REQUIRE(frame.second == "hello");
+        frame = readWebSocketFrame(socket, response);
+        REQUIRE(frame.first == 0x8a);
+        REQUIRE(frame.second == "p");
+        frame = readWebSocketFrame(socket, response);
+        REQUIRE(frame.first == 0x82);
+        REQUIRE(frame.second == "bin" + big);
+
+        asio::write(socket, asio::buffer(webSocketFrame(0x88, std::string("\x03\xe8" "bye"))));
+        frame = readWebSocketFrame(socket, response);
+        REQUIRE(frame.first == 0x88);
+        REQUIRE(frame.second == "\x03\xe8");
+
+        std::error_code ec;
+        asio::read(socket, response, asio::transfer_at_least(1), ec);
+        REQUIRE(ec == asio::error::eof);
+        // the socket is shut down before the handler is told
+        for (int i = 0; i < 100 && handler->closeCode_ == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(handler->closeCode_ == 1000);
+    }
+    SECTION("it should close on protocol errors") {
+        asio::write(socket, asio::buffer(WebSocketUpgradeRequest));
+        asio::streambuf response;
+        response.consume(asio::read_until(socket, response, "\r\n\r\n"));
+        auto frame = readWebSocketFrame(socket, response);
+        REQUIRE(frame.second == "welcome /ws/echo");
+
+        // a continuation frame without a message
+        asio::write(socket, asio::buffer(webSocketFrame(0x80, "oops")));
+        frame = readWebSocketFrame(socket, response);
+        REQUIRE(frame.first == 0x88);
+        REQUIRE(frame.second == "\x03\xea");
+    }
+    SECTION("it should refuse requests that are not an upgrade") {
+        asio::write(socket,
+                    asio::buffer(std::string("GET /ws/echo HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                                             "Connection: close\r\n\r\n")));
+        REQUIRE(readStatusLine(socket) == "HTTP/1.0 400 Bad Request\r");
+    }
+    socket.close();
+    ioc.stop();
+    t.join();
+}
+
+TEST_CASE("server with event stream", "[server]") {
+    asio::io_context ioc;
+    TestClient c(ioc);
+
+    auto broadcaster = std::make_shared<EventBroadcaster>();
+    HttpPersistence persistentOption(5s, 10, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler([broadcaster](const Request& req, Reply& rep) {
+        if (req.requestPath_ == "/events") {
+            rep.acceptEventStream(broadcaster);
+        }
+    });
+    auto t = std::thread(&asio::io_context::run, &ioc);
+
+    asio::io_context clientIoc;
+    asio::ip::tcp::socket s1(clientIoc);
+    asio::ip::tcp::socket s2(clientIoc);
+    const std::string request = "GET /events HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    asio::streambuf r1;
+    asio::streambuf r2;
+    for (auto* s : {&s1, &s2}) {
+        s->connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+        asio::write(*s, asio::buffer(request));
+    }
+    size_t headSize = asio::read_until(s1, r1, "\r\n\r\n");
+    std::string head(asio::buffers_begin(r1.data()), asio::buffers_begin(r1.data()) + headSize);
+    REQUIRE(head ==
+            "HTTP/1.0 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: "
+            "no-cache\r\nConnection: close\r\n\r\n");
+    r1.consume(headSize);
+    r2.consume(asio::read_until(s2, r2, "\r\n\r\n"));
+
+    // the subscription is made once the headers are written
+    for (int i = 0; i < 100 && broadcaster->subscriberCount() < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(broadcaster->subscriberCount() == 2);
+
+    SECTION("it should publish to all subscribers") {
+        broadcaster->publish("1");
+        broadcaster->publish("{\"t\":2}", "temp", "2");
+        const std::string expected = "data: 1\n\nevent: temp\nid: 2\ndata: {\"t\":2}\n\n";
+        for (auto p : {std::make_pair(&s1, &r1), std::make_pair(&s2, &r2)}) {
+            if (p.second->size() < expected.size()) {
+                asio::read(*p.first,
+                           *p.second,
+                           asio::transfer_exactly(expected.size() - p.second->size()));
+            }
+            std::string events(asio::buffers_begin(p.second->data()),
+                               asio::buffers_end(p.second->data()));
+            REQUIRE(events == expected);
+        }
+    }
+    SECTION("it should unsubscribe disconnected clients") {
+        s2.close();
+        for (int i = 0; i < 100 && broadcaster->subscriberCount() > 1; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(broadcaster->subscriberCount() == 1);
+    }
+    s1.close();
+    s2.close();
+    ioc.stop();
+    t.join();
+}
+
+namespace {
+
+// Counts body bytes and pauses after each chunk when pause_ is set, resuming
+// from another thread.
+class CountingBodyConsumer : public IBodyConsumer {
+   public:
+    ~CountingBodyConsumer() {
+        for (auto& t : resumers_) {
+            t.join();
+        }
+    }
+
+    bool onData(const Request& request,
+                const char* data,
+                size_t size,
+                const std::function<void()>& resume) override {
+        bytes_ += size;
+        sum_ = std::accumulate(data, data + size, sum_);
+        chunks_++;
+        if (pause_) {
+            resumers_.emplace_back([resume] {
+                std::this_thread::sleep_for(1ms);
+                resume();
+            });
+            return false;
+        }
+        return true;
+    }
+
+    void onEnd(const Request& request, Reply& reply) override {
+        std::string result = std::to_string(bytes_);
+        reply.content_.assign(result.begin(), result.end());
+        reply.send(Reply::ok, "text/plain");
+    }
+
+    void onAbort(const Request& request) override {
+        aborted_ = true;
+    }
+
+    bool pause_ = false;
+    size_t bytes_ = 0;
+    size_t chunks_ = 0;
+    unsigned sum_ = 0;
+    bool aborted_ = false;
+    std::vector<std::thread> resumers_;
+};
+
+}  // namespace
+
+namespace {
+
+std::string http2Frame(uint8_t type, uint8_t flags, uint32_t streamId, const std::string& payload) {
+    std::string frame;
+    Http2FrameParser::writeHeader(frame, payload.size(), type, flags, streamId);
+    return frame + payload;
+}
+
+// Read frames until the last frame of the stream, returns its DATA. The
+// error code of an RST_STREAM ending the stream is put in resetError.
+std::string readHttp2Stream(asio::ip::tcp::socket& socket,
+                            asio::streambuf& buffer,
+                            uint32_t streamId,
+                            std::vector<Header>& headers,
+                            uint32_t* resetError = nullptr) {
+    HpackDecoder decoder;
+    std::string data;
+    for (;;) {
+        if (buffer.size() < Http2FrameParser::headerSize) {
+            asio::read(socket,
+                       buffer,
+                       asio::transfer_exactly(Http2FrameParser::headerSize - buffer.size()));
+        }
+        const uint8_t* head = static_cast<const uint8_t*>(buffer.data().data());
+        size_t size = (head[0] << 16) | (head[1] << 8) | head[2];
+        if (buffer.size() < Http2FrameParser::headerSize + size) {
+            asio::read(socket,
+                       buffer,
+                       asio::transfer_exactly(Http2FrameParser::headerSize + size -
+                                              buffer.size()));
+        }
+        head = static_cast<const uint8_t*>(buffer.data().data());
+        uint8_t type = head[3];
+        uint8_t flags = head[4];
+        uint32_t id = ((head[5] & 0x7f) << 24) | (head[6] << 16) | (head[7] << 8) | head[8];
+        const uint8_t* payload = head + Http2FrameParser::headerSize;
+        if (id == streamId && type == Http2FrameParser::headers) {
+            decoder.decode(payload, size, headers);
+        } else if (id == streamId && type == Http2FrameParser::data) {
+            data.append(reinterpret_cast<const char*>(payload), size);
+        }
+        if (id == streamId && type == Http2FrameParser::rst_stream && size == 4) {
+            if (resetError) {
+                *resetError =
+                    (payload[0] << 24) | (payload[1] << 16) | (payload[2] << 8) | payload[3];
+            }
+            buffer.consume(Http2FrameParser::headerSize + size);
+            return data;
+        }
+        buffer.consume(Http2FrameParser::headerSize + size);
+        if (id == streamId && (flags & Http2FrameParser::end_stream)) {
+            return data;
+        }
+    }
+}
+
+std::string http2Request(uint32_t streamId, const std::string& path) {
+    std::string block;
+    hpack::encode(":method", "GET", block);
+    hpack::encode(":scheme", "http", block);
+    hpack::encode(":path", path, block);
+    hpack::encode(":authority", "127.0.0.1", block);
+    return http2Frame(Http2FrameParser::headers,
+                      Http2FrameParser::end_headers | Http2FrameParser::end_stream,
+                      streamId,
+                      block);
+}
+
+const std::string Http2ClientPreface =
+    std::string(Http2Session::preface, Http2Session::prefaceSize) +
+    http2Frame(Http2FrameParser::settings, 0, 0, std::string());
+
+}  // namespace
+
+TEST_CASE("server with http2", "[server]") {
+    asio::io_context ioc;
+
+    HttpPersistence persistentOption(5s, 10, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption);
+    dut.setHttp2(Http2Options(true));
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler([](const Request& req, Reply& rep) {
+        if (req.startsWith("/api/")) {
+            std::string content = req.requestPath_ + " " + req.getHeaderValue("Host");
+            rep.content_.assign(content.begin(), content.end());
+            rep.send(Reply::ok, "text/plain");
+        }
+    });
+    auto t = std::thread(&asio::io_context::run, &ioc);
+
+    asio::io_context clientIoc;
+    asio::ip::tcp::socket socket(clientIoc);
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+    asio::streambuf response;
+    std::vector<Header> headers;
+
+    SECTION("it should serve clients with prior knowledge") {
+        asio::write(socket,
+                    asio::buffer(Http2ClientPreface + http2Request(1, "/api/one") +
+                                 http2Request(3, "/api/two")));
+        REQUIRE(readHttp2Stream(socket, response, 1, headers) == "/api/one 127.0.0.1");
+        REQUIRE(headers[0].value_ == "200");
+        headers.clear();
+        REQUIRE(readHttp2Stream(socket, response, 3, headers) == "/api/two 127.0.0.1");
+        headers.clear();
+        // without file IO, unhandled requests are not implemented
+        asio::write(socket, asio::buffer(http2Request(5, "/missing")));
+        readHttp2Stream(socket, response, 5, headers);
+        REQUIRE(headers[0].value_ == "501");
+    }
+    SECTION("it should upgrade an HTTP/1.1 request") {
+        asio::write(socket,
+                    asio::buffer(std::string("GET /api/up HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                                             "Connection: Upgrade, HTTP2-Settings\r\n"
+                                             "Upgrade: h2c\r\nHTTP2-Settings: AAMAAABk\r\n\r\n")));
+        size_t headSize = asio::read_until(socket, response, "\r\n\r\n");
+        std::string head(asio::buffers_begin(response.data()),
+                         asio::buffers_begin(response.data()) + headSize);
+        REQUIRE(head ==
+                "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+        response.consume(headSize);
+
+        // the upgrade request is answered on stream 1
+        asio::write(socket, asio::buffer(Http2ClientPreface));
+        REQUIRE(readHttp2Stream(socket, response, 1, headers) == "/api/up 127.0.0.1");
+        headers.clear();
+        asio::write(socket, asio::buffer(http2Request(3, "/api/next")));
+        REQUIRE(readHttp2Stream(socket, response, 3, headers) == "/api/next 127.0.0.1");
+    }
+    SECTION("it should keep serving HTTP/1.1") {
+        asio::write(socket, asio::buffer(GetApiRequest));
+        REQUIRE(readLine(socket, response) == "HTTP/1.0 200 OK\r");
+    }
+    socket.close();
+    ioc.stop();
+    t.join();
+}
+
+TEST_CASE("server with body consumer", "[server]") {
+    asio::io_context ioc;
+    TestClient c(ioc);
+
+    auto consumer = std::make_shared<CountingBodyConsumer>();
+    HttpPersistence persistentOption(0s, 0, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption, 1024);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler([consumer](const Request& req, Reply& rep) {
+        if (req.method_ == "POST") {
+            rep.streamBody(consumer);
+        }
+    });
+
+    std::string body(10000, ' ');
+    unsigned sum = 0;
+    for (size_t i = 0; i < body.size(); ++i) {
+        body[i] = static_cast<char>('a' + i % 26);
+        sum += static_cast<unsigned>(body[i]);
+    }
+    const std::string request =
+        "POST /api/upload HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+        "Content-Type: application/octet-stream\r\nConnection: close\r\n"
+        "Content-Length: " +
+        std::to_string(body.size()) + "\r\n\r\n" + body;
+    const std::string expected = std::to_string(body.size());
+
+    SECTION("it should stream a body larger than the buffers to the consumer") {
+        auto t = std::thread(&asio::io_context::run, &ioc);
+        openConnection(c, "127.0.0.1", port);
+
+        std::future<TestClient::TestResult> futs[3] = {
+            createFutureResult(c), createFutureResult(c), createFutureResult(c, expected.size())};
+        c.sendRequest(request);
+
+        futs[0].get();  // status
+        futs[1].get();  // headers
+        auto res = futs[2].get();
+        REQUIRE(res.action_ == TestClient::TestResult::ReadContent);
+        REQUIRE(res.content_ == convertToCharVec(expected));
+        REQUIRE(consumer->sum_ == sum);
+        REQUIRE(consumer->chunks_ > 1);
+        REQUIRE_FALSE(consumer->aborted_);
+
+        ioc.stop();
+        t.join();
+    }
+    SECTION("it should pause reading until the consumer resumes") {
+        consumer->pause_ = true;
+        auto t = std::thread(&asio::io_context::run, &ioc);
+        openConnection(c, "127.0.0.1", port);
+
+        std::future<TestClient::TestResult> futs[3] = {
+            createFutureResult(c), createFutureResult(c), createFutureResult(c, expected.size())};
+        c.sendRequest(request);
+
+        futs[0].get();  // status
+        futs[1].get();  // headers
+        auto res = futs[2].get();
+        REQUIRE(res.action_ == TestClient::TestResult::ReadContent);
+        REQUIRE(res.content_ == convertToCharVec(expected));
+        REQUIRE(consumer->sum_ == sum);
+
+        ioc.stop();
+        t.join();
+    }
+}
+
+TEST_CASE("server with admission control", "[server]") {
+    asio::io_context ioc;
+    TestClient c1(ioc);
+    TestClient c2(ioc);
+
+    std::vector<char> buffer;
+    MockRequestHandler mockRequestHandler(buffer);
+    mockRequestHandler.setReturnToClient(true);
+    mockRequestHandler.setMockedReply(Reply::status_type::ok, "some content");
+    HttpPersistence persistentOption(5s, 100, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption, 1024);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler(std::bind(&MockRequestHandler::handleRequest,
+                                    &mockRequestHandler,
+                                    std::placeholders::_1,
+                                    std::placeholders::_2));
+
+    SECTION("it should reply 503 when the connection limit is reached") {
+        dut.setAdmissionControl(AdmissionControl(1, 0, AdmissionControl::reject_503));
+        auto t = std::thread(&asio::io_context::run, &ioc);
+        openConnection(c1, "127.0.0.1", port);
+        openConnection(c2, "127.0.0.1", port);
+
+        auto fut = createFutureResult(c2);
+        c2.sendRequest(GetApiRequest);
+
+        auto res = fut.get();
+        REQUIRE(res.action_ == TestClient::TestResult::ReadRequestStatus);
+        REQUIRE(res.statusCode_ == 503);
+        REQUIRE(mockRequestHandler.getNoCalls() == 0);
+
+        ioc.stop();
+        t.join();
+    }
+    SECTION("it should reply 503 when the buffer budget is exceeded") {
+        // a new connection needs 2 * 512 bytes of buffers
+        dut.setAdmissionControl(AdmissionControl(0, 1500, AdmissionControl::reject_503));
+        auto t = std::thread(&asio::io_context::run, &ioc);
+        openConnection(c1, "127.0.0.1", port);
+        // the partial head keeps the buffers of c1 in use, read the stats on
+        // the io_context thread
+        c1.sendRequest("GET /api/status HTTP/1.1\r\n");
+        size_t inUseBytes = 0;
+        for (int n = 0; n < 100 && inUseBytes == 0; ++n) {
+            std::this_thread::sleep_for(1ms);
+            std::promise<size_t> stats;
+            asio::post(ioc, [&stats, &dut] {
+                stats.set_value(dut.getBufferPoolStats().inUseBytes_);
+            });
+            inUseBytes = stats.get_future().get();
+        }
+        REQUIRE(inUseBytes == 2 * 512);
+        openConnection(c2, "127.0.0.1", port);
+
+        auto fut = createFutureResult(c2);
+        c2.sendRequest(GetApiRequest);
+
+        auto res = fut.get();
+        REQUIRE(res.action_ == TestClient::TestResult::ReadRequestStatus);
+        REQUIRE(res.statusCode_ == 503);
+
+        ioc.stop();
+        t.join();
+    }
+    SECTION("it should evict an idle keep-alive connection for a new client") {
+        dut.setAdmissionControl(AdmissionControl(1, 0, AdmissionControl::pause_accept));
+        auto t = std::thread(&asio::io_context::run, &ioc);
+        openConnection(c1, "127.0.0.1", port);
+
+        auto fut1 = createFutureResult(c1);
+        c1.sendRequest(GetUriWithQueryRequest);
+        auto res = fut1.get();
+        REQUIRE(res.statusCode_ == 200);
+
+        // c1 is now idle and is evicted when c2 arrives
+        openConnection(c2, "127.0.0.1", port);
+        auto fut2 = createFutureResult(c2);
+        c2.sendRequest(GetApiRequest);
+        res = fut2.get();
+        REQUIRE(res.action_ == TestClient::TestResult::ReadRequestStatus);
+        REQUIRE(res.statusCode_ == 200);
+        REQUIRE(mockRequestHandler.getNoCalls() == 2);
+
+        ioc.stop();
+        t.join();
+    }
+}
+
+TEST_CASE("server with several listeners", "[server]") {
+    asio::io_context ioc;
+
+    ContentHandler handler;
+    const std::string path = "beauty_server_test.sock";
+    std::vector<Listener> listeners;
+    listeners.push_back(Listener("127.0.0.1", "0"));
+    listeners.push_back(Listener::unixSocket(path));
+    HttpPersistence persistentOption(5s, 100, 0);
+    Server dut(ioc, listeners, nullptr, persistentOption);
+    uint16_t port = dut.getBindedPort();
+    REQUIRE(port != 0);
+    dut.addRequestHandler(handler.callback());
+    auto t = std::thread(&asio::io_context::run, &ioc);
+
+    asio::io_context clientIoc;
+    SECTION("it should serve clients on each listener") {
+        asio::ip::tcp::socket tcpSocket = connectTcp(clientIoc, port);
+        asio::write(tcpSocket, asio::buffer(GetApiRequest));
+        REQUIRE(readStatusLine(tcpSocket) == "HTTP/1.0 200 OK\r");
+
+        asio::local::stream_protocol::socket unixSocket(clientIoc);
+        unixSocket.connect(asio::local::stream_protocol::endpoint(path));
+        asio::write(unixSocket, asio::buffer(GetApiRequest));
+        REQUIRE(readStatusLine(unixSocket) == "HTTP/1.0 200 OK\r");
+        REQUIRE(handler.mock_.getNoCalls() == 2);
+    }
+    ioc.stop();
+    t.join();
+    std::remove(path.c_str());
+}
+
+TEST_CASE("server with listener handoff", "[server]") {
+    ContentHandler handler;
+    const std::string path = "beauty_handoff_test.sock";
+    HttpPersistence persistentOption(5s, 100, 0);
+
+    asio::io_context oldIoc;
+    Server oldServer(oldIoc, "127.0.0.1", "0", nullptr, persistentOption);
+    uint16_t port = oldServer.getBindedPort();
+    oldServer.addRequestHandler(handler.callback());
+    REQUIRE(oldServer.enableHandoff(path));
+    auto oldThread = std::thread(&asio::io_context::run, &oldIoc);
+
+    SECTION("it should pass the listening socket to a new server") {
+        std::vector<Listener> listeners;
+        std::string error;
+        REQUIRE(receiveListeners(path, listeners, error));
+        REQUIRE(listeners.size() == 1);
+
+        asio::io_context newIoc;
+        Server newServer(newIoc, listeners, nullptr, persistentOption);
+        REQUIRE(newServer.getBindedPort() == port);
+        newServer.addRequestHandler(handler.callback());
+        auto newThread = std::thread(&asio::io_context::run, &newIoc);
+
+        // the old server has no connections and stops on its own
+        oldThread.join();
+
+        asio::io_context clientIoc;
+        asio::ip::tcp::socket socket = connectTcp(clientIoc, port);
+        asio::write(socket, asio::buffer(GetApiRequest));
+        REQUIRE(readStatusLine(socket) == "HTTP/1.0 200 OK\r");
+
+        newIoc.stop();
+        newThread.join();
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("receive listeners from a server that does not send them", "[server]") {
+    asio::io_context ioc;
+    const std::string path = "beauty_handoff_test.sock";
+    std::remove(path.c_str());
+    // listening, so the connect succeeds, but never accepting
+    asio::local::stream_protocol::acceptor acceptor(
+        ioc, asio::local::stream_protocol::endpoint(path));
+
+    SECTION("it should fail after the timeout") {
+        std::vector<Listener> listeners;
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE_FALSE(receiveListeners(path, listeners, error, 100ms));
+        REQUIRE(std::chrono::steady_clock::now() - start >= 100ms);
+        REQUIRE(error == path + ": timed out waiting for the listeners");
+        REQUIRE(listeners.empty());
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("server with listener handoff to a path in use", "[server]") {
+    asio::io_context ioc;
+    HttpPersistence persistentOption(0s, 0, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption);
+    const std::string path = "beauty_handoff_test.txt";
+    std::ofstream(path) << "not a socket";
+
+    SECTION("it should keep a file that is not a socket") {
+        REQUIRE_FALSE(dut.enableHandoff(path));
+        std::ifstream file(path);
+        std::string content;
+        std::getline(file, content);
+        REQUIRE(content == "not a socket");
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("server with drain timeout", "[server]") {
+    asio::io_context ioc;
+
+    ContentHandler handler;
+    HttpPersistence persistentOption(5s, 100, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler(handler.callback());
+    dut.setDrainTimeout(1s);
+    auto t = std::thread(&asio::io_context::run, &ioc);
+
+    asio::io_context clientIoc;
+    asio::ip::tcp::socket socket = connectTcp(clientIoc, port);
+    std::error_code ec;
+    asio::streambuf response;
+
+    SECTION("it should close idle connections and stop") {
+        asio::write(socket, asio::buffer(GetApiKeepAliveRequest));
+        asio::read_until(socket, response, "some content");
+
+        std::raise(SIGTERM);
+        asio::read(socket, response, ec);
+        REQUIRE(ec == asio::error::eof);
+        t.join();
+        REQUIRE(dut.getDrainReport().closedIdle_ == 1);
+        REQUIRE(dut.getDrainReport().inFlight_ == 0);
+    }
+
+    SECTION("it should cut a request still in flight at the deadline") {
+        asio::write(socket, asio::buffer(std::string("GET /api/status HTTP/1.1\r\nHost")));
+        std::this_thread::sleep_for(100ms);
+
+        auto start = std::chrono::steady_clock::now();
+        std::raise(SIGTERM);
+        asio::read(socket, response, ec);
+        REQUIRE(ec);
+        t.join();
+        REQUIRE(std::chrono::steady_clock::now() - start >= 900ms);
+        REQUIRE(dut.getDrainReport().inFlight_ == 1);
+        REQUIRE(dut.getDrainReport().cutRequests_ == 1);
+    }
+}
+
+TEST_CASE("server with connection timeouts", "[server]") {
+    asio::io_context ioc;
+
+    ContentHandler handler;
+    // without keep-alive, which has a timeout of its own
+    HttpPersistence persistentOption(0s, 0, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler(handler.callback());
+    dut.setConnectionTimeouts(ConnectionTimeouts(1s, 1000, 1000, 0s, 1s));
+    auto t = std::thread(&asio::io_context::run, &ioc);
+
+    asio::io_context clientIoc;
+    asio::ip::tcp::socket socket = connectTcp(clientIoc, port);
+    std::error_code ec;
+    asio::streambuf response;
+    auto start = std::chrono::steady_clock::now();
+
+    SECTION("it should close a connection with incomplete headers") {
+        asio::write(socket, asio::buffer(std::string("GET /api/status HT")));
+        asio::read(socket, response, ec);
+        REQUIRE(ec);
+        REQUIRE(response.size() == 0);
+        REQUIRE(std::chrono::steady_clock::now() - start >= 1s);
+    }
+
+    SECTION("it should close a connection with a body below the minimum rate") {
+        asio::write(socket,
+                    asio::buffer(std::string("POST /api/upload HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                                             "Content-Length: 100000\r\n\r\nsome body")));
+        asio::read(socket, response, ec);
+        REQUIRE(ec);
+        REQUIRE(std::chrono::steady_clock::now() - start >= 1s);
+    }
+
+    SECTION("it should serve a client that is fast enough") {
+        asio::write(socket, asio::buffer(GetApiRequest));
+        asio::read_until(socket, response, "some content");
+    }
+
+    ioc.stop();
+    t.join();
+}
+
+TEST_CASE("server with rate limit", "[server]") {
+    asio::io_context ioc;
+
+    ContentHandler handler;
+    HttpPersistence persistentOption(5s, 100, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler(handler.callback());
+    // at most one connection per client
+    dut.setRateLimit(RateLimit(0, 1, 1));
+
+    asio::io_context clientIoc;
+    asio::ip::tcp::socket socket = connectTcp(clientIoc, port);
+    asio::streambuf response;
+
+    SECTION("it should reply 429 to a second connection") {
+        asio::ip::tcp::socket second = connectTcp(clientIoc, port);
+        auto t = std::thread(&asio::io_context::run, &ioc);
+
+        asio::write(second, asio::buffer(GetApiRequest));
+        REQUIRE(readStatusLine(second) == "HTTP/1.1 429 Too Many Requests\r");
+        REQUIRE(dut.getRateLimitStats().limitedConnections_ == 1);
+
+        ioc.stop();
+        t.join();
+    }
+
+    SECTION("it should reply 429 to requests over the rate") {
+        dut.setRateLimit(RateLimit(1, 1, 0, 4096, 60s));
+        auto t = std::thread(&asio::io_context::run, &ioc);
+
+        asio::write(socket, asio::buffer(GetApiKeepAliveRequest));
+        asio::read_until(socket, response, "some content");
+        response.consume(response.size());
+
+        asio::write(socket, asio::buffer(GetApiKeepAliveRequest));
+        asio::read_until(socket, response, "\r\n\r\n");
+        REQUIRE(readLine(socket, response) == "HTTP/1.1 429 Too Many Requests\r");
+        REQUIRE(readLine(socket, response) == "Retry-After: 60\r");
+        REQUIRE(dut.getRateLimitStats().limitedRequests_ == 1);
+
+        ioc.stop();
+        t.join();
+    }
+
+    SECTION("it should refuse http2 streams over the rate") {
+        dut.setRateLimit(RateLimit(1, 2, 0, 4096, 60s));
+        dut.setHttp2(Http2Options(true));
+        auto t = std::thread(&asio::io_context::run, &ioc);
+        std::vector<Header> headers;
+        uint32_t resetError = 0;
+
+        // the first stream has the token taken when accepted
+        asio::write(socket,
+                    asio::buffer(Http2ClientPreface + http2Request(1, "/api/one") +
+                                 http2Request(3, "/api/two") + http2Request(5, "/api/three")));
+        // a refused stream is reset before the others are answered
+        readHttp2Stream(socket, response, 5, headers, &resetError);
+        REQUIRE(resetError == Http2Session::refused_stream);
+        REQUIRE(readHttp2Stream(socket, response, 1, headers) == "some content");
+        REQUIRE(readHttp2Stream(socket, response, 3, headers) == "some content");
+        REQUIRE(dut.getRateLimitStats().limitedRequests_ == 1);
+
+        ioc.stop();
+        t.join();
+    }
+}
+
+TEST_CASE("server with socket options", "[server]") {
+    asio::io_context ioc;
+
+    ContentHandler handler;
+    SocketOptions socketOptions(true, 64 * 1024, 64 * 1024, 1s, 16, true, 60s, 10s, 3, 16, 8);
+    HttpPersistence persistentOption(5s, 100, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption, 1024, socketOptions);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler(handler.callback());
+
+    SECTION("it should serve a burst of clients accepted in batches") {
+        // clients queue up in the backlog before the server runs
+        asio::io_context clientIoc;
+        std::vector<asio::ip::tcp::socket> sockets;
+        for (int i = 0; i < 12; ++i) {
+            sockets.push_back(connectTcp(clientIoc, port));
+            asio::write(sockets.back(), asio::buffer(GetApiRequest));
+        }
+        auto t = std::thread(&asio::io_context::run, &ioc);
+        for (auto& socket : sockets) {
+            REQUIRE(readStatusLine(socket) == "HTTP/1.0 200 OK\r");
+        }
+        REQUIRE(handler.mock_.getNoCalls() == 12);
+
+        ioc.stop();
+        t.join();
+    }
+}
+
+TEST_CASE("server with buffer pool", "[server]") {
+    asio::io_context ioc;
+    TestClient c1(ioc);
+    TestClient c2(ioc);
+
+    std::vector<char> buffer;
+    MockRequestHandler mockRequestHandler(buffer);
+    mockRequestHandler.setReturnToClient(true);
+    mockRequestHandler.setMockedReply(Reply::status_type::ok, "some content");
+    HttpPersistence persistentOption(5s, 100, 0);
+    Server dut(ioc, "127.0.0.1", "0", nullptr, persistentOption, 1024);
+    uint16_t port = dut.getBindedPort();
+    dut.addRequestHandler(std::bind(&MockRequestHandler::handleRequest,
+                                    &mockRequestHandler,
+                                    std::placeholders::_1,
+                                    std::placeholders::_2));
+    auto t = std::thread(&asio::io_context::run, &ioc);
+
+    // read the stats on the io_context thread
+    auto getStats = [&ioc, &dut] {
+        std::promise<BufferPool::Stats> stats;
+        asio::post(ioc, [&stats, &dut] { stats.set_value(dut.getBufferPoolStats()); });
+        return stats.get_future().get();
+    };
+
+    SECTION("it should return buffers to the pool when a keep-alive connection is idle") {
+        for (TestClient *client : {&c1, &c2}) {
+            openConnection(*client, "127.0.0.1", port);
+            REQUIRE(getStats().inUse_ == 0);
+
+            auto fut = createFutureResult(*client);
+            client->sendRequest(GetApiRequest);
+            auto res = fut.get();
+            REQUIRE(res.statusCode_ == 200);
+
+            // the reply may reach the client before the write completes
+            auto stats = getStats();
+            for (int n = 0; n < 100 && stats.inUse_ != 0; ++n) {
+                std::this_thread::sleep_for(10ms);
+                stats = getStats();
+            }
+            REQUIRE(stats.inUse_ == 0);
+            REQUIRE(stats.free_ == 2);
+        }
+        // the second connection reused the buffers of the first
+        REQUIRE(getStats().allocations_ == 2);
+        REQUIRE(getStats().reuses_ == 2);
+    }
+
+    ioc.stop();
+    t.join();
+}
+
 TEST_CASE("server with write fileIO", "[server]") {
     asio::io_context ioc;
     TestClient c(ioc);
@@ -426,6 +1581,7 @@ TEST_CASE("server with write fileIO", "[server]") {
     HttpPersistence persistentOption(0s, 0, 0);
     Server dut(ioc, "127.0.0.1", "0", &mockFileIO, persistentOption);
     uint16_t port = dut.getBindedPort();
+    dut.setRawUploads(true);
     auto t = std::thread(&asio::io_context::run, &ioc);
 
     SECTION("it should handle a complete multipart request") {
@@ -459,6 +1615,38 @@ TEST_CASE("server with write fileIO", "[server]") {
         std::vector<char> expected = {'F', 'i', 'r', 's', 't', ' ', 'p', 'a', 'r', 't', '\n'};
         REQUIRE(result == expected);
     }
+    SECTION("it should stream a PUT body to fileIO") {
+        std::string body(5000, ' ');
+        for (size_t i = 0; i < body.size(); ++i) {
+            body[i] = static_cast<char>('a' + i % 26);
+        }
+        openConnection(c, "127.0.0.1", port);
+
+        auto fut = createFutureResult(c);
+        c.sendRequest("PUT /firmware.bin HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                      "Content-Type: application/octet-stream\r\nConnection: close\r\n"
+                      "Content-Length: " +
+                      std::to_string(body.size()) + "\r\n\r\n" + body);
+        auto res = fut.get();
+        REQUIRE(res.statusCode_ == 201);  // MockFileIO::openFileForWrite returns 201
+        REQUIRE(mockFileIO.getOpenFileForWriteCalls() == 1);
+        REQUIRE(mockFileIO.getLastData("/firmware.bin0") == true);
+        REQUIRE(mockFileIO.getMockWriteFile("/firmware.bin0") == convertToCharVec(body));
+    }
+    SECTION("it should stream a raw POST body to fileIO") {
+        const std::string body = "{\"key\":\"value\"}";
+        openConnection(c, "127.0.0.1", port);
+
+        auto fut = createFutureResult(c);
+        c.sendRequest("POST /data.json HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                      "Content-Type: application/json\r\nConnection: close\r\n"
+                      "Content-Length: " +
+                      std::to_string(body.size()) + "\r\n\r\n" + body);
+        auto res = fut.get();
+        REQUIRE(res.statusCode_ == 201);
+        REQUIRE(mockFileIO.getLastData("/data.json0") == true);
+        REQUIRE(mockFileIO.getMockWriteFile("/data.json0") == convertToCharVec(body));
+    }
     SECTION("it should handle divided multipart request with request headers only") {
         const std::string request1 =
             "POST / HTTP/1.1\r\n"
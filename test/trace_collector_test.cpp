@@ -0,0 +1,81 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <string>
+
+#include "trace_collector.hpp"
+
+using namespace beauty;
+
+namespace {
+
+size_t countOf(const std::string &str, const std::string &sub) {
+    size_t count = 0;
+    for (size_t pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+void simulateRequest(TraceCollector &collector, unsigned connectionId) {
+    auto t = IRequestObserver::now();
+    collector.onFirstByte(connectionId, t);
+    collector.onHeadParsed(connectionId, t + std::chrono::microseconds(10));
+    collector.onDecodeDone(connectionId, t + std::chrono::microseconds(20));
+    collector.onMiddlewareReturned(connectionId, 0, false, t + std::chrono::microseconds(30));
+    collector.onFileOpened(connectionId, 100, t + std::chrono::microseconds(40));
+    collector.onHeadersWritten(connectionId, t + std::chrono::microseconds(50));
+    collector.onBodyChunkWritten(connectionId, 100, t + std::chrono::microseconds(60));
+    collector.onResponseComplete(connectionId, t + std::chrono::microseconds(70));
+}
+
+}  // namespace
+
+TEST_CASE("trace collector", "[trace_collector]") {
+    TraceCollector collector(2);
+
+    SECTION("it should dump an empty trace") {
+        REQUIRE(collector.dumpChromeTrace() == "{\"traceEvents\":[],\"displayTimeUnit\":\"ms\"}");
+    }
+    SECTION("it should dump in-flight requests") {
+        collector.onAccept(0, IRequestObserver::now());
+        simulateRequest(collector, 0);
+        REQUIRE(collector.size() == 0);
+
+        std::string trace = collector.dumpChromeTrace();
+        REQUIRE(countOf(trace, "\"name\":\"request\"") == 1);
+        REQUIRE(countOf(trace, "\"name\":\"parse head\"") == 1);
+        REQUIRE(countOf(trace, "\"name\":\"write body\"") == 1);
+        REQUIRE(countOf(trace, "\"tid\":0") == 10);
+    }
+    SECTION("it should complete a keep-alive request on next first byte") {
+        simulateRequest(collector, 0);
+        simulateRequest(collector, 0);
+        REQUIRE(collector.size() == 1);
+        collector.onClose(0, IRequestObserver::now());
+        REQUIRE(collector.size() == 2);
+        REQUIRE(countOf(collector.dumpChromeTrace(), "\"name\":\"close\"") == 1);
+    }
+    SECTION("it should keep only the last requests") {
+        for (unsigned i = 0; i < 3; ++i) {
+            simulateRequest(collector, i);
+            collector.onClose(i, IRequestObserver::now());
+        }
+        REQUIRE(collector.size() == 2);
+        std::string trace = collector.dumpChromeTrace();
+        REQUIRE(countOf(trace, "\"tid\":0") == 0);
+        REQUIRE(countOf(trace, "\"name\":\"request\"") == 2);
+        REQUIRE(trace.find("\"tid\":1") < trace.find("\"tid\":2"));
+    }
+    SECTION("it should limit events per request") {
+        TraceCollector limited(1, 4);
+        simulateRequest(limited, 0);
+        REQUIRE(countOf(limited.dumpChromeTrace(), "\"tid\":0") == 5);
+    }
+    SECTION("it should clear") {
+        simulateRequest(collector, 0);
+        collector.onClose(0, IRequestObserver::now());
+        collector.clear();
+        REQUIRE(collector.size() == 0);
+        REQUIRE(countOf(collector.dumpChromeTrace(), "request") == 0);
+    }
+}
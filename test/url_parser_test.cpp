@@ -123,5 +123,50 @@ TEST_CASE("http", "[url_parser]") {
         REQUIRE(parser.hostname() == "hostname-01.org");
         REQUIRE(parser.path() == "/path/to/file");
     }
-}
 
+    SECTION("it should parse an IPv6 host") {
+        const char *text = "http://[2001:db8::1]:8080/dir?param=1";
+        UrlParser parser(text);
+
+        REQUIRE(parser.isValid() == true);
+        REQUIRE(parser.isIpv6());
+        REQUIRE(parser.hostname() == "2001:db8::1");
+        REQUIRE(parser.authority() == "[2001:db8::1]:8080");
+        REQUIRE(parser.httpPort() == 8080);
+        REQUIRE(parser.path() == "/dir");
+        REQUIRE(parser.query() == "param=1");
+    }
+    SECTION("it should parse an IPv6 host with zone and without port") {
+        const char *text = "https://[fe80::1%25eth0]";
+        UrlParser parser(text);
+
+        REQUIRE(parser.isValid() == true);
+        REQUIRE(parser.hostname() == "fe80::1%25eth0");
+        REQUIRE(parser.httpPort() == 443);
+        REQUIRE(parser.path() == "/");
+    }
+    SECTION("it should keep '?' within the query") {
+        UrlParser parser("http://host/p?a=?b#frag?");
+
+        REQUIRE(parser.isValid() == true);
+        REQUIRE(parser.query() == "a=?b");
+        REQUIRE(parser.fragment() == "frag?");
+    }
+    SECTION("it should reject invalid urls") {
+        REQUIRE(!UrlParser("").isValid());
+        REQUIRE(!UrlParser("/relative/path").isValid());
+        REQUIRE(!UrlParser("http://[::1/path").isValid());
+        REQUIRE(!UrlParser("http://[::1]x/path").isValid());
+        REQUIRE(!UrlParser("http://[::g]/path").isValid());
+        REQUIRE(!UrlParser("http://host:80a/path").isValid());
+        REQUIRE(!UrlParser("http://host:65536/path").isValid());
+        REQUIRE(!UrlParser("http://ho st/path").isValid());
+    }
+    SECTION("it should be reusable") {
+        UrlParser parser;
+        REQUIRE(!parser.parse("nonsense"));
+        REQUIRE(parser.parse("http://host:81"));
+        REQUIRE(parser.hostname() == "host");
+        REQUIRE(parser.httpPort() == 81);
+    }
+}
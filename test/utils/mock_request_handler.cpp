@@ -15,8 +15,6 @@ void MockRequestHandler::handleRequest(const Request& req, Reply& rep) {
     receivedRequest_.keepAlive_ = req.keepAlive_;
     receivedRequest_.requestPath_ = req.requestPath_;
     receivedRequest_.body_ = req.body_;
-    receivedRequest_.queryParams_ = req.queryParams_;
-    receivedRequest_.formParams_ = req.formParams_;
 
     receivedReply_.content_ = rep.content_;
     receivedReply_.filePath_ = rep.filePath_;
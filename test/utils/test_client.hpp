@@ -1,9 +1,11 @@
 #include <asio.hpp>
+#include <atomic>
 #include <condition_variable>
 #include <deque>
 #include <functional>
 #include <iostream>
 #include <istream>
+#include <map>
 #include <mutex>
 #include <ostream>
 #include <string>
@@ -62,17 +64,38 @@ class TestClient {
         int statusCode_;
     };
 
+    // Waits for the next result. Concurrent callers are served in the order
+    // they called, each with a copy of the result taken when it was reached.
     TestResult getResult(size_t expectedContentLength) {
-        expectedContentLength_ = expectedContentLength;
         std::unique_lock<std::mutex> lock(mutex_);
-        auto test = gotResult_.wait_for(lock, std::chrono::seconds(2));
-        if (test == std::cv_status::timeout) {
+        expectedContentLength_ = expectedContentLength;
+        size_t ticket = nextTicket_++;
+        bool gotIt = gotResult_.wait_for(lock, std::chrono::seconds(2), [this, ticket] {
+            return results_.count(ticket) > 0;
+        });
+        if (!gotIt) {
+            // leave the ticket served so later results go to later callers
+            if (nextServed_ <= ticket) {
+                nextServed_ = ticket + 1;
+            }
             return {TestResult::TimedOut, {}};
         }
-        return testResult_;
+        TestResult result = std::move(results_[ticket]);
+        results_.erase(ticket);
+        return result;
     }
 
    private:
+    // Hands a copy of the current result to the longest waiting caller of
+    // getResult(), if any.
+    void notifyResult() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (nextServed_ < nextTicket_) {
+            results_[nextServed_++] = testResult_;
+            gotResult_.notify_all();
+        }
+    }
+
     void handleResolve(const std::error_code& err,
                        const asio::ip::tcp::resolver::results_type& endpoints) {
         if (!err) {
@@ -90,7 +113,7 @@ class TestClient {
     void handleConnect(const std::error_code& err) {
         if (!err) {
             testResult_.action_ = TestResult::Opened;
-            gotResult_.notify_one();
+            notifyResult();
         } else {
             std::cout << "Error2: " << err.message() << ":" << err.value() << "\n";
         }
@@ -123,8 +146,8 @@ class TestClient {
             std::getline(responseStream, statusMessage);
 
             testResult_.action_ = TestResult::ReadRequestStatus;
-            gotResult_.notify_one();
             testResult_.statusCode_ = statusCode;
+            notifyResult();
 
             if (!responseStream) {
                 std::cout << "Invalid response stream\n";
@@ -174,7 +197,7 @@ class TestClient {
                 testResult_.headers_.push_back(header);
             }
             testResult_.action_ = TestResult::ReadHeaders;
-            gotResult_.notify_one();
+            notifyResult();
 
             // Write whatever content we already have to output.
             if (response_.size() > 0) {
@@ -183,7 +206,7 @@ class TestClient {
                                                 sizeof(decltype(testResult_.content_)::value_type));
                     asio::buffer_copy(asio::buffer(testResult_.content_), response_.data());
                     testResult_.action_ = TestResult::ReadContent;
-                    gotResult_.notify_one();
+                    notifyResult();
                 }
             }
 
@@ -205,7 +228,7 @@ class TestClient {
                                             sizeof(decltype(testResult_.content_)::value_type));
                 asio::buffer_copy(asio::buffer(testResult_.content_), response_.data());
                 testResult_.action_ = TestResult::ReadContent;
-                gotResult_.notify_one();
+                notifyResult();
             }
 
             // Continue reading remaining data until EOF.
@@ -223,9 +246,12 @@ class TestClient {
     asio::ip::tcp::socket socket_;
     asio::streambuf request_;
     asio::streambuf response_;
-    size_t expectedContentLength_;
+    std::atomic<size_t> expectedContentLength_{0};
     std::mutex mutex_;
     std::condition_variable gotResult_;
+    size_t nextTicket_ = 0;
+    size_t nextServed_ = 0;
+    std::map<size_t, TestResult> results_;
     TestResult testResult_;
     std::deque<std::string> multiPartRequests_;
     bool isMultiPart_ = false;
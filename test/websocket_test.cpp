@@ -0,0 +1,167 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "websocket.hpp"
+#include "websocket_frame_parser.hpp"
+
+using namespace beauty;
+
+namespace {
+
+const uint8_t mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+// A masked frame as sent by a client.
+std::vector<char> clientFrame(uint8_t firstByte, const std::string& payload) {
+    std::vector<char> frame;
+    frame.push_back(static_cast<char>(firstByte));
+    if (payload.size() < 126) {
+        frame.push_back(static_cast<char>(0x80 | payload.size()));
+    } else if (payload.size() <= 0xffff) {
+        frame.push_back(static_cast<char>(0x80 | 126));
+        frame.push_back(static_cast<char>(payload.size() >> 8));
+        frame.push_back(static_cast<char>(payload.size()));
+    } else {
+        frame.push_back(static_cast<char>(0x80 | 127));
+        for (int i = 7; i >= 0; --i) {
+            frame.push_back(static_cast<char>(static_cast<uint64_t>(payload.size()) >> (i * 8)));
+        }
+    }
+    frame.insert(frame.end(), mask, mask + 4);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        frame.push_back(static_cast<char>(payload[i] ^ mask[i & 3]));
+    }
+    return frame;
+}
+
+std::string toString(const WebSocketFrameParser::Chunk& chunk) {
+    return std::string(chunk.data_, chunk.size_);
+}
+
+}  // namespace
+
+TEST_CASE("websocket frame parser", "[websocket]") {
+    WebSocketFrameParser parser;
+    WebSocketFrameParser::Chunk chunk;
+
+    SECTION("it should unmask a frame in place") {
+        std::vector<char> frame = clientFrame(0x81, "Hello");
+        char* begin = frame.data();
+        REQUIRE(parser.parse(begin, frame.data() + frame.size(), chunk) ==
+                WebSocketFrameParser::chunk);
+        REQUIRE(chunk.opcode_ == WebSocketFrameParser::text);
+        REQUIRE(chunk.fin_);
+        REQUIRE(chunk.first_);
+        REQUIRE(chunk.last_);
+        REQUIRE(chunk.data_ == frame.data() + 6);
+        REQUIRE(toString(chunk) == "Hello");
+        REQUIRE(begin == frame.data() + frame.size());
+        REQUIRE(parser.parse(begin, frame.data() + frame.size(), chunk) ==
+                WebSocketFrameParser::indeterminate);
+    }
+    SECTION("it should parse several frames in one buffer") {
+        std::vector<char> data = clientFrame(0x01, "Hel");
+        std::vector<char> ping = clientFrame(0x89, "");
+        std::vector<char> last = clientFrame(0x80, "lo");
+        data.insert(data.end(), ping.begin(), ping.end());
+        data.insert(data.end(), last.begin(), last.end());
+        char* begin = data.data();
+        char* end = data.data() + data.size();
+
+        REQUIRE(parser.parse(begin, end, chunk) == WebSocketFrameParser::chunk);
+        REQUIRE(chunk.opcode_ == WebSocketFrameParser::text);
+        REQUIRE_FALSE(chunk.fin_);
+        REQUIRE(toString(chunk) == "Hel");
+        REQUIRE(parser.parse(begin, end, chunk) == WebSocketFrameParser::chunk);
+        REQUIRE(chunk.opcode_ == WebSocketFrameParser::ping);
+        REQUIRE(chunk.size_ == 0);
+        REQUIRE(chunk.last_);
+        REQUIRE(parser.parse(begin, end, chunk) == WebSocketFrameParser::chunk);
+        REQUIRE(chunk.opcode_ == WebSocketFrameParser::continuation);
+        REQUIRE(chunk.fin_);
+        REQUIRE(toString(chunk) == "lo");
+    }
+    SECTION("it should parse a frame split byte by byte") {
+        std::string payload(300, 'x');
+        std::vector<char> frame = clientFrame(0x82, payload);
+        std::string received;
+        for (size_t i = 0; i < frame.size(); ++i) {
+            char* begin = &frame[i];
+            WebSocketFrameParser::result_type result = parser.parse(begin, begin + 1, chunk);
+            if (i < 8) {
+                REQUIRE(result == WebSocketFrameParser::indeterminate);
+            } else {
+                REQUIRE(result == WebSocketFrameParser::chunk);
+                REQUIRE(chunk.first_ == (i == 8));
+                REQUIRE(chunk.last_ == (i == frame.size() - 1));
+                received += toString(chunk);
+            }
+        }
+        REQUIRE(received == payload);
+    }
+    SECTION("it should parse 64 bit lengths") {
+        std::string payload(70000, 'y');
+        payload[69999] = 'z';
+        std::vector<char> frame = clientFrame(0x82, payload);
+        char* begin = frame.data();
+        REQUIRE(parser.parse(begin, frame.data() + frame.size(), chunk) ==
+                WebSocketFrameParser::chunk);
+        REQUIRE(chunk.data_ == frame.data() + 14);
+        REQUIRE(toString(chunk) == payload);
+    }
+    SECTION("it should refuse invalid frames") {
+        std::vector<std::vector<char>> frames = {
+            {static_cast<char>(0x81), 0x05, 'H', 'e', 'l', 'l', 'o'},  // not masked
+            clientFrame(0xc1, "rsv"),                                     // reserved bit
+            clientFrame(0x83, "op"),                                      // reserved opcode
+            clientFrame(0x09, "ping"),                                    // fragmented control
+            clientFrame(0x89, std::string(126, 'p'))};                    // too long control
+        for (auto& frame : frames) {
+            parser.reset();
+            char* begin = frame.data();
+            REQUIRE(parser.parse(begin, frame.data() + frame.size(), chunk) ==
+                    WebSocketFrameParser::bad);
+        }
+    }
+    SECTION("it should unmask at any offset and length") {
+        std::string plain = "The quick brown fox jumps over the lazy dog";
+        for (size_t offset = 0; offset < 4; ++offset) {
+            for (size_t size = 0; size <= plain.size(); ++size) {
+                std::string data = plain.substr(0, size);
+                WebSocketFrameParser::unmask(&data[0], data.size(), mask, offset);
+                for (size_t i = 0; i < size; ++i) {
+                    REQUIRE(data[i] == static_cast<char>(plain[i] ^ mask[(offset + i) & 3]));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("websocket handshake", "[websocket]") {
+    SECTION("it should compute the accept key") {
+        // example from RFC 6455
+        REQUIRE(WebSocket::acceptKey("dGhlIHNhbXBsZSBub25jZQ==") ==
+                "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+    }
+    SECTION("it should encode frame headers") {
+        WebSocketFrame small(WebSocketFrameParser::text, "hi");
+        REQUIRE(small.headerSize_ == 2);
+        REQUIRE(static_cast<uint8_t>(small.header_[0]) == 0x81);
+        REQUIRE(small.header_[1] == 2);
+
+        WebSocketFrame medium(WebSocketFrameParser::binary, std::string(300, 'm'));
+        REQUIRE(medium.headerSize_ == 4);
+        REQUIRE(static_cast<uint8_t>(medium.header_[0]) == 0x82);
+        REQUIRE(medium.header_[1] == 126);
+        REQUIRE(static_cast<uint8_t>(medium.header_[2]) == 0x01);
+        REQUIRE(static_cast<uint8_t>(medium.header_[3]) == 0x2c);
+
+        WebSocketFrame large(WebSocketFrameParser::binary, std::string(70000, 'l'));
+        REQUIRE(large.headerSize_ == 10);
+        REQUIRE(large.header_[1] == 127);
+        REQUIRE(static_cast<uint8_t>(large.header_[7]) == 0x01);
+        REQUIRE(static_cast<uint8_t>(large.header_[8]) == 0x11);
+        REQUIRE(static_cast<uint8_t>(large.header_[9]) == 0x70);
+    }
+}